@@ -0,0 +1,124 @@
+// admin.c - local administration endpoint.
+
+#include <stdbool.h>
+#include <string.h>
+#include <threads.h>
+
+#include <winsock2.h>
+
+#include "debug.h"
+#include "net.h"
+#include "game.h"
+#include "metrics.h"
+#include "lock_profile.h"
+#include "admin.h"
+
+static thrd_t worker_tid;
+static volatile bool working = false;
+static SOCKET s = INVALID_SOCKET;
+
+static int __admin_worker(void *unused);
+
+bool admin_start(unsigned short port)
+{
+    if (!port)
+    {
+        port = PORT + ADMIN_PORT_OFFSET;
+    }
+
+    WSADATA winsockData;
+    check(0 == WSAStartup(MAKEWORD(2, 2), &winsockData), "Failed to initialize winsock. Error: %d.", WSAGetLastError());
+
+    s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    check(INVALID_SOCKET != s, "Failed to create admin socket. Error: %d.", WSAGetLastError());
+
+    // Only local scrapers may connect.
+    SOCKADDR_IN s_address = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    check(SOCKET_ERROR != bind(s, (const SOCKADDR *) &s_address, sizeof(s_address)), "Failed to bind admin socket. Error: %d.", WSAGetLastError());
+
+    working = true;
+    check(thrd_success == thrd_create(&worker_tid, __admin_worker, NULL), "Failed to start admin worker thread.", "");
+
+    log_info("admin endpoint: 127.0.0.1:%u.", (unsigned) port);
+    return true;
+
+    error:
+    working = false;
+    if (INVALID_SOCKET != s)
+    {
+        closesocket(s);
+        s = INVALID_SOCKET;
+    }
+    WSACleanup();
+    return false;
+}
+
+void admin_stop(void)
+{
+    if (!working)
+    {
+        return;
+    }
+
+    working = false;
+    shutdown(s, SD_RECEIVE);
+    closesocket(s);
+    s = INVALID_SOCKET;
+    thrd_join(worker_tid, NULL);
+    WSACleanup();
+}
+
+static int __admin_worker(void *unused)
+{
+    #pragma ref unused
+
+    log_info("start. tid: %u", GetCurrentThreadId());
+
+    static char request[PACKET_BUFFER];
+    static char response[METRICS_REPORT_SIZE];
+    static MetricsHistogram phases[metrics_phase_count];
+
+    while (working)
+    {
+        SOCKADDR sender_address;
+        int sender_address_size = sizeof(sender_address);
+        int res = recvfrom(s, request, sizeof(request) - 1, 0, &sender_address, &sender_address_size);
+
+        if (!working)
+        {
+            break;
+        }
+
+        if (SOCKET_ERROR == res || 0 == res)
+        {
+            continue;
+        }
+
+        // Trailing line end is allowed, so requests may be sent with echo.
+        request[res] = '\0';
+        request[strcspn(request, "\r\n")] = '\0';
+
+        size_t length;
+        if (0 == strcmp(ADMIN_REQUEST_METRICS, request))
+        {
+            game_collect_phase_times(phases);
+            length = metrics_format(response, sizeof(response), phases);
+        }
+        else if (0 == strcmp(ADMIN_REQUEST_LOCKS, request))
+        {
+            length = lock_profile_format(response, sizeof(response));
+        }
+        else
+        {
+            length = (size_t) snprintf(response, sizeof(response), "Unknown command. Commands: %s, %s.\n", ADMIN_REQUEST_METRICS, ADMIN_REQUEST_LOCKS);
+        }
+
+        if (SOCKET_ERROR == sendto(s, response, (int) length, 0, &sender_address, sender_address_size))
+        {
+            log_error("Failed to send admin response. Error: %d.", WSAGetLastError());
+        }
+    }
+
+    log_info("end.", "");
+    return 0;
+}
@@ -0,0 +1,22 @@
+// admin.h - local administration endpoint.
+
+#pragma once
+#ifndef __ADMIN_H__
+#define __ADMIN_H__
+
+//#pragma message("__ADMIN_H__")
+
+#include <stdbool.h>
+
+#include "morrigan.h"
+
+// Endpoint listens on loopback UDP port: game port + ADMIN_PORT_OFFSET.
+#define ADMIN_PORT_OFFSET 1
+#define ADMIN_REQUEST_METRICS "metrics"
+#define ADMIN_REQUEST_LOCKS "locks"
+
+// Request is a datagram with command name, response is text.
+bool admin_start(unsigned short port);
+void admin_stop(void);
+
+#endif /* __ADMIN_H__ */
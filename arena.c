@@ -0,0 +1,219 @@
+// arena.c - arena (single match) implementation.
+
+#include <assert.h>
+
+#include "debug.h"
+#include "arena.h"
+#include "scheduler.h"
+
+static bool __arena_clients_add(Arena *a, Client *c);
+
+Arena *arena_create(size_t id, const Landscape *l, uint64_t seed)
+{
+    assert(l && "Bad landscape pointer.");
+
+    Arena *a = (Arena *) calloc(1, sizeof(Arena));
+    check_mem(a);
+
+    a->id = id;
+    a->landscape = l;
+    a->tick = 0;
+    a->random_state = seed;
+    a->journal = NULL;
+
+    check(client_array_reserve(&a->clients, MAX_CLIENTS), "Failed to reserve clients.", "");
+    check(viewer_array_reserve(&a->viewers, MAX_VIEWERS), "Failed to reserve viewers.", "");
+    check_mem(a->world = world_create());
+    check(arena_shell_result_array_reserve(&a->shell_results, 16), "Failed to reserve shell results.", "");
+
+    check(thrd_success == mtx_init(&a->mutex, mtx_plain), "Failed to initialize arena mutex.", "");
+
+    return a;
+    error:
+    if (a)
+    {
+        client_array_destroy(&a->clients);
+        viewer_array_destroy(&a->viewers);
+
+        if (a->world)
+        {
+            world_destroy(a->world);
+        }
+
+        arena_shell_result_array_destroy(&a->shell_results);
+
+        free(a);
+    }
+    return NULL;
+}
+
+void arena_destroy(Arena *a)
+{
+    assert(a && "Nothing to destroy.");
+
+    if (a->journal)
+    {
+        journal_destroy(a->journal);
+    }
+
+    arena_shell_result_array_destroy(&a->shell_results);
+    world_destroy(a->world);
+    viewer_array_destroy(&a->viewers);
+    client_array_destroy(&a->clients);
+    mtx_destroy(&a->mutex);
+    free(a);
+}
+
+// Only contended locking is timed.
+void arena_lock(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    if (thrd_success == mtx_trylock(&a->mutex))
+    {
+        return;
+    }
+
+    uint64_t start = scheduler_now();
+    check(thrd_success == mtx_lock(&a->mutex), "Failed to lock arena mutex.", "");
+    metrics_lock_wait(metrics_lock_arena, scheduler_now() - start);
+    error:
+    return;
+}
+
+void arena_unlock(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+    check(thrd_success == mtx_unlock(&a->mutex), "Failed to unlock arena mutex.", "");
+    error:
+    return;
+}
+
+// 64-bit LCG (Knuth's MMIX constants), high bits are returned.
+uint32_t arena_random(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+    a->random_state = a->random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t) (a->random_state >> 32);
+}
+
+bool arena_add_client(Arena *a, NetworkClient *c)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+
+    Client *client = (Client *) c;
+    client->tank = world_tank_allocate(a->world, client);
+    if (TANK_NONE == client->tank)
+    {
+        return false;
+    }
+
+    if (!__arena_clients_add(a, client))
+    {
+        world_tank_free(a->world, client->tank);
+        client->tank = TANK_NONE;
+        return false;
+    }
+
+    if (a->journal)
+    {
+        journal_write_join(a->journal, client->tank);
+    }
+
+    return true;
+}
+
+void arena_remove_client(Arena *a, const NetworkClient *c)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+
+    if (a->journal)
+    {
+        journal_write_leave(a->journal, ((const Client *) c)->tank);
+    }
+
+    a->turn_ended[((const Client *) c)->tank] = false;
+    world_tank_free(a->world, ((const Client *) c)->tank);
+
+    for (size_t i = 0; i < a->clients.count; i++)
+    {
+        if (c == &a->clients.data[i]->network_client)
+        {
+            client_array_swap_remove(&a->clients, i);
+            return;
+        }
+    }
+}
+
+// Tank slot is already filled from checkpoint, only client is attached to it.
+bool arena_restore_client(Arena *a, NetworkClient *c, TankHandle t)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+    assert(t < WORLD_MAX_TANKS && a->world->tank_used[t] && "Bad tank handle.");
+
+    Client *client = (Client *) c;
+    if (!__arena_clients_add(a, client))
+    {
+        return false;
+    }
+
+    client->tank = t;
+    a->world->tank_client[t] = client;
+    return true;
+}
+
+bool arena_add_viewer(Arena *a, NetworkClient *c)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+    assert(NULL == c->arena && "Client already is in arena.");
+
+    if (MAX_VIEWERS == a->viewers.count)
+    {
+        return false;
+    }
+
+    check(viewer_array_push(&a->viewers, (ViewerClient *) c), "Failed to add viewer to arena.", "");
+    c->arena = a;
+    return true;
+
+    error:
+    return false;
+}
+
+void arena_remove_viewer(Arena *a, const NetworkClient *c)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+
+    for (size_t i = 0; i < a->viewers.count; i++)
+    {
+        if (c == &a->viewers.data[i]->network_client)
+        {
+            viewer_array_swap_remove(&a->viewers, i);
+            return;
+        }
+    }
+}
+
+static bool __arena_clients_add(Arena *a, Client *c)
+{
+    assert(a && "Bad arena pointer.");
+    assert(c && "Bad client pointer.");
+    assert(NULL == c->network_client.arena && "Client already is in arena.");
+
+    if (MAX_CLIENTS == a->clients.count)
+    {
+        return false;
+    }
+
+    check(client_array_push(&a->clients, c), "Failed to add client to arena.", "");
+    c->network_client.arena = a;
+    return true;
+
+    error:
+    return false;
+}
@@ -0,0 +1,71 @@
+// arena.h - arena (single match) implementation.
+
+#pragma once
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+//#pragma message("__ARENA_H__")
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "morrigan.h"
+#include "typed_array.h"
+#include "landscape.h"
+#include "server.h"
+#include "world.h"
+#include "journal.h"
+#include "metrics.h"
+
+#pragma pack(push, 8)
+
+typedef struct ArenaShellResult
+{
+    bool alive;      // Shell hasn't hit landscape or left it.
+    TankHandle hit_tank;
+} ArenaShellResult;
+
+TYPED_ARRAY_DEFINE(ArenaShellResultArray, arena_shell_result_array, ArenaShellResult)
+
+typedef struct Arena
+{
+    size_t id;
+    const Landscape *landscape; // Shared between arenas, read-only.
+    ClientArray clients;
+    ViewerArray viewers;
+    World *world;               // Tanks and shells.
+    unsigned long long tick;
+    uint64_t random_state; // Arena has own generator, so match is reproducible from seed.
+    Journal *journal;      // Match recording, NULL if disabled.
+    mtx_t mutex;
+
+    // Results of parallel tick phases, indexed by tank / shell handles. See game.c.
+    bool tank_hit_bound[MAX_CLIENTS];
+    bool tank_intersections[MAX_CLIENTS][MAX_CLIENTS];
+    ArenaShellResultArray shell_results;
+
+    // Clients which have sent "end of turn" since last tick, indexed by tank handles.
+    bool turn_ended[MAX_CLIENTS];
+    uint64_t turn_deadline; // Lockstep mode: monotonic time when tick starts without waiting for clients.
+
+    MetricsHistogram phase_times[metrics_phase_count]; // Tick phase durations.
+} Arena;
+
+#pragma pack(pop)
+
+Arena *arena_create(size_t id, const Landscape *l, uint64_t seed);
+void arena_destroy(Arena *a);
+
+void arena_lock(Arena *a);
+void arena_unlock(Arena *a);
+
+// Arena must be locked by caller.
+uint32_t arena_random(Arena *a);
+bool arena_add_client(Arena *a, NetworkClient *c);
+void arena_remove_client(Arena *a, const NetworkClient *c);
+bool arena_restore_client(Arena *a, NetworkClient *c, TankHandle t);
+bool arena_add_viewer(Arena *a, NetworkClient *c);
+void arena_remove_viewer(Arena *a, const NetworkClient *c);
+
+#endif /* __ARENA_H__ */
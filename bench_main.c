@@ -0,0 +1,485 @@
+// bench_main.c - main() for microbenchmarks of geometry and container kernels.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "debug.h"
+#include "vector.h"
+#include "matrix.h"
+#include "bounding.h"
+#include "landscape.h"
+#include "dynamic_array.h"
+#include "scheduler.h"
+
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_INPUTS 1024 // Power of two.
+#define BENCH_ARRAY_SIZE 1024
+#define BENCH_MIN_TIME (SCHEDULER_NSEC_PER_SEC / 20) // Of calibrated run.
+#define BENCH_REPEATS 5
+
+#pragma pack(push, 8)
+
+// Runs ops operations, returns elapsed time in nanoseconds.
+typedef uint64_t (*BenchmarkFunction)(size_t ops);
+
+typedef struct Benchmark
+{
+    const char *name;
+    BenchmarkFunction run;
+} Benchmark;
+
+typedef struct BenchmarkResult
+{
+    size_t ops;
+    double ns_per_op;     // Median of repeats.
+    double min_ns_per_op;
+} BenchmarkResult;
+
+#pragma pack(pop)
+
+static uint64_t random_state = BENCH_DEFAULT_SEED;
+static volatile double sink; // Keeps results alive.
+
+static const Landscape *l = NULL;
+
+// Bounding inputs reference these.
+static Vector origins[BENCH_INPUTS], previous_origins[BENCH_INPUTS], orientations[BENCH_INPUTS], directions[BENCH_INPUTS];
+static double speeds[BENCH_INPUTS];
+static Bounding boxes[BENCH_INPUTS], spheres[BENCH_INPUTS], composites[BENCH_INPUTS];
+static Bounding composite_children[BENCH_INPUTS][2];
+
+static Vector points[BENCH_INPUTS], segment_ends[BENCH_INPUTS];
+static double angles[BENCH_INPUTS];
+static Matrix matrices[BENCH_INPUTS];
+static size_t indices[BENCH_INPUTS];
+
+static double __random(double from, double to);
+static void __random_unit(Vector *v);
+static void __prepare(void);
+static bool __measure(const Benchmark *b, BenchmarkResult *result);
+static int __compare_doubles(const void *a, const void *b);
+
+static uint64_t __bench_box_box(size_t ops);
+static uint64_t __bench_box_sphere(size_t ops);
+static uint64_t __bench_composite(size_t ops);
+static uint64_t __bench_landscape_segment(size_t ops);
+static uint64_t __bench_landscape_height(size_t ops);
+static uint64_t __bench_landscape_normal(size_t ops);
+static uint64_t __bench_vector_rotate(size_t ops);
+static uint64_t __bench_matrix_invert(size_t ops);
+static uint64_t __bench_array_push(size_t ops);
+static uint64_t __bench_array_delete_at(size_t ops);
+static uint64_t __bench_array_swap_remove(size_t ops);
+
+static const Benchmark benchmarks[] =
+{
+    { .name = "intersection_test_box_box",         .run = __bench_box_box },
+    { .name = "intersection_test_box_sphere",      .run = __bench_box_sphere },
+    { .name = "intersection_test_composite",       .run = __bench_composite },
+    { .name = "landscape_intersects_with_segment", .run = __bench_landscape_segment },
+    { .name = "landscape_get_height_at",           .run = __bench_landscape_height },
+    { .name = "landscape_get_normal_at",           .run = __bench_landscape_normal },
+    { .name = "vector_rotate",                     .run = __bench_vector_rotate },
+    { .name = "matrix_invert",                     .run = __bench_matrix_invert },
+    { .name = "dynamic_array_push",                .run = __bench_array_push },
+    { .name = "dynamic_array_delete_at",           .run = __bench_array_delete_at },
+    { .name = "dynamic_array_swap_remove",         .run = __bench_array_swap_remove }
+};
+
+// Usage: morrigan_bench [<results.csv> | - [<landscape> [<seed> [<filter>]]]]
+// Results file is CSV for comparing runs: benchmark,ops,ns_per_op,min_ns_per_op,ops_per_sec.
+int main(int argc, char *argv[])
+{
+    FILE *results = NULL;
+    Landscape *landscape = NULL;
+    const char *filter = 4 < argc ? argv[4] : NULL;
+
+    if (1 < argc && 0 != strcmp("-", argv[1]))
+    {
+        results = fopen(argv[1], "w");
+        check(results, "Failed to open results file %s.", argv[1]);
+        fprintf(results, "benchmark,ops,ns_per_op,min_ns_per_op,ops_per_sec\n");
+    }
+
+    check(landscape = landscape_load(2 < argc ? argv[2] : LANDSCAPE_DEFAULT_FILE, LANDSCAPE_DEFAULT_TILE_SIZE, LANDSCAPE_DEFAULT_SCALE),
+          "Failed to load landscape.",
+          "");
+    l = landscape;
+
+    random_state = 3 < argc ? strtoull(argv[3], NULL, 10) : BENCH_DEFAULT_SEED;
+    printf("Seed: %llu, inputs: %u.\n", (unsigned long long) random_state, (unsigned) BENCH_INPUTS);
+    __prepare();
+
+    printf("%-36s %12s %12s %12s %14s\n", "benchmark", "ops", "ns/op", "min ns/op", "ops/s");
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        const Benchmark *b = &benchmarks[i];
+        if (filter && NULL == strstr(b->name, filter))
+        {
+            continue;
+        }
+
+        BenchmarkResult result;
+        check(__measure(b, &result), "Failed to run %s.", b->name);
+
+        double ops_per_sec = 1e9 / result.ns_per_op;
+        printf("%-36s %12llu %12.1f %12.1f %14.0f\n", b->name, (unsigned long long) result.ops, result.ns_per_op, result.min_ns_per_op, ops_per_sec);
+
+        if (results)
+        {
+            fprintf(results, "%s,%llu,%.3f,%.3f,%.0f\n", b->name, (unsigned long long) result.ops, result.ns_per_op, result.min_ns_per_op, ops_per_sec);
+        }
+    }
+
+    if (results)
+    {
+        check(0 == fclose(results), "Failed to write results.", "");
+    }
+    landscape_destroy(landscape);
+    return EXIT_SUCCESS;
+
+    error:
+    if (results)
+    {
+        fclose(results);
+    }
+    if (landscape)
+    {
+        landscape_destroy(landscape);
+    }
+    return EXIT_FAILURE;
+}
+
+// Same generator as arenas use, so inputs don't depend on C library.
+static double __random(double from, double to)
+{
+    random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return from + (to - from) * (double) (random_state >> 11) / (double) (1ULL << 53);
+}
+
+static void __random_unit(Vector *v)
+{
+    do
+    {
+        *v = (Vector) { .x = __random(-1, 1), .y = __random(-1, 1), .z = __random(-1, 1) };
+    } while (vector_length(v) < 0.1);
+
+    VECTOR_NORMALIZE(v);
+}
+
+// Boundings are scattered in a cube, so that some of them intersect.
+// Points lie on landscape, segments are shell steps near its surface.
+static void __prepare(void)
+{
+    double side = (double) ((l->landscape_size - 1) * l->tile_size) - 1.0;
+
+    for (size_t i = 0; i < BENCH_INPUTS; i++)
+    {
+        origins[i] = (Vector) { .x = __random(0, 30), .y = __random(0, 30), .z = __random(0, 30) };
+        __random_unit(&orientations[i]);
+        vector_get_orthogonal(&orientations[i], &directions[i]);
+        VECTOR_NORMALIZE(&directions[i]);
+        speeds[i] = __random(0, 2);
+        vector_sub(&origins[i], vector_scale(&directions[i], speeds[i], &previous_origins[i]), &previous_origins[i]);
+
+        Bounding base = {
+            .origin          = &origins[i],
+            .previous_origin = &previous_origins[i],
+            .orientation     = &orientations[i],
+            .direction       = &directions[i],
+            .offset          = { .x = 0, .y = 0, .z = 0 },
+            .speed           = &speeds[i]
+        };
+
+        boxes[i] = base;
+        boxes[i].bounding_type = bounding_box;
+        boxes[i].data.extent = (Vector) { .x = __random(1, 4), .y = __random(1, 4), .z = __random(1, 4) };
+
+        spheres[i] = base;
+        spheres[i].bounding_type = bounding_sphere;
+        spheres[i].data.radius = __random(0.5, 3);
+
+        // Like tank: hull box and turret sphere.
+        composite_children[i][0] = boxes[i];
+        composite_children[i][1] = spheres[i];
+        composite_children[i][1].offset = (Vector) { .x = 2, .y = 0, .z = spheres[i].data.radius };
+        composites[i] = base;
+        composites[i].bounding_type = bounding_composite;
+        composites[i].data.composite_data.children = composite_children[i];
+        composites[i].data.composite_data.children_count = 2;
+
+        points[i] = (Vector) { .x = __random(0, side), .y = __random(0, side), .z = 0 };
+        points[i].z = landscape_get_height_at(l, points[i].x, points[i].y) + __random(-5, 20);
+
+        Vector step;
+        __random_unit(&step);
+        vector_add(&points[i], vector_scale(&step, __random(5, 30), &step), &segment_ends[i]);
+        segment_ends[i].x = fmin(fmax(segment_ends[i].x, 0), side);
+        segment_ends[i].y = fmin(fmax(segment_ends[i].y, 0), side);
+
+        angles[i] = __random(-M_PI, M_PI);
+
+        // Diagonally dominant, so invertible.
+        for (size_t r = 0; r < 3; r++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                matrices[i].values[r][c] = r == c ? __random(4, 8) : __random(-1, 1);
+            }
+        }
+
+        indices[i] = (size_t) __random(0, BENCH_ARRAY_SIZE);
+    }
+}
+
+// Operation count is doubled until run takes BENCH_MIN_TIME, then run is repeated.
+static bool __measure(const Benchmark *b, BenchmarkResult *result)
+{
+    assert(b && "Bad benchmark pointer.");
+    assert(result && "Bad result pointer.");
+
+    size_t ops = 16;
+    uint64_t elapsed = 0;
+    while ((elapsed = b->run(ops)) < BENCH_MIN_TIME)
+    {
+        check(ops < ((size_t) 1 << 40), "Clock doesn't advance.", "");
+        ops *= 2;
+    }
+
+    double ns_per_op[BENCH_REPEATS];
+    for (size_t i = 0; i < BENCH_REPEATS; i++)
+    {
+        ns_per_op[i] = (double) b->run(ops) / (double) ops;
+    }
+
+    qsort(ns_per_op, BENCH_REPEATS, sizeof(ns_per_op[0]), __compare_doubles);
+    *result = (BenchmarkResult) {
+        .ops           = ops,
+        .ns_per_op     = ns_per_op[BENCH_REPEATS / 2],
+        .min_ns_per_op = ns_per_op[0]
+    };
+    return true;
+    error:
+    return false;
+}
+
+static int __compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t __bench_box_box(size_t ops)
+{
+    double t, total = 0;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        total += intersection_test(&boxes[i & (BENCH_INPUTS - 1)], &boxes[(i * 7 + 1) & (BENCH_INPUTS - 1)], &t) ? 1 : 0;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_box_sphere(size_t ops)
+{
+    double t, total = 0;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        total += intersection_test(&boxes[i & (BENCH_INPUTS - 1)], &spheres[(i * 7 + 1) & (BENCH_INPUTS - 1)], &t) ? 1 : 0;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_composite(size_t ops)
+{
+    double t, total = 0;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        total += intersection_test(&composites[i & (BENCH_INPUTS - 1)], &composites[(i * 7 + 1) & (BENCH_INPUTS - 1)], &t) ? 1 : 0;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_landscape_segment(size_t ops)
+{
+    double total = 0;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        double t = landscape_intersects_with_segment(l, &points[i & (BENCH_INPUTS - 1)], &segment_ends[i & (BENCH_INPUTS - 1)]);
+        total += isnan(t) ? 0 : t;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_landscape_height(size_t ops)
+{
+    double total = 0;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        const Vector *p = &points[i & (BENCH_INPUTS - 1)];
+        total += landscape_get_height_at(l, p->x, p->y);
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_landscape_normal(size_t ops)
+{
+    double total = 0;
+    Vector normal;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        const Vector *p = &points[i & (BENCH_INPUTS - 1)];
+        total += landscape_get_normal_at(l, p->x, p->y, &normal)->z;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_vector_rotate(size_t ops)
+{
+    double total = 0;
+    Vector rotated;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        size_t j = i & (BENCH_INPUTS - 1);
+        total += vector_rotate(&directions[j], &orientations[j], angles[j], &rotated)->x;
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+static uint64_t __bench_matrix_invert(size_t ops)
+{
+    double total = 0;
+    Matrix inverted;
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        total += matrix_invert(&matrices[i & (BENCH_INPUTS - 1)], &inverted)->values[0][0];
+    }
+
+    uint64_t elapsed = scheduler_now() - start;
+    sink = total;
+    return elapsed;
+}
+
+// Arrays start small and grow to BENCH_ARRAY_SIZE elements, like client lists do.
+static uint64_t __bench_array_push(size_t ops)
+{
+    uint64_t elapsed = 0;
+
+    for (size_t done = 0; done < ops; done += BENCH_ARRAY_SIZE)
+    {
+        uint64_t start = scheduler_now();
+        DynamicArray *a = DYNAMIC_ARRAY_CREATE(Vector, 1);
+        check_mem(a);
+
+        for (size_t i = 0; i < BENCH_ARRAY_SIZE; i++)
+        {
+            check(dynamic_array_push(a, &points[i & (BENCH_INPUTS - 1)]), "Failed to push.", "");
+        }
+
+        sink = DYNAMIC_ARRAY_GET(Vector *, a, BENCH_ARRAY_SIZE - 1)->x;
+        dynamic_array_destroy(a);
+        elapsed += scheduler_now() - start;
+    }
+
+    // Time per push, whole arrays are pushed.
+    return elapsed * ops / (((ops + BENCH_ARRAY_SIZE - 1) / BENCH_ARRAY_SIZE) * BENCH_ARRAY_SIZE);
+    error:
+    exit(EXIT_FAILURE);
+}
+
+// Full arrays are emptied by deletes at random positions. Filling isn't timed.
+static uint64_t __bench_array_delete_at(size_t ops)
+{
+    uint64_t elapsed = 0;
+    DynamicArray *a = DYNAMIC_ARRAY_CREATE(Vector, BENCH_ARRAY_SIZE);
+    check_mem(a);
+
+    for (size_t done = 0; done < ops; done += BENCH_ARRAY_SIZE)
+    {
+        for (size_t i = 0; i < BENCH_ARRAY_SIZE; i++)
+        {
+            check(dynamic_array_push(a, &points[i & (BENCH_INPUTS - 1)]), "Failed to push.", "");
+        }
+
+        uint64_t start = scheduler_now();
+        for (size_t count = BENCH_ARRAY_SIZE; count > 0; count--)
+        {
+            dynamic_array_delete_at(a, indices[count & (BENCH_INPUTS - 1)] % count);
+        }
+        elapsed += scheduler_now() - start;
+    }
+
+    dynamic_array_destroy(a);
+    return elapsed * ops / (((ops + BENCH_ARRAY_SIZE - 1) / BENCH_ARRAY_SIZE) * BENCH_ARRAY_SIZE);
+    error:
+    exit(EXIT_FAILURE);
+}
+
+// Same as delete_at, with unordered removal.
+static uint64_t __bench_array_swap_remove(size_t ops)
+{
+    uint64_t elapsed = 0;
+    DynamicArray *a = DYNAMIC_ARRAY_CREATE(Vector, BENCH_ARRAY_SIZE);
+    check_mem(a);
+
+    for (size_t done = 0; done < ops; done += BENCH_ARRAY_SIZE)
+    {
+        for (size_t i = 0; i < BENCH_ARRAY_SIZE; i++)
+        {
+            check(dynamic_array_push(a, &points[i & (BENCH_INPUTS - 1)]), "Failed to push.", "");
+        }
+
+        uint64_t start = scheduler_now();
+        for (size_t count = BENCH_ARRAY_SIZE; count > 0; count--)
+        {
+            dynamic_array_swap_remove(a, indices[count & (BENCH_INPUTS - 1)] % count);
+        }
+        elapsed += scheduler_now() - start;
+    }
+
+    dynamic_array_destroy(a);
+    return elapsed * ops / (((ops + BENCH_ARRAY_SIZE - 1) / BENCH_ARRAY_SIZE) * BENCH_ARRAY_SIZE);
+    error:
+    exit(EXIT_FAILURE);
+}
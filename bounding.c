@@ -474,6 +474,7 @@ static void __swap(double *a, double *b)
 
 #include "tank.h"
 #include "shell.h"
+#include "world.h"
 
 #include "testhelp.h"
 
@@ -547,25 +548,32 @@ int main(void)
 
     landscape_destroy(l);
 
-    Tank tank;
-    tank_initialize(&tank, &(Vector) { .x = 0, .y = 0, .z = 0 }, &(Vector) { .x = 0, .y = 0, .z = 1 }, 0);
-    Shell *s = shell_create(&(Vector) { .x = 20, .y = 0, .z = 0.5 }, &(Vector) { .x = -1, .y = 0, .z = 0 });
+    World *w = world_create();
+    TankHandle tank = 0;
+    tank_initialize(w, tank, &(Vector) { .x = 0, .y = 0, .z = 0 }, &(Vector) { .x = 0, .y = 0, .z = 1 }, 0);
+    ShellHandle s = shell_create(w, &(Vector) { .x = 20, .y = 0, .z = 0.5 }, &(Vector) { .x = -1, .y = 0, .z = 0 });
 
-    bool result = intersection_test(&tank.bounding, &s->bounding, &t);
+    Bounding tank_bounding_primitives[TANK_BOUNDING_PRIMITIVES], tank_bounding, shell_bounding;
+    world_tank_bounding(w, tank, tank_bounding_primitives, &tank_bounding);
+    world_shell_bounding(w, s, &shell_bounding);
+
+    bool result = intersection_test(&tank_bounding, &shell_bounding, &t);
     test_cond("Test intersection 3.", !result && !isnan(t));
 
-    s->direction.x = 1.0;
-    result = intersection_test(&tank.bounding, &s->bounding, &t);
+    w->shell_direction[s].x = 1.0;
+    result = intersection_test(&tank_bounding, &shell_bounding, &t);
     test_cond("Test intersection 4.", !result && isnan(t));
 
-    s->position.x = -20;
-    s->position.y = -20;
-    s->direction.x = 1;
-    s->direction.y = 1;
-    VECTOR_NORMALIZE(&s->direction);
-    result = intersection_test(&tank.bounding, &s->bounding, &t);
+    w->shell_position[s].x = -20;
+    w->shell_position[s].y = -20;
+    w->shell_direction[s].x = 1;
+    w->shell_direction[s].y = 1;
+    VECTOR_NORMALIZE(&w->shell_direction[s]);
+    result = intersection_test(&tank_bounding, &shell_bounding, &t);
     test_cond("Test intersection 5.", !result && !isnan(t));
 
+    world_destroy(w);
+
     test_report();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,559 @@
+// checkpoint.c - arena snapshots for warm restart.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+#include "debug.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_BUFFER 65536
+
+#pragma pack(push, 8)
+
+// Double buffer of arena. Game worker fills back buffer, writer saves front one.
+typedef struct CheckpointSlot
+{
+    CheckpointSnapshot *buffers[2];
+    size_t front;
+    bool pending; // Front buffer has snapshot which isn't saved yet.
+    bool writing; // Front buffer is being saved, it must not be swapped.
+} CheckpointSlot;
+
+#pragma pack(pop)
+
+static CheckpointSlot slots[MAX_ARENAS];
+static size_t slot_count = 0;
+static const char *checkpoint_path = NULL;
+static unsigned long long checkpoint_interval = 0;
+static uint64_t checkpoint_landscape_hash = 0;
+static unsigned long long dropped = 0; // Snapshots which weren't saved because writer was busy.
+
+static mtx_t mutex;
+static cnd_t condition; // Snapshot is pending or has been written.
+static thrd_t writer_tid;
+static bool writer_started = false;
+static volatile bool working = false;
+
+static int __checkpoint_writer(void *unused);
+static bool __write_front(size_t arena_id);
+static bool __write_tank(FILE *f, const CheckpointSnapshot *s, TankHandle t);
+static bool __read_tank(FILE *f, CheckpointSnapshot *s);
+static void __clean(void);
+
+CheckpointSnapshot *checkpoint_snapshot_create(void)
+{
+    CheckpointSnapshot *s = (CheckpointSnapshot *) calloc(1, sizeof(CheckpointSnapshot));
+    check_mem(s);
+    check_mem(s->world = world_create());
+    return s;
+
+    error:
+    if (s)
+    {
+        free(s);
+    }
+    return NULL;
+}
+
+void checkpoint_snapshot_destroy(CheckpointSnapshot *s)
+{
+    assert(s && "Nothing to destroy.");
+
+    world_destroy(s->world);
+    free(s);
+}
+
+bool checkpoint_capture(CheckpointSnapshot *s, const Arena *a, uint64_t landscape_hash)
+{
+    assert(s && "Bad snapshot pointer.");
+    assert(a && "Bad arena pointer.");
+
+    check(world_copy(s->world, a->world), "Failed to copy world.", "");
+
+    uint8_t tank_count = 0;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!s->world->tank_used[t])
+        {
+            continue;
+        }
+
+        const NetworkClient *c = &s->world->tank_client[t]->network_client;
+        s->client_state[t] = c->state;
+        s->client_address[t] = c->address;
+        s->world->tank_client[t] = NULL;
+        tank_count++;
+    }
+
+    s->header = (CheckpointHeader) {
+        .magic          = CHECKPOINT_MAGIC,
+        .version        = CHECKPOINT_VERSION,
+        .arena          = (uint8_t) a->id,
+        .landscape_hash = landscape_hash,
+        .tick           = a->tick,
+        .random_state   = a->random_state,
+        .tank_count     = tank_count,
+        .shell_count    = (uint32_t) s->world->shell_count,
+        .next_shell_id  = s->world->next_shell_id
+    };
+
+    return true;
+    error:
+    return false;
+}
+
+bool checkpoint_write(const char *filename, const CheckpointSnapshot *s)
+{
+    assert(filename && "Bad filename pointer.");
+    assert(s && "Bad snapshot pointer.");
+
+    char temporary[FILENAME_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+
+    const World *w = s->world;
+    size_t count = w->shell_count;
+
+    FILE *f = fopen(temporary, "wb");
+    check(f, "Failed to open checkpoint file: %s.", temporary);
+    setvbuf(f, NULL, _IOFBF, CHECKPOINT_BUFFER);
+
+    check(1 == fwrite(&s->header, sizeof(CheckpointHeader), 1, f), "Failed to write checkpoint header.", "");
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (w->tank_used[t])
+        {
+            check(__write_tank(f, s, t), "Failed to write tank.", "");
+        }
+    }
+
+    check(count == fwrite(w->shell_position, sizeof(Vector), count, f) &&
+          count == fwrite(w->shell_previous_position, sizeof(Vector), count, f) &&
+          count == fwrite(w->shell_direction, sizeof(Vector), count, f) &&
+          count == fwrite(w->shell_speed, sizeof(double), count, f) &&
+          count == fwrite(w->shell_id, sizeof(size_t), count, f),
+          "Failed to write shells.",
+          "");
+
+    int result = fclose(f);
+    f = NULL;
+    check(0 == result, "Failed to close checkpoint file.", "");
+
+    // Previous checkpoint is kept until new one is complete, so file is replaced in one step.
+    check(MoveFileExA(temporary, filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH),
+          "Failed to replace checkpoint file: %s. Error: %lu.",
+          filename,
+          GetLastError());
+
+    return true;
+    error:
+    if (f)
+    {
+        fclose(f);
+    }
+    return false;
+}
+
+bool checkpoint_read(const char *filename, CheckpointSnapshot *s)
+{
+    assert(filename && "Bad filename pointer.");
+    assert(s && "Bad snapshot pointer.");
+
+    World *w = s->world;
+    memset(w->tank_used, 0, sizeof(w->tank_used));
+    memset(w->tank_client, 0, sizeof(w->tank_client));
+    w->shell_count = 0;
+
+    FILE *f = fopen(filename, "rb");
+    check(f, "Failed to open checkpoint file: %s.", filename);
+    setvbuf(f, NULL, _IOFBF, CHECKPOINT_BUFFER);
+
+    check(1 == fread(&s->header, sizeof(CheckpointHeader), 1, f), "Failed to read checkpoint header.", "");
+    check(CHECKPOINT_MAGIC == s->header.magic, "Not a checkpoint file.", "");
+    check(CHECKPOINT_VERSION == s->header.version, "Unsupported checkpoint version: %u.", (unsigned) s->header.version);
+    check(WORLD_MAX_TANKS >= s->header.tank_count, "Bad tank count: %u.", (unsigned) s->header.tank_count);
+
+    for (size_t i = 0; i < s->header.tank_count; i++)
+    {
+        check(__read_tank(f, s), "Failed to read tank.", "");
+    }
+
+    size_t count = s->header.shell_count;
+    for (size_t i = 0; i < count; i++)
+    {
+        check(SHELL_NONE != world_shell_add(w), "Failed to restore shell %zu.", i);
+    }
+
+    check(count == fread(w->shell_position, sizeof(Vector), count, f) &&
+          count == fread(w->shell_previous_position, sizeof(Vector), count, f) &&
+          count == fread(w->shell_direction, sizeof(Vector), count, f) &&
+          count == fread(w->shell_speed, sizeof(double), count, f) &&
+          count == fread(w->shell_id, sizeof(size_t), count, f),
+          "Truncated shells.",
+          "");
+    check(EOF == fgetc(f), "Garbage at end of checkpoint.", "");
+
+    w->next_shell_id = (size_t) s->header.next_shell_id;
+    for (size_t i = 0; i < count; i++)
+    {
+        check(w->shell_id[i] < w->next_shell_id, "Bad id of shell %zu.", i);
+    }
+
+    fclose(f);
+    return true;
+    error:
+    if (f)
+    {
+        fclose(f);
+    }
+    return false;
+}
+
+void checkpoint_filename(char *filename, size_t size, const char *path, size_t arena_id)
+{
+    assert(filename && "Bad filename pointer.");
+    assert(path && "Bad path pointer.");
+
+    snprintf(filename, size, "%s/arena_%u.checkpoint", path, (unsigned) arena_id);
+}
+
+bool checkpoint_start(const char *path, size_t arena_count, unsigned long long interval, uint64_t landscape_hash)
+{
+    log_info("start.", "");
+    assert(path && "Bad path pointer.");
+    assert(0 < arena_count && MAX_ARENAS >= arena_count && "Bad arena count.");
+    assert(0 < interval && "Bad interval.");
+
+    checkpoint_path = path;
+    checkpoint_interval = interval;
+    checkpoint_landscape_hash = landscape_hash;
+    dropped = 0;
+
+    for (slot_count = 0; slot_count < arena_count; slot_count++)
+    {
+        CheckpointSlot *slot = &slots[slot_count];
+        *slot = (CheckpointSlot) { .buffers = { NULL, NULL }, .front = 0, .pending = false, .writing = false };
+        check_mem(slot->buffers[0] = checkpoint_snapshot_create());
+        check_mem(slot->buffers[1] = checkpoint_snapshot_create());
+    }
+
+    check(thrd_success == mtx_init(&mutex, mtx_plain), "Failed to initialize checkpoint mutex.", "");
+    if (thrd_success != cnd_init(&condition))
+    {
+        mtx_destroy(&mutex);
+        sentinel("Failed to initialize checkpoint condition.", "");
+    }
+
+    working = true;
+    check(thrd_success == thrd_create(&writer_tid, __checkpoint_writer, NULL), "Failed to start checkpoint writer thread.", "");
+    writer_started = true;
+
+    log_info("end. path: %s, interval: %llu ticks.", path, interval);
+    return true;
+    error:
+    __clean();
+    log_info("error.", "");
+    return false;
+}
+
+void checkpoint_stop(void)
+{
+    log_info("start.", "");
+    __clean();
+    log_info("end. dropped snapshots: %llu.", dropped);
+}
+
+void checkpoint_tick(const Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    if (!working || 0 != a->tick % checkpoint_interval)
+    {
+        return;
+    }
+
+    CheckpointSlot *slot = &slots[a->id];
+
+    // Only this worker swaps buffers, so back buffer is free to be filled without lock.
+    mtx_lock(&mutex);
+    bool busy = slot->writing;
+    dropped += busy ? 1 : 0;
+    mtx_unlock(&mutex);
+
+    if (busy)
+    {
+        return;
+    }
+
+    check(checkpoint_capture(slot->buffers[1 - slot->front], a, checkpoint_landscape_hash), "Failed to capture arena.", "");
+
+    mtx_lock(&mutex);
+    if (slot->writing)
+    {
+        // Writer has taken front buffer meanwhile.
+        dropped++;
+    }
+    else
+    {
+        // Not yet written snapshot is replaced by newer one.
+        slot->front = 1 - slot->front;
+        slot->pending = true;
+        cnd_broadcast(&condition);
+    }
+    mtx_unlock(&mutex);
+
+    error:
+    return;
+}
+
+bool checkpoint_save(const Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    if (!working)
+    {
+        return false;
+    }
+
+    CheckpointSlot *slot = &slots[a->id];
+    check(checkpoint_capture(slot->buffers[1 - slot->front], a, checkpoint_landscape_hash), "Failed to capture arena.", "");
+
+    mtx_lock(&mutex);
+    while (slot->writing)
+    {
+        cnd_wait(&condition, &mutex);
+    }
+
+    slot->front = 1 - slot->front;
+    slot->pending = false;
+    slot->writing = true;
+    mtx_unlock(&mutex);
+
+    return __write_front(a->id);
+    error:
+    return false;
+}
+
+static int __checkpoint_writer(void *unused)
+{
+    #pragma ref unused
+
+    log_info("start. tid: %u", GetCurrentThreadId());
+
+    mtx_lock(&mutex);
+    while (working)
+    {
+        size_t i;
+        for (i = 0; i < slot_count && !slots[i].pending; i++);
+
+        if (i == slot_count)
+        {
+            cnd_wait(&condition, &mutex);
+            continue;
+        }
+
+        slots[i].pending = false;
+        slots[i].writing = true;
+        mtx_unlock(&mutex);
+
+        __write_front(i);
+
+        mtx_lock(&mutex);
+    }
+    mtx_unlock(&mutex);
+
+    log_info("end.", "");
+    return 0;
+}
+
+// Slot must be marked as being written. Mark is cleared.
+static bool __write_front(size_t arena_id)
+{
+    CheckpointSlot *slot = &slots[arena_id];
+    char filename[FILENAME_MAX];
+    checkpoint_filename(filename, sizeof(filename), checkpoint_path, arena_id);
+
+    bool result = checkpoint_write(filename, slot->buffers[slot->front]);
+    if (!result)
+    {
+        log_error("Failed to write checkpoint of arena %u.", (unsigned) arena_id);
+    }
+
+    mtx_lock(&mutex);
+    slot->writing = false;
+    cnd_broadcast(&condition);
+    mtx_unlock(&mutex);
+
+    return result;
+}
+
+static bool __write_tank(FILE *f, const CheckpointSnapshot *s, TankHandle t)
+{
+    const World *w = s->world;
+    uint8_t header[2] = { (uint8_t) t, (uint8_t) s->client_state[t] };
+
+    return 1 == fwrite(header, sizeof(header), 1, f) &&
+           1 == fwrite(&s->client_address[t], sizeof(SOCKADDR), 1, f) &&
+           1 == fwrite(&w->tank_position[t], sizeof(Vector), 1, f) &&
+           1 == fwrite(&w->tank_previous_position[t], sizeof(Vector), 1, f) &&
+           1 == fwrite(&w->tank_direction[t], sizeof(Vector), 1, f) &&
+           1 == fwrite(&w->tank_orientation[t], sizeof(Vector), 1, f) &&
+           1 == fwrite(&w->tank_speed[t], sizeof(double), 1, f) &&
+           1 == fwrite(&w->tank_hp[t], sizeof(int), 1, f) &&
+           1 == fwrite(&w->tank_fire_delay[t], sizeof(int), 1, f) &&
+           1 == fwrite(&w->tanks[t], sizeof(Tank), 1, f);
+}
+
+static bool __read_tank(FILE *f, CheckpointSnapshot *s)
+{
+    World *w = s->world;
+    uint8_t header[2];
+
+    check(1 == fread(header, sizeof(header), 1, f), "Truncated tank.", "");
+
+    TankHandle t = header[0];
+    check(t < WORLD_MAX_TANKS && !w->tank_used[t], "Bad tank slot: %u.", (unsigned) t);
+    check(cs_in_game >= header[1], "Bad client state: %u.", (unsigned) header[1]);
+
+    w->tank_used[t] = true;
+    s->client_state[t] = (ClientState) header[1];
+
+    check(1 == fread(&s->client_address[t], sizeof(SOCKADDR), 1, f) &&
+          1 == fread(&w->tank_position[t], sizeof(Vector), 1, f) &&
+          1 == fread(&w->tank_previous_position[t], sizeof(Vector), 1, f) &&
+          1 == fread(&w->tank_direction[t], sizeof(Vector), 1, f) &&
+          1 == fread(&w->tank_orientation[t], sizeof(Vector), 1, f) &&
+          1 == fread(&w->tank_speed[t], sizeof(double), 1, f) &&
+          1 == fread(&w->tank_hp[t], sizeof(int), 1, f) &&
+          1 == fread(&w->tank_fire_delay[t], sizeof(int), 1, f) &&
+          1 == fread(&w->tanks[t], sizeof(Tank), 1, f),
+          "Truncated tank.",
+          "");
+
+    return true;
+    error:
+    return false;
+}
+
+static void __clean(void)
+{
+    if (writer_started)
+    {
+        mtx_lock(&mutex);
+        working = false;
+        cnd_broadcast(&condition);
+        mtx_unlock(&mutex);
+
+        log_info("wait for writer to stop.", "");
+        thrd_join(writer_tid, NULL);
+        writer_started = false;
+
+        cnd_destroy(&condition);
+        mtx_destroy(&mutex);
+    }
+    working = false;
+
+    // Start may have failed between buffers of slot.
+    for (size_t i = 0; i < MAX_ARENAS; i++)
+    {
+        for (size_t j = 0; j < 2; j++)
+        {
+            if (slots[i].buffers[j])
+            {
+                checkpoint_snapshot_destroy(slots[i].buffers[j]);
+                slots[i].buffers[j] = NULL;
+            }
+        }
+    }
+    slot_count = 0;
+}
+
+#if defined(CHECKPOINT_TESTS)
+#include "testhelp.h"
+
+#define TEST_CHECKPOINT "checkpoint_test.checkpoint"
+
+int main(void)
+{
+    CheckpointSnapshot *s = checkpoint_snapshot_create(), *r = checkpoint_snapshot_create();
+    test_cond("Create snapshots.", NULL != s && NULL != r);
+
+    World *w = s->world;
+    s->header = (CheckpointHeader) {
+        .magic          = CHECKPOINT_MAGIC,
+        .version        = CHECKPOINT_VERSION,
+        .arena          = 2,
+        .landscape_hash = 0xdeadbeef,
+        .tick           = 1234,
+        .random_state   = 42,
+        .tank_count     = 2,
+        .shell_count    = 20,
+        .next_shell_id  = 58
+    };
+
+    w->tank_used[3] = w->tank_used[7] = true;
+    w->tank_position[3].x = 10.0;
+    w->tank_hp[7] = 55;
+    w->tanks[7].statistics.direct_hits = 4;
+    w->tanks[3].last_shell_id = 57;
+    w->tanks[7].last_shell_id = -1;
+    s->client_state[3] = cs_in_game;
+    s->client_state[7] = cs_acknowledged;
+    memset(&s->client_address[7], 0x5a, sizeof(SOCKADDR));
+
+    for (size_t i = 0; i < s->header.shell_count; i++)
+    {
+        ShellHandle shell = world_shell_add(w);
+        w->shell_speed[shell] = (double) i;
+        w->shell_id[shell] = i * 3;
+    }
+
+    test_cond("Write checkpoint.", checkpoint_write(TEST_CHECKPOINT, s));
+    test_cond("Read checkpoint.", checkpoint_read(TEST_CHECKPOINT, r));
+    test_cond("Check header.", 0 == memcmp(&s->header, &r->header, sizeof(CheckpointHeader)));
+    test_cond("Check tank slots.", r->world->tank_used[3] && r->world->tank_used[7] && !r->world->tank_used[0]);
+    test_cond("Check tanks.",
+              10.0 == r->world->tank_position[3].x &&
+              55 == r->world->tank_hp[7] &&
+              4 == r->world->tanks[7].statistics.direct_hits);
+    test_cond("Check clients.",
+              cs_in_game == r->client_state[3] &&
+              cs_acknowledged == r->client_state[7] &&
+              0 == memcmp(&s->client_address[7], &r->client_address[7], sizeof(SOCKADDR)));
+    test_cond("Check shells.", 20 == r->world->shell_count && 19.0 == r->world->shell_speed[19] && 57 == r->world->shell_id[19]);
+
+    World *copy = world_create();
+    test_cond("Copy world.", world_copy(copy, r->world) && 20 == copy->shell_count && 55 == copy->tank_hp[7]);
+
+    // Tank 7 shoots after restart, hits are credited by matching last shell id as game does.
+    ShellHandle fired = world_shell_add(copy);
+    copy->tanks[7].last_shell_id = (int) copy->shell_id[fired];
+    size_t owners = 0;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        owners += copy->tank_used[t] && (size_t) copy->tanks[t].last_shell_id == copy->shell_id[fired];
+    }
+    test_cond("New shell continues restored ids.",
+              58 == copy->shell_id[fired] && 1 == owners && 57 == copy->tanks[3].last_shell_id);
+    world_destroy(copy);
+
+    s->header.next_shell_id = 57;
+    test_cond("Reject stale shell id counter.", checkpoint_write(TEST_CHECKPOINT, s) && !checkpoint_read(TEST_CHECKPOINT, r));
+    s->header.next_shell_id = 58;
+    checkpoint_write(TEST_CHECKPOINT, s);
+
+    FILE *f = fopen(TEST_CHECKPOINT, "ab");
+    fputc(0, f);
+    fclose(f);
+    test_cond("Reject garbage.", !checkpoint_read(TEST_CHECKPOINT, r));
+
+    remove(TEST_CHECKPOINT);
+    checkpoint_snapshot_destroy(s);
+    checkpoint_snapshot_destroy(r);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
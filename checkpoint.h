@@ -0,0 +1,76 @@
+// checkpoint.h - arena snapshots for warm restart.
+
+#pragma once
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+//#pragma message("__CHECKPOINT_H__")
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "morrigan.h"
+#include "server.h"
+#include "world.h"
+#include "arena.h"
+
+#define CHECKPOINT_MAGIC 0x4347524d // "MRGC".
+#define CHECKPOINT_VERSION 2
+
+#pragma pack(push, 1)
+#pragma warn(push)
+#pragma warn(disable: 2185)
+
+typedef struct CheckpointHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t arena;
+    uint64_t landscape_hash;
+    uint64_t tick;
+    uint64_t random_state;
+    uint8_t tank_count;
+    uint32_t shell_count;
+    uint64_t next_shell_id; // Restored shells and tanks keep their ids, new shells continue after them.
+} CheckpointHeader;
+
+#pragma warn(pop)
+#pragma pack(pop)
+
+#pragma pack(push, 8)
+
+typedef struct CheckpointSnapshot
+{
+    CheckpointHeader header;
+    World *world; // Copy of arena's world. Client pointers aren't valid.
+    ClientState client_state[WORLD_MAX_TANKS];
+    SOCKADDR client_address[WORLD_MAX_TANKS];
+} CheckpointSnapshot;
+
+#pragma pack(pop)
+
+CheckpointSnapshot *checkpoint_snapshot_create(void);
+void checkpoint_snapshot_destroy(CheckpointSnapshot *s);
+
+// Arena must be locked by caller.
+bool checkpoint_capture(CheckpointSnapshot *s, const Arena *a, uint64_t landscape_hash);
+
+// File is replaced only after new checkpoint is completely written.
+bool checkpoint_write(const char *filename, const CheckpointSnapshot *s);
+bool checkpoint_read(const char *filename, CheckpointSnapshot *s);
+void checkpoint_filename(char *filename, size_t size, const char *path, size_t arena_id);
+
+// Background writer. Game workers capture snapshot into back buffer of arena each interval ticks,
+// writer thread saves front buffer. Worker never waits for disk: if writer is still busy with arena's
+// previous snapshot, current one is dropped.
+bool checkpoint_start(const char *path, size_t arena_count, unsigned long long interval, uint64_t landscape_hash);
+void checkpoint_stop(void);
+
+// Called after arena tick. Arena must be locked by caller.
+void checkpoint_tick(const Arena *a);
+
+// Captures and writes arena at once. Arena must be locked by caller.
+bool checkpoint_save(const Arena *a);
+
+#endif /* __CHECKPOINT_H__ */
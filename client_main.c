@@ -82,7 +82,7 @@ int main(int argc, char *argv[])
 {
     if (2 > argc)
     {
-        fprintf(stderr, "Usage: %s <server-address> [<port>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <server-address> [<port> [<arena>]]\n", argv[0]);
         return -1;
     }
 
@@ -96,8 +96,14 @@ int main(int argc, char *argv[])
         }
     }
 
+    uint8_t arena = 0;
+    if (3 < argc)
+    {
+        arena = (uint8_t) atoi(argv[3]);
+    }
+
     check(client_net_start(), "Failed to initialize net.", "");
-    check(client_connect(&client_protocol, argv[1], port, true), "Failed to connect.", "");
+    check(client_connect(&client_protocol, argv[1], port, true, arena), "Failed to connect.", "");
 
     puts("Connected to server.");
 
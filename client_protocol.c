@@ -181,11 +181,9 @@ uint8_t client_protocol_wait_for(ClientProtocol *cp, uint8_t target_packet_id, v
     return false;
 }
 
-bool client_connect(ClientProtocol *cp, const char *address, unsigned short port, bool is_client)
+bool client_open_socket(SOCKET *s, const char *address, unsigned short port)
 {
-    assert(cp && "Bad client protocol pointer.");
-    assert(cp->packets && "Bad packets pointer.");
-    assert(cp->packet_count && "Bad packet count.");
+    assert(s && "Bad socket pointer.");
     assert(address && "Bad address pointer.");
 
     if (!port)
@@ -193,37 +191,65 @@ bool client_connect(ClientProtocol *cp, const char *address, unsigned short port
         port = PORT;
     }
 
-    cp->s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    check(INVALID_SOCKET != cp->s, "Failed to create socket. Error: %d.", WSAGetLastError());
+    struct addrinfo *result = NULL, hints = { .ai_family = AF_INET };
+
+    *s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    check(INVALID_SOCKET != *s, "Failed to create socket. Error: %d.", WSAGetLastError());
 
     DWORD b = PACKET_BUFFER;
-    check(SOCKET_ERROR != setsockopt(cp->s, SOL_SOCKET, SO_RCVBUF, (const char *) &b, sizeof(DWORD)),
+    check(SOCKET_ERROR != setsockopt(*s, SOL_SOCKET, SO_RCVBUF, (const char *) &b, sizeof(DWORD)),
           "Failed to socket set socket buffer. Error: %d.",
           WSAGetLastError());
-    check(SOCKET_ERROR != setsockopt(cp->s, SOL_SOCKET, SO_SNDBUF, (const char *) &b, sizeof(DWORD)),
+    check(SOCKET_ERROR != setsockopt(*s, SOL_SOCKET, SO_SNDBUF, (const char *) &b, sizeof(DWORD)),
           "Failed to socket set socket buffer. Error: %d.",
           WSAGetLastError());
 
-    struct addrinfo *result = NULL, hints = { .ai_family = AF_INET };
     check(0 == getaddrinfo(address, NULL, &hints, &result),
           "getaddrinfo() failed. Error: %d.",
           WSAGetLastError());
 
     ((SOCKADDR_IN *) result->ai_addr)->sin_port = htons(port);
 
-    check(SOCKET_ERROR != connect(cp->s, result->ai_addr, result->ai_addrlen),
+    check(SOCKET_ERROR != connect(*s, result->ai_addr, result->ai_addrlen),
           "connect() failed. Error: %d.",
           WSAGetLastError());
 
     freeaddrinfo(result);
-    result = NULL;
+    return true;
+
+    error:
+    if (INVALID_SOCKET != *s)
+    {
+        closesocket(*s);
+        *s = INVALID_SOCKET;
+    }
+
+    if (result)
+    {
+        freeaddrinfo(result);
+    }
+
+    return false;
+}
+
+bool client_connect(ClientProtocol *cp, const char *address, unsigned short port, bool is_client, uint8_t arena)
+{
+    assert(cp && "Bad client protocol pointer.");
+    assert(cp->packets && "Bad packets pointer.");
+    assert(cp->packet_count && "Bad packet count.");
+    assert(address && "Bad address pointer.");
+
+    check(client_open_socket(&cp->s, address, port), "Failed to open socket.", "");
 
     uint8_t req = is_client ? req_hello : req_viewer_hello;
 
-    check(SOCKET_ERROR != send(cp->s, (char *) &req, 1, 0), "send() failed. Error: %d.", WSAGetLastError());
+    char req_packet[1 + sizeof(ReqHello)] = { req };
+    ((ReqHello *) &req_packet[1])->arena = arena;
+
+    check(SOCKET_ERROR != send(cp->s, (char *) &req_packet, sizeof(req_packet), 0), "send() failed. Error: %d.", WSAGetLastError());
     check(req == client_protocol_wait_for(cp, req, NULL, NULL), "Connecting failed (stage 1).", "");
 
-    check(SOCKET_ERROR != send(cp->s, (char *) &req, 1, 0), "send() failed. Error: %d.", WSAGetLastError());
+    check(SOCKET_ERROR != send(cp->s, (char *) &req_packet, sizeof(req_packet), 0), "send() failed. Error: %d.", WSAGetLastError());
     check(req == client_protocol_wait_for(cp, req, NULL, NULL), "Connecting failed (stage 2).", "");
 
     cp->connected = true;
@@ -235,11 +261,6 @@ bool client_connect(ClientProtocol *cp, const char *address, unsigned short port
         closesocket(cp->s);
     }
 
-    if (result)
-    {
-        freeaddrinfo(result);
-    }
-
     return false;
 }
 
@@ -289,7 +310,7 @@ Landscape *client_get_landscape(ClientProtocol *cp)
     return NULL;
 }
 
-size_t client_get_tanks(ClientProtocol *cp, bool is_client, ResGetTanksTankRecord *tanks)
+size_t client_get_tanks(ClientProtocol *cp, bool is_client, ResGetTanksTankRecord *tanks, ResViewerGetTanks *stamp)
 {
     __assert_client_protocol(cp);
     assert(tanks && "Bad tanks pointer.");
@@ -302,14 +323,19 @@ size_t client_get_tanks(ClientProtocol *cp, bool is_client, ResGetTanksTankRecor
 
     check(req == client_protocol_wait_for(cp, req, buf, &received), "Net timeout.", "");
 
-    check(received >= 2 * sizeof(uint8_t), "Bad tanks response.", "");
+    size_t header_size = is_client ? sizeof(ResGetTanks) : sizeof(ResViewerGetTanks);
+    check(received >= header_size, "Bad tanks response.", "");
 
     check(req == (uint8_t) buf[0], "Bad tanks response.", "");
     size_t tanks_count = (uint8_t) buf[1];
 
-    check(received == 2 * sizeof(uint8_t) + tanks_count * sizeof(ResGetTanksTankRecord), "Bad tanks response (stage 2).", "");
+    check(received == header_size + tanks_count * sizeof(ResGetTanksTankRecord), "Bad tanks response (stage 2).", "");
 
-    memcpy(tanks, &buf[2 * sizeof(uint8_t)], tanks_count * sizeof(ResGetTanksTankRecord));
+    memcpy(tanks, &buf[header_size], tanks_count * sizeof(ResGetTanksTankRecord));
+    if (!is_client && stamp)
+    {
+        memcpy(stamp, buf, sizeof(ResViewerGetTanks));
+    }
 
     return tanks_count;
 
@@ -414,6 +440,58 @@ bool shoot(ClientProtocol *cp)
     return false;
 }
 
+bool end_turn(ClientProtocol *cp)
+{
+    __assert_client_protocol(cp);
+
+    uint8_t req = req_end_turn;
+    check(SOCKET_ERROR != send(cp->s, (char *) &req, sizeof(req), 0), "send() failed. Error: %d.", WSAGetLastError());
+
+    char receive_buf[1];
+    size_t received = 1;
+
+    check(req == client_protocol_wait_for(cp, req, &receive_buf, &received), "Net timeout.", "");
+
+    check(1 == received && req_end_turn == receive_buf[0], "Bad end turn response.", "");
+
+    return true;
+    error:
+    return false;
+}
+
+bool send_control(ClientProtocol *cp, const ReqControl *control)
+{
+    __assert_client_protocol(cp);
+    assert(control && "Bad control pointer.");
+
+    char req_buf[1 + sizeof(ReqControl)];
+    req_buf[0] = req_control;
+    ReqControl *req_body = (ReqControl *) &req_buf[1];
+    *req_body = *control;
+
+    if (req_body->look_z < TANK_MIN_LOOK_Z)
+    {
+        req_body->look_z = TANK_MIN_LOOK_Z;
+    }
+    else if (req_body->look_z > TANK_MAX_LOOK_Z)
+    {
+        req_body->look_z = TANK_MAX_LOOK_Z;
+    }
+
+    check(SOCKET_ERROR != send(cp->s, req_buf, sizeof(req_buf), 0), "send() failed. Error: %d.", WSAGetLastError());
+
+    char receive_buf[1];
+    size_t received = 1;
+
+    check(req_control == client_protocol_wait_for(cp, req_control, &receive_buf, &received), "Net timeout.", "");
+
+    check(1 == received && req_control == receive_buf[0], "Bad control response.", "");
+
+    return true;
+    error:
+    return false;
+}
+
 double client_tank_get_heading(ClientProtocol *cp)
 {
     __assert_client_protocol(cp);
@@ -510,6 +588,27 @@ int tank_get_fire_delay(ClientProtocol *cp)
     return 0;
 }
 
+bool tank_get_observation(ClientProtocol *cp, ResGetObservation *observation)
+{
+    __assert_client_protocol(cp);
+    assert(observation && "Bad observation pointer.");
+
+    uint8_t req = req_get_observation;
+    check(SOCKET_ERROR != send(cp->s, (char *) &req, sizeof(req), 0), "send() failed. Error: %d.", WSAGetLastError());
+
+    ResGetObservation receive_buf;
+    size_t received = sizeof(receive_buf);
+
+    check(req == client_protocol_wait_for(cp, req, &receive_buf, &received), "Net timeout.", "");
+
+    check(sizeof(receive_buf) == received && req_get_observation == receive_buf.packet_id, "Bad get observation response.", "");
+
+    *observation = receive_buf;
+    return true;
+    error:
+    return false;
+}
+
 bool tank_get_map(ClientProtocol *cp, double *m)
 {
     __assert_client_protocol(cp);
@@ -42,18 +42,24 @@ bool client_protocol_process_event(ClientProtocol *cp);
 uint8_t client_protocol_wait_for(ClientProtocol *cp, uint8_t target_packet_id, void *packet, size_t *length);
 
 // Connecting / disconnecting.
-bool client_connect(ClientProtocol *cp, const char *address, unsigned short port, bool is_client);
+// Creates UDP socket connected to server, no packets are sent.
+bool client_open_socket(SOCKET *s, const char *address, unsigned short port);
+bool client_connect(ClientProtocol *cp, const char *address, unsigned short port, bool is_client, uint8_t arena);
 bool client_disconnect(ClientProtocol *cp, bool is_client);
 
 // Viewer protocol.
 Landscape *client_get_landscape(ClientProtocol *cp);
-size_t client_get_tanks(ClientProtocol *cp, bool is_client, ResGetTanksTankRecord *tanks);
+// Viewer's response header is copied to stamp, if it's not NULL.
+size_t client_get_tanks(ClientProtocol *cp, bool is_client, ResGetTanksTankRecord *tanks, ResViewerGetTanks *stamp);
 
 // Client protocol.
 bool set_engine_power(ClientProtocol *cp, int engine_power);
 bool turn(ClientProtocol *cp, double turn_angle);
 bool look_at(ClientProtocol *cp, Vector *look_direction);
 bool shoot(ClientProtocol *cp);
+bool end_turn(ClientProtocol *cp);
+// Look direction's z is clamped as by look_at().
+bool send_control(ClientProtocol *cp, const ReqControl *control);
 
 // Tank telemetry.
 double client_tank_get_heading(ClientProtocol *cp);
@@ -61,6 +67,7 @@ double tank_get_speed(ClientProtocol *cp);
 uint8_t tank_get_hp(ClientProtocol *cp);
 bool tank_get_statistics(ClientProtocol *cp, ResGetStatistics *statistics);
 int tank_get_fire_delay(ClientProtocol *cp);
+bool tank_get_observation(ClientProtocol *cp, ResGetObservation *observation);
 
 // Observing.
 bool tank_get_map(ClientProtocol *cp, double *m);
@@ -69,11 +69,8 @@ bool dynamic_array_push(DynamicArray *a, void *data)
         return true;
     }
 
-    char *new_data = (char *) realloc(a->data, (1 + a->element_count) * a->element_size);
-    check_mem(new_data);
-
-    a->data = new_data;
-    a->array_capacity++;
+    // Doubling keeps pushes amortized O(1).
+    check(dynamic_array_reserve(a, 2 * a->array_capacity), "Failed to grow array.", "");
     dynamic_array_set(a, a->element_count++, data);
     return true;
 
@@ -104,12 +101,69 @@ void dynamic_array_delete_at(DynamicArray *a, size_t i)
     memset(a->data + a->element_count * a->element_size, 0, a->element_size);
 }
 
+void dynamic_array_swap_remove(DynamicArray *a, size_t i)
+{
+    __dynamic_array_assert(a);
+    assert(i >= 0 && i < a->element_count && "Index out of range.");
+    a->element_count--;
+    if (i != a->element_count)
+    {
+        memcpy(a->data + i * a->element_size, a->data + a->element_count * a->element_size, a->element_size);
+    }
+
+    memset(a->data + a->element_count * a->element_size, 0, a->element_size);
+}
+
 size_t dynamic_array_count(const DynamicArray *a)
 {
     __dynamic_array_assert(a);
     return a->element_count;
 }
 
+// Capacity never decreases here. New elements are zeroed, as calloc() does on create.
+bool dynamic_array_reserve(DynamicArray *a, size_t array_capacity)
+{
+    __dynamic_array_assert(a);
+
+    if (array_capacity <= a->array_capacity)
+    {
+        return true;
+    }
+
+    char *new_data = (char *) realloc(a->data, array_capacity * a->element_size);
+    check_mem(new_data);
+
+    memset(new_data + a->array_capacity * a->element_size, 0, (array_capacity - a->array_capacity) * a->element_size);
+    a->data = new_data;
+    a->array_capacity = array_capacity;
+    return true;
+
+    error:
+    return false;
+}
+
+// Capacity is kept at least 1 element.
+bool dynamic_array_shrink_to_fit(DynamicArray *a)
+{
+    __dynamic_array_assert(a);
+
+    size_t array_capacity = a->element_count ? a->element_count : 1;
+    if (array_capacity == a->array_capacity)
+    {
+        return true;
+    }
+
+    char *new_data = (char *) realloc(a->data, array_capacity * a->element_size);
+    check_mem(new_data);
+
+    a->data = new_data;
+    a->array_capacity = array_capacity;
+    return true;
+
+    error:
+    return false;
+}
+
 static void __dynamic_array_assert(const DynamicArray *a)
 {
     assert(a && "Bad array.");
@@ -122,6 +176,9 @@ static void __dynamic_array_assert(const DynamicArray *a)
 #include <stdio.h>
 
 #include "testhelp.h"
+#include "typed_array.h"
+
+TYPED_ARRAY_DEFINE(IntArray, int_array, int)
 
 int main(void)
 {
@@ -158,8 +215,51 @@ int main(void)
     test_cond("Test get at 1 after delete.", 2 == *DYNAMIC_ARRAY_GET(int *, a, 1));
 
     test_cond("Test get element count.", 5 == dynamic_array_count(a));
+    test_cond("Test capacity is doubled.", 10 == a->array_capacity);
+
+    dynamic_array_swap_remove(a, 0);
+    test_cond("Test last element is moved by swap remove.", 5 == *DYNAMIC_ARRAY_GET(int *, a, 0) && 4 == dynamic_array_count(a));
+    dynamic_array_swap_remove(a, 3);
+    test_cond("Test swap remove of last element.", 3 == dynamic_array_count(a) && 0 == *DYNAMIC_ARRAY_GET(int *, a, 3));
+
+    int sum = 0;
+    DYNAMIC_ARRAY_FOR_EACH(int *, e, a)
+    {
+        sum += *e;
+    }
+    test_cond("Test iteration.", 5 + 2 + 3 == sum);
+
+    test_cond("Test reserve.", dynamic_array_reserve(a, 100) && 100 == a->array_capacity && 0 == *DYNAMIC_ARRAY_GET(int *, a, 99));
+    test_cond("Test shrink to fit.", dynamic_array_shrink_to_fit(a) && 3 == a->array_capacity && 3 == *DYNAMIC_ARRAY_GET(int *, a, 2));
 
     dynamic_array_destroy(a);
+
+    IntArray t = { 0 };
+    bool pushed = true;
+    for (int i = 0; i < 9; i++)
+    {
+        pushed = pushed && int_array_push(&t, i);
+    }
+    test_cond("Typed array push.", pushed && 9 == t.count && 16 == t.capacity && 8 == *int_array_at(&t, 8));
+
+    test_cond("Typed array pop.", 8 == int_array_pop(&t) && 8 == t.count);
+
+    int_array_swap_remove(&t, 0);
+    int_array_delete_at(&t, 1);
+    test_cond("Typed array remove.", 6 == t.count && 7 == t.data[0] && 2 == t.data[1] && 3 == t.data[2]);
+
+    sum = 0;
+    TYPED_ARRAY_FOR_EACH(const int *, e, &t)
+    {
+        sum += *e;
+    }
+    test_cond("Typed array iteration.", 7 + 2 + 3 + 4 + 5 + 6 == sum);
+
+    test_cond("Typed array resize.", int_array_resize(&t, 8, -1) && 8 == t.count && -1 == t.data[7] && int_array_resize(&t, 2, 0) && 2 == t.count);
+
+    int_array_destroy(&t);
+    test_cond("Typed array destroy.", NULL == t.data && 0 == t.count && 0 == t.capacity);
+
     test_report();
     return EXIT_SUCCESS;
 }
@@ -32,7 +32,18 @@ const void *dynamic_array_set(DynamicArray *a, size_t i, const void *data);
 bool dynamic_array_push(DynamicArray *a, void *data);
 void *dynamic_array_pop(DynamicArray *a);
 #define DYNAMIC_ARRAY_POP(element_type, a) ((element_type) dynamic_array_pop(a))
+// Keeps order of elements, O(n).
 void dynamic_array_delete_at(DynamicArray *a, size_t i);
+// Moves last element into deleted one's place, O(1).
+void dynamic_array_swap_remove(DynamicArray *a, size_t i);
 size_t dynamic_array_count(const DynamicArray *a);
+bool dynamic_array_reserve(DynamicArray *a, size_t array_capacity);
+bool dynamic_array_shrink_to_fit(DynamicArray *a);
+
+// element is pointer of element_type to each element in order. Array mustn't be changed by loop body.
+#define DYNAMIC_ARRAY_FOR_EACH(element_type, element, a) \
+    for (element_type element = (element_type) (a)->data; \
+         (char *) element < (a)->data + (a)->element_count * (a)->element_size; \
+         element++)
 
 #endif /* __DYNAMIC_ARRAY_H__ */
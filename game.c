@@ -1,64 +1,167 @@
 // game.c - game main loop.
 
 #include <assert.h>
-#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
-#include <process.h>
 #include <threads.h>
 
 #include "debug.h"
+#include "minmax.h"
 #include "matrix.h"
 #include "game.h"
 #include "server.h"
+#include "arena.h"
 #include "landscape.h"
 #include "protocol.h"
 #include "tank.h"
 #include "shell.h"
-
-static thrd_t worker_tid;
+#include "thread_pool.h"
+#include "scheduler.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "metrics.h"
+#include "trace.h"
+
+// Chunk sizes of parallel phases.
+#define TANKS_GRAIN 2
+#define SHELLS_GRAIN 8
+
+static thrd_t worker_tids[GAME_MAX_WORKERS];
+static Scheduler schedulers[GAME_MAX_WORKERS]; // Each worker keeps its own tick deadlines.
+static SchedulerPolicy tick_policy = scheduler_catch_up;
+static unsigned tick_rate = 0;
+
+// Lockstep mode: "end of turn" packets wake worker of client's arena.
+static mtx_t turn_mutexes[GAME_MAX_WORKERS];
+static cnd_t turn_conditions[GAME_MAX_WORKERS];
+static bool turn_signaled[GAME_MAX_WORKERS];
+static size_t turn_sync_count = 0;
+static size_t worker_count = 0;
 static volatile bool working = false;
+static ThreadPool *pool = NULL; // Workers which are left after distributing arenas.
+
+static Arena *arenas[MAX_ARENAS];
+static size_t arena_count = 0;
+
+static bool __restore_arena(Arena *a, const char *path, uint64_t landscape_hash, bool *restored);
+static int __game_worker(void *worker_index);
+static bool __lockstep_step(size_t worker, Scheduler *scheduler);
+static bool __turns_ended(const Arena *a);
+static void __game_tick(Arena *a);
+static void __record_phase(Arena *a, MetricsPhase phase, uint64_t *phase_start);
+
+// Parallel phases.
+static void __integrate_tanks_task(void *context, size_t begin, size_t end);
+static void __integrate_shells_task(void *context, size_t begin, size_t end);
+static void __tank_broadphase_task(void *context, size_t begin, size_t end);
+static void __shell_narrowphase_task(void *context, size_t begin, size_t end);
+
+// Serial phases.
+static void __resolve_tanks(Arena *a);
+static void __resolve_tank_collisions(Arena *a);
+static void __resolve_shells(Arena *a);
+static bool __prepare_shell_results(Arena *a);
+static void __finish_turns(Arena *a);
+
+static void __perform_shooting(Arena *a, TankHandle t);
+static void __notify_in_radius(Arena *a, const Vector *origin, double radius, uint8_t message, TankHandle exclude);
+static TankHandle __shell_collision_detection(Arena *a, ShellHandle s);
+static void __tank_hit(Arena *a, TankHandle t, int amount);
+static void __shell_explode(Arena *a, ShellHandle s, TankHandle exclude);
+static void __tank_damage(Arena *a, TankHandle t, size_t damage_amount, uint8_t notification, const Vector *offset);
+static void __check_winner(Arena *a);
+static void __clean(void);
+
+bool game_start(const Landscape *l, const GameSettings *settings)
+{
+    log_info("start.", "");
+    assert(l && "Bad landscape pointer.");
+    assert(settings && "Bad settings pointer.");
+    assert(0 < settings->arena_count && MAX_ARENAS >= settings->arena_count && "Bad arena count.");
+    assert(0 < settings->worker_count && GAME_MAX_WORKERS >= settings->worker_count && "Bad worker count.");
+    assert(0 < settings->tick_rate && SCHEDULER_MAX_TICK_RATE >= settings->tick_rate && "Bad tick rate.");
 
-static const Landscape *landscape = NULL;
-static DynamicArray *clients = NULL;
-static DynamicArray *shells = NULL;
-
-static int __game_worker(void *unused);
+    uint64_t landscape_hash = journal_landscape_hash(l);
+    for (arena_count = 0; arena_count < settings->arena_count; arena_count++)
+    {
+        Arena *a = arena_create(arena_count, l, settings->seed + arena_count);
+        check_mem(arenas[arena_count] = a);
 
-static bool __game_tank_initialize(size_t i, Client *c, const Landscape *landscape, size_t clients_count);
-static void __tank_collision_detection(size_t i, Client *c);
-static void __perform_shooting(Client *client);
-static void __notify_in_radius(const Vector *origin, double radius, uint8_t message, Client *exclude);
-static Client *__shell_collision_detection(Shell *shell);
-static void __tank_hit(Client *c, int amount);
-static void __shell_explode(Shell *shell, Client *exclude);
-static void __tank_damage(Client *c, size_t damage_amount, uint8_t notification, const Vector *offset);
-static void __check_winner(void);
+        // Bad checkpoint mustn't keep server down, arena starts new match instead.
+        bool restored = false;
+        if (settings->checkpoint_path && !__restore_arena(a, settings->checkpoint_path, landscape_hash, &restored))
+        {
+            log_warning("arena %u isn't restored, it starts new match.", (unsigned) arena_count);
+        }
 
-static unsigned long __timeval_sub(struct _timeval *t1, struct _timeval *t2);
+        // Journal replays match from its start only.
+        if (settings->journal_path && restored)
+        {
+            log_info("arena %u is restored, it isn't recorded.", (unsigned) arena_count);
+        }
+        else if (settings->journal_path)
+        {
+            char filename[FILENAME_MAX];
+            snprintf(filename, sizeof(filename), "%s/arena_%u.journal", settings->journal_path, (unsigned) arena_count);
+
+            JournalHeader header = {
+                .magic          = JOURNAL_MAGIC,
+                .version        = JOURNAL_VERSION,
+                .arena          = (uint8_t) arena_count,
+                .seed           = settings->seed + arena_count,
+                .landscape_hash = landscape_hash,
+                .first_shell_id = a->world->next_shell_id
+            };
+            check(a->journal = journal_create(filename, &header), "Failed to create arena journal.", "");
+        }
+    }
 
-bool game_start(const Landscape *l, DynamicArray *c)
-{
-    log_info("start.", "");
-    assert(l && "Bad landscape pointer.");
-    assert(c && "Bad clients pointer.");
+    if (settings->checkpoint_path)
+    {
+        check(checkpoint_start(settings->checkpoint_path, arena_count, settings->checkpoint_interval, landscape_hash),
+              "Failed to start checkpoint writer.",
+              "");
+    }
 
-    landscape = l;
-    clients = c;
+    // Extra workers help ticking arenas in parallel phases.
+    size_t tick_worker_count = min(settings->worker_count, arena_count);
+    check_mem(pool = thread_pool_create(settings->worker_count - tick_worker_count));
 
-    check_mem(shells = DYNAMIC_ARRAY_CREATE(Shell *, 16));
+    for (turn_sync_count = 0; turn_sync_count < tick_worker_count; turn_sync_count++)
+    {
+        check(thrd_success == mtx_init(&turn_mutexes[turn_sync_count], mtx_plain), "Failed to initialize turn mutex.", "");
+        if (thrd_success != cnd_init(&turn_conditions[turn_sync_count]))
+        {
+            mtx_destroy(&turn_mutexes[turn_sync_count]);
+            sentinel("Failed to initialize turn condition.", "");
+        }
+        turn_signaled[turn_sync_count] = false;
+    }
 
+    tick_policy = settings->policy;
+    tick_rate = settings->tick_rate;
     working = true;
-    check(thrd_success == thrd_create(&worker_tid, __game_worker, NULL), "Failed to start game worker thread.", "");
+    for (worker_count = 0; worker_count < tick_worker_count; worker_count++)
+    {
+        scheduler_initialize(&schedulers[worker_count], settings->tick_rate, settings->policy);
+        check(thrd_success == thrd_create(&worker_tids[worker_count], __game_worker, (void *) (uintptr_t) worker_count),
+              "Failed to start game worker thread.",
+              "");
+    }
 
-    log_info("end.", "");
+    log_info("end. arenas: %u, workers: %u, helpers: %u, tick rate: %u, policy: %s, seed: %llu, journals: %s.",
+             (unsigned) arena_count,
+             (unsigned) worker_count,
+             (unsigned) pool->thread_count,
+             settings->tick_rate,
+             scheduler_policy_name(settings->policy),
+             (unsigned long long) settings->seed,
+             settings->journal_path ? settings->journal_path : "off");
     return true;
     error:
-    thrd_detach(worker_tid);
-    if (shells)
-    {
-        dynamic_array_destroy(shells);
-        shells = NULL;
-    }
+    __clean();
     log_info("error.", "");
     return false;
 }
@@ -66,226 +169,643 @@ bool game_start(const Landscape *l, DynamicArray *c)
 void game_stop(void)
 {
     log_info("start.", "");
-    working = false;
-    log_info("wait for worker to stop.", "");
-    thrd_join(worker_tid, NULL);
-    thrd_detach(worker_tid);
-    if (shells)
-    {
-        dynamic_array_destroy(shells);
-        shells = NULL;
-    }
+    __clean();
     log_info("end.", "");
 }
 
-const Landscape *game_get_landscape(void)
+size_t game_get_arena_count(void)
+{
+    return arena_count;
+}
+
+unsigned game_get_tick_rate(void)
 {
-    return landscape;
+    return tick_rate;
 }
 
+Arena *game_get_arena(size_t id)
+{
+    assert(id < arena_count && "Bad arena id.");
+    return arenas[id];
+}
+
+// Client's arena must be locked by caller.
 void game_tank_initialize(Client *c)
 {
     assert(c && "Bad client pointer.");
+    assert(c->network_client.arena && "Client isn't in arena.");
 
     log_info("initializing new tank.", "");
 
-    size_t clients_count = dynamic_array_count(clients), i;
+    Arena *a = c->network_client.arena;
+    const Landscape *landscape = a->landscape;
+    World *w = a->world;
+    size_t clients_count = a->clients.count;
+    TankHandle t;
+
+    Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
+    world_tank_bounding(w, c->tank, bounding_primitives, &bounding);
 
     do
     {
         Vector position, top;
 
-        position.x = (double) (rand() % (landscape->landscape_size * landscape->tile_size - 1));
-        position.y = (double) (rand() % (landscape->landscape_size * landscape->tile_size - 1));
+        position.x = (double) (arena_random(a) % (landscape->landscape_size * landscape->tile_size - 1));
+        position.y = (double) (arena_random(a) % (landscape->landscape_size * landscape->tile_size - 1));
         position.z = landscape_get_height_at(landscape, position.x, position.y);
 
         landscape_get_normal_at(landscape, position.x, position.y, &top);
-        tank_initialize(&c->tank, &position, &top, clients_count);
+        tank_initialize(w, c->tank, &position, &top, clients_count);
 
-        for (i = 0; i < clients_count; i++)
+        for (t = 0; t < WORLD_MAX_TANKS; t++)
         {
-            Client *previous_c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
-            if (c == previous_c)
+            if (!w->tank_used[t] || c->tank == t)
             {
                 continue;
             }
 
+            Bounding previous_bounding_primitives[TANK_BOUNDING_PRIMITIVES], previous_bounding;
+            world_tank_bounding(w, t, previous_bounding_primitives, &previous_bounding);
+
             double intersection_time = nan(NULL);
-            if (cs_in_game == previous_c->network_client.state &&
-                (intersection_test(&c->tank.bounding, &previous_c->tank.bounding, &intersection_time) ||
-                 !isnan(intersection_time) && 1.0 >= intersection_time))
+            if (intersection_test(&bounding, &previous_bounding, &intersection_time) ||
+                !isnan(intersection_time) && 1.0 >= intersection_time)
             {
                 break;
             }
         }
-    } while (i < clients_count);
+    } while (t < WORLD_MAX_TANKS);
 
     c->network_client.state = cs_in_game;
     log_info("initializing new tank finished.", "");
 }
 
-static int __game_worker(void *unused)
+// Client's arena must be locked by caller.
+// Client gets "end of turn" response after next tick. In lockstep mode this tick starts
+// as soon as every alive tank of arena has ended its turn.
+void game_end_turn(Client *c)
+{
+    assert(c && "Bad client pointer.");
+    assert(c->network_client.arena && "Client isn't in arena.");
+
+    Arena *a = c->network_client.arena;
+    a->turn_ended[c->tank] = true;
+
+    if (scheduler_lockstep != tick_policy)
+    {
+        return;
+    }
+
+    size_t worker = a->id % turn_sync_count;
+    mtx_lock(&turn_mutexes[worker]);
+    turn_signaled[worker] = true;
+    cnd_signal(&turn_conditions[worker]);
+    mtx_unlock(&turn_mutexes[worker]);
+}
+
+void game_tick_arena(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+    __game_tick(a);
+}
+
+void game_collect_phase_times(MetricsHistogram *phases)
+{
+    assert(phases && "Bad phase histograms pointer.");
+
+    memset(phases, 0, metrics_phase_count * sizeof(MetricsHistogram));
+    for (size_t i = 0; i < arena_count; i++)
+    {
+        arena_lock(arenas[i]);
+        for (MetricsPhase p = 0; p < metrics_phase_count; p++)
+        {
+            metrics_histogram_merge(&phases[p], &arenas[i]->phase_times[p]);
+        }
+        arena_unlock(arenas[i]);
+    }
+}
+
+bool game_save_checkpoints(void)
+{
+    bool result = true;
+    for (size_t i = 0; i < arena_count; i++)
+    {
+        arena_lock(arenas[i]);
+        result = checkpoint_save(arenas[i]) && result;
+        arena_unlock(arenas[i]);
+    }
+
+    return result;
+}
+
+// Clients are registered again with addresses from checkpoint, so they go on playing without "hello".
+static bool __restore_arena(Arena *a, const char *path, uint64_t landscape_hash, bool *restored)
 {
-    #pragma ref unused
-    struct _timeval tick_start_time, tick_end_time;
-    log_info("start. tid: %u", GetCurrentThreadId());
+    assert(a && "Bad arena pointer.");
+    assert(path && "Bad path pointer.");
+    assert(restored && "Bad restored flag pointer.");
+
+    char filename[FILENAME_MAX];
+    checkpoint_filename(filename, sizeof(filename), path, a->id);
+
+    *restored = false;
+    FILE *f = fopen(filename, "rb");
+    if (NULL == f)
+    {
+        log_info("no checkpoint of arena %u.", (unsigned) a->id);
+        return true;
+    }
+    fclose(f);
+
+    CheckpointSnapshot *s = checkpoint_snapshot_create();
+    check_mem(s);
+    check(checkpoint_read(filename, s), "Failed to read checkpoint: %s.", filename);
+    check(landscape_hash == s->header.landscape_hash && a->id == s->header.arena,
+          "Checkpoint doesn't match arena: %s.",
+          filename);
+
+    check(world_copy(a->world, s->world), "Failed to copy world.", "");
+    a->tick = s->header.tick;
+    a->random_state = s->header.random_state;
+
+    get_global_lock();
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!a->world->tank_used[t])
+        {
+            continue;
+        }
+
+        NetworkClient *c = register_client(&s->client_address[t]);
+        if (c && NULL == c->arena && arena_restore_client(a, c, t))
+        {
+            c->state = s->client_state[t];
+            continue;
+        }
+
+        log_error("Failed to restore client of tank %u.", (unsigned) t);
+        if (c && NULL == c->arena)
+        {
+            unregister_client(&s->client_address[t]);
+        }
+        world_tank_free(a->world, t);
+    }
+    release_global_lock();
+
+    log_info("arena %u is restored at tick %llu, tanks: %u, shells: %u.",
+             (unsigned) a->id,
+             a->tick,
+             (unsigned) a->clients.count,
+             (unsigned) a->world->shell_count);
+
+    *restored = true;
+    checkpoint_snapshot_destroy(s);
+    return true;
+    error:
+    if (s)
+    {
+        checkpoint_snapshot_destroy(s);
+    }
+
+    // Arena is untouched on failure. Bad file is kept for post-mortem, but isn't read at next start.
+    char aside[FILENAME_MAX];
+    snprintf(aside, sizeof(aside), "%s.bad", filename);
+    if (!MoveFileExA(filename, aside, MOVEFILE_REPLACE_EXISTING))
+    {
+        log_error("Failed to move bad checkpoint aside: %s. Error: %lu.", filename, GetLastError());
+    }
+    return false;
+}
 
-    srand((unsigned) (time(NULL) ^ _getpid()));
+static int __game_worker(void *worker_index)
+{
+    size_t first_arena = (size_t) (uintptr_t) worker_index;
+    Scheduler *scheduler = &schedulers[first_arena];
+    log_info("start. tid: %u, first arena: %u", GetCurrentThreadId(), (unsigned) first_arena);
 
     while (working)
     {
+        if (scheduler_lockstep == scheduler->policy)
+        {
+            check(__lockstep_step(first_arena, scheduler), "Failed to run lockstep turn.", "");
+            continue;
+        }
+
         //log_info("tick start.", "");
-        get_global_lock();
-        _gettimeofday(&tick_start_time, NULL);
 
-        size_t clients_count = dynamic_array_count(clients);
-        for (size_t i = 0; i < clients_count; i++)
+        // Arenas are statically distributed between workers.
+        for (size_t i = first_arena; i < arena_count; i += worker_count)
         {
-            Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+            Arena *a = arenas[i];
+            arena_lock(a);
+            __game_tick(a);
+            arena_unlock(a);
+        }
 
-            if (cs_in_game != c->network_client.state)
-            {
-                continue;
-            }
+        check(scheduler_wait(scheduler), "Failed to wait for next tick.", "");
 
-            if (c->tank.hp)
-            {
-                if (!tank_tick(&c->tank, landscape))
-                {
-                    uint8_t data = not_tank_hit_bound;
-                    respond((const char *) &data, 1, &c->network_client.address);
-                }
-            }
+        //log_info("tick end.", "");
+    }
 
-            if (-1 == c->tank.fire_delay)
-            {
-                __perform_shooting(c);
-            }
+    log_info("end. ticks: %llu, overruns: %llu, skipped: %llu, max lateness: %llu us, turn timeouts: %llu.",
+             scheduler->ticks,
+             scheduler->overruns,
+             scheduler->skipped_ticks,
+             (unsigned long long) (scheduler->max_lateness / 1000),
+             scheduler->turn_timeouts);
+    return 0;
+    error:
+    log_info("error.", "");
+    return -1;
+}
+
+// Ticks worker's arenas which are done with turn: all clients have ended it or turn timeout has passed.
+// Then sleeps until some client ends its turn or nearest timeout. Each arena tick is counted.
+static bool __lockstep_step(size_t worker, Scheduler *scheduler)
+{
+    assert(scheduler && "Bad scheduler pointer.");
+
+    uint64_t nearest_deadline = UINT64_MAX;
+    for (size_t i = worker; i < arena_count; i += worker_count)
+    {
+        Arena *a = arenas[i];
+        arena_lock(a);
+
+        bool timeout = scheduler_now() >= a->turn_deadline;
+        if (timeout || __turns_ended(a))
+        {
+            __game_tick(a);
+            scheduler->ticks++;
+            scheduler->turn_timeouts += timeout ? 1 : 0;
+            a->turn_deadline = scheduler_now() + scheduler->period;
+        }
+
+        nearest_deadline = min(nearest_deadline, a->turn_deadline);
+        arena_unlock(a);
+    }
+
+    check(thrd_success == mtx_lock(&turn_mutexes[worker]), "Failed to lock turn mutex.", "");
+    while (!turn_signaled[worker] && working)
+    {
+        uint64_t now = scheduler_now();
+        if (now >= nearest_deadline)
+        {
+            break;
+        }
+
+        // Condition waits on calendar time.
+        struct timespec wake;
+        timespec_get(&wake, TIME_UTC);
+        uint64_t wake_nsec = (uint64_t) wake.tv_nsec + (nearest_deadline - now);
+        wake.tv_sec += (time_t) (wake_nsec / SCHEDULER_NSEC_PER_SEC);
+        wake.tv_nsec = (long) (wake_nsec % SCHEDULER_NSEC_PER_SEC);
+
+        int result = cnd_timedwait(&turn_conditions[worker], &turn_mutexes[worker], &wake);
+        if (thrd_timedout == result)
+        {
+            break;
         }
 
-        for (size_t i = 0; i < clients_count; i++)
+        if (thrd_success != result)
         {
-            Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
-            if (cs_in_game != c->network_client.state)
+            mtx_unlock(&turn_mutexes[worker]);
+            sentinel("Failed to wait for turn end.", "");
+        }
+    }
+    turn_signaled[worker] = false;
+    mtx_unlock(&turn_mutexes[worker]);
+
+    return true;
+    error:
+    return false;
+}
+
+// Arena must be locked by caller. Arena without alive tanks waits for timeout.
+static bool __turns_ended(const Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    const World *w = a->world;
+    bool has_players = false;
+
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t] || 0 == w->tank_hp[t] || cs_in_game != w->tank_client[t]->network_client.state)
+        {
+            continue;
+        }
+
+        if (!a->turn_ended[t])
+        {
+            return false;
+        }
+
+        has_players = true;
+    }
+
+    return has_players;
+}
+
+// Arena must be locked by caller.
+// Tick is split into phases. Parallel phases write only to their own tank / shell
+// and to arena's phase results, serial phases apply results in tank / shell order.
+// So outcome doesn't depend on helper count.
+static void __game_tick(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    uint64_t tick_start = scheduler_now(), phase_start = tick_start;
+    a->tick++;
+
+    thread_pool_parallel_for(pool, WORLD_MAX_TANKS, TANKS_GRAIN, __integrate_tanks_task, a);
+    __resolve_tanks(a);
+    __record_phase(a, metrics_phase_tanks, &phase_start);
+
+    check(__prepare_shell_results(a), "Failed to prepare shell results.", "");
+    thread_pool_parallel_for(pool, a->world->shell_count, SHELLS_GRAIN, __integrate_shells_task, a);
+    __record_phase(a, metrics_phase_shells, &phase_start);
+
+    thread_pool_parallel_for(pool, WORLD_MAX_TANKS, TANKS_GRAIN, __tank_broadphase_task, a);
+    __resolve_tank_collisions(a);
+    __record_phase(a, metrics_phase_tank_collisions, &phase_start);
+
+    thread_pool_parallel_for(pool, a->world->shell_count, SHELLS_GRAIN, __shell_narrowphase_task, a);
+    __resolve_shells(a);
+    __record_phase(a, metrics_phase_shell_collisions, &phase_start);
+
+    if (a->journal)
+    {
+        journal_write_tick(a->journal, journal_world_hash(a->world));
+    }
+
+    checkpoint_tick(a);
+    __record_phase(a, metrics_phase_record, &phase_start);
+    metrics_histogram_record(&a->phase_times[metrics_phase_tick], phase_start - tick_start);
+    trace_span(metrics_phase_name(metrics_phase_tick), tick_start, phase_start, a->id);
+
+    error:
+    __finish_turns(a);
+    return;
+}
+
+// Arena must be locked by caller. Phase ends now, next phase starts.
+static void __record_phase(Arena *a, MetricsPhase phase, uint64_t *phase_start)
+{
+    uint64_t now = scheduler_now();
+    metrics_histogram_record(&a->phase_times[phase], now - *phase_start);
+    trace_span(metrics_phase_name(phase), *phase_start, now, a->id);
+    *phase_start = now;
+}
+
+static void __integrate_tanks_task(void *context, size_t begin, size_t end)
+{
+    Arena *a = (Arena *) context;
+    World *w = a->world;
+
+    for (TankHandle t = begin; t < end; t++)
+    {
+        a->tank_hit_bound[t] = false;
+        if (w->tank_used[t] && w->tank_hp[t])
+        {
+            a->tank_hit_bound[t] = !tank_tick(w, t, a->landscape);
+        }
+    }
+}
+
+static void __integrate_shells_task(void *context, size_t begin, size_t end)
+{
+    Arena *a = (Arena *) context;
+
+    for (ShellHandle s = begin; s < end; s++)
+    {
+        arena_shell_result_array_at(&a->shell_results, s)->alive = shell_tick(a->world, s, a->landscape);
+    }
+}
+
+// Tests every tank pair once. Resolving may move tanks, then pairs are retested in __resolve_tank_collisions().
+static void __tank_broadphase_task(void *context, size_t begin, size_t end)
+{
+    Arena *a = (Arena *) context;
+    World *w = a->world;
+    double unused;
+
+    for (TankHandle t = begin; t < end; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            continue;
+        }
+
+        Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
+        world_tank_bounding(w, t, bounding_primitives, &bounding);
+
+        for (TankHandle previous_t = 0; previous_t < t; previous_t++)
+        {
+            if (!w->tank_used[previous_t])
             {
                 continue;
             }
-            __tank_collision_detection(i, c);
+
+            Bounding previous_bounding_primitives[TANK_BOUNDING_PRIMITIVES], previous_bounding;
+            world_tank_bounding(w, previous_t, previous_bounding_primitives, &previous_bounding);
+
+            a->tank_intersections[t][previous_t] = intersection_test(&bounding, &previous_bounding, &unused);
+        }
+    }
+}
+
+static void __shell_narrowphase_task(void *context, size_t begin, size_t end)
+{
+    Arena *a = (Arena *) context;
+
+    for (ShellHandle s = begin; s < end; s++)
+    {
+        arena_shell_result_array_at(&a->shell_results, s)->hit_tank = __shell_collision_detection(a, s);
+    }
+}
+
+static void __resolve_tanks(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    World *w = a->world;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            continue;
         }
 
-        for (size_t i = 0; i < dynamic_array_count(shells);)
+        if (a->tank_hit_bound[t])
         {
-            Shell *shell = *DYNAMIC_ARRAY_GET(Shell **, shells, i);
+            uint8_t data = not_tank_hit_bound;
+            respond((const char *) &data, 1, &w->tank_client[t]->network_client.address);
+        }
 
-            bool result = shell_tick(shell, landscape);
-            Client *hit_tank = __shell_collision_detection(shell);
+        if (-1 == w->tank_fire_delay[t])
+        {
+            __perform_shooting(a, t);
+        }
+    }
+}
 
-            if (hit_tank)
-            {
-                __tank_hit(hit_tank, 0);
+static void __resolve_tank_collisions(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
 
-                for (size_t i = 0; i < clients_count; i++)
-                {
-                    Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
-                    if (c->tank.last_shell_id == shell->id)
-                    {
-                        c->tank.statistics.direct_hits++;
-                        break;
-                    }
-                }
-            }
+    World *w = a->world;
+    bool moved[WORLD_MAX_TANKS] = { false };
+    double unused;
 
-            if (hit_tank || !result)
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            continue;
+        }
+
+        Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
+        world_tank_bounding(w, t, bounding_primitives, &bounding);
+
+        for (TankHandle previous_t = 0; previous_t < t; previous_t++)
+        {
+            if (!w->tank_used[previous_t])
             {
-                __shell_explode(shell, hit_tank);
-                dynamic_array_delete_at(shells, i);
-                free(shell);
+                continue;
             }
-            else
+
+            Bounding previous_bounding_primitives[TANK_BOUNDING_PRIMITIVES], previous_bounding;
+            world_tank_bounding(w, previous_t, previous_bounding_primitives, &previous_bounding);
+
+            bool intersection = moved[t] || moved[previous_t] ?
+                                intersection_test(&bounding, &previous_bounding, &unused) :
+                                a->tank_intersections[t][previous_t];
+            if (!intersection)
             {
-                i++;
+                continue;
             }
+
+            intersection_resolve(&bounding, &previous_bounding);
+            moved[t] = moved[previous_t] = true;
+
+            uint8_t data = not_tank_collision;
+            respond((const char *) &data, 1, &w->tank_client[t]->network_client.address);
+            respond((const char *) &data, 1, &w->tank_client[previous_t]->network_client.address);
         }
+    }
+}
+
+static void __resolve_shells(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    World *w = a->world;
+    size_t kept = 0;
+
+    // In order of firing. Kept shells are moved only to already resolved handles, so s is never overwritten.
+    for (ShellHandle s = 0; s < w->shell_count; s++)
+    {
+        const ArenaShellResult *result = arena_shell_result_array_at(&a->shell_results, s);
+        TankHandle hit_tank = result->hit_tank;
+
+        if (TANK_NONE != hit_tank)
+        {
+            __tank_hit(a, hit_tank, 0);
 
-        _gettimeofday(&tick_end_time, NULL);
-        release_global_lock();
+            for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+            {
+                if (w->tank_used[t] && w->tanks[t].last_shell_id == w->shell_id[s])
+                {
+                    w->tanks[t].statistics.direct_hits++;
+                    break;
+                }
+            }
+        }
 
-        unsigned long tick_length = __timeval_sub(&tick_end_time, &tick_start_time); // Microseconds.
-        if (GAME_TICK_DURATION >= tick_length)
+        if (TANK_NONE != hit_tank || !result->alive)
         {
-            unsigned long long time_to_sleep = GAME_TICK_DURATION - tick_length;
-            struct timespec sleep_duration = {
-                .tv_sec = (time_t) (time_to_sleep / 1000000),
-                .tv_nsec = (long) ((time_to_sleep % 1000000) * 1000)
-            };
-            check(0 == thrd_sleep(&sleep_duration, NULL), "Failed to sleep.", "");
+            __shell_explode(a, s, hit_tank);
+            continue;
         }
 
-        //log_info("tick end.", "");
+        world_shell_move(w, s, kept++);
     }
 
-    log_info("end.", "");
-    return 0;
+    world_shell_truncate(w, kept);
+}
+
+static bool __prepare_shell_results(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    ArenaShellResult empty = { .alive = true, .hit_tank = TANK_NONE };
+
+    // Both phases overwrite results, so only new ones are initialized.
+    check(arena_shell_result_array_resize(&a->shell_results, a->world->shell_count, empty), "Failed to add shell results.", "");
+
+    return true;
     error:
-    log_info("error.", "");
-    return -1;
+    return false;
 }
 
-static void __tank_collision_detection(size_t i, Client *c)
+// Responds to clients which have ended their turn before this tick.
+static void __finish_turns(Arena *a)
 {
-    double unused;
+    assert(a && "Bad arena pointer.");
 
-    for (size_t j = 0; j < i; j++)
+    World *w = a->world;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
     {
-        if (i == j)
+        if (!a->turn_ended[t])
         {
             continue;
         }
 
-        Client *previous_c = *DYNAMIC_ARRAY_GET(Client **, clients, j);
-        if (cs_in_game == previous_c->network_client.state &&
-            intersection_test(&c->tank.bounding, &previous_c->tank.bounding, &unused))
+        a->turn_ended[t] = false;
+        if (w->tank_used[t])
         {
-            intersection_resolve(&c->tank.bounding, &previous_c->tank.bounding);
-
-            uint8_t data = not_tank_collision;
-            respond((const char *) &data, 1, &c->network_client.address);
-            respond((const char *) &data, 1, &previous_c->network_client.address);
+            uint8_t response = req_end_turn;
+            respond((const char *) &response, 1, &w->tank_client[t]->network_client.address);
         }
     }
 }
 
-static void __perform_shooting(Client *client)
+static void __perform_shooting(Arena *a, TankHandle t)
 {
-    assert(client && "Bad client pointer.");
+    assert(a && "Bad arena pointer.");
+
+    World *w = a->world;
+    const Vector *direction   = &w->tank_direction[t],
+                 *orientation = &w->tank_orientation[t];
+    Tank *tank = &w->tanks[t];
 
     Vector e = TANK_BOUNDING_BOX_EXTENT,
-           p = client->tank.position,
-           o = client->tank.orientation;
+           p = w->tank_position[t],
+           o = *orientation;
 
     VECTOR_SCALE(&o, 2.0 * e.z + TANK_BOUNDING_SPHERE_RADIUS / 2.0);
     VECTOR_ADD(&p, &o);
 
     Vector default_turret_direction = { .x = 1, .y = 0, .z = 0 },
-           turret_direction         = client->tank.direction;
+           turret_direction         = *direction;
 
-    if (0 != memcmp(&default_turret_direction, &client->tank.turret_direction, sizeof(Vector)))
+    if (0 != memcmp(&default_turret_direction, &tank->turret_direction, sizeof(Vector)))
     {
-        turret_direction = client->tank.turret_direction;
+        turret_direction = tank->turret_direction;
 
         Vector side;
-        vector_vector_mul(&client->tank.orientation, &client->tank.direction, &side);
+        vector_vector_mul(orientation, direction, &side);
         VECTOR_NORMALIZE(&side);
 
         Vector top;
-        vector_vector_mul(&client->tank.direction, &side, &top);
+        vector_vector_mul(direction, &side, &top);
         VECTOR_NORMALIZE(&top);
 
         Matrix m = {
             .values = {
-                { client->tank.direction.x, side.x, top.x },
-                { client->tank.direction.y, side.y, top.y },
-                { client->tank.direction.z, side.z, top.z }
+                { direction->x, side.x, top.x },
+                { direction->y, side.y, top.y },
+                { direction->z, side.z, top.z }
             }
         };
 
@@ -302,95 +822,95 @@ static void __perform_shooting(Client *client)
 
     VECTOR_NORMALIZE(&turret_direction);
 
-    Shell *new_shell = NULL;
-    new_shell = shell_create(&p, &turret_direction);
-    client->tank.last_shell_id = new_shell->id;
-    check_mem(new_shell);
+    ShellHandle s = shell_create(w, &p, &turret_direction);
+    check(SHELL_NONE != s, "Failed to add new shell.", "");
+    tank->last_shell_id = w->shell_id[s];
+    w->tank_fire_delay[t] = TANK_FIRE_DELAY;
 
-    check(dynamic_array_push(shells, &new_shell), "Failed to add new shell.", "");
-    client->tank.fire_delay = TANK_FIRE_DELAY;
-
-    __notify_in_radius(&client->tank.position, NEAR_SHOOT_NOTIFICATION_RARIUS, not_near_shoot, client);
+    __notify_in_radius(a, &w->tank_position[t], NEAR_SHOOT_NOTIFICATION_RARIUS, not_near_shoot, t);
 
     NotViewerShellEvent shoot_notification = {
         .type = not_viewer_shoot,
-        .x = new_shell->position.x,
-        .y = new_shell->position.y,
-        .z = new_shell->position.z
+        .x = w->shell_position[s].x,
+        .y = w->shell_position[s].y,
+        .z = w->shell_position[s].z
     };
 
-    notify_viewers(&shoot_notification);
+    notify_viewers(a, &shoot_notification);
 
     //printf("Shoot at: %lf; %lf; %lf\n", shoot_notification.x, shoot_notification.y, shoot_notification.z);
     error:
     return;
 }
 
-static void __notify_in_radius(const Vector *origin, double radius, uint8_t message, Client *exclude)
+static void __notify_in_radius(Arena *a, const Vector *origin, double radius, uint8_t message, TankHandle exclude)
 {
+    assert(a && "Bad arena pointer.");
     assert(origin && "Bad origin pointer.");
 
-    size_t clients_count = dynamic_array_count(clients);
-    for (size_t i = 0; i < clients_count; i++)
+    World *w = a->world;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
     {
-        Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
-
-        if (cs_in_game != c->network_client.state || exclude == c)
+        if (!w->tank_used[t] || exclude == t)
         {
             continue;
         }
 
-        Vector t;
-        vector_sub(origin, &c->tank.position, &t);
+        Vector d;
+        vector_sub(origin, &w->tank_position[t], &d);
 
-        if (vector_length(&t) > radius)
+        if (vector_length(&d) > radius)
         {
             continue;
         }
 
         NotViewerShellEvent response = {
             .type = message,
-            .x    = t.x,
-            .y    = t.y,
-            .z    = t.z
+            .x    = d.x,
+            .y    = d.y,
+            .z    = d.z
         };
 
-        respond((const char *) &response, sizeof(response), &c->network_client.address);
+        respond((const char *) &response, sizeof(response), &w->tank_client[t]->network_client.address);
     }
 }
 
-static Client *__shell_collision_detection(Shell *shell)
+static TankHandle __shell_collision_detection(Arena *a, ShellHandle s)
 {
-    assert(shell && "Bad shell pointer.");
+    assert(a && "Bad arena pointer.");
 
-    Client *result = NULL;
+    World *w = a->world;
+    TankHandle result = TANK_NONE;
     double distance = 0.0, result_intersection_time = nan(NULL);
-    Vector t;
+    Vector d;
 
-    size_t clients_count = dynamic_array_count(clients);
-    for (size_t i = 0; i < clients_count; i++)
-    {
-        Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+    Bounding shell_bounding;
+    world_shell_bounding(w, s, &shell_bounding);
 
-        if (cs_in_game != c->network_client.state)
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
         {
             continue;
         }
 
+        Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
+        world_tank_bounding(w, t, bounding_primitives, &bounding);
+
         double intersection_time = nan(NULL);
-        bool intersection = intersection_test(&shell->bounding, &c->tank.bounding, &intersection_time);
+        bool intersection = intersection_test(&shell_bounding, &bounding, &intersection_time);
 
         if (!intersection && (isnan(intersection_time) || 1.0 < intersection_time))
         {
             continue;
         }
 
-        vector_sub(shell->bounding.previous_origin, c->tank.bounding.previous_origin, &t);
+        vector_sub(&w->shell_previous_position[s], &w->tank_previous_position[t], &d);
 
-        if (NULL == result)
+        if (TANK_NONE == result)
         {
-            result = c;
-            distance = vector_length(&t);
+            result = t;
+            distance = vector_length(&d);
             if (!isnan(intersection_time) && 1.0 >= intersection_time)
             {
                 result_intersection_time = intersection_time;
@@ -398,10 +918,10 @@ static Client *__shell_collision_detection(Shell *shell)
             continue;
         }
 
-        double new_distance = vector_length(&t);
+        double new_distance = vector_length(&d);
         if (new_distance < distance)
         {
-            result = c;
+            result = t;
             distance = new_distance;
             if (!isnan(intersection_time) && 1.0 >= intersection_time)
             {
@@ -412,51 +932,54 @@ static Client *__shell_collision_detection(Shell *shell)
 
     if (!isnan(result_intersection_time))
     {
-        Vector t = shell->direction;
-        VECTOR_SCALE(&t, shell->speed * result_intersection_time);
-        VECTOR_ADD(&shell->position, &t);
+        Vector d = w->shell_direction[s];
+        VECTOR_SCALE(&d, w->shell_speed[s] * result_intersection_time);
+        VECTOR_ADD(&w->shell_position[s], &d);
     }
 
     return result;
 }
 
-static void __tank_hit(Client *c, int amount)
+static void __tank_hit(Arena *a, TankHandle t, int amount)
 {
-    assert(c && "Bad client pointer.");
+    assert(a && "Bad arena pointer.");
 
     if (!amount)
     {
         amount = SHELL_HIT_AMOUNT;
     }
 
-    c->tank.statistics.got_direct_hits++;
-    __tank_damage(c, amount, not_hit, &(Vector) { .x = 0, .y = 0, .z = 0});
+    a->world->tanks[t].statistics.got_direct_hits++;
+    __tank_damage(a, t, amount, not_hit, &(Vector) { .x = 0, .y = 0, .z = 0});
 }
 
-static void __shell_explode(Shell *shell, Client *exclude)
+static void __shell_explode(Arena *a, ShellHandle s, TankHandle exclude)
 {
-    assert(shell && "Bad shell pointer.");
+    assert(a && "Bad arena pointer.");
 
-    Vector t;
+    World *w = a->world;
+    Vector d;
 
-    Client *shell_owner = NULL;
-    size_t clients_count = dynamic_array_count(clients);
-    for (size_t i = 0; i < clients_count; i++)
+    Tank *shell_owner = NULL;
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
     {
-        Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+        if (!w->tank_used[t])
+        {
+            continue;
+        }
 
-        if (c->tank.last_shell_id == shell->id)
+        if (w->tanks[t].last_shell_id == w->shell_id[s])
         {
-            shell_owner = c;
+            shell_owner = &w->tanks[t];
         }
 
-        if (cs_in_game != c->network_client.state || c == exclude)
+        if (t == exclude)
         {
             continue;
         }
 
-        vector_sub(&shell->position, &c->tank.position, &t);
-        double r = vector_length(&t);
+        vector_sub(&w->shell_position[s], &w->tank_position[t], &d);
+        double r = vector_length(&d);
 
         if (r <= SHELL_EXPLOSION_RADIUS)
         {
@@ -466,56 +989,58 @@ static void __shell_explode(Shell *shell, Client *exclude)
             {
                 NotViewerShellEvent response = {
                     .type = not_near_explosion,
-                    .x    = t.x,
-                    .y    = t.y,
-                    .z    = t.z
+                    .x    = d.x,
+                    .y    = d.y,
+                    .z    = d.z
                 };
-                respond((const char *) &response, sizeof(response), &c->network_client.address);
+                respond((const char *) &response, sizeof(response), &w->tank_client[t]->network_client.address);
                 continue;
             }
 
-            c->tank.statistics.got_hits++;
+            w->tanks[t].statistics.got_hits++;
             if (shell_owner)
             {
-                shell_owner->tank.statistics.hits++;
+                shell_owner->statistics.hits++;
             }
-            __tank_damage(c, damage_amount, not_explosion_damage, &t);
+            __tank_damage(a, t, damage_amount, not_explosion_damage, &d);
         }
         else if (r <= NEAR_EXPLOSION_NOTIFICATION_RARIUS)
         {
             NotViewerShellEvent response = {
                 .type = not_near_explosion,
-                .x    = t.x,
-                .y    = t.y,
-                .z    = t.z
+                .x    = d.x,
+                .y    = d.y,
+                .z    = d.z
             };
-            respond((const char *) &response, sizeof(response), &c->network_client.address);
+            respond((const char *) &response, sizeof(response), &w->tank_client[t]->network_client.address);
         }
     }
 
     NotViewerShellEvent explosion_notification = {
         .type = not_viewer_explosion,
-        .x = shell->position.x,
-        .y = shell->position.y,
-        .z = shell->position.z
+        .x = w->shell_position[s].x,
+        .y = w->shell_position[s].y,
+        .z = w->shell_position[s].z
     };
-    notify_viewers(&explosion_notification);
+    notify_viewers(a, &explosion_notification);
 
+    size_t clients_count = a->clients.count;
     if (0 != clients_count && 1 != clients_count)
     {
-        __check_winner();
+        __check_winner(a);
     }
 }
 
-static void __tank_damage(Client *c, size_t damage_amount, uint8_t notification, const Vector *offset)
+static void __tank_damage(Arena *a, TankHandle t, size_t damage_amount, uint8_t notification, const Vector *offset)
 {
-    assert(c && "Bad client pointer.");
+    assert(a && "Bad arena pointer.");
 
+    World *w = a->world;
     uint8_t response_code = notification;
-    c->tank.hp -= damage_amount;
-    if (0 >= c->tank.hp)
+    w->tank_hp[t] -= damage_amount;
+    if (0 >= w->tank_hp[t])
     {
-        c->tank.hp = 0;
+        w->tank_hp[t] = 0;
         response_code = not_death;
     }
 
@@ -526,41 +1051,73 @@ static void __tank_damage(Client *c, size_t damage_amount, uint8_t notification,
         .z = offset->z
     };
 
-    respond((const char *) &response, sizeof(response), &c->network_client.address);
+    respond((const char *) &response, sizeof(response), &w->tank_client[t]->network_client.address);
 }
 
-static void __check_winner(void)
+static void __check_winner(Arena *a)
 {
-    size_t clients_count = dynamic_array_count(clients),
-           alive_count   = 0;
-    Client *last_alive = NULL;
+    assert(a && "Bad arena pointer.");
 
-    for (size_t i = 0; i < clients_count; i++)
-    {
-        Client *c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+    World *w = a->world;
+    size_t alive_count = 0;
+    TankHandle last_alive = TANK_NONE;
 
-        if (cs_in_game != c->network_client.state ||
-            0 == c->tank.hp)
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t] || 0 == w->tank_hp[t])
         {
             continue;
         }
 
         alive_count++;
-        last_alive = c;
+        last_alive = t;
     }
 
     if (1 == alive_count)
     {
         uint8_t response = not_win;
-        respond((char *) &response, 1, &last_alive->network_client.address);
-        last_alive->tank.hp = 0;
+        respond((char *) &response, 1, &w->tank_client[last_alive]->network_client.address);
+        w->tank_hp[last_alive] = 0;
     }
 }
 
-static unsigned long __timeval_sub(struct _timeval *t1, struct _timeval *t2)
+static void __clean(void)
 {
-    assert(t1 && t2 && "Bad time pointers.");
-    unsigned long _t1 = t1->tv_sec * 1000000 + t1->tv_usec,
-                  _t2 = t2->tv_sec * 1000000 + t2->tv_usec;
-    return _t1 - _t2;
+    working = false;
+
+    for (size_t i = 0; i < turn_sync_count; i++)
+    {
+        mtx_lock(&turn_mutexes[i]);
+        cnd_signal(&turn_conditions[i]);
+        mtx_unlock(&turn_mutexes[i]);
+    }
+
+    log_info("wait for workers to stop.", "");
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        thrd_join(worker_tids[i], NULL);
+    }
+    worker_count = 0;
+
+    checkpoint_stop();
+
+    for (size_t i = 0; i < turn_sync_count; i++)
+    {
+        cnd_destroy(&turn_conditions[i]);
+        mtx_destroy(&turn_mutexes[i]);
+    }
+    turn_sync_count = 0;
+
+    if (pool)
+    {
+        thread_pool_destroy(pool);
+        pool = NULL;
+    }
+
+    for (size_t i = 0; i < arena_count; i++)
+    {
+        arena_destroy(arenas[i]);
+        arenas[i] = NULL;
+    }
+    arena_count = 0;
 }
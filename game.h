@@ -7,22 +7,56 @@
 //#pragma message("__GAME_H__")
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "morrigan.h"
 #include "dynamic_array.h"
 #include "landscape.h"
 #include "server.h"
+#include "arena.h"
+#include "scheduler.h"
+#include "metrics.h"
 
-// 0.1 sec.
-#define GAME_TICK_DURATION 100000
+// Ticks per second.
+#define GAME_DEFAULT_TICK_RATE 10
+#define GAME_DEFAULT_CHECKPOINT_INTERVAL 100 // In ticks.
+#define GAME_MAX_WORKERS 64
 
 #define NEAR_SHOOT_NOTIFICATION_RARIUS 100
 #define NEAR_EXPLOSION_NOTIFICATION_RARIUS 100
 
-bool game_start(const Landscape *l, DynamicArray *c);
+#pragma pack(push, 8)
+
+typedef struct GameSettings
+{
+    size_t arena_count;
+    size_t worker_count;
+    unsigned tick_rate;
+    SchedulerPolicy policy;
+    uint64_t seed;            // Arena i is seeded with seed + i.
+    const char *journal_path; // Directory for match journals, NULL if matches aren't recorded.
+    const char *checkpoint_path;            // Directory for arena checkpoints, NULL if they are off.
+    unsigned long long checkpoint_interval; // In ticks.
+} GameSettings;
+
+#pragma pack(pop)
+
+bool game_start(const Landscape *l, const GameSettings *settings);
 void game_stop(void);
 
-const Landscape *game_get_landscape(void);
+size_t game_get_arena_count(void);
+unsigned game_get_tick_rate(void);
+Arena *game_get_arena(size_t id);
 void game_tank_initialize(Client *c);
+void game_end_turn(Client *c);
+
+// Sums tick phase histograms of all arenas into phases[metrics_phase_count].
+void game_collect_phase_times(MetricsHistogram *phases);
+
+// Writes checkpoints of all arenas at once, e.g. before planned restart.
+bool game_save_checkpoints(void);
+
+// Runs one tick of arena on calling thread. Used by replay. Arena must be locked by caller.
+void game_tick_arena(Arena *a);
 
 #endif /* __GAME_H__ */
@@ -11,19 +11,38 @@ extern "C"
     #include "client_protocol.h"
 }
 
+// Cleared by signal handler, stops every bot of process.
 extern volatile bool working;
-extern double landscape[TANK_OBSERVING_RANGE][TANK_OBSERVING_RANGE];
-extern ResGetTanksTankRecord tanks[MAX_CLIENTS];
-extern size_t tanks_count;
-
-extern bool not_hit_bound_flag;
-extern bool not_tank_collision_flag;
-extern bool not_near_shoot_flag;
-extern Vector not_near_shoot_position;
-extern bool not_hit_flag;
-extern bool not_near_explosion_flag;
-extern Vector not_near_explosion_position;
-extern bool not_explosion_damage_flag;
-extern Vector not_explosion_damage_position;
+
+// One tank driven by genetic program. Client has one, evaluator runs one per thread.
+typedef struct GeneticBot
+{
+    ClientProtocol protocol;
+    volatile bool playing; // Cleared when tank dies, wins or server says bye.
+    bool verbose;          // Traces ticks and instructions.
+
+    double landscape[TANK_OBSERVING_RANGE][TANK_OBSERVING_RANGE];
+    ResGetTanksTankRecord tanks[MAX_CLIENTS];
+    size_t tanks_count;
+
+    // Fetched once per tick, so getters never wait for network while program runs.
+    bool observation_valid;
+    ResGetObservation observation;
+    // Setters only fill it, it is sent after program stops. Last value of each command wins.
+    ReqControl pending_control;
+
+    bool not_hit_bound_flag;
+    bool not_tank_collision_flag;
+    bool not_near_shoot_flag;
+    Vector not_near_shoot_position;
+    bool not_hit_flag;
+    bool not_near_explosion_flag;
+    Vector not_near_explosion_position;
+    bool not_explosion_damage_flag;
+    Vector not_explosion_damage_position;
+} GeneticBot;
+
+// Bot of calling thread. Instructions and packet executors work with it.
+extern thread_local GeneticBot *current_bot;
 
 #endif /* __GENETIC_CLIENT_HPP__ */
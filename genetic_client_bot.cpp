@@ -0,0 +1,280 @@
+// genetic_client_bot.cpp - genetic bot: tank driven by Slash/A program.
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <vector>
+
+extern "C"
+{
+    #include "process.h"
+    #include "time.h"
+    #include "sys/time.h"
+    #include "unistd.h"
+}
+
+#include "SlashA.hpp"
+
+extern "C"
+{
+    #include "debug.h"
+    #include "client_protocol.h"
+    #include "tank_defines.h"
+}
+
+#include "genetic_client_net.hpp"
+#include "genetic_client_commands.hpp"
+#include "genetic_client_bot.hpp"
+
+// 1 sec.
+#define TICK_DURATION 1000000
+
+thread_local GeneticBot *current_bot = NULL;
+
+static void __trace(const GeneticBot *b, const char *message);
+static unsigned long __timeval_sub(struct timeval *t1, struct timeval *t2);
+
+void genetic_bot_build_instruction_set(SlashA::InstructionSet &instruction_set)
+{
+    instruction_set.insert_DIS_full();
+
+    SetEnginePower *set_engine_power_instruction = new SetEnginePower();
+    Turn *turn_instruction = new Turn();
+    LookAt *look_at_instruction = new LookAt();
+    Shoot *shoot_instruction = new Shoot();
+    GetFireDelay *get_fire_delay_instruction = new GetFireDelay();
+    GetHeading *get_heading_instruction = new GetHeading();
+    GetSpeed *get_speed_instruction = new GetSpeed();
+    GetHP *get_hp_instruction = new GetHP();
+    GetHeight *get_height_instruction = new GetHeight();
+    GetNormal *get_normal_instruction = new GetNormal();
+    Tanks *get_tanks_instruction = new Tanks();
+    Tank *get_tank_instruction = new Tank();
+    HitBound *hit_bound_instruction = new HitBound();
+    TankCollision *tank_collision_instruction = new TankCollision();
+    Hit *hit_instruction = new Hit();
+    NearShoot *near_shoot_instruction = new NearShoot();
+    NearExplosion *near_explosion_instruction = new NearExplosion();
+    NearExplosionDamage *explosion_damage_instruction = new NearExplosionDamage();
+
+    check(set_engine_power_instruction &&
+          turn_instruction &&
+          look_at_instruction &&
+          shoot_instruction &&
+          get_fire_delay_instruction &&
+          get_heading_instruction &&
+          get_speed_instruction &&
+          get_hp_instruction &&
+          get_height_instruction &&
+          get_normal_instruction &&
+          get_tanks_instruction &&
+          get_tank_instruction &&
+          hit_bound_instruction &&
+          tank_collision_instruction &&
+          hit_instruction &&
+          near_shoot_instruction &&
+          near_explosion_instruction &&
+          explosion_damage_instruction,
+          "Failed to create instructions.",
+          "");
+
+    instruction_set.insert(set_engine_power_instruction);
+    instruction_set.insert(turn_instruction);
+    instruction_set.insert(look_at_instruction);
+    instruction_set.insert(shoot_instruction);
+    instruction_set.insert(get_fire_delay_instruction);
+    instruction_set.insert(get_heading_instruction);
+    instruction_set.insert(get_speed_instruction);
+    instruction_set.insert(get_hp_instruction);
+    instruction_set.insert(get_height_instruction);
+    instruction_set.insert(get_normal_instruction);
+    instruction_set.insert(get_tanks_instruction);
+    instruction_set.insert(get_tank_instruction);
+    instruction_set.insert(hit_bound_instruction);
+    instruction_set.insert(tank_collision_instruction);
+    instruction_set.insert(hit_instruction);
+    instruction_set.insert(near_shoot_instruction);
+    instruction_set.insert(near_explosion_instruction);
+    instruction_set.insert(explosion_damage_instruction);
+
+    error:
+    return;
+}
+
+GeneticBot *genetic_bot_create(bool verbose)
+{
+    GeneticBot *b = new GeneticBot();
+    b->protocol = genetic_client_protocol;
+    b->verbose = verbose;
+    return b;
+}
+
+void genetic_bot_destroy(GeneticBot *b)
+{
+    assert(b && "Bad bot pointer.");
+
+    if (current_bot == b)
+    {
+        current_bot = NULL;
+    }
+
+    delete b;
+}
+
+bool genetic_bot_play(GeneticBot *b,
+                      SlashA::InstructionSet &instruction_set,
+                      SlashA::ByteCode &bytecode,
+                      bool lockstep,
+                      unsigned long long max_turns)
+{
+    assert(b && "Bad bot pointer.");
+
+    current_bot = b;
+    b->playing = true;
+
+    std::vector<double> input, output;
+    SlashA::MemCore mem_core(0xffff, 0xffff, input, output);
+    unsigned long long turns = 0;
+
+    try
+    {
+        struct timeval tick_start_time, tick_end_time;
+        do
+        {
+            __trace(b, "Tick start.");
+            gettimeofday(&tick_start_time, NULL);
+
+            while (client_protocol_process_event(&b->protocol));
+            tank_get_map(&b->protocol, (double *) b->landscape);
+            b->tanks_count = tank_get_tanks(&b->protocol, b->tanks, MAX_CLIENTS);
+            b->observation_valid = tank_get_observation(&b->protocol, &b->observation);
+            if (!b->observation_valid)
+            {
+                memset(&b->observation, 0, sizeof(b->observation));
+            }
+
+            memset(&b->pending_control, 0, sizeof(b->pending_control));
+
+            b->not_hit_bound_flag =
+            b->not_tank_collision_flag =
+            b->not_near_shoot_flag =
+            b->not_hit_flag =
+            b->not_near_explosion_flag =
+            b->not_explosion_damage_flag = false;
+
+            // Run genetic program.
+            bool failed = false;
+            try
+            {
+                __trace(b, "Run program.");
+                failed = !SlashA::runByteCode(instruction_set,
+                                              mem_core,
+                                              bytecode,
+                                              time(NULL) ^ _getpid() ^ (unsigned) (uintptr_t) b,
+                                              128,
+                                              256);
+                __trace(b, "Program stop.");
+            }
+            catch (std::string &e)
+            {
+                if (e != "Exception: Execution terminated.")
+                {
+                    failed = true;
+                    throw;
+                }
+
+                failed = false;
+            }
+
+            if (failed)
+            {
+                log_warning("Program failed.", "");
+            }
+
+            if (b->pending_control.flags && !send_control(&b->protocol, &b->pending_control))
+            {
+                log_warning("Failed to send control.", "");
+            }
+
+            if (lockstep)
+            {
+                // Game is usually over while we wait for tick, then notification stops us.
+                try
+                {
+                    if (!end_turn(&b->protocol))
+                    {
+                        throw std::string("Failed to end turn.");
+                    }
+                }
+                catch (std::string &e)
+                {
+                    if (e != "Execution terminated.")
+                    {
+                        throw;
+                    }
+                }
+
+                continue;
+            }
+
+            gettimeofday(&tick_end_time, NULL);
+
+            unsigned long tick_length = __timeval_sub(&tick_end_time, &tick_start_time); // Microseconds.
+            if (TICK_DURATION >= tick_length)
+            {
+                unsigned long long time_to_sleep = TICK_DURATION - tick_length;
+                usleep(time_to_sleep);
+            }
+        } while (working && b->playing && (!max_turns || ++turns < max_turns));
+    }
+    catch (std::string &e)
+    {
+        // Tank may die or win while bot waits for telemetry.
+        if (e != "Execution terminated.")
+        {
+            fprintf(stderr, "Exception: %s\n", e.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool genetic_bot_write_statistics(const std::string &filename, const ResGetStatistics &statistics)
+{
+    FILE *statistics_file = fopen(filename.c_str(), "w");
+    check(statistics_file, "Failed to open statistics file.", "");
+
+    fprintf(statistics_file, "%lu\n", (unsigned long) statistics.ticks);
+    fprintf(statistics_file, "%u\n", statistics.hp);
+    fprintf(statistics_file, "%u\n", statistics.direct_hits);
+    fprintf(statistics_file, "%u\n", statistics.hits);
+    fprintf(statistics_file, "%u\n", statistics.got_direct_hits);
+    fprintf(statistics_file, "%u\n", statistics.got_hits);
+    fclose(statistics_file);
+    return true;
+
+    error:
+    return false;
+}
+
+static void __trace(const GeneticBot *b, const char *message)
+{
+    assert(b && "Bad bot pointer.");
+    assert(message && "Bad message pointer.");
+
+    if (b->verbose)
+    {
+        puts(message);
+    }
+}
+
+static unsigned long __timeval_sub(struct timeval *t1, struct timeval *t2)
+{
+    assert(t1 && t2 && "Bad time pointers.");
+    unsigned long _t1 = t1->tv_sec * 1000000 + t1->tv_usec,
+                  _t2 = t2->tv_sec * 1000000 + t2->tv_usec;
+    return _t1 - _t2;
+}
@@ -0,0 +1,33 @@
+// genetic_client_bot.hpp - genetic bot: tank driven by Slash/A program.
+
+#pragma once
+#ifndef __GENETIC_CLIENT_BOT_HPP__
+#define __GENETIC_CLIENT_BOT_HPP__
+
+//#pragma message("__GENETIC_CLIENT_BOT_HPP__")
+
+#include <string>
+
+#include "SlashA.hpp"
+
+#include "genetic_client.hpp"
+
+// DIS and tank instructions, in order bytecode refers to them.
+void genetic_bot_build_instruction_set(SlashA::InstructionSet &instruction_set);
+
+// Bot is too big for stack. Its protocol is ready to connect.
+GeneticBot *genetic_bot_create(bool verbose);
+void genetic_bot_destroy(GeneticBot *b);
+
+// Connected bot plays until its tank dies or wins, max_turns pass (0 - no limit) or working is cleared.
+// Bot becomes current one of calling thread. False if program has failed.
+bool genetic_bot_play(GeneticBot *b,
+                      SlashA::InstructionSet &instruction_set,
+                      SlashA::ByteCode &bytecode,
+                      bool lockstep,
+                      unsigned long long max_turns);
+
+// One field per line, as gp.py reads it.
+bool genetic_bot_write_statistics(const std::string &filename, const ResGetStatistics &statistics);
+
+#endif /* __GENETIC_CLIENT_BOT_HPP__ */
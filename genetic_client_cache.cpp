@@ -0,0 +1,343 @@
+// genetic_client_cache.cpp - on-disk cache of compiled Slash/A programs.
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+#include <fstream>
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+extern "C"
+{
+    #include "process.h"
+}
+
+#include "genetic_client_cache.hpp"
+
+#define BYTECODE_IMAGE_MAGIC 0x42414c53 // "SLAB".
+
+#pragma pack(push, 8)
+
+// Followed by word_count bytecode words.
+typedef struct BytecodeImageHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t word_size;
+    uint32_t word_count;
+} BytecodeImageHeader;
+
+#pragma pack(pop)
+
+typedef SlashA::ByteCode::value_type BytecodeWord;
+
+// Population compilation shared by workers, each of them takes next program until none left.
+typedef struct CompileJob
+{
+    std::vector<std::string> programs;
+    std::string cache_path;
+    InstructionSetBuilder build_instruction_set;
+    volatile LONG next;
+    volatile LONG failed;
+} CompileJob;
+
+static uint64_t __fnv1a(uint64_t hash, const void *data, size_t size);
+static bool __read_source(const std::string &program_filename, std::string &source);
+static unsigned __stdcall __compile_worker(void *job);
+
+uint64_t bytecode_cache_key(const std::string &source)
+{
+    // Slash/A header carries its version, DIS may change with it.
+    std::string header = SlashA::getHeader();
+    uint32_t version = BYTECODE_CACHE_VERSION;
+
+    uint64_t hash = __fnv1a(0xcbf29ce484222325ULL, header.data(), header.size());
+    hash = __fnv1a(hash, &version, sizeof(version));
+    return __fnv1a(hash, source.data(), source.size());
+}
+
+std::string bytecode_cache_path(const std::string &program_filename)
+{
+    size_t separator = program_filename.find_last_of("/\\");
+    std::string population_path = std::string::npos == separator ? "." : program_filename.substr(0, separator);
+    return population_path + "/../" + BYTECODE_CACHE_DIRECTORY;
+}
+
+std::string bytecode_cache_image(const std::string &cache_path, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) key);
+    return cache_path + "/" + name + BYTECODE_CACHE_EXTENSION;
+}
+
+bool bytecode_cache_load(const std::string &image_filename, uint64_t key, SlashA::ByteCode &bytecode)
+{
+    HANDLE file = CreateFileA(image_filename.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+    if (INVALID_HANDLE_VALUE == file)
+    {
+        return false;
+    }
+
+    bool loaded = false;
+    HANDLE mapping = NULL;
+    const void *view = NULL;
+    LARGE_INTEGER size;
+
+    if (GetFileSizeEx(file, &size) &&
+        (LONGLONG) sizeof(BytecodeImageHeader) <= size.QuadPart &&
+        NULL != (mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL)) &&
+        NULL != (view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)))
+    {
+        const BytecodeImageHeader *header = (const BytecodeImageHeader *) view;
+
+        if (BYTECODE_IMAGE_MAGIC == header->magic &&
+            BYTECODE_CACHE_VERSION == header->version &&
+            key == header->key &&
+            sizeof(BytecodeWord) == header->word_size &&
+            (LONGLONG) (sizeof(BytecodeImageHeader) + header->word_count * sizeof(BytecodeWord)) == size.QuadPart)
+        {
+            const BytecodeWord *words = (const BytecodeWord *) (header + 1);
+            bytecode.assign(words, words + header->word_count);
+            loaded = true;
+        }
+    }
+
+    if (view)
+    {
+        UnmapViewOfFile(view);
+    }
+
+    if (mapping)
+    {
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+    return loaded;
+}
+
+bool bytecode_cache_store(const std::string &image_filename, uint64_t key, const SlashA::ByteCode &bytecode)
+{
+    BytecodeImageHeader header = {
+        .magic      = BYTECODE_IMAGE_MAGIC,
+        .version    = BYTECODE_CACHE_VERSION,
+        .key        = key,
+        .word_size  = sizeof(BytecodeWord),
+        .word_count = (uint32_t) bytecode.size()
+    };
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.%lu.tmp", _getpid(), (unsigned long) GetCurrentThreadId());
+    std::string temporary_filename = image_filename + suffix;
+
+    std::ofstream f(temporary_filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!f)
+    {
+        return false;
+    }
+
+    f.write((const char *) &header, sizeof(header));
+    if (!bytecode.empty())
+    {
+        f.write((const char *) &bytecode[0], bytecode.size() * sizeof(BytecodeWord));
+    }
+
+    f.close();
+
+    if (!f || !MoveFileExA(temporary_filename.c_str(), image_filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        remove(temporary_filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool bytecode_cache_get(const std::string &program_filename,
+                        SlashA::InstructionSet &instruction_set,
+                        SlashA::ByteCode &bytecode)
+{
+    std::string source;
+    if (!__read_source(program_filename, source))
+    {
+        return false;
+    }
+
+    uint64_t key = bytecode_cache_key(source);
+    std::string image_filename = bytecode_cache_image(bytecode_cache_path(program_filename), key);
+
+    if (!bytecode_cache_load(image_filename, key, bytecode))
+    {
+        SlashA::source2ByteCode(source, bytecode, instruction_set);
+        bytecode_cache_store(image_filename, key, bytecode); // Fails harmlessly if there is no cache directory.
+    }
+
+    return true;
+}
+
+size_t bytecode_cache_compile_population(const std::string &population_path,
+                                         InstructionSetBuilder build_instruction_set,
+                                         unsigned threads_count)
+{
+    assert(build_instruction_set && "Bad instruction set builder pointer.");
+
+    CompileJob job;
+    job.cache_path = population_path + "/../" + BYTECODE_CACHE_DIRECTORY;
+    job.build_instruction_set = build_instruction_set;
+    job.next = 0;
+    job.failed = 0;
+
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((population_path + "/*.sla").c_str(), &found);
+    if (INVALID_HANDLE_VALUE != search)
+    {
+        do
+        {
+            job.programs.push_back(population_path + "/" + found.cFileName);
+        } while (FindNextFileA(search, &found));
+
+        FindClose(search);
+    }
+
+    if (job.programs.empty())
+    {
+        return 0;
+    }
+
+    if (!CreateDirectoryA(job.cache_path.c_str(), NULL) && ERROR_ALREADY_EXISTS != GetLastError())
+    {
+        fprintf(stderr, "Failed to create bytecode cache: %s.\n", job.cache_path.c_str());
+        return job.programs.size();
+    }
+
+    if (!threads_count)
+    {
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        threads_count = (unsigned) system_info.dwNumberOfProcessors;
+    }
+
+    if (threads_count > job.programs.size())
+    {
+        threads_count = (unsigned) job.programs.size();
+    }
+
+    if (threads_count > MAXIMUM_WAIT_OBJECTS)
+    {
+        threads_count = MAXIMUM_WAIT_OBJECTS;
+    }
+
+    // Whatever workers failed to start is done by this thread.
+    std::vector<HANDLE> threads;
+    for (unsigned i = 1; i < threads_count; i++)
+    {
+        HANDLE t = (HANDLE) _beginthreadex(NULL, 0, __compile_worker, &job, 0, NULL);
+        if (!t)
+        {
+            break;
+        }
+
+        threads.push_back(t);
+    }
+
+    __compile_worker(&job);
+
+    if (!threads.empty())
+    {
+        WaitForMultipleObjects((DWORD) threads.size(), &threads[0], TRUE, INFINITE);
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            CloseHandle(threads[i]);
+        }
+    }
+
+    return (size_t) job.failed;
+}
+
+static uint64_t __fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    assert((data || !size) && "Bad data pointer.");
+
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static bool __read_source(const std::string &program_filename, std::string &source)
+{
+    std::ifstream f(program_filename.c_str());
+    if (!f)
+    {
+        return false;
+    }
+
+    std::getline(f, source, std::char_traits<char>::to_char_type(std::char_traits<char>::eof()));
+    return true;
+}
+
+// Instructions keep no state between runs, still every worker has its own set.
+static unsigned __stdcall __compile_worker(void *p)
+{
+    assert(p && "Bad job pointer.");
+    CompileJob *job = (CompileJob *) p;
+
+    SlashA::InstructionSet instruction_set(0xffff);
+    job->build_instruction_set(instruction_set);
+
+    for (LONG i = InterlockedIncrement(&job->next) - 1;
+         (size_t) i < job->programs.size();
+         i = InterlockedIncrement(&job->next) - 1)
+    {
+        const std::string &program_filename = job->programs[i];
+        std::string source;
+
+        if (!__read_source(program_filename, source))
+        {
+            fprintf(stderr, "Failed to open file: %s.\n", program_filename.c_str());
+            InterlockedIncrement(&job->failed);
+            continue;
+        }
+
+        uint64_t key = bytecode_cache_key(source);
+        std::string image_filename = bytecode_cache_image(job->cache_path, key);
+
+        if (INVALID_FILE_ATTRIBUTES != GetFileAttributesA(image_filename.c_str()))
+        {
+            continue;
+        }
+
+        try
+        {
+            SlashA::ByteCode bytecode;
+            SlashA::source2ByteCode(source, bytecode, instruction_set);
+
+            if (!bytecode_cache_store(image_filename, key, bytecode))
+            {
+                fprintf(stderr, "Failed to write bytecode image: %s.\n", image_filename.c_str());
+                InterlockedIncrement(&job->failed);
+            }
+        }
+        catch (std::string &e)
+        {
+            fprintf(stderr, "Failed to compile %s: %s\n", program_filename.c_str(), e.c_str());
+            InterlockedIncrement(&job->failed);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+// genetic_client_cache.hpp - on-disk cache of compiled Slash/A programs.
+
+#pragma once
+#ifndef __GENETIC_CLIENT_CACHE_HPP__
+#define __GENETIC_CLIENT_CACHE_HPP__
+
+//#pragma message("__GENETIC_CLIENT_CACHE_HPP__")
+
+#include <cstdint>
+#include <string>
+
+#include "SlashA.hpp"
+
+// Bytecode refers to instructions by index, so bump it when instructions are added, removed or reordered.
+#define BYTECODE_CACHE_VERSION 1
+// Shared by populations: <populations>/<n>/<program>.sla is cached in <populations>/bytecode.
+#define BYTECODE_CACHE_DIRECTORY "bytecode"
+#define BYTECODE_CACHE_EXTENSION ".slb"
+
+// Fills instruction set exactly as client runs it.
+typedef void (*InstructionSetBuilder)(SlashA::InstructionSet &instruction_set);
+
+// Images are named by source hash, so same program in any population is compiled once.
+uint64_t bytecode_cache_key(const std::string &source);
+std::string bytecode_cache_path(const std::string &program_filename);
+std::string bytecode_cache_image(const std::string &cache_path, uint64_t key);
+
+// Image is mapped and copied into bytecode. False on miss or on stale or damaged image.
+bool bytecode_cache_load(const std::string &image_filename, uint64_t key, SlashA::ByteCode &bytecode);
+// Written to temporary file and renamed, so concurrent writers and readers never see partial image.
+bool bytecode_cache_store(const std::string &image_filename, uint64_t key, const SlashA::ByteCode &bytecode);
+
+// Reads program and loads its image, compiling and caching program on miss.
+// False if program can't be read, compilation errors are thrown by Slash/A.
+bool bytecode_cache_get(const std::string &program_filename,
+                        SlashA::InstructionSet &instruction_set,
+                        SlashA::ByteCode &bytecode);
+
+// Compiles every *.sla of population directory into cache, threads_count 0 - one per processor.
+// Returns count of programs failed to compile.
+size_t bytecode_cache_compile_population(const std::string &population_path,
+                                         InstructionSetBuilder build_instruction_set,
+                                         unsigned threads_count);
+
+#endif /* __GENETIC_CLIENT_CACHE_HPP__ */
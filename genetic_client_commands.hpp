@@ -24,7 +24,10 @@ class ExtensionInstruction : public SlashA::Instruction
 
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
-        std::cout << "Running: " << name << std::endl;
+        if (current_bot->verbose)
+        {
+            std::cout << "Running: " << name << std::endl;
+        }
     }
 };
 
@@ -48,7 +51,8 @@ class SetEnginePower : public ExtensionInstruction
             power = TANK_MAX_ENGINE_POWER;
         }
 
-        set_engine_power(&genetic_client_protocol, (int) power);
+        current_bot->pending_control.flags |= CONTROL_ENGINE_POWER;
+        current_bot->pending_control.engine_power = (int8_t) power;
     }
 };
 
@@ -66,7 +70,8 @@ class Turn : public ExtensionInstruction
         while (angle >= +M_PI) angle -= M_PI;
         while (angle <= -M_PI) angle += M_PI;
 
-        turn(&genetic_client_protocol, angle);
+        current_bot->pending_control.flags |= CONTROL_TURN;
+        current_bot->pending_control.turn_angle = angle;
     }
 };
 
@@ -87,7 +92,10 @@ class LookAt : public ExtensionInstruction
 
         Vector l = { .x = core.D[core.I + 0], .y = core.D[core.I + 1], .z = core.D[core.I + 2] };
         VECTOR_NORMALIZE(&l);
-        look_at(&genetic_client_protocol, &l);
+        current_bot->pending_control.flags |= CONTROL_LOOK_AT;
+        current_bot->pending_control.look_x = l.x;
+        current_bot->pending_control.look_y = l.y;
+        current_bot->pending_control.look_z = l.z;
     }
 };
 
@@ -99,7 +107,7 @@ class Shoot : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        shoot(&genetic_client_protocol);
+        current_bot->pending_control.flags |= CONTROL_SHOOT;
     }
 };
 
@@ -111,8 +119,7 @@ class GetFireDelay : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        int delay = tank_get_fire_delay(&genetic_client_protocol);
-        core.setF(delay);
+        core.setF(current_bot->observation.fire_delay);
     }
 };
 
@@ -124,8 +131,7 @@ class GetHeading : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        double heading = client_tank_get_heading(&genetic_client_protocol);
-        core.setF(heading);
+        core.setF(current_bot->observation.heading);
     }
 };
 
@@ -137,8 +143,7 @@ class GetSpeed : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        double speed = tank_get_speed(&genetic_client_protocol);
-        core.setF(speed);
+        core.setF(current_bot->observation.speed);
     }
 };
 
@@ -150,8 +155,7 @@ class GetHP : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        int hp = tank_get_hp(&genetic_client_protocol);
-        core.setF(hp);
+        core.setF(current_bot->observation.hp);
     }
 };
 
@@ -174,7 +178,7 @@ class GetHeight : public ExtensionInstruction
             if (-TANK_OBSERVING_RANGE / 2.0 <= x && x <= TANK_OBSERVING_RANGE / 2.0 &&
                 -TANK_OBSERVING_RANGE / 2.0 <= y && y <= TANK_OBSERVING_RANGE / 2.0)
             {
-                height = landscape[((int) x) + TANK_OBSERVING_RANGE / 2][((int) y) + TANK_OBSERVING_RANGE / 2];
+                height = current_bot->landscape[((int) x) + TANK_OBSERVING_RANGE / 2][((int) y) + TANK_OBSERVING_RANGE / 2];
             }
         }
 
@@ -191,20 +195,14 @@ class GetNormal : public ExtensionInstruction
     {
         ExtensionInstruction::code(core, iset);
 
-        Vector normal;
-        if (!tank_get_normal(&genetic_client_protocol, &normal))
-        {
-            return;
-        }
-
-        if (core.D_size <= core.I + 2)
+        if (!current_bot->observation_valid || core.D_size <= core.I + 2)
         {
             return;
         }
 
-        core.D[core.I + 0] = normal.x;
-        core.D[core.I + 1] = normal.y;
-        core.D[core.I + 2] = normal.z;
+        core.D[core.I + 0] = current_bot->observation.normal_x;
+        core.D[core.I + 1] = current_bot->observation.normal_y;
+        core.D[core.I + 2] = current_bot->observation.normal_z;
     }
 };
 
@@ -216,7 +214,7 @@ class Tanks : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        core.setF(tanks_count);
+        core.setF(current_bot->tanks_count);
     }
 };
 
@@ -229,7 +227,7 @@ class Tank : public ExtensionInstruction
     {
         ExtensionInstruction::code(core, iset);
 
-        if (0 == tanks_count)
+        if (0 == current_bot->tanks_count)
         {
             return;
         }
@@ -240,26 +238,26 @@ class Tank : public ExtensionInstruction
             return;
         }
 
-        unsigned tank_index = core.I % tanks_count;
-        core.D[destination +  0] = tanks[tank_index].x;
-        core.D[destination +  1] = tanks[tank_index].y;
-        core.D[destination +  2] = tanks[tank_index].z;
+        unsigned tank_index = core.I % current_bot->tanks_count;
+        core.D[destination +  0] = current_bot->tanks[tank_index].x;
+        core.D[destination +  1] = current_bot->tanks[tank_index].y;
+        core.D[destination +  2] = current_bot->tanks[tank_index].z;
 
-        core.D[destination +  3] = tanks[tank_index].direction_x;
-        core.D[destination +  4] = tanks[tank_index].direction_y;
-        core.D[destination +  5] = tanks[tank_index].direction_z;
+        core.D[destination +  3] = current_bot->tanks[tank_index].direction_x;
+        core.D[destination +  4] = current_bot->tanks[tank_index].direction_y;
+        core.D[destination +  5] = current_bot->tanks[tank_index].direction_z;
 
-        core.D[destination +  6] = tanks[tank_index].orientation_x;
-        core.D[destination +  7] = tanks[tank_index].orientation_y;
-        core.D[destination +  8] = tanks[tank_index].orientation_z;
+        core.D[destination +  6] = current_bot->tanks[tank_index].orientation_x;
+        core.D[destination +  7] = current_bot->tanks[tank_index].orientation_y;
+        core.D[destination +  8] = current_bot->tanks[tank_index].orientation_z;
 
-        core.D[destination +  9] = tanks[tank_index].turret_x;
-        core.D[destination + 10] = tanks[tank_index].turret_y;
-        core.D[destination + 11] = tanks[tank_index].turret_z;
+        core.D[destination +  9] = current_bot->tanks[tank_index].turret_x;
+        core.D[destination + 10] = current_bot->tanks[tank_index].turret_y;
+        core.D[destination + 11] = current_bot->tanks[tank_index].turret_z;
 
-        core.D[destination + 12] = tanks[tank_index].speed;
-        core.D[destination + 13] = tanks[tank_index].team;
-        core.D[destination + 14] = tanks[tank_index].hp;
+        core.D[destination + 12] = current_bot->tanks[tank_index].speed;
+        core.D[destination + 13] = current_bot->tanks[tank_index].team;
+        core.D[destination + 14] = current_bot->tanks[tank_index].hp;
     }
 };
 
@@ -271,7 +269,7 @@ class HitBound : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        core.setF(not_hit_bound_flag ? 1.0 : 0.0);
+        core.setF(current_bot->not_hit_bound_flag ? 1.0 : 0.0);
     }
 };
 
@@ -283,7 +281,7 @@ class TankCollision : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        core.setF(not_tank_collision_flag ? 1.0 : 0.0);
+        core.setF(current_bot->not_tank_collision_flag ? 1.0 : 0.0);
     }
 };
 
@@ -295,7 +293,7 @@ class Hit : public ExtensionInstruction
     inline void code(SlashA::MemCore& core, SlashA::InstructionSet& iset)
     {
         ExtensionInstruction::code(core, iset);
-        core.setF(not_hit_flag ? 1.0 : 0.0);
+        core.setF(current_bot->not_hit_flag ? 1.0 : 0.0);
     }
 };
 
@@ -308,14 +306,14 @@ class NearShoot : public ExtensionInstruction
     {
         ExtensionInstruction::code(core, iset);
 
-        if (not_near_shoot_flag)
+        if (current_bot->not_near_shoot_flag)
         {
             core.setF(1.0);
             if (core.D_size > core.I + 2)
             {
-                core.D[core.I + 0] = not_near_shoot_position.x;
-                core.D[core.I + 1] = not_near_shoot_position.y;
-                core.D[core.I + 2] = not_near_shoot_position.z;
+                core.D[core.I + 0] = current_bot->not_near_shoot_position.x;
+                core.D[core.I + 1] = current_bot->not_near_shoot_position.y;
+                core.D[core.I + 2] = current_bot->not_near_shoot_position.z;
             }
         }
         else
@@ -334,14 +332,14 @@ class NearExplosion : public ExtensionInstruction
     {
         ExtensionInstruction::code(core, iset);
 
-        if (not_near_explosion_flag)
+        if (current_bot->not_near_explosion_flag)
         {
             core.setF(1.0);
             if (core.D_size > core.I + 2)
             {
-                core.D[core.I + 0] = not_near_explosion_position.x;
-                core.D[core.I + 1] = not_near_explosion_position.y;
-                core.D[core.I + 2] = not_near_explosion_position.z;
+                core.D[core.I + 0] = current_bot->not_near_explosion_position.x;
+                core.D[core.I + 1] = current_bot->not_near_explosion_position.y;
+                core.D[core.I + 2] = current_bot->not_near_explosion_position.z;
             }
         }
         else
@@ -360,14 +358,14 @@ class NearExplosionDamage : public ExtensionInstruction
     {
         ExtensionInstruction::code(core, iset);
 
-        if (not_explosion_damage_flag)
+        if (current_bot->not_explosion_damage_flag)
         {
             core.setF(1.0);
             if (core.D_size > core.I + 2)
             {
-                core.D[core.I + 0] = not_explosion_damage_position.x;
-                core.D[core.I + 1] = not_explosion_damage_position.y;
-                core.D[core.I + 2] = not_explosion_damage_position.z;
+                core.D[core.I + 0] = current_bot->not_explosion_damage_position.x;
+                core.D[core.I + 1] = current_bot->not_explosion_damage_position.y;
+                core.D[core.I + 2] = current_bot->not_explosion_damage_position.z;
             }
         }
         else
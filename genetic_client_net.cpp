@@ -25,11 +25,14 @@ PacketDefinition genetic_client_protocol_packets[] = {
     { .id = req_turn,             .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_look_at,          .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_shoot,            .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
+    { .id = req_end_turn,         .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
+    { .id = req_control,          .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_heading,      .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_speed,        .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_hp,           .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_statistics,   .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_fire_delay,   .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
+    { .id = req_get_observation,  .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_map,          .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_normal,       .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
     { .id = req_get_tanks,        .validator = NULL, .executor = NULL,                        .is_client_protocol = true },
@@ -58,56 +61,56 @@ ClientProtocol genetic_client_protocol = {
 static bool __notification_executor(void *unused)
 {
     __generic_executor(unused);
-    working = false;
+    current_bot->playing = false;
     throw std::string("Execution terminated.");
     return false;
 }
 
 static bool __hit_bound_executor(void *unused)
 {
-    not_hit_bound_flag = true;
+    current_bot->not_hit_bound_flag = true;
     return true;
 }
 
 static bool __tank_collision_executor(void *unused)
 {
-    not_tank_collision_flag = true;
+    current_bot->not_tank_collision_flag = true;
     return true;
 }
 
 static bool __near_shoot_executor(void *packet_body)
 {
-    not_near_shoot_flag = true;
+    current_bot->not_near_shoot_flag = true;
     NotViewerShellEvent *packet = (NotViewerShellEvent *) packet_body;
-    not_near_shoot_position.x = packet->x;
-    not_near_shoot_position.y = packet->y;
-    not_near_shoot_position.z = packet->z;
+    current_bot->not_near_shoot_position.x = packet->x;
+    current_bot->not_near_shoot_position.y = packet->y;
+    current_bot->not_near_shoot_position.z = packet->z;
     return true;
 }
 
 static bool __near_explosion_executor(void *packet_body)
 {
-    not_near_explosion_flag = true;
+    current_bot->not_near_explosion_flag = true;
     NotViewerShellEvent *packet = (NotViewerShellEvent *) packet_body;
-    not_near_explosion_position.x = packet->x;
-    not_near_explosion_position.y = packet->y;
-    not_near_explosion_position.z = packet->z;
+    current_bot->not_near_explosion_position.x = packet->x;
+    current_bot->not_near_explosion_position.y = packet->y;
+    current_bot->not_near_explosion_position.z = packet->z;
     return true;
 }
 
 static bool __hit_executor(void *unused)
 {
-    not_hit_flag = true;
+    current_bot->not_hit_flag = true;
     return true;
 }
 
 static bool __explosion_damage_executor(void *packet_body)
 {
-    not_explosion_damage_flag = true;
+    current_bot->not_explosion_damage_flag = true;
     NotViewerShellEvent *packet = (NotViewerShellEvent *) packet_body;
-    not_explosion_damage_position.x = packet->x;
-    not_explosion_damage_position.y = packet->y;
-    not_explosion_damage_position.z = packet->z;
+    current_bot->not_explosion_damage_position.x = packet->x;
+    current_bot->not_explosion_damage_position.y = packet->y;
+    current_bot->not_explosion_damage_position.z = packet->z;
     return true;
 }
 
@@ -11,6 +11,7 @@ extern "C"
     #include "client_protocol.h"
 }
 
+// Not connected, every bot starts with its copy.
 extern ClientProtocol genetic_client_protocol;
 
 #endif /* __GENETIC_CLIENT_NET_HPP__ */
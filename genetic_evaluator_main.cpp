@@ -0,0 +1,437 @@
+// genetic_evaluator_main.cpp - main() for genetic population evaluator: plays whole population in parallel matches.
+
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+extern "C"
+{
+    #include "process.h"
+}
+
+#include "SlashA.hpp"
+
+extern "C"
+{
+    #include "debug.h"
+    #include "client_protocol.h"
+}
+
+#include "genetic_client_net.hpp"
+#include "genetic_client_cache.hpp"
+#include "genetic_client_bot.hpp"
+
+#define EVALUATOR_DEFAULT_ARENAS 1
+#define EVALUATOR_DEFAULT_ROUNDS 1
+#define EVALUATOR_JOIN_TIMEOUT 10000 // In ms, match starts without bots which haven't joined.
+#define EVALUATOR_JOIN_POLL 10       // In ms.
+#define EVALUATOR_STATISTICS_ATTEMPTS 2
+
+#pragma pack(push, 8)
+
+// Statistics are summed over program's matches, log gets their average.
+typedef struct EvaluatedProgram
+{
+    std::string filename;
+    SlashA::ByteCode bytecode;
+    bool compiled;
+    ResGetStatistics total;
+    unsigned matches;
+} EvaluatedProgram;
+
+typedef struct BotResult
+{
+    bool played;
+    ResGetStatistics statistics;
+} BotResult;
+
+typedef struct Match
+{
+    uint8_t arena;                 // Chosen by worker which plays match.
+    std::vector<size_t> programs;  // Indices of population.
+    std::vector<BotResult> results;
+    volatile LONG arrived;         // Bots which have joined arena or failed to.
+} Match;
+
+typedef struct BotJob
+{
+    Match *match;
+    size_t slot;
+} BotJob;
+
+#pragma pack(pop)
+
+volatile bool working = true;
+
+static std::vector<EvaluatedProgram> population;
+static std::vector<Match> matches;
+static volatile LONG next_match = 0;
+
+static const char *server_address = NULL;
+static unsigned short port = PORT;
+static unsigned long long max_turns = 0;
+
+static void __stop(int unused);
+static bool __load_population(const std::string &population_path);
+static void __pair(size_t match_size, unsigned rounds, unsigned long seed);
+static unsigned __stdcall __arena_worker(void *arena);
+static unsigned __stdcall __bot_worker(void *job);
+static void __write_results(void);
+
+// Usage: morrigan_genetic_evaluator <population-directory> <server-address> [<port> [<arenas> [<match size> [<rounds> [<max turns> [<seed>]]]]]]
+// Every round population is shuffled and split into matches of match size, so every program plays rounds matches.
+// Matches are played on arenas 0 .. arenas - 1 in parallel. Server has to run that many arenas in lockstep mode.
+int main(int argc, char *argv[])
+{
+    if (3 > argc)
+    {
+        fprintf(stderr,
+                "Usage: %s <population-directory> <server-address> [<port> [<arenas> [<match size> [<rounds> [<max turns> [<seed>]]]]]]\n",
+                argv[0]);
+        return -1;
+    }
+
+    server_address = argv[2];
+    if (3 < argc && atoi(argv[3]))
+    {
+        port = (unsigned short) atoi(argv[3]);
+    }
+
+    unsigned arenas = 4 < argc ? (unsigned) atoi(argv[4]) : EVALUATOR_DEFAULT_ARENAS;
+    size_t match_size = 5 < argc ? (size_t) atoi(argv[5]) : MAX_CLIENTS;
+    unsigned rounds = 6 < argc ? (unsigned) atoi(argv[6]) : EVALUATOR_DEFAULT_ROUNDS;
+    max_turns = 7 < argc ? strtoull(argv[7], NULL, 10) : 0;
+    unsigned long seed = 8 < argc ? strtoul(argv[8], NULL, 10) : (unsigned long) time(NULL);
+
+    if (!arenas || MAXIMUM_WAIT_OBJECTS < arenas || 2 > match_size || MAX_CLIENTS < match_size || !rounds)
+    {
+        fprintf(stderr, "Bad arenas, match size or rounds.\n");
+        return -1;
+    }
+
+    if (SIG_ERR == signal(SIGINT, __stop) ||
+        SIG_ERR == signal(SIGTERM, __stop))
+    {
+        fprintf(stderr, "Failed to set signal handler.");
+        return -1;
+    }
+
+    puts(SlashA::getHeader().c_str());
+
+    if (!__load_population(argv[1]))
+    {
+        return -1;
+    }
+
+    __pair(match_size, rounds, seed);
+    printf("Evaluating %u programs in %u matches on %u arenas.\n",
+           (unsigned) population.size(),
+           (unsigned) matches.size(),
+           arenas);
+
+    if (!client_net_start())
+    {
+        fprintf(stderr, "Failed to initialize net.");
+        return -1;
+    }
+
+    if (arenas > matches.size())
+    {
+        arenas = (unsigned) matches.size();
+    }
+
+    std::vector<HANDLE> workers;
+    for (unsigned i = 0; i < arenas; i++)
+    {
+        HANDLE t = (HANDLE) _beginthreadex(NULL, 0, __arena_worker, (void *) (uintptr_t) i, 0, NULL);
+        if (!t)
+        {
+            fprintf(stderr, "Failed to start arena %u worker.\n", i);
+            continue;
+        }
+
+        workers.push_back(t);
+    }
+
+    if (!workers.empty())
+    {
+        WaitForMultipleObjects((DWORD) workers.size(), &workers[0], TRUE, INFINITE);
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            CloseHandle(workers[i]);
+        }
+    }
+
+    client_net_stop();
+    __write_results();
+    return 0;
+}
+
+static void __stop(int unused)
+{
+    puts("Termination requested.");
+    working = false;
+}
+
+// Population is compiled into bytecode cache on all processors first, then images are loaded.
+static bool __load_population(const std::string &population_path)
+{
+    bytecode_cache_compile_population(population_path, genetic_bot_build_instruction_set, 0);
+
+    SlashA::InstructionSet instruction_set(0xffff);
+    genetic_bot_build_instruction_set(instruction_set);
+
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((population_path + "/*.sla").c_str(), &found);
+    if (INVALID_HANDLE_VALUE == search)
+    {
+        fprintf(stderr, "No programs found in %s.\n", population_path.c_str());
+        return false;
+    }
+
+    do
+    {
+        EvaluatedProgram p;
+        p.filename = population_path + "/" + found.cFileName;
+        p.compiled = false;
+        p.matches = 0;
+        memset(&p.total, 0, sizeof(p.total));
+
+        try
+        {
+            p.compiled = bytecode_cache_get(p.filename, instruction_set, p.bytecode);
+        }
+        catch (std::string &e)
+        {
+            fprintf(stderr, "Failed to compile %s: %s\n", p.filename.c_str(), e.c_str());
+        }
+
+        population.push_back(p);
+    } while (FindNextFileA(search, &found));
+
+    FindClose(search);
+    return true;
+}
+
+// Programs which failed to compile don't play. Lone leftover joins previous match, if there is place.
+static void __pair(size_t match_size, unsigned rounds, unsigned long seed)
+{
+    std::vector<size_t> players;
+    for (size_t i = 0; i < population.size(); i++)
+    {
+        if (population[i].compiled)
+        {
+            players.push_back(i);
+        }
+    }
+
+    std::mt19937 random(seed);
+
+    for (unsigned round = 0; round < rounds; round++)
+    {
+        std::shuffle(players.begin(), players.end(), random);
+        size_t round_start = matches.size();
+
+        for (size_t i = 0; i < players.size(); i += match_size)
+        {
+            size_t count = std::min(match_size, players.size() - i);
+
+            if (1 == count && round_start < matches.size() && MAX_CLIENTS > matches.back().programs.size())
+            {
+                matches.back().programs.push_back(players[i]);
+                continue;
+            }
+
+            Match m;
+            m.arena = 0;
+            m.arrived = 0;
+            m.programs.assign(players.begin() + i, players.begin() + i + count);
+            matches.push_back(m);
+        }
+    }
+
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        matches[i].results.assign(matches[i].programs.size(), BotResult());
+    }
+}
+
+// Arena plays matches one after another, taking next unplayed one.
+static unsigned __stdcall __arena_worker(void *arena)
+{
+    for (LONG i = InterlockedIncrement(&next_match) - 1;
+         working && (size_t) i < matches.size();
+         i = InterlockedIncrement(&next_match) - 1)
+    {
+        Match *m = &matches[i];
+        m->arena = (uint8_t) (uintptr_t) arena;
+
+        std::vector<BotJob> jobs(m->programs.size());
+        std::vector<HANDLE> bots;
+
+        for (size_t slot = 0; slot < m->programs.size(); slot++)
+        {
+            jobs[slot].match = m;
+            jobs[slot].slot = slot;
+
+            HANDLE t = (HANDLE) _beginthreadex(NULL, 0, __bot_worker, &jobs[slot], 0, NULL);
+            if (!t)
+            {
+                fprintf(stderr, "Failed to start bot.\n");
+                InterlockedIncrement(&m->arrived);
+                continue;
+            }
+
+            bots.push_back(t);
+        }
+
+        if (!bots.empty())
+        {
+            WaitForMultipleObjects((DWORD) bots.size(), &bots[0], TRUE, INFINITE);
+            for (size_t j = 0; j < bots.size(); j++)
+            {
+                CloseHandle(bots[j]);
+            }
+        }
+
+        printf("Match %u of %u has finished on arena %u.\n",
+               (unsigned) (i + 1),
+               (unsigned) matches.size(),
+               (unsigned) m->arena);
+    }
+
+    return 0;
+}
+
+// Each bot has own instruction set and bytecode copy, only the program itself is shared.
+static unsigned __stdcall __bot_worker(void *job)
+{
+    assert(job && "Bad job pointer.");
+
+    Match *m = ((BotJob *) job)->match;
+    size_t slot = ((BotJob *) job)->slot;
+    BotResult *result = &m->results[slot];
+
+    GeneticBot *b = genetic_bot_create(false);
+    bool connected = client_connect(&b->protocol, server_address, port, true, m->arena);
+    InterlockedIncrement(&m->arrived);
+
+    if (!connected)
+    {
+        fprintf(stderr, "Failed to connect %s.\n", population[m->programs[slot]].filename.c_str());
+        genetic_bot_destroy(b);
+        return 0;
+    }
+
+    try
+    {
+        SlashA::InstructionSet instruction_set(0xffff);
+        genetic_bot_build_instruction_set(instruction_set);
+        SlashA::ByteCode bytecode = population[m->programs[slot]].bytecode;
+
+        // Lockstep arena ticks as soon as joined bots end turn, so nobody starts before whole match has joined.
+        for (unsigned waited = 0;
+             (size_t) m->arrived < m->programs.size() && EVALUATOR_JOIN_TIMEOUT > waited;
+             waited += EVALUATOR_JOIN_POLL)
+        {
+            Sleep(EVALUATOR_JOIN_POLL);
+        }
+
+        bool played = genetic_bot_play(b, instruction_set, bytecode, true, max_turns);
+
+        // When turns run out together with match, death or win notification interrupts request, then it's repeated.
+        for (unsigned attempt = 0; played && !result->played && EVALUATOR_STATISTICS_ATTEMPTS > attempt; attempt++)
+        {
+            try
+            {
+                result->played = tank_get_statistics(&b->protocol, &result->statistics);
+                break;
+            }
+            catch (std::string &e)
+            {
+                if (e != "Execution terminated.")
+                {
+                    throw;
+                }
+            }
+        }
+    }
+    catch (std::string &e)
+    {
+        fprintf(stderr, "Exception: %s\n", e.c_str());
+        result->played = false;
+    }
+
+    client_disconnect(&b->protocol, true);
+    genetic_bot_destroy(b);
+    return 0;
+}
+
+// Programs which haven't played any match get no log, as with failed client.
+static void __write_results(void)
+{
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        for (size_t slot = 0; slot < matches[i].programs.size(); slot++)
+        {
+            const BotResult *r = &matches[i].results[slot];
+            if (!r->played)
+            {
+                continue;
+            }
+
+            EvaluatedProgram *p = &population[matches[i].programs[slot]];
+            p->total.ticks += r->statistics.ticks;
+            p->total.hp += r->statistics.hp;
+            p->total.direct_hits += r->statistics.direct_hits;
+            p->total.hits += r->statistics.hits;
+            p->total.got_direct_hits += r->statistics.got_direct_hits;
+            p->total.got_hits += r->statistics.got_hits;
+            p->matches++;
+        }
+    }
+
+    for (size_t i = 0; i < population.size(); i++)
+    {
+        EvaluatedProgram *p = &population[i];
+        std::string statistics_filename = p->filename + ".log";
+
+        if (!p->matches)
+        {
+            remove(statistics_filename.c_str());
+            printf("%s: no matches played.\n", p->filename.c_str());
+            continue;
+        }
+
+        ResGetStatistics average = p->total;
+        average.ticks /= p->matches;
+        average.hp /= p->matches;
+        average.direct_hits /= p->matches;
+        average.hits /= p->matches;
+        average.got_direct_hits /= p->matches;
+        average.got_hits /= p->matches;
+
+        if (!genetic_bot_write_statistics(statistics_filename, average))
+        {
+            fprintf(stderr, "Failed to write %s.\n", statistics_filename.c_str());
+        }
+
+        printf("%s: %u matches, %llu ticks, %u hp, %u direct hits, %u hits.\n",
+               p->filename.c_str(),
+               p->matches,
+               (unsigned long long) average.ticks,
+               (unsigned) average.hp,
+               (unsigned) average.direct_hits,
+               (unsigned) average.hits);
+    }
+}
@@ -7,6 +7,8 @@ Genetic programming driver.
 Operations:
     init
     step
+    init-islands
+    islands <generations>
 """
 
 import sys
@@ -18,6 +20,8 @@ import glob
 import signal
 import time
 import shutil
+import multiprocessing
+import multiprocessing.connection
 
 class ProgramLog:
     def __init__(self, program_file):
@@ -34,12 +38,12 @@ class ProgramLog:
 
         try:
             with open(program_log_filename, mode='r') as f:
-                self.ticks = int(readline(f))
-                self.hp = int(readline(f))
-                self.direct_hits = int(readline(f))
-                self.hits = int(readline(f))
-                self.got_direct_hits = int(readline(f))
-                self.got_hits = int(readline(f))
+                self.ticks = int(f.readline())
+                self.hp = int(f.readline())
+                self.direct_hits = int(f.readline())
+                self.hits = int(f.readline())
+                self.got_direct_hits = int(f.readline())
+                self.got_hits = int(f.readline())
         except IOError:
             print("Failed to open program log: {0}.".format(program_log_filename))
 
@@ -121,57 +125,89 @@ min_program_length = 256
 max_program_length = 4096
 
 morrigan_server = "bin/morrigan.exe"
-morrigan_client = "bin/morrigan_genetic_client"
+morrigan_evaluator = "bin/morrigan_genetic_evaluator"
+
+# Evaluator plays population in parallel matches on lockstep server, which ticks as soon as every bot
+# has ended its turn. Every program plays evaluation_rounds matches against randomly drawn opponents,
+# its statistics are averaged. Tick rate sets turn timeout.
+evaluation_arenas = 4
+match_size = 8
+evaluation_rounds = 3
+max_turns = 3000
+tick_rate = 10
+
+# Island model: islands_count populations of population_size evolve apart and are stepped by island_workers
+# local worker processes, each with own server. Every migration_interval generations best migration_count
+# programs of each island replace random programs of the next one in ring.
+islands_path = "bin/islands"
+islands_count = 8
+island_workers = 2
+migration_interval = 5
+migration_count = 2
+# Worker n runs its server on island_base_port + 2 * n, next port is taken by server admin endpoint.
+island_base_port = 9100
 
 def main():
     if 1 >= len(sys.argv):
-        print("usage: {0} <action>\nactions:\n\tinit\n\tstep".format(sys.argv[0]))
+        print("usage: {0} <action>\nactions:\n\tinit\n\tstep\n\tinit-islands\n\tislands <generations>".format(sys.argv[0]))
         return 1
 
     random.seed()
 
     if "init" == sys.argv[1]:
-        initialize_population()
+        initialize_population(populations_path)
         return 0
     elif "step" == sys.argv[1]:
         genetic_step()
         return 0
+    elif "init-islands" == sys.argv[1]:
+        initialize_islands()
+        return 0
+    elif "islands" == sys.argv[1] and 3 == len(sys.argv):
+        evolve_islands(int(sys.argv[2]))
+        return 0
     else:
         print("Unknown operation. See usage for help.")
         return -1
 
 def genetic_step():
-    subdirectories = [ subdir for subdir in os.listdir(populations_path) if os.path.isdir(os.path.join(populations_path, subdir)) ]
-    subdirectories = list(filter(lambda subdir: None != re.match(r"^\d+$", subdir), subdirectories))
-
-    if 0 == len(subdirectories):
+    population_path = find_last_population(populations_path)
+    if None == population_path:
         print("No populations found. Nothing to do here.")
         return -1
 
-    last_population = int(max(subdirectories, key=lambda subdir: int(subdir)))
-    population_path = os.path.realpath(os.path.join(populations_path, str(last_population)))
     print("Wokring with population at {0}".format(population_path))
 
-    programs = glob.glob(os.path.join(population_path, "*.sla"))
-    if population_size != len(programs):
+    if population_size != len(glob.glob(os.path.join(population_path, "*.sla"))):
         print("Bad program count.")
         return -1
 
-    server_pid = start_morrigan_server()
+    server_pid = start_morrigan_server(0)
     time.sleep(2.0)
 
-    program_pids = [ start_morrigan_client(p) for p in programs ]
-
-    print("Waiting for clients to terminate.")
-    for pid in program_pids:
-        pid.wait()
+    evaluate_population(population_path, 0)
 
     server_pid.terminate()
     server_pid.wait()
 
+    breed_population(population_path)
+
+def find_last_population(path):
+    subdirectories = [ subdir for subdir in os.listdir(path) if os.path.isdir(os.path.join(path, subdir)) ]
+    subdirectories = list(filter(lambda subdir: None != re.match(r"^\d+$", subdir), subdirectories))
+
+    if 0 == len(subdirectories):
+        return None
+
+    last_population = max(subdirectories, key=lambda subdir: int(subdir))
+    return os.path.realpath(os.path.join(path, last_population))
+
+# Breeds next population from logs of evaluated one, returns their ProgramLogs.
+def breed_population(population_path):
+    programs = glob.glob(os.path.join(population_path, "*.sla"))
     fitnesses = list(map(lambda p: ProgramLog(p), programs))
 
-    new_population_path = os.path.realpath(os.path.join(populations_path, str(1 + last_population)))
+    new_population_path = os.path.join(os.path.dirname(population_path), str(1 + int(os.path.basename(population_path))))
     os.mkdir(new_population_path)
 
     new_fitnesses = []
@@ -179,6 +215,150 @@ def genetic_step():
     perform_crossover(new_fitnesses, new_population_path)
     perform_mutation(new_population_path)
 
+    return fitnesses
+
+def initialize_islands():
+    for island in range(islands_count):
+        initialize_population(os.path.join(islands_path, str(island)))
+
+# Coordinator: hands islands out to workers generation by generation and carries migrants between them.
+def evolve_islands(generations):
+    islands = [ os.path.realpath(os.path.join(islands_path, str(island))) for island in range(islands_count) ]
+    if not all(map(lambda island: None != find_last_population(island), islands)):
+        print("Not all islands are initialized.")
+        return -1
+
+    # UNIX socket, or named pipe on Windows. Workers connect themselves, so none of them holds another's connection.
+    authkey = multiprocessing.current_process().authkey
+    listener = multiprocessing.connection.Listener(authkey=authkey)
+
+    processes = []
+    for worker_index in range(island_workers):
+        process = multiprocessing.Process(target=island_worker, args=(worker_index, listener.address, authkey))
+        process.start()
+        processes.append(process)
+
+    connections = [ None ] * island_workers
+    for i in range(island_workers):
+        connection = listener.accept()
+        connections[connection.recv()] = connection
+
+    listener.close()
+
+    alive = list(range(island_workers))
+    throughputs = [ None ] * island_workers # Programs per second.
+    emigrants = [ [] ] * islands_count
+
+    for generation in range(generations):
+        migration = 0 == (generation + 1) % migration_interval
+        pending = [ (island, emigrants[island - 1] if migration else []) for island in range(islands_count) ]
+        idle = list(alive)
+        busy = {}
+
+        print("Generation {0} of {1}{2}.".format(generation + 1, generations, ", migration" if migration else ""))
+
+        while (pending and alive) or busy:
+            while pending and idle:
+                worker_index = idle.pop()
+                batch_size = island_batch_size(len(pending), worker_index, throughputs)
+                batch, pending = pending[:batch_size], pending[batch_size:]
+
+                try:
+                    connections[worker_index].send([ (islands[island], island, immigrants) for (island, immigrants) in batch ])
+                    busy[connections[worker_index]] = (worker_index, batch)
+                except OSError:
+                    pending += batch
+                    lose_island_worker(worker_index, alive, throughputs)
+
+            for connection in multiprocessing.connection.wait(list(busy.keys())):
+                worker_index, batch = busy.pop(connection)
+
+                try:
+                    results, programs, seconds = connection.recv()
+                except EOFError:
+                    pending += batch
+                    lose_island_worker(worker_index, alive, throughputs)
+                    continue
+
+                idle.append(worker_index)
+
+                for (island, best) in results:
+                    emigrants[island] = best
+
+                throughput = programs / max(seconds, 0.001)
+                previous = throughputs[worker_index]
+                throughputs[worker_index] = throughput if None == previous else (previous + throughput) / 2
+                print("Island worker {0}: {1} islands, {2:.2f} programs per second.".format(worker_index, len(results), throughput))
+
+        if not alive:
+            print("All island workers have died.")
+            break
+
+    for worker_index in alive:
+        connections[worker_index].send(None)
+
+    for process in processes:
+        process.join()
+
+# Islands of dead worker go to the rest of workers.
+def lose_island_worker(worker_index, alive, throughputs):
+    print("Island worker {0} has died.".format(worker_index))
+    alive.remove(worker_index)
+    throughputs[worker_index] = 0
+
+# Worker gets share of pending islands proportional to its measured throughput, so slow worker takes less.
+# Share is halved, so tail of generation is split finely between workers. Unmeasured worker gets single island.
+def island_batch_size(pending_count, worker_index, throughputs):
+    if None in throughputs:
+        return 1
+
+    share = throughputs[worker_index] / max(sum(throughputs), 0.001)
+    return max(1, int(pending_count * share / 2))
+
+# Worker: evaluates and breeds islands it is sent until it gets None.
+def island_worker(worker_index, address, authkey):
+    connection = multiprocessing.connection.Client(address, authkey=authkey)
+    connection.send(worker_index)
+
+    random.seed()
+    port = island_base_port + 2 * worker_index
+
+    server_pid = start_morrigan_server(port)
+    time.sleep(2.0)
+
+    try:
+        while True:
+            batch = connection.recv()
+            if None == batch:
+                break
+
+            start = time.time()
+            results = [ (island, step_island(island_path, immigrants, port)) for (island_path, island, immigrants) in batch ]
+            connection.send((results, population_size * len(batch), time.time() - start))
+    finally:
+        server_pid.terminate()
+        server_pid.wait()
+
+# Returns sources of island's best programs.
+def step_island(island_path, immigrants, port):
+    population_path = find_last_population(island_path)
+    programs = glob.glob(os.path.join(population_path, "*.sla"))
+
+    for (program_file, source) in zip(random.sample(programs, len(immigrants)), immigrants):
+        with open(program_file, mode='w') as f:
+            f.write(source)
+
+    evaluate_population(population_path, port)
+    fitnesses = breed_population(population_path)
+    fitnesses.sort(key=lambda f: f.get_fitness(), reverse=True)
+
+    best = []
+    for f in fitnesses[:migration_count]:
+        with open(f.program_file, mode='r') as program:
+            best.append(program.read())
+
+    return best
+
 def perform_selection(fitnesses, new_population_path, new_fitnesses):
     weights = list(map(lambda f: f.get_fitness(), fitnesses))
 
@@ -234,8 +414,8 @@ def roulette_wheel(weights):
 
     return transformed_weights_len - 1
 
-def initialize_population():
-    population_path = os.path.realpath(os.path.join(populations_path, "0"))
+def initialize_population(path):
+    population_path = os.path.realpath(os.path.join(path, "0"))
     print("Creating new population with size {0} at {1}".format(population_size, population_path))
     if not os.path.exists(population_path):
         os.makedirs(population_path)
@@ -262,16 +442,21 @@ def write_program(f):
 
     f.write(".\n")
 
-def start_morrigan_server():
+def start_morrigan_server(port):
     print("Starting {0}".format(morrigan_server))
-    return subprocess.Popen(morrigan_server, cwd=os.path.dirname(morrigan_server))
-
-def start_morrigan_client(program):
-    client_command = "{0} {1} {2}".format(morrigan_client,
-                                          program,
-                                          "localhost")
-    print("Starting {0}".format(client_command))
-    return subprocess.Popen(client_command)
+    # <port> <arenas> <workers> <tick-rate> <policy>, 0 port is default one.
+    server_command = [ morrigan_server, str(port), str(evaluation_arenas), str(os.cpu_count() or 1), str(tick_rate), "lockstep" ]
+    return subprocess.Popen(server_command, executable=os.path.realpath(morrigan_server), cwd=os.path.dirname(morrigan_server))
+
+# Writes <program>.log for every program which has played.
+def evaluate_population(population_path, port):
+    # <population> <server> <port> <arenas> <match size> <rounds> <max turns> <seed>.
+    evaluator_command = [ morrigan_evaluator, population_path, "localhost", str(port),
+                          str(evaluation_arenas), str(match_size), str(evaluation_rounds), str(max_turns),
+                          str(random.randrange(1 << 31)) ]
+    print("Starting {0}".format(" ".join(evaluator_command)))
+    if 0 != subprocess.call(evaluator_command):
+        print("Evaluation has failed.")
 
 def probability_test(rate):
     return random.random() < rate
@@ -0,0 +1,376 @@
+// journal.c - match journal for deterministic replays.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "journal.h"
+
+#define JOURNAL_BUFFER 65536
+
+static void __journal_write(Journal *j, const void *data, size_t size);
+
+Journal *journal_create(const char *filename, const JournalHeader *header)
+{
+    assert(filename && "Bad filename pointer.");
+    assert(header && "Bad header pointer.");
+
+    Journal *j = (Journal *) calloc(1, sizeof(Journal));
+    check_mem(j);
+
+    j->f = fopen(filename, "wb");
+    check(j->f, "Failed to open journal file: %s.", filename);
+    setvbuf(j->f, NULL, _IOFBF, JOURNAL_BUFFER);
+
+    j->failed = false;
+    __journal_write(j, header, sizeof(JournalHeader));
+    check(!j->failed, "Failed to write journal header.", "");
+
+    return j;
+    error:
+    if (j)
+    {
+        journal_destroy(j);
+    }
+    return NULL;
+}
+
+void journal_destroy(Journal *j)
+{
+    assert(j && "Nothing to destroy.");
+
+    if (j->f)
+    {
+        fclose(j->f);
+    }
+
+    free(j);
+}
+
+void journal_write_tick(Journal *j, uint64_t state_hash)
+{
+    assert(j && "Bad journal pointer.");
+
+    uint8_t type = journal_tick;
+    __journal_write(j, &type, sizeof(type));
+    __journal_write(j, &state_hash, sizeof(state_hash));
+
+    j->ticks++;
+    if (!j->failed && 0 == j->ticks % JOURNAL_FLUSH_INTERVAL && 0 != fflush(j->f))
+    {
+        log_error("Failed to flush journal, recording is stopped.", "");
+        j->failed = true;
+    }
+}
+
+void journal_write_join(Journal *j, TankHandle t)
+{
+    assert(j && "Bad journal pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
+
+    uint8_t record[2] = { journal_join, (uint8_t) t };
+    __journal_write(j, record, sizeof(record));
+}
+
+void journal_write_leave(Journal *j, TankHandle t)
+{
+    assert(j && "Bad journal pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
+
+    uint8_t record[2] = { journal_leave, (uint8_t) t };
+    __journal_write(j, record, sizeof(record));
+}
+
+void journal_write_command(Journal *j, TankHandle t, const char *packet, size_t packet_size)
+{
+    assert(j && "Bad journal pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
+    assert(packet && "Bad packet pointer.");
+    assert(0 < packet_size && JOURNAL_MAX_PACKET >= packet_size && "Bad packet size.");
+
+    uint8_t record[3] = { journal_command, (uint8_t) t, (uint8_t) packet_size };
+    __journal_write(j, record, sizeof(record));
+    __journal_write(j, packet, packet_size);
+}
+
+JournalReader *journal_reader_open(const char *filename)
+{
+    assert(filename && "Bad filename pointer.");
+
+    JournalReader *r = (JournalReader *) calloc(1, sizeof(JournalReader));
+    check_mem(r);
+
+    r->f = fopen(filename, "rb");
+    check(r->f, "Failed to open journal file: %s.", filename);
+    setvbuf(r->f, NULL, _IOFBF, JOURNAL_BUFFER);
+
+    check(1 == fread(&r->header, sizeof(JournalHeader), 1, r->f), "Failed to read journal header.", "");
+    check(JOURNAL_MAGIC == r->header.magic, "Not a journal file.", "");
+    check(JOURNAL_VERSION == r->header.version, "Unsupported journal version: %u.", (unsigned) r->header.version);
+
+    r->failed = false;
+    r->truncated = false;
+    return r;
+    error:
+    if (r)
+    {
+        journal_reader_close(r);
+    }
+    return NULL;
+}
+
+void journal_reader_close(JournalReader *r)
+{
+    assert(r && "Nothing to close.");
+
+    if (r->f)
+    {
+        fclose(r->f);
+    }
+
+    free(r);
+}
+
+bool journal_read(JournalReader *r, JournalRecord *record)
+{
+    assert(r && "Bad journal reader pointer.");
+    assert(record && "Bad record pointer.");
+
+    int type = fgetc(r->f);
+    if (EOF == type)
+    {
+        return false;
+    }
+
+    record->type = (JournalRecordType) type;
+    record->tank = TANK_NONE;
+    record->state_hash = 0;
+    record->packet_size = 0;
+
+    uint8_t tank;
+    switch (record->type)
+    {
+        case journal_tick:
+            check(1 == fread(&record->state_hash, sizeof(record->state_hash), 1, r->f), "Truncated tick record.", "");
+            break;
+
+        case journal_join:
+        case journal_leave:
+            check(1 == fread(&tank, sizeof(tank), 1, r->f), "Truncated tank record.", "");
+            record->tank = tank;
+            break;
+
+        case journal_command:
+        {
+            uint8_t header[2];
+            check(1 == fread(header, sizeof(header), 1, r->f), "Truncated command record.", "");
+            check(0 < header[1], "Empty command packet.", "");
+            record->tank = header[0];
+            record->packet_size = header[1];
+            check(1 == fread(record->packet, record->packet_size, 1, r->f), "Truncated command packet.", "");
+            break;
+        }
+
+        default:
+            sentinel("Unknown journal record type: %d.", type);
+    }
+
+    check(record->tank == TANK_NONE || record->tank < WORLD_MAX_TANKS, "Bad tank handle in journal.", "");
+    return true;
+    error:
+    // Only short read sets end of file: complete records are never cut by their checks.
+    r->truncated = feof(r->f);
+    r->failed = !r->truncated;
+    return false;
+}
+
+uint64_t journal_hash(uint64_t hash, const void *data, size_t size)
+{
+    assert(data && "Bad data pointer.");
+
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint64_t journal_world_hash(const World *w)
+{
+    assert(w && "Bad world pointer.");
+
+    uint64_t hash = JOURNAL_HASH_SEED;
+
+    // Fields are hashed one by one: structures have padding.
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            continue;
+        }
+
+        const Tank *tank = &w->tanks[t];
+        hash = journal_hash(hash, &t, sizeof(t));
+        hash = journal_hash(hash, &w->tank_position[t], sizeof(Vector));
+        hash = journal_hash(hash, &w->tank_previous_position[t], sizeof(Vector));
+        hash = journal_hash(hash, &w->tank_direction[t], sizeof(Vector));
+        hash = journal_hash(hash, &w->tank_orientation[t], sizeof(Vector));
+        hash = journal_hash(hash, &w->tank_speed[t], sizeof(double));
+        hash = journal_hash(hash, &w->tank_hp[t], sizeof(int));
+        hash = journal_hash(hash, &w->tank_fire_delay[t], sizeof(int));
+        hash = journal_hash(hash, &tank->team, sizeof(tank->team));
+        hash = journal_hash(hash, &tank->engine_power, sizeof(tank->engine_power));
+        hash = journal_hash(hash, &tank->engine_power_target, sizeof(tank->engine_power_target));
+        hash = journal_hash(hash, &tank->turret_direction, sizeof(Vector));
+        hash = journal_hash(hash, &tank->turret_direction_target, sizeof(Vector));
+        hash = journal_hash(hash, &tank->turn_angle_target, sizeof(tank->turn_angle_target));
+        hash = journal_hash(hash, &tank->statistics.ticks, sizeof(tank->statistics.ticks));
+        hash = journal_hash(hash, &tank->statistics.hp, sizeof(tank->statistics.hp));
+        hash = journal_hash(hash, &tank->statistics.direct_hits, sizeof(tank->statistics.direct_hits));
+        hash = journal_hash(hash, &tank->statistics.hits, sizeof(tank->statistics.hits));
+        hash = journal_hash(hash, &tank->statistics.got_direct_hits, sizeof(tank->statistics.got_direct_hits));
+        hash = journal_hash(hash, &tank->statistics.got_hits, sizeof(tank->statistics.got_hits));
+        hash = journal_hash(hash, &tank->last_shell_id, sizeof(tank->last_shell_id));
+    }
+
+    hash = journal_hash(hash, &w->next_shell_id, sizeof(w->next_shell_id));
+    hash = journal_hash(hash, &w->shell_count, sizeof(w->shell_count));
+    hash = journal_hash(hash, w->shell_position, w->shell_count * sizeof(Vector));
+    hash = journal_hash(hash, w->shell_previous_position, w->shell_count * sizeof(Vector));
+    hash = journal_hash(hash, w->shell_direction, w->shell_count * sizeof(Vector));
+    hash = journal_hash(hash, w->shell_speed, w->shell_count * sizeof(double));
+    hash = journal_hash(hash, w->shell_id, w->shell_count * sizeof(size_t));
+
+    return hash;
+}
+
+uint64_t journal_landscape_hash(const Landscape *l)
+{
+    assert(l && "Bad landscape pointer.");
+
+    uint64_t hash = JOURNAL_HASH_SEED;
+    hash = journal_hash(hash, &l->landscape_size, sizeof(l->landscape_size));
+    hash = journal_hash(hash, &l->tile_size, sizeof(l->tile_size));
+    hash = journal_hash(hash, &l->scale, sizeof(l->scale));
+    hash = journal_hash(hash, l->height_map, l->landscape_size * l->landscape_size * sizeof(double));
+    return hash;
+}
+
+static void __journal_write(Journal *j, const void *data, size_t size)
+{
+    assert(j && "Bad journal pointer.");
+
+    if (j->failed)
+    {
+        return;
+    }
+
+    if (1 != fwrite(data, size, 1, j->f))
+    {
+        log_error("Failed to write journal, recording is stopped.", "");
+        j->failed = true;
+    }
+}
+
+#if defined(JOURNAL_TESTS)
+#include "testhelp.h"
+
+#define TEST_JOURNAL "journal_test.journal"
+
+int main(void)
+{
+    JournalHeader header = {
+        .magic          = JOURNAL_MAGIC,
+        .version        = JOURNAL_VERSION,
+        .arena          = 3,
+        .seed           = 12345,
+        .landscape_hash = 0xdeadbeef,
+        .first_shell_id = 7
+    };
+    char packet[] = { 0x11, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    Journal *j = journal_create(TEST_JOURNAL, &header);
+    test_cond("Create journal.", NULL != j);
+
+    journal_write_join(j, 5);
+    journal_write_command(j, 5, packet, sizeof(packet));
+    journal_write_tick(j, 0x0123456789abcdefULL);
+    journal_write_leave(j, 5);
+    test_cond("Write records.", !j->failed);
+    journal_destroy(j);
+
+    JournalReader *r = journal_reader_open(TEST_JOURNAL);
+    test_cond("Open journal.", NULL != r);
+    test_cond("Check header.", 3 == r->header.arena && 12345 == r->header.seed && 0xdeadbeef == r->header.landscape_hash && 7 == r->header.first_shell_id);
+
+    JournalRecord record;
+    test_cond("Read join.", journal_read(r, &record) && journal_join == record.type && 5 == record.tank);
+    test_cond("Read command.",
+              journal_read(r, &record) &&
+              journal_command == record.type &&
+              5 == record.tank &&
+              sizeof(packet) == record.packet_size &&
+              0 == memcmp(packet, record.packet, sizeof(packet)));
+    test_cond("Read tick.", journal_read(r, &record) && journal_tick == record.type && 0x0123456789abcdefULL == record.state_hash);
+    test_cond("Read leave.", journal_read(r, &record) && journal_leave == record.type && 5 == record.tank);
+    test_cond("Journal end.", !journal_read(r, &record) && !r->failed && !r->truncated);
+    journal_reader_close(r);
+
+    // Server crashed in the middle of tick record.
+    FILE *f = fopen(TEST_JOURNAL, "ab");
+    fwrite(&(uint8_t) { journal_tick }, 1, 1, f);
+    fwrite(packet, 3, 1, f);
+    fclose(f);
+
+    r = journal_reader_open(TEST_JOURNAL);
+    size_t count = 0;
+    while (journal_read(r, &record))
+    {
+        count++;
+    }
+    test_cond("Truncated record is end of journal.", 4 == count && r->truncated && !r->failed);
+    journal_reader_close(r);
+
+    j = journal_create(TEST_JOURNAL, &header);
+    for (size_t i = 0; i < JOURNAL_FLUSH_INTERVAL; i++)
+    {
+        journal_write_tick(j, i);
+    }
+
+    r = journal_reader_open(TEST_JOURNAL);
+    count = 0;
+    while (r && journal_read(r, &record))
+    {
+        count++;
+    }
+    test_cond("Journal is flushed each interval.", r && JOURNAL_FLUSH_INTERVAL == count && !r->truncated && !r->failed);
+    if (r)
+    {
+        journal_reader_close(r);
+    }
+    journal_destroy(j);
+
+    World *w1 = world_create(), *w2 = world_create();
+    w1->tank_used[2] = w2->tank_used[2] = true;
+    w1->tank_position[2].x = w2->tank_position[2].x = 10.0;
+    test_cond("Equal worlds have equal hashes.", journal_world_hash(w1) == journal_world_hash(w2));
+
+    world_shell_add(w1);
+    test_cond("Different worlds have different hashes.", journal_world_hash(w1) != journal_world_hash(w2));
+
+    world_shell_add(w2);
+    test_cond("Shell ids are per world.", 0 == w1->shell_id[0] && 0 == w2->shell_id[0] && 1 == w1->next_shell_id);
+    world_destroy(w1);
+    world_destroy(w2);
+
+    remove(TEST_JOURNAL);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
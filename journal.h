@@ -0,0 +1,100 @@
+// journal.h - match journal for deterministic replays.
+
+#pragma once
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+//#pragma message("__JOURNAL_H__")
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "morrigan.h"
+#include "landscape.h"
+#include "world.h"
+
+#define JOURNAL_MAGIC 0x4a47524d // "MRGJ".
+#define JOURNAL_VERSION 2
+#define JOURNAL_MAX_PACKET 255
+#define JOURNAL_FLUSH_INTERVAL 10 // In ticks, crashed server loses at most these.
+#define JOURNAL_HASH_SEED 14695981039346656037ULL
+
+// Journal is a header followed by records. Records between two tick records were applied
+// to arena between these ticks, in journal order.
+typedef enum JournalRecordType
+{
+    journal_tick    = 0x01, // State hash after tick.
+    journal_join    = 0x02, // Tank joined arena, followed by its random placement.
+    journal_leave   = 0x03,
+    journal_command = 0x04  // Tank control packet, as received.
+} JournalRecordType;
+
+#pragma pack(push, 1)
+#pragma warn(push)
+#pragma warn(disable: 2185)
+
+typedef struct JournalHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t arena;
+    uint64_t seed;           // Arena random seed.
+    uint64_t landscape_hash;
+    uint64_t first_shell_id; // Shell id counter of arena's world at start.
+} JournalHeader;
+
+#pragma warn(pop)
+#pragma pack(pop)
+
+#pragma pack(push, 8)
+
+typedef struct Journal
+{
+    FILE *f;
+    bool failed; // Write has failed, journal is incomplete.
+    unsigned long long ticks;
+} Journal;
+
+typedef struct JournalRecord
+{
+    JournalRecordType type;
+    TankHandle tank;
+    uint64_t state_hash;
+    size_t packet_size;
+    char packet[JOURNAL_MAX_PACKET];
+} JournalRecord;
+
+typedef struct JournalReader
+{
+    FILE *f;
+    JournalHeader header;
+    bool failed;    // Journal is corrupted.
+    bool truncated; // Last record is incomplete, e.g. server has crashed while writing it.
+} JournalReader;
+
+#pragma pack(pop)
+
+// Writing. Arena must be locked by caller.
+Journal *journal_create(const char *filename, const JournalHeader *header);
+void journal_destroy(Journal *j);
+
+void journal_write_tick(Journal *j, uint64_t state_hash);
+void journal_write_join(Journal *j, TankHandle t);
+void journal_write_leave(Journal *j, TankHandle t);
+void journal_write_command(Journal *j, TankHandle t, const char *packet, size_t packet_size);
+
+// Reading.
+JournalReader *journal_reader_open(const char *filename);
+void journal_reader_close(JournalReader *r);
+
+// Returns false at end of journal or on error (r->failed is set then).
+// Incomplete last record is end of journal too (r->truncated is set then).
+bool journal_read(JournalReader *r, JournalRecord *record);
+
+// State hashes (FNV-1a).
+uint64_t journal_hash(uint64_t hash, const void *data, size_t size);
+uint64_t journal_world_hash(const World *w);
+uint64_t journal_landscape_hash(const Landscape *l);
+
+#endif /* __JOURNAL_H__ */
@@ -13,6 +13,11 @@
 
 #define TILE_SIZE 16
 
+// Landscape of server and tools which replay or benchmark it.
+#define LANDSCAPE_DEFAULT_FILE "land.dat"
+#define LANDSCAPE_DEFAULT_TILE_SIZE 32
+#define LANDSCAPE_DEFAULT_SCALE 1.0
+
 #pragma pack(push, 8)
 
 typedef struct Landscape
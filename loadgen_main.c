@@ -0,0 +1,433 @@
+// loadgen_main.c - main() for synthetic load generator which simulates many tank clients.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "net.h"
+#include "protocol.h"
+#include "client_protocol.h"
+#include "scheduler.h"
+#include "metrics.h"
+
+#define LOAD_DEFAULT_TANKS 100
+#define LOAD_DEFAULT_RATE 10     // Requests per second per tank.
+#define LOAD_DEFAULT_DURATION 30 // In seconds.
+#define LOAD_DEFAULT_MIX "60,35,5"
+#define LOAD_MAX_TANKS 16384
+#define LOAD_TIMEOUT (NET_TIMEOUT * SCHEDULER_NSEC_PER_SEC / 1000) // Request is lost after it.
+#define LOAD_IDLE_SLEEP 200000                                    // In nanoseconds.
+
+typedef enum LoadTankState
+{
+    load_connecting, // First hello is sent.
+    load_joining,    // Second hello is sent.
+    load_playing,
+    load_failed
+} LoadTankState;
+
+typedef enum LoadRequestClass
+{
+    load_connect,
+    load_control,
+    load_telemetry,
+    load_map,
+    load_class_count
+} LoadRequestClass;
+
+#pragma pack(push, 8)
+
+// Each tank has one request in flight at most, so responses are matched by packet id.
+typedef struct LoadTank
+{
+    SOCKET s;
+    LoadTankState state;
+    bool pending;
+    uint8_t pending_id;
+    LoadRequestClass pending_class;
+    uint64_t sent_at;
+    uint64_t next_send;
+    unsigned retries;
+} LoadTank;
+
+typedef struct LoadStats
+{
+    MetricsHistogram rtt; // In nanoseconds.
+    unsigned long long sent;
+    unsigned long long received;
+    unsigned long long rejected; // Answered with error or "wait" response.
+    unsigned long long lost;
+} LoadStats;
+
+#pragma pack(pop)
+
+static const char *class_names[load_class_count] = { "connect", "control", "telemetry", "map" };
+
+static LoadTank *tanks = NULL;
+static size_t tank_count = 0;
+static LoadStats stats[load_class_count];
+static unsigned mix[load_class_count];
+static uint64_t random_state = 1;
+
+static bool __parse_mix(const char *s);
+static double __random(double from, double to);
+static bool __send_hello(LoadTank *t, uint8_t arena);
+static bool __send_request(LoadTank *t);
+static void __receive(LoadTank *t, uint8_t arena, uint64_t now, bool *busy);
+static void __print_report(double seconds);
+
+// Usage: morrigan_loadgen <server> [<port> [<tanks> [<rate> [<duration> [<mix> [<arenas> [<seed>]]]]]]]
+// Mix is weights of control, telemetry and map requests.
+int main(int argc, char *argv[])
+{
+    if (2 > argc)
+    {
+        fprintf(stderr, "Usage: %s <server> [<port> [<tanks> [<rate> [<duration> [<mix> [<arenas> [<seed>]]]]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *server = argv[1];
+    unsigned short port = 2 < argc ? (unsigned short) atoi(argv[2]) : PORT;
+    tank_count = 3 < argc ? strtoul(argv[3], NULL, 10) : LOAD_DEFAULT_TANKS;
+    double rate = 4 < argc ? atof(argv[4]) : LOAD_DEFAULT_RATE;
+    double duration = 5 < argc ? atof(argv[5]) : LOAD_DEFAULT_DURATION;
+    unsigned arenas = 7 < argc ? (unsigned) atoi(argv[7]) : 1;
+    random_state = 8 < argc ? strtoull(argv[8], NULL, 10) : 1;
+    bool net_started = false;
+
+    check(0 < tank_count && LOAD_MAX_TANKS >= tank_count, "Bad tank count.", "");
+    check(0 < rate && 0 < duration && 0 < arenas && UINT8_MAX >= arenas, "Bad rate, duration or arena count.", "");
+    check(__parse_mix(6 < argc ? argv[6] : LOAD_DEFAULT_MIX), "Bad request mix.", "");
+
+    check(net_started = client_net_start(), "Failed to start network.", "");
+    check_mem(tanks = (LoadTank *) calloc(tank_count, sizeof(LoadTank)));
+    for (size_t i = 0; i < tank_count; i++)
+    {
+        tanks[i].s = INVALID_SOCKET;
+    }
+
+    uint64_t period = (uint64_t) (SCHEDULER_NSEC_PER_SEC / rate);
+    uint64_t start = scheduler_now();
+
+    for (size_t i = 0; i < tank_count; i++)
+    {
+        LoadTank *t = &tanks[i];
+        t->state = load_failed;
+        check(client_open_socket(&t->s, server, port), "Failed to open socket of tank %u.", (unsigned) i);
+
+        u_long non_blocking = 1;
+        check(SOCKET_ERROR != ioctlsocket(t->s, FIONBIO, &non_blocking), "Failed to make socket non-blocking. Error: %d.", WSAGetLastError());
+
+        // Requests of tanks are spread over period.
+        t->next_send = start + (uint64_t) __random(0, (double) period);
+        t->state = load_connecting;
+        __send_hello(t, (uint8_t) (i % arenas));
+    }
+
+    printf("Tanks: %u, rate: %g requests/s per tank, duration: %g s, arenas: %u.\n", (unsigned) tank_count, rate, duration, arenas);
+
+    uint64_t end = start + (uint64_t) (duration * SCHEDULER_NSEC_PER_SEC), next_progress = start + SCHEDULER_NSEC_PER_SEC;
+    uint64_t now = start;
+
+    while ((now = scheduler_now()) < end)
+    {
+        bool busy = false;
+
+        for (size_t i = 0; i < tank_count; i++)
+        {
+            LoadTank *t = &tanks[i];
+            if (load_failed == t->state)
+            {
+                continue;
+            }
+
+            __receive(t, (uint8_t) (i % arenas), now, &busy);
+
+            if (t->pending && now - t->sent_at > LOAD_TIMEOUT)
+            {
+                stats[t->pending_class].lost++;
+                t->pending = false;
+
+                // Hello is resent, like client_connect() waits for it.
+                if (load_playing != t->state)
+                {
+                    t->state = ++t->retries < NET_RETRIES ? t->state : load_failed;
+                    if (load_failed != t->state)
+                    {
+                        __send_hello(t, (uint8_t) (i % arenas));
+                    }
+                }
+            }
+
+            if (load_playing == t->state && !t->pending && now >= t->next_send)
+            {
+                // Late tanks don't send bursts.
+                t->next_send = max(t->next_send + period, now);
+                if (!__send_request(t))
+                {
+                    t->state = load_failed;
+                }
+                busy = true;
+            }
+        }
+
+        if (now >= next_progress)
+        {
+            unsigned long long sent = 0, received = 0, lost = 0;
+            for (LoadRequestClass c = load_control; c < load_class_count; c++)
+            {
+                sent += stats[c].sent;
+                received += stats[c].received;
+                lost += stats[c].lost;
+            }
+
+            printf("%.0f s: sent: %llu, received: %llu, lost: %llu.\n", (double) (now - start) / SCHEDULER_NSEC_PER_SEC, sent, received, lost);
+            next_progress += SCHEDULER_NSEC_PER_SEC;
+        }
+
+        if (!busy)
+        {
+            thrd_sleep(&(struct timespec) { .tv_nsec = LOAD_IDLE_SLEEP }, NULL);
+        }
+    }
+
+    __print_report((double) (now - start) / SCHEDULER_NSEC_PER_SEC);
+
+    for (size_t i = 0; i < tank_count; i++)
+    {
+        if (INVALID_SOCKET != tanks[i].s)
+        {
+            uint8_t req = req_bye;
+            send(tanks[i].s, (char *) &req, 1, 0);
+            closesocket(tanks[i].s);
+        }
+    }
+
+    free(tanks);
+    client_net_stop();
+    return EXIT_SUCCESS;
+
+    error:
+    if (tanks)
+    {
+        for (size_t i = 0; i < tank_count; i++)
+        {
+            if (INVALID_SOCKET != tanks[i].s)
+            {
+                closesocket(tanks[i].s);
+            }
+        }
+        free(tanks);
+    }
+    if (net_started)
+    {
+        client_net_stop();
+    }
+    return EXIT_FAILURE;
+}
+
+static bool __parse_mix(const char *s)
+{
+    assert(s && "Bad mix pointer.");
+
+    unsigned control, telemetry, map;
+    if (3 != sscanf(s, "%u,%u,%u", &control, &telemetry, &map) || 0 == control + telemetry + map)
+    {
+        return false;
+    }
+
+    mix[load_connect] = 0;
+    mix[load_control] = control;
+    mix[load_telemetry] = telemetry;
+    mix[load_map] = map;
+    return true;
+}
+
+// Same generator as arenas use, so runs with equal seed send equal requests.
+static double __random(double from, double to)
+{
+    random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return from + (to - from) * (double) (random_state >> 11) / (double) (1ULL << 53);
+}
+
+static bool __send_hello(LoadTank *t, uint8_t arena)
+{
+    assert(t && "Bad tank pointer.");
+
+    char req_packet[1 + sizeof(ReqHello)] = { req_hello };
+    ((ReqHello *) &req_packet[1])->arena = arena;
+
+    t->pending = true;
+    t->pending_id = req_hello;
+    t->pending_class = load_connect;
+    t->sent_at = scheduler_now();
+    stats[load_connect].sent++;
+
+    check(SOCKET_ERROR != send(t->s, req_packet, sizeof(req_packet), 0), "send() failed. Error: %d.", WSAGetLastError());
+    return true;
+    error:
+    return false;
+}
+
+static bool __send_request(LoadTank *t)
+{
+    assert(t && "Bad tank pointer.");
+
+    static const uint8_t control_ids[] = { req_set_engine_power, req_turn, req_look_at, req_shoot, req_control };
+    static const uint8_t telemetry_ids[] = { req_get_heading, req_get_speed, req_get_hp, req_get_statistics, req_get_fire_delay, req_get_observation, req_get_normal };
+
+    // Request class is chosen by mix weights.
+    double pick = __random(0, mix[load_control] + mix[load_telemetry] + mix[load_map]);
+    LoadRequestClass c = pick < mix[load_control] ? load_control : pick < mix[load_control] + mix[load_telemetry] ? load_telemetry : load_map;
+
+    char req_buf[1 + sizeof(ReqControl)];
+    size_t length = 1;
+
+    switch (c)
+    {
+        case load_control:
+            req_buf[0] = control_ids[(size_t) __random(0, sizeof(control_ids))];
+            break;
+
+        case load_telemetry:
+            req_buf[0] = telemetry_ids[(size_t) __random(0, sizeof(telemetry_ids))];
+            break;
+
+        default:
+            req_buf[0] = req_get_map;
+            break;
+    }
+
+    switch ((uint8_t) req_buf[0])
+    {
+        case req_set_engine_power:
+            ((ReqSetEnginePower *) &req_buf[1])->engine_power = (int8_t) __random(-100, 100);
+            length += sizeof(ReqSetEnginePower);
+            break;
+
+        case req_turn:
+            ((ReqTurn *) &req_buf[1])->turn_angle = __random(-M_PI, M_PI);
+            length += sizeof(ReqTurn);
+            break;
+
+        case req_look_at:
+            *(ReqLookAt *) &req_buf[1] = (ReqLookAt) { .x = __random(-1, 1), .y = __random(-1, 1), .z = __random(0, 0.5) };
+            length += sizeof(ReqLookAt);
+            break;
+
+        case req_control:
+            *(ReqControl *) &req_buf[1] = (ReqControl) {
+                .flags        = CONTROL_ALL,
+                .engine_power = (int8_t) __random(-100, 100),
+                .turn_angle   = __random(-M_PI, M_PI),
+                .look_x       = __random(-1, 1),
+                .look_y       = __random(-1, 1),
+                .look_z       = __random(0, 0.5)
+            };
+            length += sizeof(ReqControl);
+            break;
+    }
+
+    t->pending = true;
+    t->pending_id = (uint8_t) req_buf[0];
+    t->pending_class = c;
+    t->sent_at = scheduler_now();
+    stats[c].sent++;
+
+    check(SOCKET_ERROR != send(t->s, req_buf, (int) length, 0), "send() failed. Error: %d.", WSAGetLastError());
+    return true;
+    error:
+    return false;
+}
+
+// Reads all datagrams which have arrived. Notifications are skipped.
+static void __receive(LoadTank *t, uint8_t arena, uint64_t now, bool *busy)
+{
+    assert(t && "Bad tank pointer.");
+    assert(busy && "Bad busy pointer.");
+
+    static char buf[CLIENT_PACKET_BUFFER];
+
+    int received;
+    while (0 < (received = recv(t->s, buf, sizeof(buf), 0)))
+    {
+        uint8_t id = (uint8_t) buf[0];
+        *busy = true;
+
+        if (req_bye == id)
+        {
+            log_warning("Server has said bye.", "");
+            t->state = load_failed;
+            return;
+        }
+
+        bool error = res_bad_request == id || res_too_many_clients == id || res_wait == id || res_wait_shoot == id || res_dead == id;
+        if (!t->pending || (id != t->pending_id && !error))
+        {
+            continue;
+        }
+
+        LoadStats *s = &stats[t->pending_class];
+        metrics_histogram_record(&s->rtt, now - t->sent_at);
+        s->received++;
+        s->rejected += error ? 1 : 0;
+        t->pending = false;
+
+        if (load_connecting == t->state || load_joining == t->state)
+        {
+            if (res_too_many_clients == id)
+            {
+                t->state = load_failed;
+                return;
+            }
+
+            if (req_hello == id)
+            {
+                t->state = load_connecting == t->state ? load_joining : load_playing;
+                t->retries = 0;
+                if (load_joining == t->state)
+                {
+                    __send_hello(t, arena);
+                }
+            }
+        }
+    }
+}
+
+static void __print_report(double seconds)
+{
+    size_t playing = 0;
+    for (size_t i = 0; i < tank_count; i++)
+    {
+        playing += load_playing == tanks[i].state ? 1 : 0;
+    }
+
+    printf("Tanks playing: %u of %u.\n", (unsigned) playing, (unsigned) tank_count);
+    printf("%-10s %10s %10s %8s %10s %10s %10s %10s %10s %10s %10s\n",
+           "requests", "sent", "received", "loss %", "rejected", "req/s", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+
+    for (LoadRequestClass c = 0; c < load_class_count; c++)
+    {
+        const LoadStats *s = &stats[c];
+        printf("%-10s %10llu %10llu %8.2f %10llu %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+               class_names[c],
+               s->sent,
+               s->received,
+               s->sent ? 100.0 * (double) s->lost / (double) s->sent : 0.0,
+               s->rejected,
+               (double) s->received / seconds,
+               metrics_histogram_percentile(&s->rtt, 50.0) / 1000.0,
+               metrics_histogram_percentile(&s->rtt, 90.0) / 1000.0,
+               metrics_histogram_percentile(&s->rtt, 99.0) / 1000.0,
+               metrics_histogram_percentile(&s->rtt, 99.9) / 1000.0,
+               s->rtt.max / 1000.0);
+    }
+}
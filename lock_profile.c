@@ -0,0 +1,371 @@
+// lock_profile.c - contention profiler of global lock.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <winsock2.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "metrics.h"
+#include "lock_profile.h"
+
+#pragma pack(push, 8)
+
+typedef struct LockProfileTotals
+{
+    size_t site;
+    uint64_t acquisitions, contended, wait_time, max_wait, hold_time, max_hold;
+} LockProfileTotals;
+
+#pragma pack(pop)
+
+static atomic_bool enabled = ATOMIC_VAR_INIT(false);
+static atomic_size_t holder = ATOMIC_VAR_INIT(LOCK_PROFILE_NO_SITE);
+static atomic_uint_fast64_t unprofiled = ATOMIC_VAR_INIT(0); // Acquisitions of threads or sites over limits.
+
+// Sites are appended by lock holder, so they are never written concurrently.
+static LockProfileSite sites[LOCK_PROFILE_MAX_SITES];
+static atomic_size_t site_count = ATOMIC_VAR_INIT(0);
+
+static LockProfileBuffer *buffers[LOCK_PROFILE_MAX_THREADS];
+static atomic_size_t buffer_count = ATOMIC_VAR_INIT(0);
+static _Thread_local LockProfileBuffer *thread_buffer = NULL;
+
+static size_t __site_index(const LockProfileSite *site);
+static LockProfileBuffer *__thread_buffer(void);
+static void __add(atomic_uint_fast64_t *counter, uint64_t value);
+static void __max(atomic_uint_fast64_t *counter, uint64_t value);
+static uint64_t __load(atomic_uint_fast64_t *counter);
+static void __site_name(char *name, size_t size, size_t site);
+
+void lock_profile_start(void)
+{
+    atomic_store(&holder, LOCK_PROFILE_NO_SITE);
+    atomic_store(&enabled, true);
+}
+
+void lock_profile_stop(void)
+{
+    atomic_store(&enabled, false);
+}
+
+bool lock_profile_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+size_t lock_profile_holder(void)
+{
+    return atomic_load_explicit(&holder, memory_order_relaxed);
+}
+
+void lock_profile_acquired(const LockProfileSite *site, bool contended, uint64_t wait_time, size_t blocker, uint64_t now)
+{
+    assert(site && "Bad site pointer.");
+
+    size_t s = __site_index(site);
+    LockProfileBuffer *b = __thread_buffer();
+    atomic_store_explicit(&holder, s, memory_order_relaxed);
+
+    if (NULL == b || LOCK_PROFILE_NO_SITE == s)
+    {
+        atomic_fetch_add_explicit(&unprofiled, 1, memory_order_relaxed);
+        if (b)
+        {
+            b->site = LOCK_PROFILE_NO_SITE;
+        }
+        return;
+    }
+
+    b->site = s;
+    b->acquired_at = now;
+
+    LockProfileSiteStats *stats = &b->sites[s];
+    __add(&stats->acquisitions, 1);
+    if (!contended)
+    {
+        return;
+    }
+
+    __add(&stats->contended, 1);
+    __add(&stats->wait_time, wait_time);
+    __max(&stats->max_wait, wait_time);
+
+    if (LOCK_PROFILE_NO_SITE != blocker)
+    {
+        __add(&b->blocked_count[s][blocker], 1);
+        __add(&b->blocked_time[s][blocker], wait_time);
+    }
+}
+
+void lock_profile_releasing(uint64_t now)
+{
+    LockProfileBuffer *b = thread_buffer;
+    atomic_store_explicit(&holder, LOCK_PROFILE_NO_SITE, memory_order_relaxed);
+
+    if (NULL == b || LOCK_PROFILE_NO_SITE == b->site)
+    {
+        return;
+    }
+
+    uint64_t hold_time = now - b->acquired_at;
+    __add(&b->sites[b->site].hold_time, hold_time);
+    __max(&b->sites[b->site].max_hold, hold_time);
+    b->site = LOCK_PROFILE_NO_SITE;
+}
+
+size_t lock_profile_format(char *buffer, size_t size)
+{
+    assert(buffer && "Bad buffer pointer.");
+    assert(size && "Bad buffer size.");
+
+    size_t length = 0, sites_seen = min(atomic_load(&site_count), LOCK_PROFILE_MAX_SITES);
+    size_t threads = min(atomic_load(&buffer_count), LOCK_PROFILE_MAX_THREADS);
+    char name[128], holder_name[128];
+    buffer[0] = '\0';
+
+    LockProfileTotals totals[LOCK_PROFILE_MAX_SITES];
+    memset(totals, 0, sizeof(totals));
+
+    for (size_t s = 0; s < sites_seen; s++)
+    {
+        totals[s].site = s;
+        for (size_t t = 0; t < threads; t++)
+        {
+            if (NULL == buffers[t])
+            {
+                continue;
+            }
+
+            LockProfileSiteStats *stats = &buffers[t]->sites[s];
+            totals[s].acquisitions += __load(&stats->acquisitions);
+            totals[s].contended += __load(&stats->contended);
+            totals[s].wait_time += __load(&stats->wait_time);
+            totals[s].max_wait = max(totals[s].max_wait, __load(&stats->max_wait));
+            totals[s].hold_time += __load(&stats->hold_time);
+            totals[s].max_hold = max(totals[s].max_hold, __load(&stats->max_hold));
+        }
+    }
+
+    // Sites which made others wait most come first.
+    for (size_t i = 1; i < sites_seen; i++)
+    {
+        LockProfileTotals current = totals[i];
+        size_t j = i;
+        for (; j > 0 && totals[j - 1].wait_time < current.wait_time; j--)
+        {
+            totals[j] = totals[j - 1];
+        }
+        totals[j] = current;
+    }
+
+    length = metrics_append(buffer, size, length, "Global lock profile: %s, threads: %u, sites: %u, unprofiled acquisitions: %llu.\n",
+                            lock_profile_enabled() ? "on" : "off",
+                            (unsigned) threads,
+                            (unsigned) sites_seen,
+                            (unsigned long long) __load(&unprofiled));
+
+    length = metrics_append(buffer, size, length, "Sites by wait time (us):\n");
+    for (size_t i = 0; i < sites_seen; i++)
+    {
+        const LockProfileTotals *total = &totals[i];
+        __site_name(name, sizeof(name), total->site);
+        length = metrics_append(buffer, size, length,
+                                "  %s: acquisitions: %llu, contended: %llu, wait: %.1f total, %.1f max, hold: %.1f total, %.1f max.\n",
+                                name,
+                                (unsigned long long) total->acquisitions,
+                                (unsigned long long) total->contended,
+                                total->wait_time / 1000.0,
+                                total->max_wait / 1000.0,
+                                total->hold_time / 1000.0,
+                                total->max_hold / 1000.0);
+    }
+
+    length = metrics_append(buffer, size, length, "Waiter <- holder (us):\n");
+    for (size_t waiter = 0; waiter < sites_seen; waiter++)
+    {
+        for (size_t blocker = 0; blocker < sites_seen; blocker++)
+        {
+            uint64_t count = 0, wait_time = 0;
+            for (size_t t = 0; t < threads; t++)
+            {
+                if (buffers[t])
+                {
+                    count += __load(&buffers[t]->blocked_count[waiter][blocker]);
+                    wait_time += __load(&buffers[t]->blocked_time[waiter][blocker]);
+                }
+            }
+
+            if (0 == count)
+            {
+                continue;
+            }
+
+            __site_name(name, sizeof(name), waiter);
+            __site_name(holder_name, sizeof(holder_name), blocker);
+            length = metrics_append(buffer, size, length, "  %s <- %s: %llu times, %.1f.\n",
+                                    name,
+                                    holder_name,
+                                    (unsigned long long) count,
+                                    wait_time / 1000.0);
+        }
+    }
+
+    length = metrics_append(buffer, size, length, "Threads (us):\n");
+    for (size_t t = 0; t < threads; t++)
+    {
+        if (NULL == buffers[t])
+        {
+            continue;
+        }
+
+        uint64_t acquisitions = 0, wait_time = 0, hold_time = 0;
+        for (size_t s = 0; s < sites_seen; s++)
+        {
+            acquisitions += __load(&buffers[t]->sites[s].acquisitions);
+            wait_time += __load(&buffers[t]->sites[s].wait_time);
+            hold_time += __load(&buffers[t]->sites[s].hold_time);
+        }
+
+        length = metrics_append(buffer, size, length, "  tid %lu: acquisitions: %llu, wait: %.1f, hold: %.1f.\n",
+                                buffers[t]->thread_id,
+                                (unsigned long long) acquisitions,
+                                wait_time / 1000.0,
+                                hold_time / 1000.0);
+    }
+
+    return length;
+}
+
+void lock_profile_clean(void)
+{
+    atomic_store(&enabled, false);
+
+    size_t threads = min(atomic_load(&buffer_count), LOCK_PROFILE_MAX_THREADS);
+    for (size_t t = 0; t < threads; t++)
+    {
+        free(buffers[t]);
+        buffers[t] = NULL;
+    }
+
+    atomic_store(&buffer_count, 0);
+    thread_buffer = NULL;
+}
+
+// Lock holder only.
+static size_t __site_index(const LockProfileSite *site)
+{
+    size_t count = atomic_load_explicit(&site_count, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (site->line == sites[i].line && 0 == strcmp(site->file, sites[i].file))
+        {
+            return i;
+        }
+    }
+
+    if (LOCK_PROFILE_MAX_SITES == count)
+    {
+        return LOCK_PROFILE_NO_SITE;
+    }
+
+    sites[count] = *site;
+    atomic_store_explicit(&site_count, count + 1, memory_order_release);
+    return count;
+}
+
+// Buffer is allocated on first profiled acquisition of thread.
+static LockProfileBuffer *__thread_buffer(void)
+{
+    if (thread_buffer)
+    {
+        return thread_buffer;
+    }
+
+    size_t index = atomic_fetch_add(&buffer_count, 1);
+    if (LOCK_PROFILE_MAX_THREADS <= index)
+    {
+        return NULL;
+    }
+
+    LockProfileBuffer *b = (LockProfileBuffer *) calloc(1, sizeof(LockProfileBuffer));
+    check_mem(b);
+
+    b->thread_id = GetCurrentThreadId();
+    b->site = LOCK_PROFILE_NO_SITE;
+    buffers[index] = b;
+    thread_buffer = b;
+    return b;
+    error:
+    return NULL;
+}
+
+// Counters have single writer.
+static void __add(atomic_uint_fast64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static void __max(atomic_uint_fast64_t *counter, uint64_t value)
+{
+    if (value > atomic_load_explicit(counter, memory_order_relaxed))
+    {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static uint64_t __load(atomic_uint_fast64_t *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void __site_name(char *name, size_t size, size_t site)
+{
+    snprintf(name, size, "%s:%d %s()", sites[site].file, sites[site].line, sites[site].function);
+}
+
+#if defined(LOCK_PROFILE_TESTS)
+#include "testhelp.h"
+
+int main(void)
+{
+    LockProfileSite a = { .file = "a.c", .line = 10, .function = "first" };
+    LockProfileSite b = { .file = "b.c", .line = 20, .function = "second" };
+    char report[LOCK_PROFILE_REPORT_SIZE];
+
+    test_cond("Profiling is off by default.", !lock_profile_enabled());
+
+    lock_profile_start();
+    lock_profile_acquired(&a, false, 0, LOCK_PROFILE_NO_SITE, 1000);
+    test_cond("Holder is known.", 0 == lock_profile_holder());
+    lock_profile_releasing(1500);
+    test_cond("Holder is cleared.", LOCK_PROFILE_NO_SITE == lock_profile_holder());
+
+    lock_profile_acquired(&b, true, 300, 0, 2000);
+    lock_profile_releasing(2100);
+    lock_profile_acquired(&a, false, 0, LOCK_PROFILE_NO_SITE, 3000);
+    lock_profile_releasing(4000);
+
+    LockProfileSiteStats *first = &thread_buffer->sites[0], *second = &thread_buffer->sites[1];
+    test_cond("Count acquisitions.", 2 == __load(&first->acquisitions) && 1 == __load(&second->acquisitions));
+    test_cond("Count hold time.", 1500 == __load(&first->hold_time) && 1000 == __load(&first->max_hold));
+    test_cond("Count wait time.", 1 == __load(&second->contended) && 300 == __load(&second->wait_time));
+    test_cond("Count blocker.", 1 == __load(&thread_buffer->blocked_count[1][0]));
+
+    size_t length = lock_profile_format(report, sizeof(report));
+    test_cond("Report length.", strlen(report) == length);
+    test_cond("Report sites.", NULL != strstr(report, "b.c:20 second(): acquisitions: 1, contended: 1"));
+    test_cond("Report blocker.", NULL != strstr(report, "b.c:20 second() <- a.c:10 first(): 1 times"));
+    test_cond("Sites are sorted by wait time.", strstr(report, "b.c:20 second(): ") < strstr(report, "a.c:10 first(): "));
+
+    lock_profile_stop();
+    test_cond("Profiling is off.", !lock_profile_enabled());
+    lock_profile_clean();
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
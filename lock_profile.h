@@ -0,0 +1,76 @@
+// lock_profile.h - contention profiler of global lock.
+
+#pragma once
+#ifndef __LOCK_PROFILE_H__
+#define __LOCK_PROFILE_H__
+
+//#pragma message("__LOCK_PROFILE_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "morrigan.h"
+
+#define LOCK_PROFILE_MAX_THREADS 64
+#define LOCK_PROFILE_MAX_SITES 32
+#define LOCK_PROFILE_NO_SITE ((size_t) -1)
+#define LOCK_PROFILE_REPORT_SIZE 32768
+
+#pragma pack(push, 8)
+
+// Place in code where lock is taken.
+typedef struct LockProfileSite
+{
+    const char *file;
+    int line;
+    const char *function;
+} LockProfileSite;
+
+// Times are in nanoseconds. Hold time is measured from acquisition to release.
+typedef struct LockProfileSiteStats
+{
+    atomic_uint_fast64_t acquisitions;
+    atomic_uint_fast64_t contended;
+    atomic_uint_fast64_t wait_time;
+    atomic_uint_fast64_t max_wait;
+    atomic_uint_fast64_t hold_time;
+    atomic_uint_fast64_t max_hold;
+} LockProfileSiteStats;
+
+// Written only by its thread, so no read-modify-write is needed. Report reads it concurrently.
+typedef struct LockProfileBuffer
+{
+    unsigned long thread_id;
+    LockProfileSiteStats sites[LOCK_PROFILE_MAX_SITES];
+    // Contended acquisitions by waiter site and site which held lock at that moment.
+    atomic_uint_fast64_t blocked_count[LOCK_PROFILE_MAX_SITES][LOCK_PROFILE_MAX_SITES];
+    atomic_uint_fast64_t blocked_time[LOCK_PROFILE_MAX_SITES][LOCK_PROFILE_MAX_SITES];
+
+    // Current acquisition.
+    size_t site;
+    uint64_t acquired_at;
+} LockProfileBuffer;
+
+#pragma pack(pop)
+
+// Profiling is off by default. Statistics are kept between sessions.
+void lock_profile_start(void);
+void lock_profile_stop(void);
+bool lock_profile_enabled(void);
+
+// Site which holds lock now, LOCK_PROFILE_NO_SITE if it's unknown.
+size_t lock_profile_holder(void);
+
+// Both must be called while lock is held.
+void lock_profile_acquired(const LockProfileSite *site, bool contended, uint64_t wait_time, size_t blocker, uint64_t now);
+void lock_profile_releasing(uint64_t now);
+
+// Contention report: sites by total wait time and waiter / holder pairs. Returns report length.
+size_t lock_profile_format(char *buffer, size_t size);
+
+// Frees thread buffers. No thread may use lock after it.
+void lock_profile_clean(void);
+
+#endif /* __LOCK_PROFILE_H__ */
@@ -16,12 +16,21 @@
 #include "server.h"
 #include "game.h"
 #include "landscape.h"
+#include "arena.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "lock_profile.h"
+#include "trace.h"
+#include "admin.h"
 #include "debug.h"
 
 static void __stop(int unused);
 
 static Landscape *l = NULL;
 static bstring input = NULL;
+static const char *checkpoint_path = NULL;
+static char report[METRICS_REPORT_SIZE];
+static MetricsHistogram phases[metrics_phase_count];
 
 //int main(int argc, char *argv[], char *envp[])
 int main(int argc, char *argv[])
@@ -39,16 +48,87 @@ int main(int argc, char *argv[])
         printf("Using port: %d.\n", port);
     }
 
+    GameSettings settings = {
+        .arena_count         = 1,
+        .worker_count        = 0,
+        .tick_rate           = GAME_DEFAULT_TICK_RATE,
+        .policy              = scheduler_catch_up,
+        .seed                = (uint64_t) (time(NULL) ^ _getpid()),
+        .journal_path        = NULL,
+        .checkpoint_path     = NULL,
+        .checkpoint_interval = GAME_DEFAULT_CHECKPOINT_INTERVAL
+    };
+
+    if (2 < argc)
+    {
+        settings.arena_count = (size_t) atoi(argv[2]);
+        check(0 < settings.arena_count && MAX_ARENAS >= settings.arena_count, "Bad arena count. Must be in [1; %d].", MAX_ARENAS);
+    }
+
+    settings.worker_count = settings.arena_count;
+    if (3 < argc)
+    {
+        settings.worker_count = (size_t) atoi(argv[3]);
+        check(0 < settings.worker_count && GAME_MAX_WORKERS >= settings.worker_count, "Bad worker count. Must be in [1; %d].", GAME_MAX_WORKERS);
+    }
+    printf("Using arenas: %u, game workers: %u.\n", (unsigned) settings.arena_count, (unsigned) settings.worker_count);
+
+    if (4 < argc)
+    {
+        settings.tick_rate = (unsigned) atoi(argv[4]);
+        check(0 < settings.tick_rate && SCHEDULER_MAX_TICK_RATE >= settings.tick_rate, "Bad tick rate. Must be in [1; %d].", SCHEDULER_MAX_TICK_RATE);
+    }
+
+    if (5 < argc)
+    {
+        check(scheduler_parse_policy(argv[5], &settings.policy), "Bad tick policy. Must be catchup, skip or lockstep.", "");
+    }
+    printf("Using tick rate: %u, tick policy: %s.\n", settings.tick_rate, scheduler_policy_name(settings.policy));
+
+    // "-" keeps recording off, so seed may be given alone.
+    if (6 < argc && 0 != strcmp("-", argv[6]))
+    {
+        settings.journal_path = argv[6];
+        printf("Recording journals to: %s.\n", settings.journal_path);
+    }
+
+    if (7 < argc)
+    {
+        settings.seed = (uint64_t) strtoull(argv[7], NULL, 10);
+    }
+    printf("Using seed: %llu.\n", (unsigned long long) settings.seed);
+
+    // Arenas are resumed from checkpoints in this directory at start.
+    if (8 < argc && 0 != strcmp("-", argv[8]))
+    {
+        settings.checkpoint_path = argv[8];
+        checkpoint_path = argv[8];
+    }
+
+    if (9 < argc)
+    {
+        settings.checkpoint_interval = strtoull(argv[9], NULL, 10);
+        check(0 < settings.checkpoint_interval, "Bad checkpoint interval.", "");
+    }
+
+    if (settings.checkpoint_path)
+    {
+        printf("Using checkpoints: %s, interval: %llu ticks.\n", settings.checkpoint_path, settings.checkpoint_interval);
+    }
+
     check(SIG_ERR != signal(SIGINT, __stop), "Failed to set signal handler.", "");
     check(SIG_ERR != signal(SIGTERM, __stop), "Failed to set signal handler.", "");
 
     srand((unsigned) (time(NULL) ^ _getpid()));
 
-    l = landscape_load("land.dat", 32, 1.0);
+    l = landscape_load(LANDSCAPE_DEFAULT_FILE, LANDSCAPE_DEFAULT_TILE_SIZE, LANDSCAPE_DEFAULT_SCALE);
     check(l, "Failed to load landscape.", "");
-    check(net_start(port), "Failed to start network interface.", "");
     check(server_start(), "Failed to start server.", "");
-    check(game_start(l, server_get_clients()), "Failed to start game.", "");
+    check(game_start(l, &settings), "Failed to start game.", "");
+
+    // Packets are handled only after all arenas are created and restored.
+    check(net_start(port), "Failed to start network interface.", "");
+    check(admin_start(port ? port + ADMIN_PORT_OFFSET : 0), "Failed to start admin endpoint.", "");
 
     do
     {
@@ -60,6 +140,46 @@ int main(int argc, char *argv[])
             break;
         }
 
+        if (0 == strcmp("metrics\n", bdata(input)))
+        {
+            game_collect_phase_times(phases);
+            metrics_format(report, sizeof(report), phases);
+            fputs(report, stdout);
+        }
+
+        if (0 == strcmp("locks on\n", bdata(input)))
+        {
+            lock_profile_start();
+        }
+
+        if (0 == strcmp("locks off\n", bdata(input)))
+        {
+            lock_profile_stop();
+        }
+
+        if (0 == strcmp("locks\n", bdata(input)))
+        {
+            lock_profile_format(report, sizeof(report));
+            fputs(report, stdout);
+        }
+
+        if (0 == strcmp("trace on\n", bdata(input)))
+        {
+            trace_start();
+        }
+
+        // Trace is written to working directory.
+        if (0 == strcmp("trace off\n", bdata(input)))
+        {
+            trace_stop();
+            puts(trace_write(TRACE_DEFAULT_FILE) ? "Trace is saved." : "Failed to save trace.");
+        }
+
+        if (0 == strcmp("checkpoint\n", bdata(input)))
+        {
+            puts(checkpoint_path && game_save_checkpoints() ? "Checkpoints are saved." : "Failed to save checkpoints.");
+        }
+
         bdestroy(input);
         input = NULL;
     } while(true);
@@ -90,14 +210,35 @@ static void __stop(int unused)
     {
         bdestroy(input);
     }
+    admin_stop();
+
+    // Before clients are sent "bye" and leave arenas.
+    if (checkpoint_path)
+    {
+        game_save_checkpoints();
+    }
     net_stop();
     game_stop();
+
+    // All lock users are stopped, report is final.
+    if (lock_profile_enabled())
+    {
+        lock_profile_format(report, sizeof(report));
+        fputs(report, stderr);
+    }
+
+    if (trace_enabled())
+    {
+        trace_stop();
+        trace_write(TRACE_DEFAULT_FILE);
+    }
     server_stop();
     if (l)
     {
         landscape_destroy(l);
         l = NULL;
     }
+    trace_clean();
 }
 
 #endif
@@ -0,0 +1,424 @@
+// matchbench_main.c - main() for end-to-end match benchmark with scripted bots.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "debug.h"
+#include "net.h"
+#include "server.h"
+#include "game.h"
+#include "arena.h"
+#include "landscape.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "client_protocol.h"
+
+#define MATCH_BENCH_HOST "127.0.0.1"
+#define MATCH_BENCH_PORT (PORT + 2) // Doesn't clash with server and its admin endpoint.
+#define MATCH_BENCH_DEFAULT_TICKS 3000
+#define MATCH_BENCH_DEFAULT_BOTS 12
+#define MATCH_BENCH_DEFAULT_SEED 1
+#define MATCH_BENCH_POLL_PERIOD 10000000 // In nanoseconds.
+#define BOT_ENGINE_POWER 60
+#define BOT_TURN_ANGLE 0.3
+
+typedef enum BotBehaviour
+{
+    bot_circle_strafe,   // Drives in circles.
+    bot_shoot_at_nearest,
+    bot_idle,            // Only polls its hp.
+    bot_behaviour_count
+} BotBehaviour;
+
+#pragma pack(push, 8)
+
+typedef struct Bot
+{
+    ClientProtocol protocol;
+    BotBehaviour behaviour;
+    thrd_t tid;
+    bool started;
+    unsigned long long steps;
+    unsigned long long failures; // Requests which weren't answered as expected, e.g. with "wait".
+} Bot;
+
+#pragma pack(pop)
+
+static const char *behaviour_names[bot_behaviour_count] = { "circle-strafe", "shoot-at-nearest", "idle" };
+
+// Same packets as interactive client knows, without executors.
+static PacketDefinition bot_packets[] = {
+    { .id = req_hello            },
+    { .id = req_bye              },
+    { .id = req_set_engine_power },
+    { .id = req_turn             },
+    { .id = req_look_at          },
+    { .id = req_shoot            },
+    { .id = req_get_heading      },
+    { .id = req_get_speed        },
+    { .id = req_get_hp           },
+    { .id = req_get_map          },
+    { .id = req_get_normal       },
+    { .id = req_get_tanks        },
+    { .id = res_bad_request      },
+    { .id = res_too_many_clients },
+    { .id = res_wait             },
+    { .id = res_wait_shoot       },
+    { .id = res_dead             },
+    { .id = not_tank_hit_bound   },
+    { .id = not_tank_collision   },
+    { .id = not_near_shoot       },
+    { .id = not_death            },
+    { .id = not_win              },
+    { .id = not_hit              },
+    { .id = not_near_explosion   },
+    { .id = not_explosion_damage },
+    { .id = not_viewer_shoot     },
+    { .id = not_viewer_explosion }
+};
+
+static Bot *bots = NULL;
+static size_t bot_count = 0;
+static size_t arena_count = 1;
+static unsigned short port = MATCH_BENCH_PORT;
+static struct timespec bot_period = { 0 }; // Bots make one decision per tick.
+static atomic_size_t connected = ATOMIC_VAR_INIT(0);
+static atomic_size_t finished = ATOMIC_VAR_INIT(0); // Bots which have failed to connect or died.
+static atomic_bool running = ATOMIC_VAR_INIT(true);
+
+static int __bot_worker(void *bot_index);
+static bool __bot_step(Bot *b);
+static unsigned long long __ticks(void);
+static uint64_t __process_cpu_time(void);
+static void __histogram_delta(MetricsHistogram *end, const MetricsHistogram *start);
+
+// Usage: morrigan_matchbench [<ticks> [<bots> [<arenas> [<tick rate> [<results.csv> | - [<landscape> [<seed>]]]]]]]
+// Server runs in process on loopback, bots use real UDP through client_protocol.c.
+// Results file is CSV for comparing runs: metric,value.
+int main(int argc, char *argv[])
+{
+    unsigned long long ticks = 1 < argc ? strtoull(argv[1], NULL, 10) : MATCH_BENCH_DEFAULT_TICKS;
+    bot_count = 2 < argc ? strtoul(argv[2], NULL, 10) : MATCH_BENCH_DEFAULT_BOTS;
+    arena_count = 3 < argc ? strtoul(argv[3], NULL, 10) : 1;
+    const char *results_path = 5 < argc && 0 != strcmp("-", argv[5]) ? argv[5] : NULL;
+
+    GameSettings settings = {
+        .arena_count         = arena_count,
+        .worker_count        = arena_count,
+        .tick_rate           = 4 < argc ? strtoul(argv[4], NULL, 10) : GAME_DEFAULT_TICK_RATE,
+        .policy              = scheduler_catch_up,
+        .seed                = 7 < argc ? strtoull(argv[7], NULL, 10) : MATCH_BENCH_DEFAULT_SEED,
+        .journal_path        = NULL,
+        .checkpoint_path     = NULL,
+        .checkpoint_interval = GAME_DEFAULT_CHECKPOINT_INTERVAL
+    };
+
+    Landscape *l = NULL;
+    bool net_started = false, server_started = false, game_started = false, client_net_started = false;
+
+    check(0 < ticks, "Bad tick count.", "");
+    check(0 < settings.tick_rate, "Bad tick rate.", "");
+    check(0 < arena_count && MAX_ARENAS >= arena_count && GAME_MAX_WORKERS >= arena_count, "Bad arena count.", "");
+    check(0 < bot_count && arena_count * MAX_CLIENTS >= bot_count, "Bad bot count. Must be in [1; %u].", (unsigned) (arena_count * MAX_CLIENTS));
+
+    uint64_t period = SCHEDULER_NSEC_PER_SEC / settings.tick_rate;
+    bot_period = (struct timespec) { .tv_sec = (time_t) (period / SCHEDULER_NSEC_PER_SEC), .tv_nsec = (long) (period % SCHEDULER_NSEC_PER_SEC) };
+
+    check(l = landscape_load(6 < argc ? argv[6] : LANDSCAPE_DEFAULT_FILE, LANDSCAPE_DEFAULT_TILE_SIZE, LANDSCAPE_DEFAULT_SCALE),
+          "Failed to load landscape.",
+          "");
+    check(net_started = net_start(port), "Failed to start network interface.", "");
+    check(server_started = server_start(), "Failed to start server.", "");
+    check(game_started = game_start(l, &settings), "Failed to start game.", "");
+    check(client_net_started = client_net_start(), "Failed to start client network.", "");
+
+    check_mem(bots = (Bot *) calloc(bot_count, sizeof(Bot)));
+    for (size_t i = 0; i < bot_count; i++)
+    {
+        bots[i].protocol = (ClientProtocol) {
+            .packets      = bot_packets,
+            .packet_count = sizeof(bot_packets) / sizeof(bot_packets[0]),
+            .s            = INVALID_SOCKET,
+            .connected    = false
+        };
+        bots[i].behaviour = (BotBehaviour) (i % bot_behaviour_count);
+        check(thrd_success == thrd_create(&bots[i].tid, __bot_worker, (void *) (uintptr_t) i), "Failed to start bot.", "");
+        bots[i].started = true;
+    }
+
+    while (atomic_load(&connected) + atomic_load(&finished) < bot_count)
+    {
+        thrd_sleep(&(struct timespec) { .tv_nsec = MATCH_BENCH_POLL_PERIOD }, NULL);
+    }
+    check(atomic_load(&connected) == bot_count, "Not all bots have connected.", "");
+
+    // Measurement starts when all bots play.
+    static MetricsHistogram start_phases[metrics_phase_count], end_phases[metrics_phase_count];
+    uint64_t start_packets_in, start_packets_out, start_bytes_in, start_bytes_out;
+    game_collect_phase_times(start_phases);
+    metrics_packet_totals(&start_packets_in, &start_packets_out, &start_bytes_in, &start_bytes_out);
+    unsigned long long start_ticks = __ticks();
+    uint64_t start_time = scheduler_now(), start_cpu = __process_cpu_time();
+
+    printf("Bots: %u, arenas: %u, tick rate: %u, seed: %llu. Running %llu ticks.\n",
+           (unsigned) bot_count,
+           (unsigned) arena_count,
+           (unsigned) settings.tick_rate,
+           (unsigned long long) settings.seed,
+           ticks);
+
+    while (__ticks() - start_ticks < ticks)
+    {
+        thrd_sleep(&(struct timespec) { .tv_nsec = MATCH_BENCH_POLL_PERIOD }, NULL);
+    }
+
+    uint64_t elapsed = scheduler_now() - start_time, cpu = __process_cpu_time() - start_cpu;
+    uint64_t packets_in, packets_out, bytes_in, bytes_out;
+    unsigned long long arena_ticks = __ticks() - start_ticks;
+    game_collect_phase_times(end_phases);
+    metrics_packet_totals(&packets_in, &packets_out, &bytes_in, &bytes_out);
+
+    for (MetricsPhase p = 0; p < metrics_phase_count; p++)
+    {
+        __histogram_delta(&end_phases[p], &start_phases[p]);
+    }
+
+    double seconds = (double) elapsed / SCHEDULER_NSEC_PER_SEC;
+    arena_ticks *= arena_count; // All arenas run at the same rate.
+
+    // name, value pairs of report.
+    struct
+    {
+        const char *name;
+        double value;
+    } report[] = {
+        { "ticks",                  (double) arena_ticks },
+        { "seconds",                seconds },
+        { "tick_p50_us",            metrics_histogram_percentile(&end_phases[metrics_phase_tick], 50.0) / 1000.0 },
+        { "tick_p90_us",            metrics_histogram_percentile(&end_phases[metrics_phase_tick], 90.0) / 1000.0 },
+        { "tick_p99_us",            metrics_histogram_percentile(&end_phases[metrics_phase_tick], 99.0) / 1000.0 },
+        { "tick_p999_us",           metrics_histogram_percentile(&end_phases[metrics_phase_tick], 99.9) / 1000.0 },
+        { "tick_mean_us",           end_phases[metrics_phase_tick].count ? (double) end_phases[metrics_phase_tick].sum / end_phases[metrics_phase_tick].count / 1000.0 : 0.0 },
+        { "cpu_per_tick_us",        arena_ticks ? (double) cpu / arena_ticks / 1000.0 : 0.0 },
+        { "packets_in_per_second",  (double) (packets_in - start_packets_in) / seconds },
+        { "packets_out_per_second", (double) (packets_out - start_packets_out) / seconds },
+        { "bytes_in_per_second",    (double) (bytes_in - start_bytes_in) / seconds },
+        { "bytes_out_per_second",   (double) (bytes_out - start_bytes_out) / seconds }
+    };
+
+    for (size_t i = 0; i < sizeof(report) / sizeof(report[0]); i++)
+    {
+        printf("%-24s %14.1f\n", report[i].name, report[i].value);
+    }
+
+    for (MetricsPhase p = metrics_phase_tick + 1; p < metrics_phase_count; p++)
+    {
+        printf("phase %-18s p50: %8.1f us, p99: %8.1f us.\n",
+               metrics_phase_name(p),
+               metrics_histogram_percentile(&end_phases[p], 50.0) / 1000.0,
+               metrics_histogram_percentile(&end_phases[p], 99.0) / 1000.0);
+    }
+
+    if (results_path)
+    {
+        FILE *f = fopen(results_path, "w");
+        check(f, "Failed to open results file %s.", results_path);
+        fprintf(f, "metric,value\n");
+        for (size_t i = 0; i < sizeof(report) / sizeof(report[0]); i++)
+        {
+            fprintf(f, "%s,%.3f\n", report[i].name, report[i].value);
+        }
+        check(0 == fclose(f), "Failed to write results.", "");
+    }
+
+    atomic_store(&running, false);
+    for (size_t i = 0; i < bot_count; i++)
+    {
+        thrd_join(bots[i].tid, NULL);
+        printf("bot %2u %-17s steps: %6llu, failures: %6llu.\n", (unsigned) i, behaviour_names[bots[i].behaviour], bots[i].steps, bots[i].failures);
+    }
+
+    free(bots);
+    client_net_stop();
+    net_stop();
+    game_stop();
+    server_stop();
+    landscape_destroy(l);
+    return EXIT_SUCCESS;
+
+    error:
+    atomic_store(&running, false);
+    if (bots)
+    {
+        for (size_t i = 0; i < bot_count; i++)
+        {
+            if (bots[i].started)
+            {
+                thrd_join(bots[i].tid, NULL);
+            }
+        }
+        free(bots);
+    }
+    if (client_net_started)
+    {
+        client_net_stop();
+    }
+    if (net_started)
+    {
+        net_stop();
+    }
+    if (game_started)
+    {
+        game_stop();
+    }
+    if (server_started)
+    {
+        server_stop();
+    }
+    if (l)
+    {
+        landscape_destroy(l);
+    }
+    return EXIT_FAILURE;
+}
+
+static int __bot_worker(void *bot_index)
+{
+    size_t i = (size_t) (uintptr_t) bot_index;
+    Bot *b = &bots[i];
+
+    if (!client_connect(&b->protocol, MATCH_BENCH_HOST, port, true, (uint8_t) (i % arena_count)))
+    {
+        log_error("Bot %u has failed to connect.", (unsigned) i);
+        atomic_fetch_add(&finished, 1);
+        return -1;
+    }
+
+    atomic_fetch_add(&connected, 1);
+
+    if (bot_circle_strafe == b->behaviour && !set_engine_power(&b->protocol, BOT_ENGINE_POWER))
+    {
+        b->failures++;
+    }
+
+    while (atomic_load(&running))
+    {
+        b->steps++;
+        bool result = __bot_step(b);
+        thrd_sleep(&bot_period, NULL);
+        if (result)
+        {
+            continue;
+        }
+
+        // Dead tanks can only leave.
+        b->failures++;
+        if (0 == tank_get_hp(&b->protocol))
+        {
+            break;
+        }
+    }
+
+    client_disconnect(&b->protocol, true);
+    return 0;
+}
+
+// One decision of bot.
+static bool __bot_step(Bot *b)
+{
+    assert(b && "Bad bot pointer.");
+
+    ClientProtocol *cp = &b->protocol;
+
+    switch (b->behaviour)
+    {
+        case bot_circle_strafe:
+            return b->steps % 2 ? turn(cp, BOT_TURN_ANGLE) : 0 <= tank_get_speed(cp);
+
+        case bot_shoot_at_nearest:
+        {
+            ResGetTanksTankRecord tanks[MAX_CLIENTS];
+            int count = tank_get_tanks(cp, tanks, MAX_CLIENTS);
+            if (0 >= count)
+            {
+                return 0 < tank_get_hp(cp);
+            }
+
+            // Positions are relative to bot.
+            Vector nearest = { .x = tanks[0].x, .y = tanks[0].y, .z = tanks[0].z };
+            for (int i = 1; i < count; i++)
+            {
+                Vector v = { .x = tanks[i].x, .y = tanks[i].y, .z = tanks[i].z };
+                if (vector_length(&v) < vector_length(&nearest))
+                {
+                    nearest = v;
+                }
+            }
+
+            VECTOR_NORMALIZE(&nearest);
+            if (!look_at(cp, &nearest))
+            {
+                return false;
+            }
+
+            shoot(cp); // Fails while gun reloads.
+            return true;
+        }
+
+        default:
+            return 0 < tank_get_hp(cp);
+    }
+}
+
+// Ticks of first arena, other arenas run at the same rate.
+static unsigned long long __ticks(void)
+{
+    Arena *a = game_get_arena(0);
+    arena_lock(a);
+    unsigned long long ticks = a->tick;
+    arena_unlock(a);
+    return ticks;
+}
+
+// In nanoseconds. Bots are counted too, but they mostly wait for responses.
+static uint64_t __process_cpu_time(void)
+{
+    #if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+
+    uint64_t k = ((uint64_t) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100; // FILETIME is in 100 ns units.
+    #else
+    return (uint64_t) clock() * (SCHEDULER_NSEC_PER_SEC / CLOCKS_PER_SEC);
+    #endif
+}
+
+// Leaves samples which were recorded after start. Maximum can't be subtracted, it's kept.
+static void __histogram_delta(MetricsHistogram *end, const MetricsHistogram *start)
+{
+    assert(end && start && "Bad histogram pointers.");
+
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        end->buckets[i] -= start->buckets[i];
+    }
+
+    end->count -= start->count;
+    end->sum -= start->sum;
+}
@@ -0,0 +1,483 @@
+// mesh.c - triangle meshes for tanks and shell events, generated without GLU.
+
+#include <assert.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+
+#include "debug.h"
+#include "mesh.h"
+#include "tank.h"
+
+static Mesh *__mesh_allocate(size_t vertex_count, size_t index_count);
+static void __set_vertex(MeshVertex *v, const Vector *position, const Vector *normal);
+static void __set_axis(Vector *v, size_t axis, double value);
+
+Mesh *mesh_create_box(const Vector *center, const Vector *extent)
+{
+    assert(center && "Bad center pointer.");
+    assert(extent && "Bad extent pointer.");
+
+    Mesh *m = NULL;
+    check_mem(m = __mesh_allocate(6 * 4, 6 * 6));
+
+    MeshVertex *v = m->vertices;
+    uint16_t *index = m->indices;
+
+    // Face normal n = s * e[a], u = e[a + 1], v = s * e[a + 2], so u x v = n
+    // and corners (u, v), (-u, v), (-u, -v), (u, -v) go counter-clockwise around n.
+    static const double corners[4][2] = { { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+    const double extents[3] = { extent->x, extent->y, extent->z };
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        for (int sign = 1; sign >= -1; sign -= 2)
+        {
+            size_t first = (size_t) (v - m->vertices),
+                   u_axis = (axis + 1) % 3,
+                   v_axis = (axis + 2) % 3;
+            Vector normal = { 0 };
+            __set_axis(&normal, axis, sign);
+
+            for (size_t c = 0; c < 4; c++)
+            {
+                Vector offset = { 0 }, position;
+                __set_axis(&offset, axis, sign * extents[axis]);
+                __set_axis(&offset, u_axis, corners[c][0] * extents[u_axis]);
+                __set_axis(&offset, v_axis, sign * corners[c][1] * extents[v_axis]);
+                vector_add(center, &offset, &position);
+
+                __set_vertex(v++, &position, &normal);
+            }
+
+            static const uint16_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+            for (size_t i = 0; i < 6; i++)
+            {
+                *index++ = (uint16_t) (first + quad[i]);
+            }
+        }
+    }
+
+    return m;
+
+    error:
+    return NULL;
+}
+
+Mesh *mesh_create_sphere(const Vector *center, double radius, size_t slices, size_t stacks)
+{
+    assert(center && "Bad center pointer.");
+    assert(0.0 < radius && "Bad radius.");
+    assert(3 <= slices && 2 <= stacks && "Bad tessellation.");
+
+    Mesh *m = NULL;
+    // Pole rows have one triangle per slice.
+    check_mem(m = __mesh_allocate((stacks + 1) * (slices + 1), 3 * slices * (2 * stacks - 2)));
+
+    // Stack i goes from north pole, slice j goes counter-clockwise around z, seam vertices are doubled.
+    for (size_t i = 0; i <= stacks; i++)
+    {
+        double phi = M_PI * i / stacks;
+
+        for (size_t j = 0; j <= slices; j++)
+        {
+            double theta = 2.0 * M_PI * j / slices;
+            Vector normal = { .x = sin(phi) * cos(theta), .y = sin(phi) * sin(theta), .z = cos(phi) },
+                   position;
+
+            vector_scale(&normal, radius, &position);
+            VECTOR_ADD(&position, center);
+            __set_vertex(&m->vertices[i * (slices + 1) + j], &position, &normal);
+        }
+    }
+
+    uint16_t *index = m->indices;
+    for (size_t i = 0; i < stacks; i++)
+    {
+        for (size_t j = 0; j < slices; j++)
+        {
+            uint16_t a = (uint16_t) (i * (slices + 1) + j),
+                     b = (uint16_t) (a + slices + 1),
+                     c = (uint16_t) (b + 1),
+                     d = (uint16_t) (a + 1);
+
+            if (stacks - 1 != i)
+            {
+                *index++ = a;
+                *index++ = b;
+                *index++ = c;
+            }
+
+            if (0 != i)
+            {
+                *index++ = a;
+                *index++ = c;
+                *index++ = d;
+            }
+        }
+    }
+
+    assert((size_t) (index - m->indices) == m->index_count && "Bad sphere index count.");
+    return m;
+
+    error:
+    return NULL;
+}
+
+Mesh *mesh_create_cylinder(double radius, double length, size_t slices)
+{
+    assert(0.0 < radius && "Bad radius.");
+    assert(0.0 < length && "Bad length.");
+    assert(3 <= slices && "Bad tessellation.");
+
+    Mesh *m = NULL;
+    // Side: near and far rings. Cap: center and its own ring, as its normal differs.
+    check_mem(m = __mesh_allocate(3 * (slices + 1) + 1, 3 * slices * 3));
+
+    size_t near_ring = 0,
+           far_ring = slices + 1,
+           cap_ring = 2 * (slices + 1),
+           cap_center = 3 * (slices + 1);
+
+    Vector axis = { .x = 1.0, .y = 0.0, .z = 0.0 },
+           far_center = { .x = length, .y = 0.0, .z = 0.0 };
+
+    for (size_t j = 0; j <= slices; j++)
+    {
+        double theta = 2.0 * M_PI * j / slices;
+        Vector normal = { .x = 0.0, .y = cos(theta), .z = sin(theta) },
+               position;
+
+        vector_scale(&normal, radius, &position);
+        __set_vertex(&m->vertices[near_ring + j], &position, &normal);
+        position.x = length;
+        __set_vertex(&m->vertices[far_ring + j], &position, &normal);
+        __set_vertex(&m->vertices[cap_ring + j], &position, &axis);
+    }
+
+    __set_vertex(&m->vertices[cap_center], &far_center, &axis);
+
+    uint16_t *index = m->indices;
+    for (size_t j = 0; j < slices; j++)
+    {
+        uint16_t a = (uint16_t) (near_ring + j),
+                 b = (uint16_t) (a + 1),
+                 c = (uint16_t) (far_ring + j + 1),
+                 d = (uint16_t) (far_ring + j);
+
+        *index++ = a;
+        *index++ = b;
+        *index++ = c;
+        *index++ = a;
+        *index++ = c;
+        *index++ = d;
+
+        *index++ = (uint16_t) cap_center;
+        *index++ = (uint16_t) (cap_ring + j);
+        *index++ = (uint16_t) (cap_ring + j + 1);
+    }
+
+    return m;
+
+    error:
+    return NULL;
+}
+
+void mesh_destroy(Mesh *m)
+{
+    assert(m && "Nothing to destroy.");
+    free(m->vertices);
+    free(m->indices);
+    free(m);
+}
+
+void mesh_transform(const Mesh *m, const MeshTransform *t, MeshVertex *result)
+{
+    assert(m && "Bad mesh pointer.");
+    assert(t && "Bad transform pointer.");
+    assert(result && "Bad result pointer.");
+
+    const double (*r)[3] = t->rotation.values;
+
+    for (size_t i = 0; i < m->vertex_count; i++)
+    {
+        const MeshVertex *v = &m->vertices[i];
+        MeshVertex *o = &result[i];
+
+        o->x = (float) (r[0][0] * v->x + r[0][1] * v->y + r[0][2] * v->z + t->translation.x);
+        o->y = (float) (r[1][0] * v->x + r[1][1] * v->y + r[1][2] * v->z + t->translation.y);
+        o->z = (float) (r[2][0] * v->x + r[2][1] * v->y + r[2][2] * v->z + t->translation.z);
+        o->nx = (float) (r[0][0] * v->nx + r[0][1] * v->ny + r[0][2] * v->nz);
+        o->ny = (float) (r[1][0] * v->nx + r[1][1] * v->ny + r[1][2] * v->nz);
+        o->nz = (float) (r[2][0] * v->nx + r[2][1] * v->ny + r[2][2] * v->nz);
+    }
+}
+
+// Same shapes and placement as former GLU display lists: body box stands on tank's origin,
+// turret sphere is on top of it, gun starts half turret radius above turret center.
+Mesh *mesh_create_tank_part(size_t part)
+{
+    assert(TANK_MESH_PARTS > part && "Bad tank part.");
+
+    static const Vector extent = TANK_BOUNDING_BOX_EXTENT;
+
+    switch (part)
+    {
+        case TANK_MESH_BODY:
+        {
+            Vector center = { .x = 0.0, .y = 0.0, .z = extent.z };
+            return mesh_create_box(&center, &extent);
+        }
+
+        case TANK_MESH_TURRET:
+        {
+            Vector center = { .x = MESH_TURRET_OFFSET, .y = 0.0, .z = 2.0 * extent.z };
+            return mesh_create_sphere(&center, TANK_BOUNDING_SPHERE_RADIUS, MESH_SPHERE_SLICES, MESH_SPHERE_STACKS);
+        }
+
+        default:
+            return mesh_create_cylinder(MESH_GUN_RADIUS, TANK_GUN_LENGTH, MESH_GUN_SLICES);
+    }
+}
+
+void mesh_get_tank_transforms(const ResGetTanksTankRecord *tank, MeshTransform *body, MeshTransform *gun)
+{
+    assert(tank && "Bad tank pointer.");
+    assert(body && "Bad body transform pointer.");
+    assert(gun && "Bad gun transform pointer.");
+
+    static const Vector extent = TANK_BOUNDING_BOX_EXTENT;
+
+    Vector direction   = { .x = tank->direction_x,   .y = tank->direction_y,   .z = tank->direction_z   },
+           orientation = { .x = tank->orientation_x, .y = tank->orientation_y, .z = tank->orientation_z },
+           side;
+
+    VECTOR_NORMALIZE(&direction);
+    VECTOR_NORMALIZE(&orientation);
+    vector_vector_mul(&orientation, &direction, &side);
+    VECTOR_NORMALIZE(&side);
+
+    // Columns are tank's axes in world.
+    Matrix tank_rotation = { .values = {
+        { direction.x, side.x, orientation.x },
+        { direction.y, side.y, orientation.y },
+        { direction.z, side.z, orientation.z }
+    } };
+
+    body->rotation = tank_rotation;
+    body->translation.x = tank->x;
+    body->translation.y = tank->y;
+    body->translation.z = tank->z;
+
+    // Turret direction is applied in tank's space, as viewer always did.
+    Vector default_look = { .x = 1, .y = 0, .z = 0 },
+           look         = { .x = tank->turret_x, .y = tank->turret_y, .z = tank->turret_z },
+           gun_origin   = { .x = MESH_TURRET_OFFSET, .y = 0.0, .z = 2.0 * extent.z + TANK_BOUNDING_SPHERE_RADIUS / 2.0 };
+
+    gun->rotation = tank_rotation;
+    if (0 != memcmp(&default_look, &look, sizeof(Vector)))
+    {
+        Vector look_side, top;
+        vector_get_orthogonal(&look, &look_side);
+        VECTOR_NORMALIZE(&look_side);
+        vector_vector_mul(&look, &look_side, &top);
+        VECTOR_NORMALIZE(&top);
+
+        Matrix turret_rotation = { .values = {
+            { look.x, look_side.x, top.x },
+            { look.y, look_side.y, top.y },
+            { look.z, look_side.z, top.z }
+        } };
+
+        MATRIX_MATRIX_MUL(&gun->rotation, &turret_rotation);
+    }
+
+    matrix_vector_mul(&tank_rotation, &gun_origin, &gun->translation);
+    VECTOR_ADD(&gun->translation, &body->translation);
+}
+
+static Mesh *__mesh_allocate(size_t vertex_count, size_t index_count)
+{
+    assert(UINT16_MAX >= vertex_count && "Too many vertices.");
+
+    Mesh *m = NULL;
+    check_mem(m = (Mesh *) calloc(1, sizeof(Mesh)));
+    check_mem(m->vertices = (MeshVertex *) malloc(vertex_count * sizeof(MeshVertex)));
+    check_mem(m->indices = (uint16_t *) malloc(index_count * sizeof(uint16_t)));
+    m->vertex_count = vertex_count;
+    m->index_count = index_count;
+    return m;
+
+    error:
+    if (m)
+    {
+        free(m->vertices);
+        free(m);
+    }
+
+    return NULL;
+}
+
+static void __set_vertex(MeshVertex *v, const Vector *position, const Vector *normal)
+{
+    v->x = (float) position->x;
+    v->y = (float) position->y;
+    v->z = (float) position->z;
+    v->nx = (float) normal->x;
+    v->ny = (float) normal->y;
+    v->nz = (float) normal->z;
+}
+
+static void __set_axis(Vector *v, size_t axis, double value)
+{
+    switch (axis)
+    {
+        case 0:  v->x = value; break;
+        case 1:  v->y = value; break;
+        default: v->z = value; break;
+    }
+}
+
+#if defined(MESH_TESTS)
+#include <stdio.h>
+
+#include "testhelp.h"
+
+// Every non degenerate triangle is counter-clockwise seen from outside, i.e. agrees with its vertices' normals.
+static bool __is_outward(const Mesh *m)
+{
+    for (size_t i = 0; i < m->index_count; i += 3)
+    {
+        const MeshVertex *a = &m->vertices[m->indices[i]],
+                         *b = &m->vertices[m->indices[i + 1]],
+                         *c = &m->vertices[m->indices[i + 2]];
+
+        Vector ab = { .x = b->x - a->x, .y = b->y - a->y, .z = b->z - a->z },
+               ac = { .x = c->x - a->x, .y = c->y - a->y, .z = c->z - a->z },
+               n  = { .x = a->nx + b->nx + c->nx, .y = a->ny + b->ny + c->ny, .z = a->nz + b->nz + c->nz },
+               cross;
+
+        vector_vector_mul(&ab, &ac, &cross);
+        if (1e-9 > vector_length(&cross) || 0.0 >= vector_mul(&cross, &n))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool __indices_in_range(const Mesh *m)
+{
+    for (size_t i = 0; i < m->index_count; i++)
+    {
+        if (m->vertex_count <= m->indices[i])
+        {
+            return false;
+        }
+    }
+
+    return 0 == m->index_count % 3;
+}
+
+static bool __float_eq(double a, double b)
+{
+    return 1e-5 > fabs(a - b);
+}
+
+int main(void)
+{
+    Vector center = { .x = 1.0, .y = 2.0, .z = 3.0 },
+           extent = { .x = 10.0, .y = 6.0, .z = 2.0 };
+
+    Mesh *box = mesh_create_box(&center, &extent);
+    test_cond("Box.", box && 24 == box->vertex_count && 36 == box->index_count && __indices_in_range(box));
+    test_cond("Box is outward.", __is_outward(box));
+
+    bool on_faces = true;
+    for (size_t i = 0; i < box->vertex_count; i++)
+    {
+        const MeshVertex *v = &box->vertices[i];
+        on_faces = on_faces &&
+                   __float_eq(fabs(v->x - center.x), extent.x) &&
+                   __float_eq(fabs(v->y - center.y), extent.y) &&
+                   __float_eq(fabs(v->z - center.z), extent.z);
+    }
+    test_cond("Box corners.", on_faces);
+
+    Mesh *sphere = mesh_create_sphere(&center, 3.75, MESH_SPHERE_SLICES, MESH_SPHERE_STACKS);
+    test_cond("Sphere.", sphere && __indices_in_range(sphere));
+    test_cond("Sphere is outward.", __is_outward(sphere));
+
+    bool on_sphere = true;
+    for (size_t i = 0; i < sphere->vertex_count; i++)
+    {
+        const MeshVertex *v = &sphere->vertices[i];
+        Vector r = { .x = v->x - center.x, .y = v->y - center.y, .z = v->z - center.z },
+               n = { .x = v->nx, .y = v->ny, .z = v->nz };
+        on_sphere = on_sphere && __float_eq(vector_length(&r), 3.75) && __float_eq(vector_mul(&r, &n), 3.75);
+    }
+    test_cond("Sphere vertices and normals.", on_sphere);
+
+    Mesh *cylinder = mesh_create_cylinder(0.25, 15.0, MESH_GUN_SLICES);
+    test_cond("Cylinder.", cylinder && __indices_in_range(cylinder));
+    test_cond("Cylinder is outward.", __is_outward(cylinder));
+
+    double max_x = 0.0;
+    for (size_t i = 0; i < cylinder->vertex_count; i++)
+    {
+        max_x = fmax(max_x, cylinder->vertices[i].x);
+    }
+    test_cond("Cylinder length.", __float_eq(15.0, max_x));
+
+    bool parts = true;
+    for (size_t part = 0; part < TANK_MESH_PARTS; part++)
+    {
+        Mesh *m = mesh_create_tank_part(part);
+        parts = parts && m && __is_outward(m);
+        if (m)
+        {
+            mesh_destroy(m);
+        }
+    }
+    test_cond("Tank parts.", parts);
+
+    // Tank looking along y, standing on xz plane, turret looking along its x.
+    ResGetTanksTankRecord tank = {
+        .x = 100.0, .y = 200.0, .z = 10.0,
+        .direction_x = 0.0, .direction_y = 1.0, .direction_z = 0.0,
+        .orientation_x = 0.0, .orientation_y = 0.0, .orientation_z = 1.0,
+        .turret_x = 1.0, .turret_y = 0.0, .turret_z = 0.0
+    };
+
+    MeshTransform body, gun;
+    mesh_get_tank_transforms(&tank, &body, &gun);
+
+    MeshVertex moved[24];
+    mesh_transform(box, &body, moved);
+    // Box vertex 0: +x face, corner (+y, +z) relative to center.
+    test_cond("Transform position.",
+              __float_eq(100.0 - 8.0, moved[0].x) && __float_eq(200.0 + 11.0, moved[0].y) && __float_eq(10.0 + 5.0, moved[0].z));
+    test_cond("Transform normal.", __float_eq(0.0, moved[0].nx) && __float_eq(1.0, moved[0].ny) && __float_eq(0.0, moved[0].nz));
+    test_cond("Gun origin.",
+              __float_eq(100.0, gun.translation.x) &&
+              __float_eq(200.0 + MESH_TURRET_OFFSET, gun.translation.y) &&
+              __float_eq(10.0 + 4.0 + 3.75 / 2.0, gun.translation.z));
+
+    // Turret turned to tank's left, gun must point along -x in world.
+    tank.turret_x = 0.0;
+    tank.turret_y = 1.0;
+    mesh_get_tank_transforms(&tank, &body, &gun);
+    Vector muzzle = { .x = 1.0, .y = 0.0, .z = 0.0 };
+    MATRIX_VECTOR_MUL(&gun.rotation, &muzzle);
+    test_cond("Gun rotation.", __float_eq(-1.0, muzzle.x) && __float_eq(0.0, muzzle.y) && __float_eq(0.0, muzzle.z));
+
+    mesh_destroy(box);
+    mesh_destroy(sphere);
+    mesh_destroy(cylinder);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
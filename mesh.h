@@ -0,0 +1,75 @@
+// mesh.h - triangle meshes for tanks and shell events, generated without GLU.
+
+#pragma once
+#ifndef __MESH_H__
+#define __MESH_H__
+
+//#pragma message("__MESH_H__")
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "morrigan.h"
+#include "vector.h"
+#include "matrix.h"
+#include "protocol.h"
+
+#define MESH_SPHERE_SLICES 16
+#define MESH_SPHERE_STACKS 12
+#define MESH_GUN_SLICES 8
+#define MESH_GUN_RADIUS 0.25
+#define MESH_TURRET_OFFSET 2.0 // Turret is ahead of body center.
+
+// Parts sharing one tank's transform are drawn one after another.
+#define TANK_MESH_BODY   0
+#define TANK_MESH_TURRET 1
+#define TANK_MESH_GUN    2 // Has its own transform, turret may look anywhere.
+#define TANK_MESH_PARTS  3
+
+#pragma pack(push, 4)
+
+// Interleaved as expected by glVertexPointer() / glNormalPointer().
+typedef struct MeshVertex
+{
+    float x, y, z;
+    float nx, ny, nz;
+} MeshVertex;
+
+#pragma pack(pop)
+
+#pragma pack(push, 8)
+
+// Triangles are counter-clockwise seen from outside.
+typedef struct Mesh
+{
+    size_t vertex_count;
+    MeshVertex *vertices;
+    size_t index_count;
+    uint16_t *indices;
+} Mesh;
+
+// result = rotation * v + translation. Rotation is orthonormal, so it's applied to normals as is.
+typedef struct MeshTransform
+{
+    Matrix rotation;
+    Vector translation;
+} MeshTransform;
+
+#pragma pack(pop)
+
+Mesh *mesh_create_box(const Vector *center, const Vector *extent);
+Mesh *mesh_create_sphere(const Vector *center, double radius, size_t slices, size_t stacks);
+// Along x axis from origin, closed at far end.
+Mesh *mesh_create_cylinder(double radius, double length, size_t slices);
+void mesh_destroy(Mesh *m);
+
+// Writes m->vertex_count vertices.
+void mesh_transform(const Mesh *m, const MeshTransform *t, MeshVertex *result);
+
+// Part in its transform's space, as given by mesh_get_tank_transforms().
+Mesh *mesh_create_tank_part(size_t part);
+// Body and turret share body transform, gun is placed by gun transform.
+void mesh_get_tank_transforms(const ResGetTanksTankRecord *tank, MeshTransform *body, MeshTransform *gun);
+
+#endif /* __MESH_H__ */
@@ -0,0 +1,322 @@
+// metrics.c - tick phase histograms and server counters.
+
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "protocol.h"
+#include "metrics.h"
+
+static atomic_uint_fast64_t packets_in[METRICS_PACKET_TYPES];
+static atomic_uint_fast64_t packets_out[METRICS_PACKET_TYPES];
+static atomic_uint_fast64_t bytes_in;
+static atomic_uint_fast64_t bytes_out;
+static atomic_uint_fast64_t lock_waits[metrics_lock_count];     // Contended acquisitions.
+static atomic_uint_fast64_t lock_wait_time[metrics_lock_count]; // In nanoseconds.
+
+static const char *lock_names[metrics_lock_count] = { "global", "arena" };
+
+static size_t __bucket_index(uint64_t value);
+static uint64_t __bucket_upper_bound(size_t index);
+
+void metrics_histogram_record(MetricsHistogram *h, uint64_t value)
+{
+    assert(h && "Bad histogram pointer.");
+
+    h->buckets[__bucket_index(value)]++;
+    h->count++;
+    h->sum += value;
+    h->max = max(h->max, value);
+}
+
+void metrics_histogram_merge(MetricsHistogram *dst, const MetricsHistogram *src)
+{
+    assert(dst && "Bad destination histogram pointer.");
+    assert(src && "Bad source histogram pointer.");
+
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        dst->buckets[i] += src->buckets[i];
+    }
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->max = max(dst->max, src->max);
+}
+
+uint64_t metrics_histogram_percentile(const MetricsHistogram *h, double percentile)
+{
+    assert(h && "Bad histogram pointer.");
+    assert(0.0 <= percentile && 100.0 >= percentile && "Bad percentile.");
+
+    if (0 == h->count)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t) ceil(percentile / 100.0 * (double) h->count), seen = 0;
+    rank = max(rank, 1);
+
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            return min(__bucket_upper_bound(i), h->max);
+        }
+    }
+
+    return h->max;
+}
+
+void metrics_packet_in(uint8_t id, size_t size)
+{
+    atomic_fetch_add_explicit(&packets_in[id], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes_in, size, memory_order_relaxed);
+}
+
+void metrics_packet_out(uint8_t id, size_t size)
+{
+    atomic_fetch_add_explicit(&packets_out[id], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes_out, size, memory_order_relaxed);
+}
+
+void metrics_lock_wait(MetricsLock lock, uint64_t wait_time)
+{
+    assert(lock < metrics_lock_count && "Bad lock.");
+
+    atomic_fetch_add_explicit(&lock_waits[lock], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lock_wait_time[lock], wait_time, memory_order_relaxed);
+}
+
+void metrics_packet_totals(uint64_t *packets_in_total, uint64_t *packets_out_total, uint64_t *bytes_in_total, uint64_t *bytes_out_total)
+{
+    assert(packets_in_total && packets_out_total && "Bad packet total pointers.");
+    assert(bytes_in_total && bytes_out_total && "Bad byte total pointers.");
+
+    *packets_in_total = 0;
+    *packets_out_total = 0;
+    for (size_t i = 0; i < METRICS_PACKET_TYPES; i++)
+    {
+        *packets_in_total += atomic_load_explicit(&packets_in[i], memory_order_relaxed);
+        *packets_out_total += atomic_load_explicit(&packets_out[i], memory_order_relaxed);
+    }
+
+    *bytes_in_total = atomic_load_explicit(&bytes_in, memory_order_relaxed);
+    *bytes_out_total = atomic_load_explicit(&bytes_out, memory_order_relaxed);
+}
+
+size_t metrics_format(char *buffer, size_t size, const MetricsHistogram *phases)
+{
+    assert(buffer && "Bad buffer pointer.");
+    assert(size && "Bad buffer size.");
+    assert(phases && "Bad phase histograms pointer.");
+
+    static const double quantiles[] = { 50.0, 90.0, 99.0, 99.9 };
+    size_t length = 0;
+    buffer[0] = '\0';
+
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_tick_phase_ns summary\n");
+    for (MetricsPhase p = 0; p < metrics_phase_count; p++)
+    {
+        const MetricsHistogram *h = &phases[p];
+        const char *name = metrics_phase_name(p);
+
+        for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++)
+        {
+            length = metrics_append(buffer, size, length, "morrigan_tick_phase_ns{phase=\"%s\",quantile=\"%g\"} %llu\n",
+                                    name,
+                                    quantiles[i] / 100.0,
+                                    (unsigned long long) metrics_histogram_percentile(h, quantiles[i]));
+        }
+
+        length = metrics_append(buffer, size, length, "morrigan_tick_phase_ns_sum{phase=\"%s\"} %llu\n", name, (unsigned long long) h->sum);
+        length = metrics_append(buffer, size, length, "morrigan_tick_phase_ns_count{phase=\"%s\"} %llu\n", name, (unsigned long long) h->count);
+        length = metrics_append(buffer, size, length, "morrigan_tick_phase_ns_max{phase=\"%s\"} %llu\n", name, (unsigned long long) h->max);
+    }
+
+    // Only packet types which have been seen.
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_packets_in_total counter\n");
+    for (size_t i = 0; i < METRICS_PACKET_TYPES; i++)
+    {
+        uint64_t count = atomic_load_explicit(&packets_in[i], memory_order_relaxed);
+        if (count)
+        {
+            length = metrics_append(buffer, size, length, "morrigan_packets_in_total{type=\"0x%02x\"} %llu\n", (unsigned) i, (unsigned long long) count);
+        }
+    }
+
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_packets_out_total counter\n");
+    for (size_t i = 0; i < METRICS_PACKET_TYPES; i++)
+    {
+        uint64_t count = atomic_load_explicit(&packets_out[i], memory_order_relaxed);
+        if (count)
+        {
+            length = metrics_append(buffer, size, length, "morrigan_packets_out_total{type=\"0x%02x\"} %llu\n", (unsigned) i, (unsigned long long) count);
+        }
+    }
+
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_bytes_in_total counter\nmorrigan_bytes_in_total %llu\n",
+                            (unsigned long long) atomic_load_explicit(&bytes_in, memory_order_relaxed));
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_bytes_out_total counter\nmorrigan_bytes_out_total %llu\n",
+                            (unsigned long long) atomic_load_explicit(&bytes_out, memory_order_relaxed));
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_wait_rejections_total counter\nmorrigan_wait_rejections_total %llu\n",
+                            (unsigned long long) atomic_load_explicit(&packets_out[res_wait], memory_order_relaxed));
+
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_lock_waits_total counter\n");
+    for (MetricsLock l = 0; l < metrics_lock_count; l++)
+    {
+        length = metrics_append(buffer, size, length, "morrigan_lock_waits_total{lock=\"%s\"} %llu\n",
+                                lock_names[l],
+                                (unsigned long long) atomic_load_explicit(&lock_waits[l], memory_order_relaxed));
+    }
+
+    length = metrics_append(buffer, size, length, "# TYPE morrigan_lock_wait_ns_total counter\n");
+    for (MetricsLock l = 0; l < metrics_lock_count; l++)
+    {
+        length = metrics_append(buffer, size, length, "morrigan_lock_wait_ns_total{lock=\"%s\"} %llu\n",
+                                lock_names[l],
+                                (unsigned long long) atomic_load_explicit(&lock_wait_time[l], memory_order_relaxed));
+    }
+
+    return length;
+}
+
+const char *metrics_phase_name(MetricsPhase phase)
+{
+    static const char *names[metrics_phase_count] = {
+        "tick",
+        "tanks",
+        "shells",
+        "tank_collisions",
+        "shell_collisions",
+        "record"
+    };
+
+    assert(phase < metrics_phase_count && "Bad phase.");
+    return names[phase];
+}
+
+size_t metrics_append(char *buffer, size_t size, size_t length, const char *format, ...)
+{
+    if (length + 1 >= size)
+    {
+        return length;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+
+    if (0 > written)
+    {
+        return length;
+    }
+
+    return min(length + (size_t) written, size - 1);
+}
+
+// Values below METRICS_SUB_BUCKETS have own buckets. Larger ones are shifted, so that
+// METRICS_SUB_BUCKET_BITS + 1 high bits are left: leading one selects power of two, others select sub-bucket.
+static size_t __bucket_index(uint64_t value)
+{
+    if (value < METRICS_SUB_BUCKETS)
+    {
+        return (size_t) value;
+    }
+
+    size_t shift = 0;
+    while ((value >> shift) >= 2 * METRICS_SUB_BUCKETS)
+    {
+        shift++;
+    }
+
+    return (shift + 1) * METRICS_SUB_BUCKETS + (size_t) ((value >> shift) - METRICS_SUB_BUCKETS);
+}
+
+static uint64_t __bucket_upper_bound(size_t index)
+{
+    if (index < METRICS_SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    size_t shift = index / METRICS_SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t) (METRICS_SUB_BUCKETS + index % METRICS_SUB_BUCKETS) << shift;
+    return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+#if defined(METRICS_TESTS)
+#include <string.h>
+
+#include "testhelp.h"
+
+int main(void)
+{
+    MetricsHistogram h = { 0 };
+
+    test_cond("Empty histogram.", 0 == metrics_histogram_percentile(&h, 50.0));
+
+    bool exact = true;
+    for (uint64_t i = 0; i < METRICS_SUB_BUCKETS; i++)
+    {
+        exact = exact && i == __bucket_upper_bound(__bucket_index(i));
+    }
+    test_cond("Small values are exact.", exact);
+
+    bool bounded = true;
+    for (uint64_t v = 8; v < 1000000; v = v * 3 / 2 + 1)
+    {
+        uint64_t upper = __bucket_upper_bound(__bucket_index(v));
+        bounded = bounded && v <= upper && upper - v <= v / METRICS_SUB_BUCKETS;
+    }
+    test_cond("Bucket precision.", bounded);
+    test_cond("Largest value has bucket.", METRICS_HISTOGRAM_BUCKETS - 1 == __bucket_index(UINT64_MAX));
+
+    for (uint64_t i = 1; i <= 1000; i++)
+    {
+        metrics_histogram_record(&h, i * 1000);
+    }
+
+    uint64_t median = metrics_histogram_percentile(&h, 50.0);
+    test_cond("Check count, sum and max.", 1000 == h.count && 500500000 == h.sum && 1000000 == h.max);
+    test_cond("Check median.", 500000 <= median && 500000 + 500000 / METRICS_SUB_BUCKETS >= median);
+    test_cond("Check top percentile.", 1000000 == metrics_histogram_percentile(&h, 100.0));
+
+    MetricsHistogram merged = { 0 };
+    metrics_histogram_merge(&merged, &h);
+    metrics_histogram_merge(&merged, &h);
+    test_cond("Merge histograms.", 2000 == merged.count && median == metrics_histogram_percentile(&merged, 50.0));
+
+    metrics_packet_in(0x10, 9);
+    metrics_packet_out(res_wait, 1);
+    metrics_lock_wait(metrics_lock_arena, 1500);
+
+    MetricsHistogram phases[metrics_phase_count] = { 0 };
+    phases[metrics_phase_tanks] = h;
+    char report[METRICS_REPORT_SIZE];
+    size_t length = metrics_format(report, sizeof(report), phases);
+    test_cond("Report length.", strlen(report) == length);
+    test_cond("Report phases.", NULL != strstr(report, "morrigan_tick_phase_ns_count{phase=\"tanks\"} 1000\n"));
+    test_cond("Report packets.",
+              NULL != strstr(report, "morrigan_packets_in_total{type=\"0x10\"} 1\n") &&
+              NULL != strstr(report, "morrigan_bytes_in_total 9\n") &&
+              NULL != strstr(report, "morrigan_wait_rejections_total 1\n"));
+    uint64_t total_in, total_out, total_bytes_in, total_bytes_out;
+    metrics_packet_totals(&total_in, &total_out, &total_bytes_in, &total_bytes_out);
+    test_cond("Packet totals.", 1 == total_in && 1 == total_out && 9 == total_bytes_in && 1 == total_bytes_out);
+    test_cond("Report locks.", NULL != strstr(report, "morrigan_lock_wait_ns_total{lock=\"arena\"} 1500\n"));
+
+    char small[64];
+    test_cond("Report is cut.", sizeof(small) - 1 == metrics_format(small, sizeof(small), phases));
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
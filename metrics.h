@@ -0,0 +1,75 @@
+// metrics.h - tick phase histograms and server counters.
+
+#pragma once
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+//#pragma message("__METRICS_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "morrigan.h"
+
+// Log-linear buckets: each power of two is split into 2 ^ METRICS_SUB_BUCKET_BITS buckets,
+// so recorded value is known with 1 / 8 relative precision.
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_HISTOGRAM_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+#define METRICS_PACKET_TYPES 256
+#define METRICS_REPORT_SIZE 32768
+
+typedef enum MetricsPhase
+{
+    metrics_phase_tick,             // Whole tick.
+    metrics_phase_tanks,            // Tank integration and bound checks.
+    metrics_phase_shells,           // Shell integration, terrain raycast.
+    metrics_phase_tank_collisions,
+    metrics_phase_shell_collisions, // Shell hits, explosions and their notifications.
+    metrics_phase_record,           // Journal and checkpoint.
+    metrics_phase_count
+} MetricsPhase;
+
+typedef enum MetricsLock
+{
+    metrics_lock_global,
+    metrics_lock_arena,
+    metrics_lock_count
+} MetricsLock;
+
+#pragma pack(push, 8)
+
+// Nanoseconds.
+typedef struct MetricsHistogram
+{
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} MetricsHistogram;
+
+#pragma pack(pop)
+
+// Histograms aren't synchronized: each one has single writer (arena's histograms are written under arena lock).
+void metrics_histogram_record(MetricsHistogram *h, uint64_t value);
+void metrics_histogram_merge(MetricsHistogram *dst, const MetricsHistogram *src);
+// Highest value of bucket which holds given percentile, in [0; 100].
+uint64_t metrics_histogram_percentile(const MetricsHistogram *h, double percentile);
+
+// Counters are atomic, may be called from any thread.
+void metrics_packet_in(uint8_t id, size_t size);
+void metrics_packet_out(uint8_t id, size_t size);
+void metrics_lock_wait(MetricsLock lock, uint64_t wait_time);
+
+// Totals of all packet types since start.
+void metrics_packet_totals(uint64_t *packets_in_total, uint64_t *packets_out_total, uint64_t *bytes_in_total, uint64_t *bytes_out_total);
+
+// Text report in Prometheus exposition format. Returns report length.
+size_t metrics_format(char *buffer, size_t size, const MetricsHistogram *phases);
+
+// Appends to report of given length, report is cut if buffer is too small. Returns new length.
+size_t metrics_append(char *buffer, size_t size, size_t length, const char *format, ...);
+const char *metrics_phase_name(MetricsPhase phase);
+
+#endif /* __METRICS_H__ */
@@ -10,6 +10,9 @@
 #include "debug.h"
 #include "protocol.h"
 #include "server.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "trace.h"
 
 static thrd_t worker_tid;
 static volatile bool working = false;
@@ -48,8 +51,8 @@ bool net_start(unsigned short port)
 
     error:
     closesocket(s);
+    s = INVALID_SOCKET;
     WSACleanup();
-    thrd_detach(worker_tid);
     return false;
 }
 
@@ -84,9 +87,16 @@ static int __net_worker(void *unused)
             continue;
         }
 
+        // Span includes global lock wait.
+        uint64_t start = trace_enabled() ? scheduler_now() : 0;
         get_global_lock();
         handle_packet(buf, res, &sender_address);
         release_global_lock();
+
+        if (start)
+        {
+            trace_packet("handle_packet", start, scheduler_now(), (uint8_t) buf[0], &sender_address);
+        }
     }
 
     return 0;
@@ -97,19 +107,31 @@ void net_stop(void)
     fprintf(stderr, "net_stop start.\n");
     working = false;
     notify_shutdown();
-    shutdown(s, SD_RECEIVE);
-    closesocket(s);
-    thrd_join(worker_tid, NULL);
-    thrd_detach(worker_tid);
-    WSACleanup();
+
+    // Game may fail to start before network does.
+    if (INVALID_SOCKET != s)
+    {
+        shutdown(s, SD_RECEIVE);
+        closesocket(s);
+        s = INVALID_SOCKET;
+        thrd_join(worker_tid, NULL);
+        thrd_detach(worker_tid);
+        WSACleanup();
+    }
     fprintf(stderr, "net_stop end.\n");
 }
 
 void respond(const char *data, size_t data_length, const SOCKADDR *to)
 {
+    metrics_packet_out((uint8_t) data[0], data_length);
+    uint64_t start = trace_enabled() ? scheduler_now() : 0;
     check(SOCKET_ERROR != sendto(s, data, data_length, 0, to, sizeof(*to)),
           "Failed to send response to client. Error: %d.",
            WSAGetLastError());
     error:
+    if (start)
+    {
+        trace_packet("respond", start, scheduler_now(), (uint8_t) data[0], to);
+    }
     return;
 }
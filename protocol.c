@@ -11,8 +11,10 @@
 #include "protocol_utils.h"
 #include "server.h"
 #include "game.h"
+#include "arena.h"
 #include "landscape.h"
 #include "debug.h"
+#include "metrics.h"
 
 static void __packet_processor(NetworkClient *c,
                                const SOCKADDR *address,
@@ -22,9 +24,13 @@ static void __packet_processor(NetworkClient *c,
                                const PacketDefinition *packet_definition,
                                uint8_t hello_packet);
 static bool __check_double(double v, double min, double max);
+static size_t __get_requested_arena(const NetworkClient *c);
+static void __journal_command(const Client *c);
 
 // Connecting.
 static bool __req_hello_executor(Client *c);
+static bool __req_hello_validator(const void *packet, size_t packet_size);
+
 static bool __req_bye_executor(Client *c);
 static bool __req_viewer_hello_executor(ViewerClient *c);
 static bool __req_viewer_bye_executor(ViewerClient *c);
@@ -37,6 +43,9 @@ static bool __req_turn_validator(const void *packet, size_t packet_size);
 static bool __req_look_at_executor(Client *c);
 static bool __req_look_at_validator(const void *packet, size_t packet_size);
 static bool __req_shoot_executor(Client *c);
+static bool __req_end_turn_executor(Client *c);
+static bool __req_control_executor(Client *c);
+static bool __req_control_validator(const void *packet, size_t packet_size);
 
 // Tank telemetry.
 static bool __req_get_heading_executor(Client *c);
@@ -44,6 +53,7 @@ static bool __req_get_speed_executor(Client *c);
 static bool __req_get_hp_executor(Client *c);
 static bool __req_get_statistics_executor(Client *c);
 static bool __req_get_fire_delay_executor(Client *c);
+static bool __req_get_observation_executor(Client *c);
 
 // Observing.
 static bool __req_get_map_executor(Client *c);
@@ -60,9 +70,9 @@ static bool __req_viewer_get_tanks_executor(ViewerClient *c);
 static PacketDefinition RequestDefinitions[] =
 {
     // Connecting.
-    { .id = req_hello,            .validator = NULL,                             .executor = __req_hello_executor,            .is_client_protocol = true  },
+    { .id = req_hello,            .validator = __req_hello_validator,            .executor = __req_hello_executor,            .is_client_protocol = true  },
     { .id = req_bye,              .validator = NULL,                             .executor = __req_bye_executor,              .is_client_protocol = true  },
-    { .id = req_viewer_hello,     .validator = NULL,                             .executor = __req_viewer_hello_executor,     .is_client_protocol = false },
+    { .id = req_viewer_hello,     .validator = __req_hello_validator,            .executor = __req_viewer_hello_executor,     .is_client_protocol = false },
     { .id = req_viewer_bye,       .validator = NULL,                             .executor = __req_viewer_bye_executor,       .is_client_protocol = false },
 
     // Tank control.
@@ -70,6 +80,8 @@ static PacketDefinition RequestDefinitions[] =
     { .id = req_turn,             .validator = __req_turn_validator,             .executor = __req_turn_executor,             .is_client_protocol = true  },
     { .id = req_look_at,          .validator = __req_look_at_validator,          .executor = __req_look_at_executor,          .is_client_protocol = true  },
     { .id = req_shoot,            .validator = NULL,                             .executor = __req_shoot_executor,            .is_client_protocol = true  },
+    { .id = req_end_turn,         .validator = NULL,                             .executor = __req_end_turn_executor,         .is_client_protocol = true  },
+    { .id = req_control,          .validator = __req_control_validator,          .executor = __req_control_executor,          .is_client_protocol = true  },
 
     // Tank telemetry.
     { .id = req_get_heading,      .validator = NULL,                             .executor = __req_get_heading_executor,      .is_client_protocol = true  },
@@ -77,6 +89,7 @@ static PacketDefinition RequestDefinitions[] =
     { .id = req_get_hp,           .validator = NULL,                             .executor = __req_get_hp_executor,           .is_client_protocol = true  },
     { .id = req_get_statistics,   .validator = NULL,                             .executor = __req_get_statistics_executor,   .is_client_protocol = true  },
     { .id = req_get_fire_delay,   .validator = NULL,                             .executor = __req_get_fire_delay_executor,   .is_client_protocol = true  },
+    { .id = req_get_observation,  .validator = NULL,                             .executor = __req_get_observation_executor,  .is_client_protocol = true  },
 
     // Observing.
     { .id = req_get_map,          .validator = NULL,                             .executor = __req_get_map_executor,          .is_client_protocol = true  },
@@ -95,6 +108,7 @@ void handle_packet(const char *packet, size_t packet_size,  const SOCKADDR *send
     check(packet_size && PACKET_BUFFER >= packet_size, "Bad packet size.", "");
 
     uint8_t id = packet[0];
+    metrics_packet_in(id, packet_size);
     const PacketDefinition *packet_definition = find_packet_by_id(RequestDefinitions, sizeof(RequestDefinitions) / sizeof(RequestDefinitions[0]), id);
 
     if ((NULL == packet_definition && 1 == packet_size) ||
@@ -178,11 +192,36 @@ static void __packet_processor(NetworkClient *c,
         return;
     }
 
+    if (NULL == c->arena &&
+        hello_packet != packet_definition->id &&
+        req_bye != packet_definition->id &&
+        req_viewer_bye != packet_definition->id)
+    { // Not joined any arena yet.
+        uint8_t response = res_bad_request;
+        respond((char *) &response, 1, address);
+        return;
+    }
+
     memcpy(c->current_packet_buffer, packet_buffer, PACKET_BUFFER);
     c->current_packet_size = packet_size;
     c->current_packet_definition = packet_definition;
-    c->current_packet_definition->executor(c);
-    c->current_packet_definition = NULL;
+
+    // Client may leave its arena (and be freed) during execution.
+    Arena *arena = c->arena;
+    if (arena)
+    {
+        arena_lock(arena);
+    }
+
+    if (c->current_packet_definition->executor(c))
+    {
+        c->current_packet_definition = NULL;
+    }
+
+    if (arena)
+    {
+        arena_unlock(arena);
+    }
 }
 
 // Connecting.
@@ -192,8 +231,24 @@ static bool __req_hello_executor(Client *c)
 
     if (cs_connected == c->network_client.state)
     {
-        c->network_client.state = cs_acknowledged;
-        game_tank_initialize(c);
+        Arena *arena = game_get_arena(__get_requested_arena(&c->network_client));
+
+        arena_lock(arena);
+        bool joined = arena_add_client(arena, &c->network_client);
+        if (joined)
+        {
+            c->network_client.state = cs_acknowledged;
+            game_tank_initialize(c);
+        }
+        arena_unlock(arena);
+
+        if (!joined)
+        {
+            uint8_t response = res_too_many_clients;
+            respond((char *) &response, 1, &c->network_client.address);
+            unregister_client(&c->network_client.address);
+            return false;
+        }
     }
 
     uint8_t response = req_hello;
@@ -202,6 +257,19 @@ static bool __req_hello_executor(Client *c)
     return true;
 }
 
+static bool __req_hello_validator(const void *packet, size_t packet_size)
+{
+    assert(packet && "Bad packet data pointer.");
+
+    if (1 == packet_size)
+    {
+        return true;
+    }
+
+    return sizeof(ReqHello) == packet_size - 1 &&
+           game_get_arena_count() > ((ReqHello *) (& ((const char *) packet)[1]))->arena;
+}
+
 static bool __req_bye_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
@@ -218,6 +286,20 @@ static bool __req_viewer_hello_executor(ViewerClient *c)
 
     if (cs_connected == c->network_client.state)
     {
+        Arena *arena = game_get_arena(__get_requested_arena(&c->network_client));
+
+        arena_lock(arena);
+        bool joined = arena_add_viewer(arena, &c->network_client);
+        arena_unlock(arena);
+
+        if (!joined)
+        {
+            uint8_t response = res_too_many_clients;
+            respond((char *) &response, 1, &c->network_client.address);
+            unregister_viewer(&c->network_client.address);
+            return false;
+        }
+
         c->network_client.state = cs_acknowledged;
     }
 
@@ -241,15 +323,17 @@ static bool __req_viewer_bye_executor(ViewerClient *c)
 static bool __req_set_engine_power_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    tank_set_engine_power(&c->tank, ((ReqSetEnginePower *) (&c->network_client.current_packet_buffer[1]))->engine_power);
+    tank_set_engine_power(w, c->tank, ((ReqSetEnginePower *) (&c->network_client.current_packet_buffer[1]))->engine_power);
+    __journal_command(c);
 
     uint8_t response = req_set_engine_power;
     respond((char *) &response, 1, &c->network_client.address);
@@ -265,15 +349,17 @@ static bool __req_set_engine_power_validator(const void *packet, size_t packet_s
 static bool __req_turn_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    tank_turn(&c->tank, ((ReqTurn *) (&c->network_client.current_packet_buffer[1]))->turn_angle);
+    tank_turn(w, c->tank, ((ReqTurn *) (&c->network_client.current_packet_buffer[1]))->turn_angle);
+    __journal_command(c);
 
     uint8_t response = req_turn;
     respond((char *) &response, 1, &c->network_client.address);
@@ -296,8 +382,9 @@ static bool __req_turn_validator(const void *packet, size_t packet_size)
 static bool __req_look_at_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
@@ -305,7 +392,8 @@ static bool __req_look_at_executor(Client *c)
     }
 
     ReqLookAt *p = ((ReqLookAt *) (&c->network_client.current_packet_buffer[1]));
-    tank_look_at(&c->tank, &(Vector) { .x = p->x, .y = p->y, .z = p->z });
+    tank_look_at(w, c->tank, &(Vector) { .x = p->x, .y = p->y, .z = p->z });
+    __journal_command(c);
     uint8_t response = req_look_at;
     respond((char *) &response, 1, &c->network_client.address);
     return true;
@@ -329,32 +417,110 @@ static bool __req_look_at_validator(const void *packet, size_t packet_size)
 static bool __req_shoot_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    uint8_t response = tank_shoot(&c->tank) ? req_shoot : res_wait_shoot;
+    uint8_t response = tank_shoot(w, c->tank) ? req_shoot : res_wait_shoot;
+    __journal_command(c);
     respond((char *) &response, 1, &c->network_client.address);
     return true;
 }
 
+static bool __req_end_turn_executor(Client *c)
+{
+    assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
+
+    if (0 == w->tank_hp[c->tank])
+    {
+        uint8_t response = res_dead;
+        respond((char *) &response, 1, &c->network_client.address);
+        return true;
+    }
+
+    // Response is sent by game after next tick.
+    game_end_turn(c);
+    return true;
+}
+
+static bool __req_control_executor(Client *c)
+{
+    assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
+
+    if (0 == w->tank_hp[c->tank])
+    {
+        uint8_t response = res_dead;
+        respond((char *) &response, 1, &c->network_client.address);
+        return true;
+    }
+
+    ReqControl *p = ((ReqControl *) (&c->network_client.current_packet_buffer[1]));
+
+    if (p->flags & CONTROL_ENGINE_POWER)
+    {
+        tank_set_engine_power(w, c->tank, p->engine_power);
+    }
+
+    if (p->flags & CONTROL_TURN)
+    {
+        tank_turn(w, c->tank, p->turn_angle);
+    }
+
+    if (p->flags & CONTROL_LOOK_AT)
+    {
+        tank_look_at(w, c->tank, &(Vector) { .x = p->look_x, .y = p->look_y, .z = p->look_z });
+    }
+
+    if (p->flags & CONTROL_SHOOT)
+    {
+        tank_shoot(w, c->tank);
+    }
+
+    __journal_command(c);
+
+    uint8_t response = req_control;
+    respond((char *) &response, 1, &c->network_client.address);
+    return true;
+}
+
+static bool __req_control_validator(const void *packet, size_t packet_size)
+{
+    assert(packet && "Bad packet data pointer.");
+
+    if (sizeof(ReqControl) != packet_size - 1)
+    {
+        return false;
+    }
+
+    ReqControl *p = ((ReqControl *) (& ((const char *) packet)[1]));
+    return !(p->flags & ~CONTROL_ALL) &&
+           (!(p->flags & CONTROL_TURN) || __check_double(p->turn_angle, -M_PI, M_PI)) &&
+           (!(p->flags & CONTROL_LOOK_AT) || (__check_double(p->look_x, -1.0, 1.0) &&
+                                              __check_double(p->look_y, -1.0, 1.0) &&
+                                              __check_double(p->look_z, -1.0, 1.0)));
+}
+
 // Tank telemetry.
 static bool __req_get_heading_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    ResGetHeading response = { .packet_id = req_get_heading, .heading = tank_get_heading(&c->tank) };
+    ResGetHeading response = { .packet_id = req_get_heading, .heading = tank_get_heading(w, c->tank) };
     respond((char *) &response, sizeof(response), &c->network_client.address);
     return true;
 }
@@ -362,15 +528,16 @@ static bool __req_get_heading_executor(Client *c)
 static bool __req_get_speed_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    ResGetSpeed response = { .packet_id = req_get_speed, .speed = c->tank.speed };
+    ResGetSpeed response = { .packet_id = req_get_speed, .speed = w->tank_speed[c->tank] };
     respond((char *) &response, sizeof(response), &c->network_client.address);
     return true;
 }
@@ -378,15 +545,16 @@ static bool __req_get_speed_executor(Client *c)
 static bool __req_get_hp_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
         return true;
     }
 
-    ResGetHP response = { .packet_id = req_get_hp, .hp = (uint8_t) c->tank.hp };
+    ResGetHP response = { .packet_id = req_get_hp, .hp = (uint8_t) w->tank_hp[c->tank] };
     respond((char *) &response, sizeof(response), &c->network_client.address);
     return true;
 }
@@ -394,15 +562,16 @@ static bool __req_get_hp_executor(Client *c)
 static bool __req_get_statistics_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
     ResGetStatistics response = {
         .packet_id       = req_get_statistics,
-        .ticks           = c->tank.statistics.ticks,
-        .hp              = c->tank.statistics.hp,
-        .direct_hits     = c->tank.statistics.direct_hits,
-        .hits            = c->tank.statistics.hits,
-        .got_direct_hits = c->tank.statistics.got_direct_hits,
-        .got_hits        = c->tank.statistics.got_hits,
+        .ticks           = w->tanks[c->tank].statistics.ticks,
+        .hp              = w->tanks[c->tank].statistics.hp,
+        .direct_hits     = w->tanks[c->tank].statistics.direct_hits,
+        .hits            = w->tanks[c->tank].statistics.hits,
+        .got_direct_hits = w->tanks[c->tank].statistics.got_direct_hits,
+        .got_hits        = w->tanks[c->tank].statistics.got_hits,
     };
     respond((char *) &response, sizeof(response), &c->network_client.address);
     return true;
@@ -411,10 +580,41 @@ static bool __req_get_statistics_executor(Client *c)
 static bool __req_get_fire_delay_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
     ResGetFireDelay response = {
         .packet_id  = req_get_fire_delay,
-        .fire_delay = c->tank.fire_delay
+        .fire_delay = w->tank_fire_delay[c->tank]
+    };
+    respond((char *) &response, sizeof(response), &c->network_client.address);
+    return true;
+}
+
+static bool __req_get_observation_executor(Client *c)
+{
+    assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
+
+    if (0 == w->tank_hp[c->tank])
+    {
+        uint8_t response = res_dead;
+        respond((char *) &response, 1, &c->network_client.address);
+        return true;
+    }
+
+    Vector normal;
+    const Landscape *landscape = c->network_client.arena->landscape;
+    landscape_get_normal_at(landscape, w->tank_position[c->tank].x, w->tank_position[c->tank].y, &normal);
+
+    ResGetObservation response = {
+        .packet_id  = req_get_observation,
+        .heading    = tank_get_heading(w, c->tank),
+        .speed      = w->tank_speed[c->tank],
+        .hp         = (uint8_t) w->tank_hp[c->tank],
+        .fire_delay = w->tank_fire_delay[c->tank],
+        .normal_x   = normal.x,
+        .normal_y   = normal.y,
+        .normal_z   = normal.z
     };
     respond((char *) &response, sizeof(response), &c->network_client.address);
     return true;
@@ -424,8 +624,9 @@ static bool __req_get_fire_delay_executor(Client *c)
 static bool __req_get_map_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
@@ -437,14 +638,14 @@ static bool __req_get_map_executor(Client *c)
 
     response[0] = (uint8_t) req_get_map;
 
-    const Landscape *landscape = game_get_landscape();
+    const Landscape *landscape = c->network_client.arena->landscape;
     *((double *) &response[1]) = landscape->scale;
 
     uint8_t (*response_height_map)[TANK_OBSERVING_RANGE][TANK_OBSERVING_RANGE] =
         (uint8_t (*)[TANK_OBSERVING_RANGE][TANK_OBSERVING_RANGE]) (&response[1 + sizeof(double)]);
 
     size_t t_x, t_y;
-    landscape_get_tile(landscape, c->tank.position.x, c->tank.position.y, &t_x, &t_y);
+    landscape_get_tile(landscape, w->tank_position[c->tank].x, w->tank_position[c->tank].y, &t_x, &t_y);
 
     for (int i = -TANK_OBSERVING_RANGE / 2; i < TANK_OBSERVING_RANGE / 2; i++)
     {
@@ -468,8 +669,9 @@ static bool __req_get_map_executor(Client *c)
 static bool __req_get_normal_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
@@ -478,8 +680,8 @@ static bool __req_get_normal_executor(Client *c)
 
     ResGetNormal response = { .packet_id = req_get_normal };
     Vector t;
-    const Landscape *landscape = game_get_landscape();
-    landscape_get_normal_at(landscape, c->tank.position.x, c->tank.position.y, &t);
+    const Landscape *landscape = c->network_client.arena->landscape;
+    landscape_get_normal_at(landscape, w->tank_position[c->tank].x, w->tank_position[c->tank].y, &t);
     response.x = t.x;
     response.y = t.y;
     response.z = t.z;
@@ -490,8 +692,9 @@ static bool __req_get_normal_executor(Client *c)
 static bool __req_get_tanks_executor(Client *c)
 {
     assert(c && "Bad client pointer.");
+    World *w = c->network_client.arena->world;
 
-    if (0 == c->tank.hp)
+    if (0 == w->tank_hp[c->tank])
     {
         uint8_t response = res_dead;
         respond((char *) &response, 1, &c->network_client.address);
@@ -507,34 +710,34 @@ static bool __req_get_tanks_executor(Client *c)
 
     ResGetTanksTankRecord *response_body = (ResGetTanksTankRecord *) (response + sizeof(ResGetTanks));
 
-    const Landscape *landscape = game_get_landscape();
-    DynamicArray *clients = server_get_clients();
-    size_t clients_count = dynamic_array_count(clients);
-    for (size_t i = 0; i < clients_count; i++)
+    const Landscape *landscape = c->network_client.arena->landscape;
+    const ClientArray *clients = &c->network_client.arena->clients;
+    for (size_t i = 0; i < clients->count; i++)
     {
-        Client *other_c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+        Client *other_c = *client_array_at(clients, i);
+        TankHandle o = other_c->tank;
 
         if (other_c == c ||
-            TANK_OBSERVING_RANGE * landscape->tile_size < vector_distance(&c->tank.position, &other_c->tank.position))
+            TANK_OBSERVING_RANGE * landscape->tile_size < vector_distance(&w->tank_position[c->tank], &w->tank_position[o]))
         {
             continue;
         }
 
         *response_body = (ResGetTanksTankRecord) {
-            .x             = other_c->tank.position.x - c->tank.position.x,
-            .y             = other_c->tank.position.y - c->tank.position.y,
-            .z             = other_c->tank.position.z - c->tank.position.z,
-            .direction_x   = other_c->tank.direction.x,
-            .direction_y   = other_c->tank.direction.y,
-            .direction_z   = other_c->tank.direction.z,
-            .orientation_x = other_c->tank.orientation.x,
-            .orientation_y = other_c->tank.orientation.y,
-            .orientation_z = other_c->tank.orientation.z,
-            .turret_x      = other_c->tank.turret_direction.x,
-            .turret_y      = other_c->tank.turret_direction.y,
-            .turret_z      = other_c->tank.turret_direction.z,
-            .speed         = other_c->tank.speed,
-            .team          = (uint8_t) other_c->tank.team
+            .x             = w->tank_position[o].x - w->tank_position[c->tank].x,
+            .y             = w->tank_position[o].y - w->tank_position[c->tank].y,
+            .z             = w->tank_position[o].z - w->tank_position[c->tank].z,
+            .direction_x   = w->tank_direction[o].x,
+            .direction_y   = w->tank_direction[o].y,
+            .direction_z   = w->tank_direction[o].z,
+            .orientation_x = w->tank_orientation[o].x,
+            .orientation_y = w->tank_orientation[o].y,
+            .orientation_z = w->tank_orientation[o].z,
+            .turret_x      = w->tanks[o].turret_direction.x,
+            .turret_y      = w->tanks[o].turret_direction.y,
+            .turret_z      = w->tanks[o].turret_direction.z,
+            .speed         = w->tank_speed[o],
+            .team          = (uint8_t) w->tanks[o].team
         };
 
         response_body++;
@@ -550,7 +753,7 @@ static bool __req_get_tanks_executor(Client *c)
 static bool __req_viewer_get_map_executor(ViewerClient *c)
 {
     assert(c && "Bad viewer client pointer.");
-    const Landscape *landscape = game_get_landscape();
+    const Landscape *landscape = c->network_client.arena->landscape;
     const size_t ls = landscape->landscape_size;
     char response[1 + 2 * sizeof(size_t) + ls * ls * sizeof(double)];
     memset(response, 0, sizeof(response));
@@ -567,46 +770,49 @@ static bool __req_viewer_get_map_executor(ViewerClient *c)
 static bool __req_viewer_get_tanks_executor(ViewerClient *c)
 {
     assert(c && "Bad viewer client pointer.");
-    char response[sizeof(ResGetTanks) + MAX_CLIENTS * sizeof(ResGetTanksTankRecord)];
+    World *w = c->network_client.arena->world;
+    char response[sizeof(ResViewerGetTanks) + MAX_CLIENTS * sizeof(ResGetTanksTankRecord)];
     memset(response, 0, sizeof(response));
 
-    ResGetTanks *response_header = (ResGetTanks *) response;
+    ResViewerGetTanks *response_header = (ResViewerGetTanks *) response;
     response_header->packet_id = req_viewer_get_tanks;
     response_header->tanks_count = 0;
+    response_header->tick = c->network_client.arena->tick;
+    response_header->tick_rate = (uint16_t) game_get_tick_rate();
 
-    ResGetTanksTankRecord *response_body = (ResGetTanksTankRecord *) (response + sizeof(ResGetTanks));
+    ResGetTanksTankRecord *response_body = (ResGetTanksTankRecord *) (response + sizeof(ResViewerGetTanks));
 
-    DynamicArray *clients = server_get_clients();
-    size_t clients_count = dynamic_array_count(clients);
-    for (size_t i = 0; i < clients_count; i++, response_body++, response_header->tanks_count++)
+    const ClientArray *clients = &c->network_client.arena->clients;
+    for (size_t i = 0; i < clients->count; i++, response_body++, response_header->tanks_count++)
     {
-        Client *other_c = *DYNAMIC_ARRAY_GET(Client **, clients, i);
+        Client *other_c = *client_array_at(clients, i);
+        TankHandle o = other_c->tank;
 
         *response_body = (ResGetTanksTankRecord) {
-            .x               = other_c->tank.position.x,
-            .y               = other_c->tank.position.y,
-            .z               = other_c->tank.position.z,
-            .direction_x     = other_c->tank.direction.x,
-            .direction_y     = other_c->tank.direction.y,
-            .direction_z     = other_c->tank.direction.z,
-            .orientation_x   = other_c->tank.orientation.x,
-            .orientation_y   = other_c->tank.orientation.y,
-            .orientation_z   = other_c->tank.orientation.z,
-            .turret_x        = other_c->tank.turret_direction.x,
-            .turret_y        = other_c->tank.turret_direction.y,
-            .turret_z        = other_c->tank.turret_direction.z,
-            .target_turret_x = other_c->tank.turret_direction_target.x,
-            .target_turret_y = other_c->tank.turret_direction_target.y,
-            .target_turret_z = other_c->tank.turret_direction_target.z,
-            .target_turn     = other_c->tank.turn_angle_target,
-            .speed           = other_c->tank.speed,
-            .team            = (uint8_t) other_c->tank.team,
-            .hp              = (uint8_t) other_c->tank.hp
+            .x               = w->tank_position[o].x,
+            .y               = w->tank_position[o].y,
+            .z               = w->tank_position[o].z,
+            .direction_x     = w->tank_direction[o].x,
+            .direction_y     = w->tank_direction[o].y,
+            .direction_z     = w->tank_direction[o].z,
+            .orientation_x   = w->tank_orientation[o].x,
+            .orientation_y   = w->tank_orientation[o].y,
+            .orientation_z   = w->tank_orientation[o].z,
+            .turret_x        = w->tanks[o].turret_direction.x,
+            .turret_y        = w->tanks[o].turret_direction.y,
+            .turret_z        = w->tanks[o].turret_direction.z,
+            .target_turret_x = w->tanks[o].turret_direction_target.x,
+            .target_turret_y = w->tanks[o].turret_direction_target.y,
+            .target_turret_z = w->tanks[o].turret_direction_target.z,
+            .target_turn     = w->tanks[o].turn_angle_target,
+            .speed           = w->tank_speed[o],
+            .team            = (uint8_t) w->tanks[o].team,
+            .hp              = (uint8_t) w->tank_hp[o]
         };
     }
 
     respond((char *) &response,
-            sizeof(ResGetTanks) + response_header->tanks_count * sizeof(ResGetTanksTankRecord),
+            sizeof(ResViewerGetTanks) + response_header->tanks_count * sizeof(ResGetTanksTankRecord),
             &c->network_client.address);
     return true;
 }
@@ -615,3 +821,27 @@ static bool __check_double(double v, double min_value, double max_value)
 {
     return isfinite(v) && min_value <= v && v <= max_value;
 }
+
+static size_t __get_requested_arena(const NetworkClient *c)
+{
+    assert(c && "Bad client pointer.");
+
+    if (1 + sizeof(ReqHello) == c->current_packet_size)
+    {
+        return ((const ReqHello *) (&c->current_packet_buffer[1]))->arena;
+    }
+
+    return 0;
+}
+
+// Records state-changing packet for replay. Arena must be locked by caller.
+static void __journal_command(const Client *c)
+{
+    assert(c && "Bad client pointer.");
+
+    Journal *j = c->network_client.arena->journal;
+    if (j)
+    {
+        journal_write_command(j, c->tank, c->network_client.current_packet_buffer, c->network_client.current_packet_size);
+    }
+}
@@ -27,6 +27,8 @@ typedef enum Requests
     req_turn             = 0x11,
     req_look_at          = 0x12,
     req_shoot            = 0x13,
+    req_end_turn         = 0x14,
+    req_control          = 0x15, // Any of above but end of turn, in one packet.
 
     // Tank telemetry.
     req_get_heading      = 0x20,
@@ -34,6 +36,7 @@ typedef enum Requests
     req_get_hp           = 0x22,
     req_get_statistics   = 0x23,
     req_get_fire_delay   = 0x24,
+    req_get_observation  = 0x25, // Heading, speed, hp, fire delay and normal in one packet.
 
     // Observing.
     req_get_map          = 0x30,
@@ -90,6 +93,11 @@ void handle_packet(const char *packet, size_t packet_size, const SOCKADDR *sende
 #pragma warn(disable: 2185)
 
 // Packet body definitions.
+typedef struct ReqHello
+{
+    uint8_t arena;
+} ReqHello;
+
 typedef struct ReqSetEnginePower
 {
     int8_t engine_power;
@@ -105,6 +113,22 @@ typedef struct ReqLookAt
     double x, y, z;
 } ReqLookAt;
 
+// ReqControl flags, fields without their flag are ignored.
+#define CONTROL_ENGINE_POWER 0x01
+#define CONTROL_TURN         0x02
+#define CONTROL_LOOK_AT      0x04
+#define CONTROL_SHOOT        0x08
+#define CONTROL_ALL          (CONTROL_ENGINE_POWER | CONTROL_TURN | CONTROL_LOOK_AT | CONTROL_SHOOT)
+
+// Commands are applied in flags order. Shoot failing for fire delay isn't reported.
+typedef struct ReqControl
+{
+    uint8_t flags;
+    int8_t engine_power;
+    double turn_angle;
+    double look_x, look_y, look_z;
+} ReqControl;
+
 typedef struct ResGetHeading
 {
     uint8_t packet_id;
@@ -140,6 +164,16 @@ typedef struct ResGetFireDelay
     int fire_delay;
 } ResGetFireDelay;
 
+typedef struct ResGetObservation
+{
+    uint8_t packet_id;
+    double heading;
+    double speed;
+    uint8_t hp;
+    int fire_delay;
+    double normal_x, normal_y, normal_z;
+} ResGetObservation;
+
 typedef struct ResGetNormal
 {
     uint8_t packet_id;
@@ -152,6 +186,15 @@ typedef struct ResGetTanks
     uint8_t tanks_count;
 } ResGetTanks;
 
+// Viewer's tanks response is stamped with arena tick, so viewer may interpolate between responses.
+typedef struct ResViewerGetTanks
+{
+    uint8_t packet_id;
+    uint8_t tanks_count;
+    uint64_t tick;
+    uint16_t tick_rate; // Ticks per second.
+} ResViewerGetTanks;
+
 typedef struct ResGetTanksTankRecord
 {
     double x, y, z;
@@ -0,0 +1,429 @@
+// relay_main.c - main() for viewer relay: one upstream viewer, any number of downstream viewers.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+
+#include <winsock2.h>
+
+#include "debug.h"
+#include "net.h"
+#include "protocol.h"
+#include "client_protocol.h"
+#include "scheduler.h"
+#include "typed_array.h"
+
+#define RELAY_PORT_OFFSET 3 // From server's default port.
+#define RELAY_DEFAULT_POLL_INTERVAL 100 // In milliseconds, same as viewer's tanks poll.
+#define RELAY_SUBSCRIBER_TIMEOUT (10 * SCHEDULER_NSEC_PER_SEC) // Viewers which stopped polling are dropped.
+#define RELAY_CATCH_UP_PERIOD (3 * SCHEDULER_NSEC_PER_SEC)    // Older shell events aren't replayed to late joiners.
+#define RELAY_RECENT_EVENTS (NET_RETRIES / 2) // Replayed to late joiners. Clients count unexpected packets as retries.
+#define RELAY_REPORT_PERIOD (10 * SCHEDULER_NSEC_PER_SEC)
+
+#pragma pack(push, 8)
+
+typedef struct RelaySubscriber
+{
+    SOCKADDR address;
+    bool acknowledged; // Second hello is received.
+    bool caught_up;    // Recent shell events are sent.
+    uint64_t last_seen;
+} RelaySubscriber;
+
+typedef struct RelayEvent
+{
+    uint64_t received_at;
+    NotViewerShellEvent event;
+} RelayEvent;
+
+#pragma pack(pop)
+
+TYPED_ARRAY_DEFINE(RelaySubscriberArray, relay_subscriber_array, RelaySubscriber)
+
+// Upstream notifications, without executors: relay only forwards them.
+static PacketDefinition upstream_packets[] = {
+    { .id = req_viewer_hello     },
+    { .id = req_viewer_bye       },
+    { .id = req_viewer_get_map   },
+    { .id = req_viewer_get_tanks },
+    { .id = res_bad_request      },
+    { .id = res_too_many_clients },
+    { .id = not_viewer_shoot     },
+    { .id = not_viewer_explosion }
+};
+
+static ClientProtocol upstream = {
+    .packets      = upstream_packets,
+    .packet_count = sizeof(upstream_packets) / sizeof(upstream_packets[0]),
+    .s            = INVALID_SOCKET,
+    .connected    = false
+};
+
+static SOCKET downstream = INVALID_SOCKET;
+static RelaySubscriberArray subscribers = { 0 };
+static volatile bool working = true;
+
+// Encoded once, sent as is to every subscriber.
+static char map_packet[CLIENT_PACKET_BUFFER];
+static size_t map_packet_size = 0;
+static char tanks_packet[CLIENT_PACKET_BUFFER] = { req_viewer_get_tanks, 0 };
+static size_t tanks_packet_size = sizeof(ResViewerGetTanks);
+
+// Ring of last shell events.
+static RelayEvent recent_events[RELAY_RECENT_EVENTS];
+static size_t recent_events_head = 0, recent_events_count = 0;
+
+static unsigned long long forwarded_packets = 0, served_requests = 0;
+
+static void __stop(int unused);
+static bool __open_downstream(unsigned short port);
+static void __process_upstream(uint64_t now);
+static void __process_downstream(uint64_t now);
+static RelaySubscriber *__find_subscriber(const SOCKADDR *address);
+static void __send_to(const void *packet, size_t size, const SOCKADDR *address);
+static void __broadcast(const void *packet, size_t size);
+static void __catch_up(const SOCKADDR *address, uint64_t now);
+static void __drop_idle_subscribers(uint64_t now);
+
+// Usage: morrigan_relay <server> [<server port> [<arena> [<relay port> [<poll interval, ms>]]]]
+// Game server sees relay as single viewer, downstream viewers connect to relay as to server.
+int main(int argc, char *argv[])
+{
+    if (2 > argc)
+    {
+        fprintf(stderr, "Usage: %s <server> [<server port> [<arena> [<relay port> [<poll interval, ms>]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned short server_port = 2 < argc ? (unsigned short) atoi(argv[2]) : PORT;
+    uint8_t arena = 3 < argc ? (uint8_t) atoi(argv[3]) : 0;
+    unsigned short relay_port = 4 < argc ? (unsigned short) atoi(argv[4]) : PORT + RELAY_PORT_OFFSET;
+    unsigned poll_interval = 5 < argc ? (unsigned) atoi(argv[5]) : RELAY_DEFAULT_POLL_INTERVAL;
+    bool net_started = false;
+
+    check(0 < poll_interval, "Bad poll interval.", "");
+    check(SIG_ERR != signal(SIGINT, __stop), "Failed to set signal handler.", "");
+    check(SIG_ERR != signal(SIGTERM, __stop), "Failed to set signal handler.", "");
+
+    check(net_started = client_net_start(), "Failed to initialize net.", "");
+    check(client_connect(&upstream, argv[1], server_port, false, arena), "Failed to connect to server.", "");
+
+    uint8_t req = req_viewer_get_map;
+    map_packet_size = sizeof(map_packet);
+    check(SOCKET_ERROR != send(upstream.s, (char *) &req, 1, 0), "send() failed. Error: %d.", WSAGetLastError());
+    check(req == client_protocol_wait_for(&upstream, req, map_packet, &map_packet_size), "Failed to get map.", "");
+
+    check(__open_downstream(relay_port), "Failed to open relay socket.", "");
+    printf("Relaying arena %u of %s:%u on port %u.\n", (unsigned) arena, argv[1], (unsigned) server_port, (unsigned) relay_port);
+
+    uint64_t poll_period = (uint64_t) poll_interval * (SCHEDULER_NSEC_PER_SEC / 1000);
+    uint64_t next_poll = scheduler_now(), next_report = next_poll + RELAY_REPORT_PERIOD;
+
+    while (working && upstream.connected)
+    {
+        uint64_t now = scheduler_now();
+
+        if (now >= next_poll)
+        {
+            // Relay polls at its own rate, however many subscribers are there.
+            req = req_viewer_get_tanks;
+            check(SOCKET_ERROR != send(upstream.s, (char *) &req, 1, 0), "send() failed. Error: %d.", WSAGetLastError());
+            next_poll += poll_period;
+            if (next_poll < now)
+            {
+                next_poll = now + poll_period;
+            }
+
+            __drop_idle_subscribers(now);
+        }
+
+        if (now >= next_report)
+        {
+            printf("Subscribers: %u, forwarded: %llu, served: %llu.\n", (unsigned) subscribers.count, forwarded_packets, served_requests);
+            next_report += RELAY_REPORT_PERIOD;
+        }
+
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(upstream.s, &set);
+        FD_SET(downstream, &set);
+
+        uint64_t wait = next_poll > now ? next_poll - now : 0;
+        struct timeval tv = {
+            .tv_sec = (long) (wait / SCHEDULER_NSEC_PER_SEC),
+            .tv_usec = (long) (wait % SCHEDULER_NSEC_PER_SEC / 1000)
+        };
+
+        int ready = select(0, &set, NULL, NULL, &tv);
+        check(SOCKET_ERROR != ready, "select() failed. Error: %d.", WSAGetLastError());
+
+        now = scheduler_now();
+        if (FD_ISSET(upstream.s, &set))
+        {
+            __process_upstream(now);
+        }
+
+        if (FD_ISSET(downstream, &set))
+        {
+            __process_downstream(now);
+        }
+    }
+
+    uint8_t bye = req_viewer_bye;
+    __broadcast(&bye, 1);
+    if (upstream.connected)
+    {
+        client_disconnect(&upstream, false);
+    }
+
+    closesocket(downstream);
+    relay_subscriber_array_destroy(&subscribers);
+    client_net_stop();
+    return EXIT_SUCCESS;
+
+    error:
+    if (upstream.connected)
+    {
+        client_disconnect(&upstream, false);
+    }
+
+    if (INVALID_SOCKET != downstream)
+    {
+        closesocket(downstream);
+    }
+
+    relay_subscriber_array_destroy(&subscribers);
+    if (net_started)
+    {
+        client_net_stop();
+    }
+
+    return EXIT_FAILURE;
+}
+
+static void __stop(int unused)
+{
+    #pragma ref unused
+
+    working = false;
+}
+
+static bool __open_downstream(unsigned short port)
+{
+    downstream = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    check(INVALID_SOCKET != downstream, "Failed to create socket. Error: %d.", WSAGetLastError());
+
+    DWORD b = PACKET_BUFFER;
+    check(SOCKET_ERROR != setsockopt(downstream, SOL_SOCKET, SO_SNDBUF, (const char *) &b, sizeof(DWORD)),
+          "Failed to socket set socket buffer. Error: %d.",
+          WSAGetLastError());
+
+    SOCKADDR_IN s_address = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    check(SOCKET_ERROR != bind(downstream, (const SOCKADDR *) &s_address, sizeof(s_address)), "Failed to bind socket. Error: %d.", WSAGetLastError());
+
+    return true;
+
+    error:
+    if (INVALID_SOCKET != downstream)
+    {
+        closesocket(downstream);
+        downstream = INVALID_SOCKET;
+    }
+
+    return false;
+}
+
+static void __process_upstream(uint64_t now)
+{
+    char packet[CLIENT_PACKET_BUFFER];
+    int received = recv(upstream.s, packet, sizeof(packet), 0);
+    if (SOCKET_ERROR == received || 0 >= received)
+    {
+        return;
+    }
+
+    switch ((uint8_t) packet[0])
+    {
+        case req_viewer_get_tanks:
+            if (sizeof(ResViewerGetTanks) <= (size_t) received &&
+                sizeof(ResViewerGetTanks) + ((ResViewerGetTanks *) packet)->tanks_count * sizeof(ResGetTanksTankRecord) == (size_t) received)
+            {
+                memcpy(tanks_packet, packet, received);
+                tanks_packet_size = received;
+            }
+            break;
+
+        case not_viewer_shoot:
+        case not_viewer_explosion:
+            if (sizeof(NotViewerShellEvent) == received)
+            {
+                RelayEvent *e = &recent_events[recent_events_head];
+                e->received_at = now;
+                memcpy(&e->event, packet, sizeof(NotViewerShellEvent));
+                recent_events_head = (recent_events_head + 1) % RELAY_RECENT_EVENTS;
+                if (RELAY_RECENT_EVENTS > recent_events_count)
+                {
+                    recent_events_count++;
+                }
+
+                __broadcast(packet, received);
+            }
+            break;
+
+        case req_viewer_bye:
+            puts("Server has closed connection.");
+            upstream.connected = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void __process_downstream(uint64_t now)
+{
+    char packet[PACKET_BUFFER];
+    SOCKADDR address;
+    int address_size = sizeof(address);
+    int received = recvfrom(downstream, packet, sizeof(packet), 0, &address, &address_size);
+    if (SOCKET_ERROR == received || 0 >= received)
+    {
+        return;
+    }
+
+    uint8_t id = (uint8_t) packet[0];
+    RelaySubscriber *s = __find_subscriber(&address);
+
+    if (req_viewer_hello == id && 1 + sizeof(ReqHello) == received)
+    {
+        if (!s)
+        {
+            RelaySubscriber new_subscriber = { .address = address, .acknowledged = false, .caught_up = false, .last_seen = now };
+            if (!relay_subscriber_array_push(&subscribers, new_subscriber))
+            {
+                uint8_t response = res_too_many_clients;
+                __send_to(&response, 1, &address);
+                return;
+            }
+
+            __send_to(&id, 1, &address);
+            return;
+        }
+
+        s->last_seen = now;
+        s->acknowledged = true;
+        __send_to(&id, 1, &address);
+        return;
+    }
+
+    if (!s)
+    {
+        uint8_t response = res_bad_request;
+        __send_to(&response, 1, &address);
+        return;
+    }
+
+    s->last_seen = now;
+    served_requests++;
+
+    switch (id)
+    {
+        case req_viewer_get_tanks:
+            __send_to(tanks_packet, tanks_packet_size, &address);
+            if (s->acknowledged && !s->caught_up)
+            {
+                // Not on hello: map response would be queued behind events.
+                __catch_up(&address, now);
+                s->caught_up = true;
+            }
+            break;
+
+        case req_viewer_get_map:
+            __send_to(map_packet, map_packet_size, &address);
+            break;
+
+        case req_viewer_bye:
+            __send_to(&id, 1, &address);
+            relay_subscriber_array_swap_remove(&subscribers, (size_t) (s - subscribers.data));
+            break;
+
+        default:
+        {
+            uint8_t response = res_bad_request;
+            __send_to(&response, 1, &address);
+            break;
+        }
+    }
+}
+
+static RelaySubscriber *__find_subscriber(const SOCKADDR *address)
+{
+    assert(address && "Bad address pointer.");
+
+    TYPED_ARRAY_FOR_EACH(RelaySubscriber *, s, &subscribers)
+    {
+        if (0 == memcmp(address, &s->address, sizeof(SOCKADDR)))
+        {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+static void __send_to(const void *packet, size_t size, const SOCKADDR *address)
+{
+    assert(packet && "Bad packet pointer.");
+    assert(address && "Bad address pointer.");
+
+    if (SOCKET_ERROR == sendto(downstream, (const char *) packet, (int) size, 0, address, sizeof(SOCKADDR)))
+    {
+        log_warning("sendto() failed. Error: %d.", WSAGetLastError());
+    }
+}
+
+// Only to subscribers which have finished connecting.
+static void __broadcast(const void *packet, size_t size)
+{
+    TYPED_ARRAY_FOR_EACH(const RelaySubscriber *, s, &subscribers)
+    {
+        if (s->acknowledged)
+        {
+            __send_to(packet, size, &s->address);
+            forwarded_packets++;
+        }
+    }
+}
+
+// Late joiner gets last shell events which are still visible, oldest first.
+static void __catch_up(const SOCKADDR *address, uint64_t now)
+{
+    size_t first = (recent_events_head + RELAY_RECENT_EVENTS - recent_events_count) % RELAY_RECENT_EVENTS;
+    for (size_t i = 0; i < recent_events_count; i++)
+    {
+        const RelayEvent *e = &recent_events[(first + i) % RELAY_RECENT_EVENTS];
+        if (now - e->received_at <= RELAY_CATCH_UP_PERIOD)
+        {
+            __send_to(&e->event, sizeof(NotViewerShellEvent), address);
+        }
+    }
+}
+
+static void __drop_idle_subscribers(uint64_t now)
+{
+    for (size_t i = 0; i < subscribers.count;)
+    {
+        if (now - subscribers.data[i].last_seen > RELAY_SUBSCRIBER_TIMEOUT)
+        {
+            relay_subscriber_array_swap_remove(&subscribers, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
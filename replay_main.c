@@ -0,0 +1,300 @@
+// replay_main.c - main() for headless match replay.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "debug.h"
+#include "net.h"
+#include "protocol.h"
+#include "server.h"
+#include "game.h"
+#include "arena.h"
+#include "landscape.h"
+#include "journal.h"
+#include "scheduler.h"
+#include "metrics.h"
+
+static bool __join(Arena *a, TankHandle t);
+static bool __leave(Arena *a, TankHandle t);
+static bool __apply_command(Arena *a, const JournalRecord *r);
+static void __print_tanks(const Arena *a);
+static void __free_clients(Arena *a);
+
+int main(int argc, char *argv[])
+{
+    if (2 > argc)
+    {
+        fprintf(stderr, "Usage: %s <journal> [<landscape> [<stop-tick>]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    JournalReader *r = NULL;
+    Landscape *l = NULL;
+    Arena *a = NULL;
+    bool diverged = false;
+
+    check(r = journal_reader_open(argv[1]), "Failed to open journal.", "");
+    check(l = landscape_load(2 < argc ? argv[2] : LANDSCAPE_DEFAULT_FILE, LANDSCAPE_DEFAULT_TILE_SIZE, LANDSCAPE_DEFAULT_SCALE),
+          "Failed to load landscape.",
+          "");
+    check(journal_landscape_hash(l) == r->header.landscape_hash, "Landscape doesn't match journal.", "");
+
+    // Replay may stop early to inspect state at given tick.
+    unsigned long long stop_tick = 3 < argc ? strtoull(argv[3], NULL, 10) : ULLONG_MAX;
+
+    check_mem(a = arena_create(r->header.arena, l, r->header.seed));
+    a->world->next_shell_id = (size_t) r->header.first_shell_id;
+    printf("Replaying arena %u, seed: %llu.\n", (unsigned) r->header.arena, (unsigned long long) r->header.seed);
+
+    uint64_t start = scheduler_now();
+    JournalRecord record;
+
+    while (a->tick < stop_tick && journal_read(r, &record))
+    {
+        switch (record.type)
+        {
+            case journal_tick:
+                arena_lock(a);
+                game_tick_arena(a);
+                arena_unlock(a);
+                if (journal_world_hash(a->world) != record.state_hash)
+                {
+                    log_error("State diverged at tick %llu.", a->tick);
+                    diverged = true;
+                }
+                break;
+
+            case journal_join:
+                check(__join(a, record.tank), "Failed to replay join at tick %llu.", a->tick);
+                break;
+
+            case journal_leave:
+                check(__leave(a, record.tank), "Failed to replay leave at tick %llu.", a->tick);
+                break;
+
+            case journal_command:
+                check(__apply_command(a, &record), "Failed to replay command at tick %llu.", a->tick);
+                break;
+        }
+
+        if (diverged)
+        {
+            break;
+        }
+    }
+
+    check(!r->failed, "Journal is corrupted.", "");
+    if (r->truncated)
+    {
+        puts("Journal ends with incomplete record, it is replayed up to it.");
+    }
+
+    double elapsed = (double) (scheduler_now() - start) / SCHEDULER_NSEC_PER_SEC;
+    printf("Replayed %llu ticks in %.3f s (%.0f ticks/s): %s.\n",
+           a->tick,
+           elapsed,
+           0.0 < elapsed ? a->tick / elapsed : 0.0,
+           diverged ? "DIVERGED" : "ok");
+
+    for (MetricsPhase p = 0; p < metrics_phase_count; p++)
+    {
+        printf("  %-16s p50: %8llu ns, p99: %8llu ns, max: %8llu ns.\n",
+               metrics_phase_name(p),
+               (unsigned long long) metrics_histogram_percentile(&a->phase_times[p], 50.0),
+               (unsigned long long) metrics_histogram_percentile(&a->phase_times[p], 99.0),
+               (unsigned long long) a->phase_times[p].max);
+    }
+
+    // Crashed server's journal is replayed for post-mortem.
+    if (3 < argc || diverged || r->truncated)
+    {
+        __print_tanks(a);
+    }
+
+    __free_clients(a);
+    arena_destroy(a);
+    landscape_destroy(l);
+    journal_reader_close(r);
+    return diverged ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    error:
+    if (a)
+    {
+        __free_clients(a);
+        arena_destroy(a);
+    }
+
+    if (l)
+    {
+        landscape_destroy(l);
+    }
+
+    if (r)
+    {
+        journal_reader_close(r);
+    }
+    return EXIT_FAILURE;
+}
+
+// Replay is headless: game output goes nowhere.
+void respond(const char *data, size_t data_length, const SOCKADDR *to)
+{
+    #pragma ref data
+    #pragma ref data_length
+    #pragma ref to
+}
+
+// Same steps as "Hello" executor: tank slot, then random placement.
+static bool __join(Arena *a, TankHandle t)
+{
+    assert(a && "Bad arena pointer.");
+
+    Client *c = (Client *) calloc(1, sizeof(Client));
+    check_mem(c);
+    c->network_client.state = cs_acknowledged;
+
+    check(arena_add_client(a, &c->network_client), "Arena is full.", "");
+    if (c->tank != t)
+    {
+        arena_remove_client(a, &c->network_client);
+        sentinel("Tank got slot %u instead of %u.", (unsigned) c->tank, (unsigned) t);
+    }
+
+    game_tank_initialize(c);
+    return true;
+    error:
+    if (c)
+    {
+        free(c);
+    }
+    return false;
+}
+
+static bool __leave(Arena *a, TankHandle t)
+{
+    assert(a && "Bad arena pointer.");
+
+    check(a->world->tank_used[t], "Tank %u isn't in arena.", (unsigned) t);
+
+    Client *c = a->world->tank_client[t];
+    arena_remove_client(a, &c->network_client);
+    free(c);
+    return true;
+    error:
+    return false;
+}
+
+static bool __apply_command(Arena *a, const JournalRecord *r)
+{
+    assert(a && "Bad arena pointer.");
+    assert(r && "Bad record pointer.");
+
+    World *w = a->world;
+    TankHandle t = r->tank;
+    const char *body = &r->packet[1];
+
+    check(w->tank_used[t], "Tank %u isn't in arena.", (unsigned) t);
+
+    switch ((uint8_t) r->packet[0])
+    {
+        case req_set_engine_power:
+            check(1 + sizeof(ReqSetEnginePower) == r->packet_size, "Bad engine power packet.", "");
+            tank_set_engine_power(w, t, ((const ReqSetEnginePower *) body)->engine_power);
+            break;
+
+        case req_turn:
+            check(1 + sizeof(ReqTurn) == r->packet_size, "Bad turn packet.", "");
+            tank_turn(w, t, ((const ReqTurn *) body)->turn_angle);
+            break;
+
+        case req_look_at:
+        {
+            check(1 + sizeof(ReqLookAt) == r->packet_size, "Bad look at packet.", "");
+            const ReqLookAt *p = (const ReqLookAt *) body;
+            tank_look_at(w, t, &(Vector) { .x = p->x, .y = p->y, .z = p->z });
+            break;
+        }
+
+        case req_shoot:
+            tank_shoot(w, t);
+            break;
+
+        case req_control:
+        {
+            check(1 + sizeof(ReqControl) == r->packet_size, "Bad control packet.", "");
+            const ReqControl *p = (const ReqControl *) body;
+
+            if (p->flags & CONTROL_ENGINE_POWER)
+            {
+                tank_set_engine_power(w, t, p->engine_power);
+            }
+
+            if (p->flags & CONTROL_TURN)
+            {
+                tank_turn(w, t, p->turn_angle);
+            }
+
+            if (p->flags & CONTROL_LOOK_AT)
+            {
+                tank_look_at(w, t, &(Vector) { .x = p->look_x, .y = p->look_y, .z = p->look_z });
+            }
+
+            if (p->flags & CONTROL_SHOOT)
+            {
+                tank_shoot(w, t);
+            }
+
+            break;
+        }
+
+        default:
+            sentinel("Unknown command: %u.", (unsigned) (uint8_t) r->packet[0]);
+    }
+
+    return true;
+    error:
+    return false;
+}
+
+static void __print_tanks(const Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    const World *w = a->world;
+    printf("Tick %llu, shells: %u.\n", a->tick, (unsigned) w->shell_count);
+
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            continue;
+        }
+
+        printf("  tank %u: team %d, hp %d, position (%.3f, %.3f, %.3f), speed %.3f, fire delay %d.\n",
+               (unsigned) t,
+               w->tanks[t].team,
+               w->tank_hp[t],
+               w->tank_position[t].x,
+               w->tank_position[t].y,
+               w->tank_position[t].z,
+               w->tank_speed[t],
+               w->tank_fire_delay[t]);
+    }
+}
+
+static void __free_clients(Arena *a)
+{
+    assert(a && "Bad arena pointer.");
+
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (a->world->tank_used[t])
+        {
+            __leave(a, t);
+        }
+    }
+}
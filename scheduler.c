@@ -0,0 +1,243 @@
+// scheduler.c - fixed-timestep tick scheduler.
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+
+#if !defined(CLOCK_MONOTONIC)
+#include <windows.h>
+#endif
+
+#include "debug.h"
+#include "scheduler.h"
+
+static bool __sleep_until(uint64_t wake_time);
+
+void scheduler_initialize(Scheduler *s, unsigned tick_rate, SchedulerPolicy policy)
+{
+    assert(s && "Bad scheduler pointer.");
+    assert(0 < tick_rate && SCHEDULER_MAX_TICK_RATE >= tick_rate && "Bad tick rate.");
+
+    *s = (Scheduler) {
+        .period        = SCHEDULER_NSEC_PER_SEC / tick_rate,
+        .policy        = policy,
+        .deadline      = 0,
+        .ticks         = 0,
+        .overruns      = 0,
+        .skipped_ticks = 0,
+        .max_lateness  = 0,
+        .turn_timeouts = 0
+    };
+
+    s->deadline = scheduler_now() + s->period;
+}
+
+bool scheduler_wait(Scheduler *s)
+{
+    assert(s && "Bad scheduler pointer.");
+
+    uint64_t now = scheduler_now();
+    check(0 != now, "Failed to read clock.", "");
+
+    uint64_t wake_time = scheduler_advance(s, now);
+    if (wake_time > now)
+    {
+        check(__sleep_until(wake_time), "Failed to sleep.", "");
+    }
+
+    return true;
+    error:
+    return false;
+}
+
+uint64_t scheduler_advance(Scheduler *s, uint64_t now)
+{
+    assert(s && "Bad scheduler pointer.");
+
+    s->ticks++;
+
+    if (now > s->deadline)
+    {
+        uint64_t lateness = now - s->deadline;
+        s->overruns++;
+        if (lateness > s->max_lateness)
+        {
+            s->max_lateness = lateness;
+        }
+
+        // Whole periods which have passed after missed deadline.
+        uint64_t behind = lateness / s->period, skip = 0;
+        if (scheduler_skip == s->policy)
+        {
+            skip = behind;
+        }
+        else if (SCHEDULER_MAX_CATCH_UP_TICKS < behind)
+        {
+            skip = behind - SCHEDULER_MAX_CATCH_UP_TICKS;
+        }
+
+        // Skipping keeps deadlines on the grid of periods.
+        s->skipped_ticks += skip;
+        s->deadline += skip * s->period;
+    }
+
+    uint64_t next_tick_start = s->deadline;
+    s->deadline += s->period;
+    return next_tick_start;
+}
+
+uint64_t scheduler_now(void)
+{
+    #if defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    check(0 == clock_gettime(CLOCK_MONOTONIC, &now), "Failed to get monotonic time.", "");
+    return (uint64_t) now.tv_sec * SCHEDULER_NSEC_PER_SEC + (uint64_t) now.tv_nsec;
+    #else
+    LARGE_INTEGER counter, frequency;
+    check(QueryPerformanceCounter(&counter) && QueryPerformanceFrequency(&frequency), "Failed to query performance counter.", "");
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * SCHEDULER_NSEC_PER_SEC +
+           (uint64_t) (counter.QuadPart % frequency.QuadPart) * SCHEDULER_NSEC_PER_SEC / (uint64_t) frequency.QuadPart;
+    #endif
+
+    error:
+    return 0;
+}
+
+bool scheduler_parse_policy(const char *name, SchedulerPolicy *policy)
+{
+    assert(name && "Bad name pointer.");
+    assert(policy && "Bad policy pointer.");
+
+    if (0 == strcmp("catchup", name))
+    {
+        *policy = scheduler_catch_up;
+        return true;
+    }
+
+    if (0 == strcmp("skip", name))
+    {
+        *policy = scheduler_skip;
+        return true;
+    }
+
+    if (0 == strcmp("lockstep", name))
+    {
+        *policy = scheduler_lockstep;
+        return true;
+    }
+
+    return false;
+}
+
+const char *scheduler_policy_name(SchedulerPolicy policy)
+{
+    switch (policy)
+    {
+        case scheduler_skip:
+            return "skip";
+
+        case scheduler_lockstep:
+            return "lockstep";
+
+        default:
+            return "catchup";
+    }
+}
+
+static bool __sleep_until(uint64_t wake_time)
+{
+    #if defined(TIMER_ABSTIME)
+    struct timespec wake = {
+        .tv_sec = (time_t) (wake_time / SCHEDULER_NSEC_PER_SEC),
+        .tv_nsec = (long) (wake_time % SCHEDULER_NSEC_PER_SEC)
+    };
+
+    int result;
+    while (EINTR == (result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL)));
+    return 0 == result;
+    #else
+    // No absolute sleep: relative one is still computed from deadline, so error doesn't accumulate.
+    uint64_t now = scheduler_now();
+    check(0 != now, "Failed to read clock.", "");
+    if (wake_time <= now)
+    {
+        return true;
+    }
+
+    uint64_t duration = wake_time - now;
+    struct timespec sleep_duration = {
+        .tv_sec = (time_t) (duration / SCHEDULER_NSEC_PER_SEC),
+        .tv_nsec = (long) (duration % SCHEDULER_NSEC_PER_SEC)
+    };
+    int result = thrd_sleep(&sleep_duration, NULL);
+    return 0 == result || -1 == result; // -1 is interruption by signal, deadline logic handles it.
+    error:
+    return false;
+    #endif
+}
+
+#if defined(SCHEDULER_TESTS)
+#include <stdio.h>
+
+#include "testhelp.h"
+
+#define PERIOD (SCHEDULER_NSEC_PER_SEC / 10)
+
+static void __reset(Scheduler *s, SchedulerPolicy policy)
+{
+    scheduler_initialize(s, 10, policy);
+    s->deadline = PERIOD; // Previous tick started at 0.
+}
+
+int main(void)
+{
+    Scheduler s;
+
+    __reset(&s, scheduler_catch_up);
+    test_cond("Check period.", PERIOD == s.period);
+
+    uint64_t next = scheduler_advance(&s, PERIOD / 2);
+    test_cond("In time tick starts on deadline.", PERIOD == next && 2 * PERIOD == s.deadline && 0 == s.overruns);
+
+    next = scheduler_advance(&s, 2 * PERIOD + PERIOD / 2 + 3 * PERIOD);
+    test_cond("Catch-up starts late tick at once.", 2 * PERIOD == next && 1 == s.overruns && 0 == s.skipped_ticks);
+    test_cond("Check lateness.", 3 * PERIOD + PERIOD / 2 == s.max_lateness);
+
+    next = scheduler_advance(&s, 5 * PERIOD + PERIOD / 2);
+    next = scheduler_advance(&s, 5 * PERIOD + PERIOD / 2);
+    next = scheduler_advance(&s, 5 * PERIOD + PERIOD / 2);
+    test_cond("Catch-up runs missed ticks.", 5 * PERIOD == next && 6 * PERIOD == s.deadline);
+
+    next = scheduler_advance(&s, 5 * PERIOD + PERIOD / 2);
+    test_cond("Catch-up finishes in time.", 6 * PERIOD == next && 4 == s.overruns);
+
+    __reset(&s, scheduler_catch_up);
+    next = scheduler_advance(&s, PERIOD + (SCHEDULER_MAX_CATCH_UP_TICKS + 5) * PERIOD);
+    test_cond("Catch-up is limited.", 5 == s.skipped_ticks && 6 * PERIOD == next);
+
+    __reset(&s, scheduler_skip);
+    next = scheduler_advance(&s, 3 * PERIOD + PERIOD / 2);
+    test_cond("Skip drops missed ticks.", 3 * PERIOD == next && 4 * PERIOD == s.deadline && 2 == s.skipped_ticks);
+
+    next = scheduler_advance(&s, 3 * PERIOD + PERIOD / 2 + 1);
+    test_cond("Skip keeps period grid.", 4 * PERIOD == next && 1 == s.overruns);
+
+    SchedulerPolicy policy;
+    test_cond("Parse policy.",
+              scheduler_parse_policy("skip", &policy) && scheduler_skip == policy &&
+              scheduler_parse_policy("catchup", &policy) && scheduler_catch_up == policy &&
+              scheduler_parse_policy("lockstep", &policy) && scheduler_lockstep == policy &&
+              !scheduler_parse_policy("fast", &policy));
+
+    __reset(&s, scheduler_catch_up);
+    uint64_t start = scheduler_now();
+    s.deadline = start + PERIOD / 10;
+    test_cond("Wait sleeps until deadline.", scheduler_wait(&s) && scheduler_now() >= start + PERIOD / 10);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,58 @@
+// scheduler.h - fixed-timestep tick scheduler.
+
+#pragma once
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+//#pragma message("__SCHEDULER_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "morrigan.h"
+
+#define SCHEDULER_NSEC_PER_SEC 1000000000ULL
+#define SCHEDULER_MAX_TICK_RATE 1000
+// Catch-up policy runs at most this many late ticks back to back, older ones are skipped.
+#define SCHEDULER_MAX_CATCH_UP_TICKS 10
+
+typedef enum SchedulerPolicy
+{
+    scheduler_catch_up, // Late ticks are run without sleeping, so tick count follows clock.
+    scheduler_skip,     // Late ticks are dropped, next tick starts on next period boundary.
+    scheduler_lockstep  // Tick starts when all clients have ended their turn, period is turn timeout.
+} SchedulerPolicy;
+
+#pragma pack(push, 8)
+
+typedef struct Scheduler
+{
+    uint64_t period;        // In nanoseconds.
+    SchedulerPolicy policy;
+    uint64_t deadline;      // Monotonic start time of next tick, in nanoseconds.
+
+    // Counters.
+    unsigned long long ticks;
+    unsigned long long overruns;      // Ticks which ended after next tick's deadline.
+    unsigned long long skipped_ticks;
+    uint64_t max_lateness;            // In nanoseconds.
+    unsigned long long turn_timeouts; // Lockstep turns which were ended by timeout.
+} Scheduler;
+
+#pragma pack(pop)
+
+void scheduler_initialize(Scheduler *s, unsigned tick_rate, SchedulerPolicy policy);
+
+// Sleeps until start of next tick. Returns false if clock or sleep failed.
+bool scheduler_wait(Scheduler *s);
+
+// Accounts tick which has just ended at monotonic time now and moves deadline to following tick.
+// Returns start time of next tick. It is in past if scheduler is catching up.
+uint64_t scheduler_advance(Scheduler *s, uint64_t now);
+
+uint64_t scheduler_now(void);
+bool scheduler_parse_policy(const char *name, SchedulerPolicy *policy);
+const char *scheduler_policy_name(SchedulerPolicy policy);
+
+#endif /* __SCHEDULER_H__ */
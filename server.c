@@ -7,27 +7,36 @@
 #include "debug.h"
 #include "server.h"
 #include "protocol.h"
-#include "dynamic_array.h"
+#include "typed_array.h"
+#include "arena.h"
+#include "metrics.h"
+#include "lock_profile.h"
+#include "scheduler.h"
+
+// Clients and viewers are handled alike here, by their common NetworkClient part.
+TYPED_ARRAY_DEFINE(NetworkClientArray, network_client_array, NetworkClient *)
 
 static mtx_t global_mutex;
-static DynamicArray *clients = NULL;
-static DynamicArray *viewers = NULL;
+static NetworkClientArray clients = { 0 };
+static NetworkClientArray viewers = { 0 };
 
-static NetworkClient *__client_finder_by_address(const SOCKADDR *address, DynamicArray *a);
+static NetworkClient *__client_finder_by_address(const SOCKADDR *address, const NetworkClientArray *a);
 static NetworkClient *__client_registrator(const SOCKADDR *address,
-                                           DynamicArray *a,
+                                           NetworkClientArray *a,
                                            size_t max_count,
                                            size_t client_size);
-static bool __client_unregistrator(const SOCKADDR *address, DynamicArray *a);
-static void __shutdown_notifier(DynamicArray *a, uint8_t message);
+static bool __client_unregistrator(const SOCKADDR *address,
+                                   NetworkClientArray *a,
+                                   void (*arena_remover)(Arena *, const NetworkClient *));
+static void __shutdown_notifier(NetworkClientArray *a,
+                                uint8_t message,
+                                void (*arena_remover)(Arena *, const NetworkClient *));
 static void __clean(void);
 
 bool server_start(void)
 {
-    clients = DYNAMIC_ARRAY_CREATE(Client *, MAX_CLIENTS);
-    check_mem(clients);
-    viewers = DYNAMIC_ARRAY_CREATE(ViewerClient *, MAX_VIEWERS);
-    check_mem(viewers);
+    check(network_client_array_reserve(&clients, MAX_CLIENTS), "Failed to reserve clients.", "");
+    check(network_client_array_reserve(&viewers, MAX_VIEWERS), "Failed to reserve viewers.", "");
 
     check(thrd_success == mtx_init(&global_mutex, mtx_plain), "Failed to initialize global mutex.", "");
 
@@ -44,34 +53,26 @@ void server_stop(void)
     fprintf(stderr, "server_stop end.\n");
 }
 
-DynamicArray *server_get_clients(void)
-{
-    return clients;
-}
-
 Client *find_client_by_address(const SOCKADDR *address)
 {
-    return (Client *) __client_finder_by_address(address, clients);
+    return (Client *) __client_finder_by_address(address, &clients);
 }
 
 ViewerClient *find_viewer_by_address(const SOCKADDR *address)
 {
-    return (ViewerClient *) __client_finder_by_address(address, viewers);
+    return (ViewerClient *) __client_finder_by_address(address, &viewers);
 }
 
-static NetworkClient *__client_finder_by_address(const SOCKADDR *address, DynamicArray *a)
+static NetworkClient *__client_finder_by_address(const SOCKADDR *address, const NetworkClientArray *a)
 {
     assert(address && "Bad address pointer.");
     assert(a && "Bad collection pointer.");
 
-    size_t count = dynamic_array_count(a);
-
-    for (size_t i = 0; i < count; i++)
+    TYPED_ARRAY_FOR_EACH(NetworkClient **, c, a)
     {
-        NetworkClient *c = *DYNAMIC_ARRAY_GET(NetworkClient **, a, i);
-        if (0 == memcmp(address, &c->address, sizeof(SOCKADDR)))
+        if (0 == memcmp(address, &(*c)->address, sizeof(SOCKADDR)))
         {
-            return c;
+            return *c;
         }
     }
 
@@ -80,16 +81,16 @@ static NetworkClient *__client_finder_by_address(const SOCKADDR *address, Dynami
 
 NetworkClient *register_client(const SOCKADDR *address)
 {
-    return __client_registrator(address, clients, MAX_CLIENTS, sizeof(Client));
+    return __client_registrator(address, &clients, MAX_SERVER_CLIENTS, sizeof(Client));
 }
 
 NetworkClient *register_viewer(const SOCKADDR *address)
 {
-    return __client_registrator(address, viewers, MAX_VIEWERS, sizeof(ViewerClient));
+    return __client_registrator(address, &viewers, MAX_SERVER_VIEWERS, sizeof(ViewerClient));
 }
 
 static NetworkClient *__client_registrator(const SOCKADDR *address,
-                                           DynamicArray *a,
+                                           NetworkClientArray *a,
                                            size_t max_count,
                                            size_t client_size)
 {
@@ -104,7 +105,7 @@ static NetworkClient *__client_registrator(const SOCKADDR *address,
         return c;
     }
 
-    if (max_count == dynamic_array_count(a))
+    if (max_count == a->count)
     {
         return NULL;
     }
@@ -113,9 +114,10 @@ static NetworkClient *__client_registrator(const SOCKADDR *address,
     check_mem(c);
 
     c->state = cs_connected;
+    c->arena = NULL;
     memcpy(&c->address, address, sizeof(SOCKADDR));
 
-    check(dynamic_array_push(a, &c), "Failed to add new client.", "");
+    check(network_client_array_push(a, c), "Failed to add new client.", "");
 
     return c;
     error:
@@ -128,27 +130,34 @@ static NetworkClient *__client_registrator(const SOCKADDR *address,
 
 bool unregister_client(const SOCKADDR *address)
 {
-    return __client_unregistrator(address, clients);
+    return __client_unregistrator(address, &clients, arena_remove_client);
 }
 
 bool unregister_viewer(const SOCKADDR *address)
 {
-    return __client_unregistrator(address, viewers);
+    return __client_unregistrator(address, &viewers, arena_remove_viewer);
 }
 
-static bool __client_unregistrator(const SOCKADDR *address, DynamicArray *a)
+// Client's arena must be locked by caller.
+static bool __client_unregistrator(const SOCKADDR *address,
+                                   NetworkClientArray *a,
+                                   void (*arena_remover)(Arena *, const NetworkClient *))
 {
     assert(address && "Bad address pointer.");
     assert(a && "Bad client array pointer.");
+    assert(arena_remover && "Bad arena remover callback.");
 
-    size_t count = dynamic_array_count(a);
-
-    for (size_t i = 0; i < count; i++)
+    for (size_t i = 0; i < a->count; i++)
     {
-        NetworkClient *c = *DYNAMIC_ARRAY_GET(NetworkClient **, a, i);
+        NetworkClient *c = a->data[i];
         if (0 == memcmp(address, &c->address, sizeof(SOCKADDR)))
         {
-            dynamic_array_delete_at(a, i);
+            if (c->arena)
+            {
+                arena_remover(c->arena, c);
+            }
+
+            network_client_array_swap_remove(a, i);
             free(c);
             return true;
         }
@@ -157,50 +166,86 @@ static bool __client_unregistrator(const SOCKADDR *address, DynamicArray *a)
     return false;
 }
 
-void notify_viewers(NotViewerShellEvent *notification)
+// Arena must be locked by caller.
+void notify_viewers(const Arena *a, NotViewerShellEvent *notification)
 {
+    assert(a && "Bad arena pointer.");
     assert(notification && "Bad notification pointer.");
 
-    size_t viewer_count = dynamic_array_count(viewers);
-    for (size_t i = 0; i < viewer_count; i++)
+    TYPED_ARRAY_FOR_EACH(ViewerClient * const *, c, &a->viewers)
     {
-        ViewerClient *c = *DYNAMIC_ARRAY_GET(ViewerClient **, viewers, i);
-        respond((void *) notification, sizeof(NotViewerShellEvent), &c->network_client.address);
+        respond((void *) notification, sizeof(NotViewerShellEvent), &(*c)->network_client.address);
     }
 }
 
 void notify_shutdown(void)
 {
-    __shutdown_notifier(clients, req_bye);
-    __shutdown_notifier(viewers, req_viewer_bye);
+    __shutdown_notifier(&clients, req_bye, arena_remove_client);
+    __shutdown_notifier(&viewers, req_viewer_bye, arena_remove_viewer);
 }
 
-static void __shutdown_notifier(DynamicArray *a, uint8_t message)
+static void __shutdown_notifier(NetworkClientArray *a,
+                                uint8_t message,
+                                void (*arena_remover)(Arena *, const NetworkClient *))
 {
-    if (!a)
-    {
-        return;
-    }
+    assert(a && "Bad client array pointer.");
+    assert(arena_remover && "Bad arena remover callback.");
 
-    while (dynamic_array_count(a))
+    while (a->count)
     {
-        NetworkClient *c = *DYNAMIC_ARRAY_GET(NetworkClient **, a, 0);
-        dynamic_array_delete_at(a, 0);
+        NetworkClient *c = network_client_array_pop(a);
+
+        Arena *arena = c->arena;
+        if (arena)
+        {
+            arena_lock(arena);
+            arena_remover(arena, c);
+            arena_unlock(arena);
+        }
+
         uint8_t response = message;
         respond((char *) &response, 1, &c->address);
         free(c);
     }
 }
 
-void get_global_lock(void)
+void get_global_lock_at(const char *file, int line, const char *function)
 {
+    bool profile = lock_profile_enabled();
+
+    if (thrd_success == mtx_trylock(&global_mutex))
+    {
+        if (profile)
+        {
+            LockProfileSite site = { .file = file, .line = line, .function = function };
+            lock_profile_acquired(&site, false, 0, LOCK_PROFILE_NO_SITE, scheduler_now());
+        }
+        return;
+    }
+
+    // Holder may change before lock is taken, it's only a hint.
+    size_t blocker = profile ? lock_profile_holder() : LOCK_PROFILE_NO_SITE;
+    uint64_t start = scheduler_now();
     check(thrd_success == mtx_lock(&global_mutex), "Failed to lock global mutex.", "");
+    uint64_t now = scheduler_now();
+    metrics_lock_wait(metrics_lock_global, now - start);
+
+    if (profile)
+    {
+        LockProfileSite site = { .file = file, .line = line, .function = function };
+        lock_profile_acquired(&site, true, now - start, blocker, now);
+    }
     error:
     return;
 }
 
 void release_global_lock(void)
 {
+    if (lock_profile_enabled())
+    {
+        lock_profile_releasing(scheduler_now());
+    }
+
     check(thrd_success == mtx_unlock(&global_mutex), "Failed to unlock global mutex.", "");
     error:
     return;
@@ -208,17 +253,9 @@ void release_global_lock(void)
 
 static void __clean(void)
 {
-    if (clients)
-    {
-        dynamic_array_destroy(clients);
-        clients = NULL;
-    }
-
-    if (viewers)
-    {
-        dynamic_array_destroy(viewers);
-        viewers = NULL;
-    }
+    network_client_array_destroy(&clients);
+    network_client_array_destroy(&viewers);
 
     mtx_destroy(&global_mutex);
+    lock_profile_clean();
 }
@@ -10,11 +10,15 @@
 
 #include "morrigan.h"
 #include "protocol.h"
-#include "dynamic_array.h"
+#include "typed_array.h"
 #include "tank.h"
 
+// Per arena.
 #define MAX_CLIENTS 16
 #define MAX_VIEWERS 4
+#define MAX_ARENAS 64
+#define MAX_SERVER_CLIENTS (MAX_CLIENTS * MAX_ARENAS)
+#define MAX_SERVER_VIEWERS (MAX_VIEWERS * MAX_ARENAS)
 
 typedef enum ClientState
 {
@@ -23,12 +27,15 @@ typedef enum ClientState
     cs_in_game
 } ClientState;
 
+struct Arena;
+
 #pragma pack(push, 8)
 
 typedef struct NetworkClient
 {
     ClientState state;
     SOCKADDR address;
+    struct Arena *arena;
     char current_packet_buffer[PACKET_BUFFER];
     size_t current_packet_size;
     const PacketDefinition *current_packet_definition;
@@ -37,7 +44,7 @@ typedef struct NetworkClient
 typedef struct Client
 {
     NetworkClient network_client;
-    Tank tank;
+    TankHandle tank; // In arena's world.
 } Client;
 
 typedef struct ViewerClient
@@ -47,11 +54,12 @@ typedef struct ViewerClient
 
 #pragma pack(pop)
 
+TYPED_ARRAY_DEFINE(ClientArray, client_array, Client *)
+TYPED_ARRAY_DEFINE(ViewerArray, viewer_array, ViewerClient *)
+
 bool server_start(void);
 void server_stop(void);
 
-DynamicArray *server_get_clients(void);
-
 Client *find_client_by_address(const SOCKADDR *address);
 NetworkClient *register_client(const SOCKADDR *address);
 bool unregister_client(const SOCKADDR *address);
@@ -60,10 +68,12 @@ ViewerClient *find_viewer_by_address(const SOCKADDR *address);
 NetworkClient *register_viewer(const SOCKADDR *address);
 bool unregister_viewer(const SOCKADDR *address);
 
-void notify_viewers(NotViewerShellEvent *notification);
+void notify_viewers(const struct Arena *a, NotViewerShellEvent *notification);
 void notify_shutdown(void);
 
-void get_global_lock(void);
+// Call site is recorded when lock profiling is on.
+#define get_global_lock() get_global_lock_at(__FILE__, __LINE__, __func__)
+void get_global_lock_at(const char *file, int line, const char *function);
 void release_global_lock(void);
 
 #endif /* __SERVER_H__ */
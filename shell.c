@@ -5,72 +5,66 @@
 
 #include "debug.h"
 #include "shell.h"
+#include "world.h"
 
 static bool __shell_position_tester(const Landscape *l, const Vector *position);
 
-Shell *shell_create(const Vector *position, const Vector *direction)
+ShellHandle shell_create(World *w, const Vector *position, const Vector *direction)
 {
-    static size_t shell_id_generator = 0;
+    assert(w && "Bad world pointer.");
     assert(position && direction && "Bad geometry pointers.");
 
-    Shell *shell = NULL;
-    check_mem(shell = calloc(1, sizeof(Shell)));
+    ShellHandle s = world_shell_add(w);
+    check(SHELL_NONE != s, "Failed to add shell.", "");
 
-    *shell = (Shell) {
-        .position          = { .x = position->x,  .y = position->y,  .z = position->z  },
-        .previous_position = { .x = position->x,  .y = position->y,  .z = position->z  },
-        .direction         = { .x = direction->x, .y = direction->y, .z = direction->z },
-        .speed             = SHELL_DEFAULT_SPEED,
-        .bounding = {
-            .origin          = &shell->position,
-            .previous_origin = &shell->previous_position,
-            .direction       = &shell->direction,
-            .orientation     = &shell->direction,
-            .offset          = { .x = 0, .y = 0, .z = 0 },
-            .speed           = &shell->speed,
-            .bounding_type   = bounding_sphere,
-            .data            = { .radius = SHELL_RADIUS }
-        },
-        .id = shell_id_generator++
-    };
+    w->shell_position[s]          = (Vector) { .x = position->x,  .y = position->y,  .z = position->z  };
+    w->shell_previous_position[s] = (Vector) { .x = position->x,  .y = position->y,  .z = position->z  };
+    w->shell_direction[s]         = (Vector) { .x = direction->x, .y = direction->y, .z = direction->z };
+    w->shell_speed[s]             = SHELL_DEFAULT_SPEED;
 
-    return shell;
+    return s;
     error:
-    return NULL;
+    return SHELL_NONE;
 }
 
-bool shell_tick(Shell *shell, const Landscape *l)
+bool shell_tick(World *w, ShellHandle s, const Landscape *l)
 {
-    assert(shell && "Bad shell pointer.");
+    assert(w && "Bad world pointer.");
+    assert(s < w->shell_count && "Bad shell handle.");
     assert(l && "Bad landscape pointer.");
 
-    shell->previous_position = shell->position;
+    Vector *position          = &w->shell_position[s],
+           *previous_position = &w->shell_previous_position[s],
+           *direction         = &w->shell_direction[s];
+    double *speed             = &w->shell_speed[s];
+
+    *previous_position = *position;
 
     Vector vector_speed;
-    vector_scale(&shell->direction, shell->speed, &vector_speed);
+    vector_scale(direction, *speed, &vector_speed);
     Vector g = { .x = 0, .y = 0, .z = -SHELL_G_ACCELERATION };
     VECTOR_ADD(&vector_speed, &g);
 
-    VECTOR_ADD(&shell->position, &vector_speed);
+    VECTOR_ADD(position, &vector_speed);
 
-    vector_sub(&shell->position, &shell->previous_position, &shell->direction);
-    VECTOR_NORMALIZE(&shell->direction);
-    shell->speed = vector_mul(&shell->direction, &vector_speed);
+    vector_sub(position, previous_position, direction);
+    VECTOR_NORMALIZE(direction);
+    *speed = vector_mul(direction, &vector_speed);
 
     double intersection = landscape_intersects_with_segment(l,
-                                                            &shell->previous_position,
-                                                            &shell->position);
+                                                            previous_position,
+                                                            position);
     if (isnan(intersection))
     {
-        return !(0.0 > shell->position.x ||
-                 0.0 > shell->position.y ||
-                 l->tile_size * l->landscape_size < shell->position.x ||
-                 l->tile_size * l->landscape_size < shell->position.y);
+        return !(0.0 > position->x ||
+                 0.0 > position->y ||
+                 l->tile_size * l->landscape_size < position->x ||
+                 l->tile_size * l->landscape_size < position->y);
     }
 
     Vector shell_direction;
-    vector_sub(&shell->position, &shell->previous_position, &shell_direction);
+    vector_sub(position, previous_position, &shell_direction);
     VECTOR_SCALE(&shell_direction, intersection);
-    vector_add(&shell->previous_position, &shell_direction, &shell->position);
+    vector_add(previous_position, &shell_direction, position);
     return false;
 }
@@ -19,21 +19,13 @@
 #define SHELL_EXPLOSION_DAMAGE 1000
 #define SHELL_EXPLOSION_RADIUS 20
 
-#pragma pack(push, 8)
-
-typedef struct Shell
-{
-    Vector position;
-    Vector previous_position;
-    Vector direction;
-    Bounding bounding;
-    double speed;
-    size_t id;
-} Shell;
-
-#pragma pack(pop)
-
-Shell *shell_create(const Vector *position, const Vector *direction);
-bool shell_tick(Shell *shell, const Landscape *landscape);
+// Index of shell in world, see world.h.
+typedef size_t ShellHandle;
+#define SHELL_NONE ((ShellHandle) -1)
+
+struct World;
+
+ShellHandle shell_create(struct World *w, const Vector *position, const Vector *direction);
+bool shell_tick(struct World *w, ShellHandle s, const Landscape *landscape);
 
 #endif /* __SHELL_H__ */
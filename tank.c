@@ -4,65 +4,33 @@
 #include <stdbool.h>
 
 #include "tank.h"
+#include "world.h"
 #include "landscape.h"
 #include "debug.h"
 
-static void __tank_change_turn(Tank *tank);
+static void __tank_change_turn(World *w, TankHandle t);
 static void __tank_change_engine_power(Tank *tank);
-static bool __tank_move(Tank *tank, const Landscape *l);
+static bool __tank_move(World *w, TankHandle t, const Landscape *l);
 static void __tank_rotate_turret(Tank *tank);
 
-void tank_initialize(Tank *tank, const Vector *position, const Vector *top, int team)
+void tank_initialize(World *w, TankHandle t, const Vector *position, const Vector *top, int team)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
     assert(position && top && "Bad geometry pointers.");
 
-    *tank = (Tank) {
-        .position          = { .x = position->x, .y = position->y, .z = position->z },
-        .previous_position = { .x = position->x, .y = position->y, .z = position->z },
-        .direction         = { .x  = 1, .y = 0, .z = 0 },
-        .orientation       = { .x = top->x, .y = top->y, .z = top->z },
-        .speed             = 0,
-        .bounding_primitives = {
-            {
-                .origin          = &tank->position,
-                .previous_origin = &tank->previous_position,
-                .orientation     = &tank->orientation,
-                .direction       = &tank->direction,
-                .offset          = { .x = 0, .y = 0, .z = 0 },
-                .speed           = &tank->speed,
-                .bounding_type   = bounding_box,
-                .data            = { .extent = TANK_BOUNDING_BOX_EXTENT }
-            },
-            {
-                .origin          = &tank->position,
-                .previous_origin = &tank->previous_position,
-                .orientation     = &tank->orientation,
-                .direction       = &tank->direction,
-                .offset          = { .x = 2, .y = 0, .z = TANK_BOUNDING_SPHERE_RADIUS },
-                .speed           = &tank->speed,
-                .bounding_type   = bounding_sphere,
-                .data            = { .radius = TANK_BOUNDING_SPHERE_RADIUS }
-            }
-        },
-        .bounding = {
-            .origin              = &tank->position,
-            .previous_origin     = &tank->previous_position,
-            .orientation         = &tank->orientation,
-            .direction           = &tank->direction,
-            .offset              = { .x = 0, .y = 0, .z = 0 },
-            .speed               = &tank->speed,
-            .bounding_type       = bounding_composite,
-            .data.composite_data = {
-                .children       = tank->bounding_primitives,
-                .children_count = TANK_BOUNDING_PRIMITIVES
-            }
-        },
-        .hp                      = TANK_HP,
+    w->tank_position[t]          = (Vector) { .x = position->x, .y = position->y, .z = position->z };
+    w->tank_previous_position[t] = (Vector) { .x = position->x, .y = position->y, .z = position->z };
+    w->tank_direction[t]         = (Vector) { .x = 1, .y = 0, .z = 0 };
+    w->tank_orientation[t]       = (Vector) { .x = top->x, .y = top->y, .z = top->z };
+    w->tank_speed[t]             = 0;
+    w->tank_hp[t]                = TANK_HP;
+    w->tank_fire_delay[t]        = 0;
+
+    w->tanks[t] = (Tank) {
         .team                    = team,
         .engine_power            = 0,
         .engine_power_target     = 0,
-        .fire_delay              = 0,
         .turret_direction        = { .x = 1, .y = 0, .z = 0 },
         .turret_direction_target = { .x = 1, .y = 0, .z = 0 },
         .turn_angle_target       = 0,
@@ -70,54 +38,59 @@ void tank_initialize(Tank *tank, const Vector *position, const Vector *top, int
         .last_shell_id           = -1
     };
 
-    tank_rotate_direction(&tank->direction, &(Vector) { .x = 0, .y = 0, .z = 1}, &tank->orientation);
+    tank_rotate_direction(&w->tank_direction[t], &(Vector) { .x = 0, .y = 0, .z = 1}, &w->tank_orientation[t]);
 }
 
-bool tank_tick(Tank *tank, const Landscape *l)
+bool tank_tick(World *w, TankHandle t, const Landscape *l)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
 
+    Tank *tank = &w->tanks[t];
     tank->statistics.ticks++;
     bool result = true;
 
-    if (0 != tank->fire_delay && -1 != tank->fire_delay)
+    if (0 != w->tank_fire_delay[t] && -1 != w->tank_fire_delay[t])
     {
-        tank->fire_delay--;
+        w->tank_fire_delay[t]--;
     }
 
     __tank_change_engine_power(tank);
-    result = __tank_move(tank, l);
-    __tank_change_turn(tank);
+    result = __tank_move(w, t, l);
+    __tank_change_turn(w, t);
     __tank_rotate_turret(tank);
 
     return result;
 }
 
-void tank_turn(Tank *tank, double turn_angle)
+void tank_turn(World *w, TankHandle t, double turn_angle)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
     assert(-M_PI <= turn_angle && turn_angle <= M_PI && "Bad turn angle.");
-    tank->turn_angle_target = turn_angle;
+    w->tanks[t].turn_angle_target = turn_angle;
 }
 
-void tank_look_at(Tank *tank, const Vector *look)
+void tank_look_at(World *w, TankHandle t, const Vector *look)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
     assert(look && "Bad look pointer.");
 
-    Vector t = *look;
-    VECTOR_NORMALIZE(&t);
+    Vector l = *look;
+    VECTOR_NORMALIZE(&l);
 
-    if (TANK_MIN_LOOK_Z <= t.z &&
-        TANK_MAX_LOOK_Z >= t.z)
+    if (TANK_MIN_LOOK_Z <= l.z &&
+        TANK_MAX_LOOK_Z >= l.z)
     {
-        tank->turret_direction_target = t;
+        w->tanks[t].turret_direction_target = l;
     }
 }
 
-void tank_set_engine_power(Tank *tank, int power)
+void tank_set_engine_power(World *w, TankHandle t, int power)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
 
     if (TANK_MIN_ENGINE_POWER > power)
     {
@@ -128,27 +101,29 @@ void tank_set_engine_power(Tank *tank, int power)
         power = TANK_MAX_ENGINE_POWER;
     }
 
-    tank->engine_power_target = (double) power;
+    w->tanks[t].engine_power_target = (double) power;
 }
 
-bool tank_shoot(Tank *tank)
+bool tank_shoot(World *w, TankHandle t)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
 
-    if (0 == tank->fire_delay)
+    if (0 == w->tank_fire_delay[t])
     {
-        tank->fire_delay = -1;
+        w->tank_fire_delay[t] = -1;
         return true;
     }
 
     return false;
 }
 
-double tank_get_heading(Tank *tank)
+double tank_get_heading(World *w, TankHandle t)
 {
-    assert(tank && "Bad tank pointer.");
-    double x = tank->direction.x;
-    double y = tank->direction.y;
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
+    double x = w->tank_direction[t].x;
+    double y = w->tank_direction[t].y;
     double s = x + y;
     y /= s;
     x /= s;
@@ -168,10 +143,10 @@ double tank_get_heading(Tank *tank)
     return 0.0;
 }
 
-static void __tank_change_turn(Tank *tank)
+static void __tank_change_turn(World *w, TankHandle t)
 {
-    assert(tank && "Bad tank pointer.");
-    tank_change_turn_worker(&tank->turn_angle_target, TANK_MAX_TURN_SPEED, &tank->direction, &tank->orientation);
+    assert(w && "Bad world pointer.");
+    tank_change_turn_worker(&w->tanks[t].turn_angle_target, TANK_MAX_TURN_SPEED, &w->tank_direction[t], &w->tank_orientation[t]);
 }
 
 void tank_change_turn_worker(double *turn_angle_target, double max_turn_speed, Vector *direction, Vector *orientation)
@@ -226,50 +201,60 @@ static void __tank_change_engine_power(Tank *tank)
     }
 }
 
-static bool __tank_move(Tank *tank, const Landscape *l)
+static bool __tank_move(World *w, TankHandle t, const Landscape *l)
 {
-    assert(tank && "Bad tank pointer.");
+    assert(w && "Bad world pointer.");
+
+    Vector *position          = &w->tank_position[t],
+           *previous_position = &w->tank_previous_position[t],
+           *direction         = &w->tank_direction[t],
+           *orientation       = &w->tank_orientation[t];
+    double *speed             = &w->tank_speed[t],
+           engine_power       = w->tanks[t].engine_power;
 
-    tank->previous_position = tank->position;
+    *previous_position = *position;
 
-    if (0 == tank->engine_power)
+    if (0 == engine_power)
     { // We hold brakes.
-        tank->speed = 0.0;
+        *speed = 0.0;
         return true;
     }
 
-    tank->speed = TANK_ENGINE_POWER_TO_SPEED_COEFFICIENT * tank->engine_power;
+    *speed = TANK_ENGINE_POWER_TO_SPEED_COEFFICIENT * engine_power;
+
+    Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
+    world_tank_bounding(w, t, bounding_primitives, &bounding);
 
     double k = 1.0;
     while (true)
     {
-        Vector t;
-        vector_scale(&tank->direction, k * tank->speed, &t);
-        vector_add(&tank->previous_position, &t, &tank->position);
-
-        if (tank->position.x < 0.0 ||
-            tank->position.y < 0.0 ||
-            tank->position.x > l->landscape_size * l->tile_size ||
-            tank->position.y > l->landscape_size * l->tile_size)
+        Vector d;
+        vector_scale(direction, k * *speed, &d);
+        vector_add(previous_position, &d, position);
+
+        if (position->x < 0.0 ||
+            position->y < 0.0 ||
+            position->x > l->landscape_size * l->tile_size ||
+            position->y > l->landscape_size * l->tile_size)
         {
-            tank->position = tank->previous_position;
+            *position = *previous_position;
             return false;
         }
 
-        if (composite_intersects_with_landscape(l, &tank->bounding))
+        if (composite_intersects_with_landscape(l, &bounding))
         {
-            tank->position.z = landscape_get_height_at(l, tank->position.x, tank->position.y);
+            position->z = landscape_get_height_at(l, position->x, position->y);
         }
 
-        vector_sub(&tank->position, &tank->previous_position, &t);
-        double new_speed = vector_length(&t);
+        vector_sub(position, previous_position, &d);
+        double new_speed = vector_length(&d);
 
-        if (vector_tolerance_eq(new_speed, tank->speed))
+        if (vector_tolerance_eq(new_speed, *speed))
         {
             break;
         }
 
-        if (new_speed > tank->speed)
+        if (new_speed > *speed)
         {
             k -= k / 2.0;
         }
@@ -281,9 +266,9 @@ static bool __tank_move(Tank *tank, const Landscape *l)
         break;
     }
 
-    Vector old_orientation = tank->orientation;
-    landscape_get_normal_at(l, tank->position.x, tank->position.y, &tank->orientation);
-    tank_rotate_direction(&tank->direction, &old_orientation, &tank->orientation);
+    Vector old_orientation = *orientation;
+    landscape_get_normal_at(l, position->x, position->y, orientation);
+    tank_rotate_direction(direction, &old_orientation, orientation);
 
     return true;
 }
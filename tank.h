@@ -25,6 +25,12 @@
 #define TANK_GUN_LENGTH 15
 #define TANK_BOUNDING_PRIMITIVES 2
 
+// Index of tank slot in world, see world.h.
+typedef size_t TankHandle;
+#define TANK_NONE ((TankHandle) -1)
+
+struct World;
+
 #pragma pack(push, 8)
 
 typedef struct TankStatistics
@@ -37,21 +43,11 @@ typedef struct TankStatistics
     size_t got_hits;
 } TankStatistics;
 
+// Rarely used tank fields. Position, direction, orientation, speed, hp and fire delay are world arrays.
 typedef struct Tank
 {
-    // Common game object fields.
-    Vector position;
-    Vector previous_position;
-    Vector direction; // Look.
-    Vector orientation; // Top.
-    double speed;
-    Bounding bounding_primitives[TANK_BOUNDING_PRIMITIVES], bounding;
-
-    // Tank-specific fields.
-    int hp;
     int team;
     double engine_power, engine_power_target;
-    int fire_delay; // In ticks.
     Vector turret_direction, turret_direction_target;
     double turn_angle_target;
 
@@ -61,18 +57,18 @@ typedef struct Tank
 
 #pragma pack(pop)
 
-void tank_initialize(Tank *tank, const Vector *position, const Vector *top, int team);
-bool tank_tick(Tank *tank, const Landscape *l);
+void tank_initialize(struct World *w, TankHandle t, const Vector *position, const Vector *top, int team);
+bool tank_tick(struct World *w, TankHandle t, const Landscape *l);
 
 void tank_rotate_direction(Vector *direction, const Vector *old_orientation, const Vector *orientation);
 void tank_change_turn_worker(double *turn_angle_target, double max_turn_speed, Vector *direction, Vector *orientation);
 void tank_rotate_turret_worker(Vector *turret_direction_target, Vector *turret_direction, double max_turret_turn_speed);
 
 // Protocol functions.
-void tank_turn(Tank *tank, double turn_angle);
-void tank_look_at(Tank *tank, const Vector *look);
-void tank_set_engine_power(Tank *tank, int power);
-bool tank_shoot(Tank *tank);
-double tank_get_heading(Tank *tank);
+void tank_turn(struct World *w, TankHandle t, double turn_angle);
+void tank_look_at(struct World *w, TankHandle t, const Vector *look);
+void tank_set_engine_power(struct World *w, TankHandle t, int power);
+bool tank_shoot(struct World *w, TankHandle t);
+double tank_get_heading(struct World *w, TankHandle t);
 
 #endif /* __TANK_H__ */
@@ -0,0 +1,511 @@
+// terrain_mesh.c - chunked terrain mesh with distance-based LOD.
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "terrain_mesh.h"
+
+static void __build_indices(TerrainMesh *m);
+static void __build_chunk(TerrainMesh *m, const Landscape *l, size_t chunk);
+static TerrainVertex __node_vertex(const Landscape *l, size_t i, size_t j);
+static void __coarse_vertex(const TerrainVertex *v, size_t size, size_t a, size_t b, TerrainVertex *result);
+static double __box_distance(const TerrainChunk *c, double x, double y, double z, bool farthest);
+
+TerrainMesh *terrain_mesh_create(const Landscape *l)
+{
+    assert(l && "Bad landscape pointer.");
+    assert(1 < l->landscape_size && "Bad landscape size.");
+
+    TerrainMesh *m = NULL;
+    check_mem(m = (TerrainMesh *) calloc(1, sizeof(TerrainMesh)));
+
+    size_t tiles = l->landscape_size - 1;
+    m->chunks_per_side = (tiles + TERRAIN_CHUNK_TILES - 1) / TERRAIN_CHUNK_TILES;
+    m->chunk_count = m->chunks_per_side * m->chunks_per_side;
+    m->chunk_world_size = (double) TERRAIN_CHUNK_TILES * l->tile_size;
+
+    for (size_t level = 0; level < TERRAIN_LOD_LEVELS; level++)
+    {
+        size_t size = TERRAIN_CHUNK_TILES >> level;
+        m->level_size[level] = size;
+        m->level_vertex_offset[level] = m->chunk_vertex_count;
+        m->level_index_offset[level] = m->index_count;
+        m->level_index_count[level] = 6 * size * size;
+
+        m->chunk_vertex_count += (size + 1) * (size + 1);
+        m->index_count += m->level_index_count[level];
+    }
+
+    m->vertex_count = m->chunk_count * m->chunk_vertex_count;
+
+    check_mem(m->chunks = (TerrainChunk *) calloc(m->chunk_count, sizeof(TerrainChunk)));
+    check_mem(m->vertices = (TerrainVertex *) malloc(m->vertex_count * sizeof(TerrainVertex)));
+    check_mem(m->indices = (uint16_t *) malloc(m->index_count * sizeof(uint16_t)));
+
+    __build_indices(m);
+    for (size_t chunk = 0; chunk < m->chunk_count; chunk++)
+    {
+        __build_chunk(m, l, chunk);
+    }
+
+    return m;
+
+    error:
+    if (m)
+    {
+        terrain_mesh_destroy(m);
+    }
+
+    return NULL;
+}
+
+void terrain_mesh_destroy(TerrainMesh *m)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    free(m->chunks);
+    free(m->vertices);
+    free(m->indices);
+    free(m);
+}
+
+const TerrainVertex *terrain_mesh_get_vertices(const TerrainMesh *m, size_t chunk, size_t level)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(chunk < m->chunk_count && "Bad chunk.");
+    assert(level < TERRAIN_LOD_LEVELS && "Bad level.");
+    return &m->vertices[chunk * m->chunk_vertex_count + m->level_vertex_offset[level]];
+}
+
+const uint16_t *terrain_mesh_get_indices(const TerrainMesh *m, size_t level)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(level < TERRAIN_LOD_LEVELS && "Bad level.");
+    return &m->indices[m->level_index_offset[level]];
+}
+
+size_t terrain_mesh_get_level_vertex_count(const TerrainMesh *m, size_t level)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(level < TERRAIN_LOD_LEVELS && "Bad level.");
+    return (m->level_size[level] + 1) * (m->level_size[level] + 1);
+}
+
+double terrain_mesh_get_level_range(const TerrainMesh *m, size_t level)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(level < TERRAIN_LOD_LEVELS && "Bad level.");
+    return TERRAIN_LOD_RANGE * m->chunk_world_size * (double) (1 << level);
+}
+
+size_t terrain_mesh_select_level(const TerrainMesh *m, size_t chunk, double camera_x, double camera_y, double camera_z)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(chunk < m->chunk_count && "Bad chunk.");
+
+    double distance = __box_distance(&m->chunks[chunk], camera_x, camera_y, camera_z, false);
+    for (size_t level = 0; level < TERRAIN_LOD_LEVELS - 1; level++)
+    {
+        if (distance < terrain_mesh_get_level_range(m, level))
+        {
+            return level;
+        }
+    }
+
+    return TERRAIN_LOD_LEVELS - 1;
+}
+
+bool terrain_mesh_is_morphed(const TerrainMesh *m, size_t chunk, size_t level, double camera_x, double camera_y, double camera_z)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(chunk < m->chunk_count && "Bad chunk.");
+    assert(level < TERRAIN_LOD_LEVELS && "Bad level.");
+
+    return TERRAIN_LOD_LEVELS - 1 != level &&
+           TERRAIN_MORPH_START * terrain_mesh_get_level_range(m, level) < __box_distance(&m->chunks[chunk], camera_x, camera_y, camera_z, true);
+}
+
+void terrain_mesh_morph(const TerrainMesh *m,
+                        size_t chunk,
+                        size_t level,
+                        double camera_x,
+                        double camera_y,
+                        double camera_z,
+                        TerrainVertex *result)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(result && "Bad result pointer.");
+
+    const TerrainVertex *v = terrain_mesh_get_vertices(m, chunk, level);
+    memcpy(result, v, terrain_mesh_get_level_vertex_count(m, level) * sizeof(TerrainVertex));
+
+    if (TERRAIN_LOD_LEVELS - 1 == level)
+    {
+        return;
+    }
+
+    double range = terrain_mesh_get_level_range(m, level),
+           morph_start = TERRAIN_MORPH_START * range;
+    size_t size = m->level_size[level];
+
+    for (size_t a = 0; a <= size; a++)
+    {
+        for (size_t b = 0; b <= size; b++)
+        {
+            const TerrainVertex *p = &v[a * (size + 1) + b];
+            double dx = p->x - camera_x,
+                   dy = p->y - camera_y,
+                   dz = p->z - camera_z,
+                   t = (sqrt(dx * dx + dy * dy + dz * dz) - morph_start) / (range - morph_start);
+
+            if (0.0 >= t)
+            {
+                continue;
+            }
+
+            t = min(t, 1.0);
+
+            TerrainVertex target;
+            __coarse_vertex(v, size, a, b, &target);
+
+            TerrainVertex *r = &result[a * (size + 1) + b];
+            r->z = (float) (p->z + (target.z - p->z) * t);
+
+            double nx = p->nx + (target.nx - p->nx) * t,
+                   ny = p->ny + (target.ny - p->ny) * t,
+                   nz = p->nz + (target.nz - p->nz) * t,
+                   length = sqrt(nx * nx + ny * ny + nz * nz);
+            r->nx = (float) (nx / length);
+            r->ny = (float) (ny / length);
+            r->nz = (float) (nz / length);
+        }
+    }
+}
+
+// Quads are split along (0, 1) - (1, 0) diagonal, like landscape_get_height_at() does,
+// so triangles of each level lie inside triangles of next one.
+static void __build_indices(TerrainMesh *m)
+{
+    assert(m && "Bad terrain mesh pointer.");
+
+    for (size_t level = 0; level < TERRAIN_LOD_LEVELS; level++)
+    {
+        size_t size = m->level_size[level];
+        uint16_t *index = &m->indices[m->level_index_offset[level]];
+
+        for (size_t a = 0; a < size; a++)
+        {
+            for (size_t b = 0; b < size; b++)
+            {
+                uint16_t v00 = (uint16_t) (a * (size + 1) + b),
+                         v01 = (uint16_t) (v00 + 1),
+                         v10 = (uint16_t) (v00 + size + 1),
+                         v11 = (uint16_t) (v10 + 1);
+
+                *index++ = v00;
+                *index++ = v01;
+                *index++ = v10;
+                *index++ = v10;
+                *index++ = v01;
+                *index++ = v11;
+            }
+        }
+    }
+}
+
+static void __build_chunk(TerrainMesh *m, const Landscape *l, size_t chunk)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(l && "Bad landscape pointer.");
+
+    size_t last_node = l->landscape_size - 1,
+           first_i = (chunk / m->chunks_per_side) * TERRAIN_CHUNK_TILES,
+           first_j = (chunk % m->chunks_per_side) * TERRAIN_CHUNK_TILES;
+
+    for (size_t level = 0; level < TERRAIN_LOD_LEVELS; level++)
+    {
+        size_t size = m->level_size[level],
+               stride = (size_t) 1 << level;
+        TerrainVertex *v = (TerrainVertex *) terrain_mesh_get_vertices(m, chunk, level);
+
+        for (size_t a = 0; a <= size; a++)
+        {
+            for (size_t b = 0; b <= size; b++)
+            {
+                *v++ = __node_vertex(l, min(first_i + a * stride, last_node), min(first_j + b * stride, last_node));
+            }
+        }
+    }
+
+    // Full detail level holds every node of chunk.
+    const TerrainVertex *v = terrain_mesh_get_vertices(m, chunk, 0);
+    TerrainChunk *c = &m->chunks[chunk];
+    *c = (TerrainChunk) { v->x, v->y, v->z, v->x, v->y, v->z };
+
+    for (size_t i = 1; i < terrain_mesh_get_level_vertex_count(m, 0); i++)
+    {
+        c->min_x = min(c->min_x, v[i].x);
+        c->min_y = min(c->min_y, v[i].y);
+        c->min_z = min(c->min_z, v[i].z);
+        c->max_x = max(c->max_x, v[i].x);
+        c->max_y = max(c->max_y, v[i].y);
+        c->max_z = max(c->max_z, v[i].z);
+    }
+}
+
+// Node (i, j) is at (j, i) tiles, normal is taken from central differences of heights.
+static TerrainVertex __node_vertex(const Landscape *l, size_t i, size_t j)
+{
+    assert(l && "Bad landscape pointer.");
+
+    size_t last_node = l->landscape_size - 1,
+           i0 = 0 < i ? i - 1 : i,
+           i1 = min(i + 1, last_node),
+           j0 = 0 < j ? j - 1 : j,
+           j1 = min(j + 1, last_node);
+
+    double ts = (double) l->tile_size,
+           dzdx = (landscape_get_height_at_node(l, i, j1) - landscape_get_height_at_node(l, i, j0)) / ((j1 - j0) * ts),
+           dzdy = (landscape_get_height_at_node(l, i1, j) - landscape_get_height_at_node(l, i0, j)) / ((i1 - i0) * ts),
+           length = sqrt(dzdx * dzdx + dzdy * dzdy + 1.0);
+
+    return (TerrainVertex) {
+        .x  = (float) (j * ts),
+        .y  = (float) (i * ts),
+        .z  = (float) landscape_get_height_at_node(l, i, j),
+        .nx = (float) (-dzdx / length),
+        .ny = (float) (-dzdy / length),
+        .nz = (float) (1.0 / length)
+    };
+}
+
+// Point of next level's surface under vertex (a, b). Next level consists of even vertices of this one.
+static void __coarse_vertex(const TerrainVertex *v, size_t size, size_t a, size_t b, TerrainVertex *result)
+{
+    assert(v && "Bad vertices pointer.");
+    assert(0 == size % 2 && "Level has no next one.");
+    assert(result && "Bad result pointer.");
+
+    size_t a0 = a & ~(size_t) 1,
+           a1 = min(a0 + 2, size),
+           b0 = b & ~(size_t) 1,
+           b1 = min(b0 + 2, size);
+
+    const TerrainVertex *p   = &v[a * (size + 1) + b],
+                        *v00 = &v[a0 * (size + 1) + b0],
+                        *v01 = &v[a0 * (size + 1) + b1],
+                        *v10 = &v[a1 * (size + 1) + b0],
+                        *v11 = &v[a1 * (size + 1) + b1];
+
+    // Fractions are taken from positions, since nodes out of landscape are clamped to its edge.
+    double fi = v10->y > v00->y ? (p->y - v00->y) / (v10->y - v00->y) : 0.0,
+           fj = v01->x > v00->x ? (p->x - v00->x) / (v01->x - v00->x) : 0.0;
+
+    *result = *p;
+
+#define __COARSE(field)                                                                        \
+    result->field = (float) (1.0 >= fi + fj ?                                                  \
+        v00->field + fj * (v01->field - v00->field) + fi * (v10->field - v00->field) :         \
+        v11->field + (1.0 - fj) * (v10->field - v11->field) + (1.0 - fi) * (v01->field - v11->field))
+
+    __COARSE(z);
+    __COARSE(nx);
+    __COARSE(ny);
+    __COARSE(nz);
+
+#undef __COARSE
+}
+
+static double __box_distance(const TerrainChunk *c, double x, double y, double z, bool farthest)
+{
+    assert(c && "Bad chunk pointer.");
+
+    double dx = farthest ? max(fabs(x - c->min_x), fabs(x - c->max_x)) : max(max(c->min_x - x, x - c->max_x), 0.0),
+           dy = farthest ? max(fabs(y - c->min_y), fabs(y - c->max_y)) : max(max(c->min_y - y, y - c->max_y), 0.0),
+           dz = farthest ? max(fabs(z - c->min_z), fabs(z - c->max_z)) : max(max(c->min_z - z, z - c->max_z), 0.0);
+
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+#if defined(TERRAIN_MESH_TESTS)
+#include <stdio.h>
+
+#include "testhelp.h"
+
+#define TEST_LANDSCAPE_SIZE 500 // Last chunk is partial.
+#define TEST_TILE_SIZE 16
+
+static bool __vertex_eq(const TerrainVertex *v1, const TerrainVertex *v2)
+{
+    return 1e-3 > fabs(v1->x - v2->x) && 1e-3 > fabs(v1->y - v2->y) && 1e-3 > fabs(v1->z - v2->z);
+}
+
+// Height of chunk's border polyline at given coordinate along it.
+static double __edge_z(const TerrainVertex *v, size_t size, bool vertical, size_t line, double coordinate)
+{
+    for (size_t k = 0; k < size; k++)
+    {
+        const TerrainVertex *p = vertical ? &v[k * (size + 1) + line] : &v[line * (size + 1) + k],
+                            *q = vertical ? &v[(k + 1) * (size + 1) + line] : &v[line * (size + 1) + k + 1];
+        double from = vertical ? p->y : p->x,
+               to   = vertical ? q->y : q->x;
+
+        if (from <= coordinate && coordinate <= to)
+        {
+            return to > from ? p->z + (q->z - p->z) * (coordinate - from) / (to - from) : p->z;
+        }
+    }
+
+    return nan(NULL);
+}
+
+// Checks that common border of chunk c1 and its right (vertical) or bottom neighbour c2 has no cracks.
+static bool __edge_matches(const TerrainMesh *m, size_t c1, size_t c2, bool vertical, double x, double y, double z)
+{
+    static TerrainVertex v1[(TERRAIN_CHUNK_TILES + 1) * (TERRAIN_CHUNK_TILES + 1)],
+                         v2[(TERRAIN_CHUNK_TILES + 1) * (TERRAIN_CHUNK_TILES + 1)];
+
+    size_t l1 = terrain_mesh_select_level(m, c1, x, y, z),
+           l2 = terrain_mesh_select_level(m, c2, x, y, z);
+    terrain_mesh_morph(m, c1, l1, x, y, z, v1);
+    terrain_mesh_morph(m, c2, l2, x, y, z, v2);
+
+    size_t s1 = m->level_size[l1],
+           s2 = m->level_size[l2];
+    for (size_t k = 0; k <= s1; k++)
+    {
+        const TerrainVertex *p = vertical ? &v1[k * (s1 + 1) + s1] : &v1[s1 * (s1 + 1) + k];
+        double z2 = __edge_z(v2, s2, vertical, 0, vertical ? p->y : p->x);
+        if (!(1e-3 > fabs(p->z - z2)))
+        {
+            return false;
+        }
+    }
+
+    for (size_t k = 0; k <= s2; k++)
+    {
+        const TerrainVertex *p = vertical ? &v2[k * (s2 + 1)] : &v2[k];
+        double z1 = __edge_z(v1, s1, vertical, s1, vertical ? p->y : p->x);
+        if (!(1e-3 > fabs(p->z - z1)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    Landscape *l = landscape_create(TEST_LANDSCAPE_SIZE, TEST_TILE_SIZE, 1.0);
+    test_cond("Create landscape.", l);
+
+    unsigned seed = 1;
+    for (size_t i = 0; i < TEST_LANDSCAPE_SIZE; i++)
+    {
+        for (size_t j = 0; j < TEST_LANDSCAPE_SIZE; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            landscape_set_height_at_node(l, i, j, (double) ((seed >> 16) & 0xff));
+        }
+    }
+
+    TerrainMesh *m = terrain_mesh_create(l);
+    test_cond("Create mesh.", m);
+    test_cond("Chunks.",
+              (TEST_LANDSCAPE_SIZE + TERRAIN_CHUNK_TILES - 2) / TERRAIN_CHUNK_TILES == m->chunks_per_side &&
+              m->chunks_per_side * m->chunks_per_side == m->chunk_count);
+
+    bool indices_ok = true;
+    for (size_t level = 0; level < TERRAIN_LOD_LEVELS; level++)
+    {
+        const uint16_t *indices = terrain_mesh_get_indices(m, level);
+        for (size_t i = 0; i < m->level_index_count[level]; i++)
+        {
+            indices_ok = indices_ok && indices[i] < terrain_mesh_get_level_vertex_count(m, level);
+        }
+    }
+    test_cond("Indices are in range.", indices_ok && 6 * 2 * 2 == m->level_index_count[TERRAIN_LOD_LEVELS - 1]);
+
+    const TerrainVertex *v = terrain_mesh_get_vertices(m, m->chunks_per_side + 1, 1);
+    test_cond("Vertex position.",
+              TERRAIN_CHUNK_TILES * TEST_TILE_SIZE + 2 * TEST_TILE_SIZE == v[1].x &&
+              TERRAIN_CHUNK_TILES * TEST_TILE_SIZE == v[0].y &&
+              landscape_get_height_at_node(l, TERRAIN_CHUNK_TILES, TERRAIN_CHUNK_TILES + 2) == v[1].z);
+
+    v = terrain_mesh_get_vertices(m, m->chunk_count - 1, 0);
+    TerrainVertex last = v[terrain_mesh_get_level_vertex_count(m, 0) - 1];
+    test_cond("Nodes are clamped to landscape.",
+              (TEST_LANDSCAPE_SIZE - 1) * TEST_TILE_SIZE == last.x &&
+              (TEST_LANDSCAPE_SIZE - 1) * TEST_TILE_SIZE == last.y &&
+              last.x == m->chunks[m->chunk_count - 1].max_x);
+
+    bool normals_ok = true;
+    for (size_t i = 0; i < m->vertex_count; i++)
+    {
+        const TerrainVertex *p = &m->vertices[i];
+        normals_ok = normals_ok && 1e-4 > fabs(1.0 - sqrt(p->nx * p->nx + p->ny * p->ny + p->nz * p->nz)) && 0.0 < p->nz;
+    }
+    test_cond("Normals.", normals_ok);
+
+    test_cond("Near chunk is detailed.", 0 == terrain_mesh_select_level(m, 0, 0.0, 0.0, 0.0));
+    test_cond("Far chunk is coarse.", TERRAIN_LOD_LEVELS - 1 == terrain_mesh_select_level(m, 0, 1e6, 1e6, 0.0));
+    test_cond("Near chunk isn't morphed.", !terrain_mesh_is_morphed(m, 0, 0, 0.0, 0.0, 0.0));
+
+    TerrainVertex morphed[(TERRAIN_CHUNK_TILES + 1) * (TERRAIN_CHUNK_TILES + 1)];
+    terrain_mesh_morph(m, 0, 0, 0.0, 0.0, 0.0, morphed);
+    test_cond("Unmorphed vertices.", 0 == memcmp(morphed, terrain_mesh_get_vertices(m, 0, 0), sizeof(morphed)));
+
+    terrain_mesh_morph(m, 0, 0, 1e6, 1e6, 0.0, morphed);
+    v = terrain_mesh_get_vertices(m, 0, 0);
+    size_t side = TERRAIN_CHUNK_TILES + 1;
+    test_cond("Fully morphed vertices.",
+              __vertex_eq(&morphed[0], &v[0]) &&
+              1e-3 > fabs(morphed[1].z - (v[0].z + v[2].z) / 2) &&
+              1e-3 > fabs(morphed[side].z - (v[0].z + v[2 * side].z) / 2) &&
+              1e-3 > fabs(morphed[side + 1].z - (v[2].z + v[2 * side].z) / 2));
+    test_cond("Morph is in range.", terrain_mesh_is_morphed(m, 0, 0, 1e6, 1e6, 0.0) &&
+                                    !terrain_mesh_is_morphed(m, 0, TERRAIN_LOD_LEVELS - 1, 1e6, 1e6, 0.0));
+
+    bool levels_ok = true, edges_ok = true;
+    double world_size = (TEST_LANDSCAPE_SIZE - 1) * TEST_TILE_SIZE;
+    for (double x = -0.5 * world_size; x <= 1.5 * world_size; x += world_size / 7)
+    {
+        for (double y = -0.5 * world_size; y <= 1.5 * world_size; y += world_size / 5)
+        {
+            for (double z = 0.0; z <= 2048.0; z += 1024.0)
+            {
+                for (size_t c = 0; c < m->chunk_count; c++)
+                {
+                    size_t level = terrain_mesh_select_level(m, c, x, y, z);
+
+                    if (m->chunks_per_side - 1 != c % m->chunks_per_side)
+                    {
+                        size_t right = terrain_mesh_select_level(m, c + 1, x, y, z);
+                        levels_ok = levels_ok && 1 >= max(level, right) - min(level, right);
+                        edges_ok = edges_ok && __edge_matches(m, c, c + 1, true, x, y, z);
+                    }
+
+                    if (c + m->chunks_per_side < m->chunk_count)
+                    {
+                        size_t bottom = terrain_mesh_select_level(m, c + m->chunks_per_side, x, y, z);
+                        levels_ok = levels_ok && 1 >= max(level, bottom) - min(level, bottom);
+                        edges_ok = edges_ok && __edge_matches(m, c, c + m->chunks_per_side, false, x, y, z);
+                    }
+                }
+            }
+        }
+    }
+    test_cond("Neighbour chunks differ by one level at most.", levels_ok);
+    test_cond("No cracks between chunks.", edges_ok);
+
+    terrain_mesh_destroy(m);
+    landscape_destroy(l);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,93 @@
+// terrain_mesh.h - chunked terrain mesh with distance-based LOD.
+
+#pragma once
+#ifndef __TERRAIN_MESH_H__
+#define __TERRAIN_MESH_H__
+
+//#pragma message("__TERRAIN_MESH_H__")
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "morrigan.h"
+#include "landscape.h"
+
+// Chunk side in tiles at full detail, power of two. Level l samples every 2 ^ l-th node,
+// so coarsest level still has 2 x 2 tiles and may be morphed from.
+#define TERRAIN_CHUNK_TILES 32
+#define TERRAIN_LOD_LEVELS 5
+// Level l is drawn up to TERRAIN_LOD_RANGE * 2 ^ l chunk sizes from camera, coarsest one - at any distance.
+// Range must exceed chunk diagonal twice, so neighbour chunks differ by one level at most
+// and coarser neighbour doesn't morph at their common edge.
+#define TERRAIN_LOD_RANGE 4.0
+// Vertices are morphed into next level over last quarter of level's range.
+#define TERRAIN_MORPH_START 0.75
+
+#pragma pack(push, 4)
+
+// Interleaved as expected by glVertexPointer() / glNormalPointer().
+typedef struct TerrainVertex
+{
+    float x, y, z;
+    float nx, ny, nz;
+} TerrainVertex;
+
+#pragma pack(pop)
+
+#pragma pack(push, 8)
+
+typedef struct TerrainChunk
+{
+    float min_x, min_y, min_z;
+    float max_x, max_y, max_z;
+} TerrainChunk;
+
+// Vertices of chunk c at level l start at c * chunk_vertex_count + level_vertex_offset[l],
+// they are (level_size[l] + 1) ^ 2 nodes row by row. Nodes out of landscape are clamped to its edge.
+// Index lists are shared by all chunks and are relative to level's first vertex.
+typedef struct TerrainMesh
+{
+    size_t chunks_per_side;
+    size_t chunk_count;
+    double chunk_world_size;
+    TerrainChunk *chunks;
+
+    size_t level_size[TERRAIN_LOD_LEVELS]; // In tiles.
+    size_t level_vertex_offset[TERRAIN_LOD_LEVELS];
+    size_t level_index_offset[TERRAIN_LOD_LEVELS];
+    size_t level_index_count[TERRAIN_LOD_LEVELS];
+
+    size_t chunk_vertex_count; // All levels of one chunk.
+    size_t vertex_count;
+    TerrainVertex *vertices;
+    size_t index_count;
+    uint16_t *indices;
+} TerrainMesh;
+
+#pragma pack(pop)
+
+TerrainMesh *terrain_mesh_create(const Landscape *l);
+void terrain_mesh_destroy(TerrainMesh *m);
+
+const TerrainVertex *terrain_mesh_get_vertices(const TerrainMesh *m, size_t chunk, size_t level);
+const uint16_t *terrain_mesh_get_indices(const TerrainMesh *m, size_t level);
+size_t terrain_mesh_get_level_vertex_count(const TerrainMesh *m, size_t level);
+
+// Distance at which level ends, i.e. its vertices are fully morphed into next level.
+double terrain_mesh_get_level_range(const TerrainMesh *m, size_t level);
+// Finest level whose range covers nearest point of chunk.
+size_t terrain_mesh_select_level(const TerrainMesh *m, size_t chunk, double camera_x, double camera_y, double camera_z);
+// Whether any vertex of chunk at level is morphed, i.e. terrain_mesh_morph() is needed instead of static vertices.
+bool terrain_mesh_is_morphed(const TerrainMesh *m, size_t chunk, size_t level, double camera_x, double camera_y, double camera_z);
+// Writes terrain_mesh_get_level_vertex_count() vertices of chunk at level, each moved towards
+// next level's surface by its distance to camera.
+void terrain_mesh_morph(const TerrainMesh *m,
+                        size_t chunk,
+                        size_t level,
+                        double camera_x,
+                        double camera_y,
+                        double camera_z,
+                        TerrainVertex *result);
+
+#endif /* __TERRAIN_MESH_H__ */
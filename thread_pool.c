@@ -0,0 +1,297 @@
+// thread_pool.c - work-stealing thread pool for data-parallel loops.
+
+#include <assert.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "thread_pool.h"
+
+#define QUEUE_RANGE(head, tail) ((uint_fast64_t) (head) | ((uint_fast64_t) (tail) << 32))
+#define QUEUE_HEAD(range) ((size_t) ((range) & 0xffffffff))
+#define QUEUE_TAIL(range) ((size_t) ((range) >> 32))
+
+static int __thread_pool_worker(void *param);
+static void __thread_pool_work(ThreadPool *p, size_t self);
+static bool __queue_pop_head(ThreadPoolQueue *q, size_t *chunk);
+static bool __queue_pop_tail(ThreadPoolQueue *q, size_t *chunk);
+
+typedef struct ThreadPoolWorkerParam
+{
+    ThreadPool *pool;
+    size_t index;
+} ThreadPoolWorkerParam;
+
+ThreadPool *thread_pool_create(size_t thread_count)
+{
+    assert(THREAD_POOL_MAX_THREADS >= thread_count && "Bad thread count.");
+
+    ThreadPool *p = (ThreadPool *) calloc(1, sizeof(ThreadPool));
+    check_mem(p);
+
+    for (size_t i = 0; i <= THREAD_POOL_MAX_THREADS; i++)
+    {
+        atomic_init(&p->queues[i].range, QUEUE_RANGE(0, 0));
+    }
+
+    check(thrd_success == mtx_init(&p->submit_mutex, mtx_plain), "Failed to initialize submit mutex.", "");
+    check(thrd_success == mtx_init(&p->mutex, mtx_plain), "Failed to initialize pool mutex.", "");
+    check(thrd_success == cnd_init(&p->job_ready), "Failed to initialize condition variable.", "");
+    check(thrd_success == cnd_init(&p->job_done), "Failed to initialize condition variable.", "");
+
+    p->working = true;
+    for (p->thread_count = 0; p->thread_count < thread_count; p->thread_count++)
+    {
+        ThreadPoolWorkerParam *param = (ThreadPoolWorkerParam *) malloc(sizeof(ThreadPoolWorkerParam));
+        check_mem(param);
+        *param = (ThreadPoolWorkerParam) { .pool = p, .index = p->thread_count };
+
+        if (thrd_success != thrd_create(&p->threads[p->thread_count], __thread_pool_worker, param))
+        {
+            free(param);
+            sentinel("Failed to start pool thread.", "");
+        }
+    }
+
+    return p;
+    error:
+    if (p)
+    {
+        thread_pool_destroy(p);
+    }
+    return NULL;
+}
+
+void thread_pool_destroy(ThreadPool *p)
+{
+    assert(p && "Nothing to destroy.");
+
+    mtx_lock(&p->mutex);
+    p->working = false;
+    cnd_broadcast(&p->job_ready);
+    mtx_unlock(&p->mutex);
+
+    for (size_t i = 0; i < p->thread_count; i++)
+    {
+        thrd_join(p->threads[i], NULL);
+    }
+
+    cnd_destroy(&p->job_done);
+    cnd_destroy(&p->job_ready);
+    mtx_destroy(&p->mutex);
+    mtx_destroy(&p->submit_mutex);
+    free(p);
+}
+
+void thread_pool_parallel_for(ThreadPool *p, size_t count, size_t grain, ThreadPoolTask task, void *context)
+{
+    assert(task && "Bad task pointer.");
+    assert(grain && "Bad grain.");
+
+    if (0 == count)
+    {
+        return;
+    }
+
+    if (NULL == p ||
+        0 == p->thread_count ||
+        count <= grain ||
+        thrd_success != mtx_trylock(&p->submit_mutex))
+    {
+        task(context, 0, count);
+        return;
+    }
+
+    // Split chunks evenly between participants, remainder goes to first ones.
+    size_t chunk_count = (count + grain - 1) / grain,
+           participants = p->thread_count + 1,
+           first_chunk = 0;
+
+    for (size_t i = 0; i < participants; i++)
+    {
+        size_t share = chunk_count / participants + (i < chunk_count % participants ? 1 : 0);
+        atomic_store(&p->queues[i].range, QUEUE_RANGE(first_chunk, first_chunk + share));
+        first_chunk += share;
+    }
+
+    mtx_lock(&p->mutex);
+    p->task = task;
+    p->context = context;
+    p->count = count;
+    p->grain = grain;
+    p->job_generation++;
+    p->job_open = true;
+    cnd_broadcast(&p->job_ready);
+    mtx_unlock(&p->mutex);
+
+    __thread_pool_work(p, p->thread_count);
+
+    // All queues are empty now, but chunks may still run on other threads.
+    mtx_lock(&p->mutex);
+    p->job_open = false;
+    while (p->active_count)
+    {
+        cnd_wait(&p->job_done, &p->mutex);
+    }
+    mtx_unlock(&p->mutex);
+
+    mtx_unlock(&p->submit_mutex);
+}
+
+static int __thread_pool_worker(void *param)
+{
+    ThreadPoolWorkerParam worker_param = *(ThreadPoolWorkerParam *) param;
+    free(param);
+
+    ThreadPool *p = worker_param.pool;
+    unsigned long long seen_generation = 0;
+
+    mtx_lock(&p->mutex);
+    while (true)
+    {
+        while (p->working && (!p->job_open || seen_generation == p->job_generation))
+        {
+            cnd_wait(&p->job_ready, &p->mutex);
+        }
+
+        if (!p->working)
+        {
+            break;
+        }
+
+        seen_generation = p->job_generation;
+        p->active_count++;
+        mtx_unlock(&p->mutex);
+
+        __thread_pool_work(p, worker_param.index);
+
+        mtx_lock(&p->mutex);
+        if (0 == --p->active_count)
+        {
+            cnd_signal(&p->job_done);
+        }
+    }
+    mtx_unlock(&p->mutex);
+
+    return 0;
+}
+
+static void __thread_pool_work(ThreadPool *p, size_t self)
+{
+    assert(p && "Bad pool pointer.");
+
+    size_t participants = p->thread_count + 1;
+
+    while (true)
+    {
+        size_t chunk;
+        bool found = __queue_pop_head(&p->queues[self], &chunk);
+
+        for (size_t i = 1; !found && i < participants; i++)
+        {
+            found = __queue_pop_tail(&p->queues[(self + i) % participants], &chunk);
+        }
+
+        if (!found)
+        {
+            return;
+        }
+
+        size_t begin = chunk * p->grain;
+        p->task(p->context, begin, min(begin + p->grain, p->count));
+    }
+}
+
+static bool __queue_pop_head(ThreadPoolQueue *q, size_t *chunk)
+{
+    uint_fast64_t range = atomic_load(&q->range);
+
+    while (QUEUE_HEAD(range) < QUEUE_TAIL(range))
+    {
+        if (atomic_compare_exchange_weak(&q->range, &range, QUEUE_RANGE(QUEUE_HEAD(range) + 1, QUEUE_TAIL(range))))
+        {
+            *chunk = QUEUE_HEAD(range);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool __queue_pop_tail(ThreadPoolQueue *q, size_t *chunk)
+{
+    uint_fast64_t range = atomic_load(&q->range);
+
+    while (QUEUE_HEAD(range) < QUEUE_TAIL(range))
+    {
+        if (atomic_compare_exchange_weak(&q->range, &range, QUEUE_RANGE(QUEUE_HEAD(range), QUEUE_TAIL(range) - 1)))
+        {
+            *chunk = QUEUE_TAIL(range) - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#if defined(THREAD_POOL_TESTS)
+#include <stdio.h>
+
+#include "testhelp.h"
+
+#define TEST_COUNT 10007
+
+static atomic_int visits[TEST_COUNT];
+
+static void __visit_task(void *context, size_t begin, size_t end)
+{
+    #pragma ref context
+
+    for (size_t i = begin; i < end; i++)
+    {
+        atomic_fetch_add(&visits[i], 1);
+    }
+}
+
+static bool __all_visited(int times)
+{
+    for (size_t i = 0; i < TEST_COUNT; i++)
+    {
+        if (times != atomic_load(&visits[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    ThreadPool *p = thread_pool_create(3);
+    test_cond("Check pool creation.", p && 3 == p->thread_count);
+
+    thread_pool_parallel_for(p, TEST_COUNT, 16, __visit_task, NULL);
+    test_cond("Each index is visited once.", __all_visited(1));
+
+    thread_pool_parallel_for(p, TEST_COUNT, 1, __visit_task, NULL);
+    test_cond("Each index is visited once with grain 1.", __all_visited(2));
+
+    thread_pool_parallel_for(p, TEST_COUNT, TEST_COUNT, __visit_task, NULL);
+    test_cond("Single chunk is run on calling thread.", __all_visited(3));
+
+    thread_pool_parallel_for(NULL, TEST_COUNT, 16, __visit_task, NULL);
+    test_cond("No pool - loop is run on calling thread.", __all_visited(4));
+
+    thread_pool_destroy(p);
+
+    p = thread_pool_create(0);
+    test_cond("Check empty pool creation.", p && 0 == p->thread_count);
+    thread_pool_parallel_for(p, TEST_COUNT, 16, __visit_task, NULL);
+    test_cond("Empty pool runs loop on calling thread.", __all_visited(5));
+    thread_pool_destroy(p);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,64 @@
+// thread_pool.h - work-stealing thread pool for data-parallel loops.
+
+#pragma once
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+//#pragma message("__THREAD_POOL_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "morrigan.h"
+
+#define THREAD_POOL_MAX_THREADS 64
+#define THREAD_POOL_CACHE_LINE 64
+
+// Body of parallel loop: processes [begin; end) part of index range.
+typedef void (*ThreadPoolTask)(void *context, size_t begin, size_t end);
+
+#pragma pack(push, 8)
+
+// Chunk range of one participant: head in low 32 bits, tail in high 32 bits.
+// Owner pops from head, thieves pop from tail.
+typedef struct ThreadPoolQueue
+{
+    atomic_uint_fast64_t range;
+    char padding[THREAD_POOL_CACHE_LINE - sizeof(atomic_uint_fast64_t)];
+} ThreadPoolQueue;
+
+typedef struct ThreadPool
+{
+    thrd_t threads[THREAD_POOL_MAX_THREADS];
+    size_t thread_count;
+    ThreadPoolQueue queues[THREAD_POOL_MAX_THREADS + 1]; // Last one is for submitting thread.
+
+    mtx_t submit_mutex; // Only one loop runs at a time.
+    mtx_t mutex;
+    cnd_t job_ready;
+    cnd_t job_done;
+    bool working;
+    bool job_open;
+    unsigned long long job_generation;
+    size_t active_count;
+
+    ThreadPoolTask task;
+    void *context;
+    size_t count;
+    size_t grain;
+} ThreadPool;
+
+#pragma pack(pop)
+
+ThreadPool *thread_pool_create(size_t thread_count);
+void thread_pool_destroy(ThreadPool *p);
+
+// Runs task over [0; count) in chunks of grain indices. Returns when all chunks are done.
+// Chunks are processed in arbitrary order and on arbitrary threads, so task must write only
+// to index-owned data. If pool is busy with another loop, task is run on calling thread.
+void thread_pool_parallel_for(ThreadPool *p, size_t count, size_t grain, ThreadPoolTask task, void *context);
+
+#endif /* __THREAD_POOL_H__ */
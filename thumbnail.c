@@ -0,0 +1,466 @@
+// thumbnail.c - top-down match images rendered on CPU, PNG output.
+
+#include <assert.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "thumbnail.h"
+#include "tank.h"
+
+#define THUMBNAIL_MIN_TANK_RADIUS 3.0 // In pixels, so tanks are seen on large maps.
+#define THUMBNAIL_SHOOT_RADIUS 3.0    // In world units, as drawn by viewer.
+#define THUMBNAIL_EXPLOSION_RADIUS 5.0
+#define PNG_MAX_STORED_BLOCK 65535
+
+// Same palette as viewer's.
+static const uint8_t team_colors[][3] = {
+    { 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x80 }, { 0x00, 0x80, 0x00 }, { 0x00, 0x80, 0x80 },
+    { 0x80, 0x00, 0x00 }, { 0x80, 0x00, 0x80 }, { 0x80, 0x80, 0x00 }, { 0xc0, 0xc0, 0xc0 },
+    { 0x80, 0x80, 0x80 }, { 0x00, 0x00, 0xff }, { 0x00, 0xff, 0x00 }, { 0x00, 0xff, 0xff },
+    { 0xff, 0x00, 0x00 }, { 0xff, 0x00, 0xff }, { 0xff, 0xff, 0x00 }, { 0xff, 0xff, 0xff }
+};
+
+static double __world_size(const Landscape *l);
+static double __scale(const Thumbnail *t, const Landscape *l);
+static void __to_pixel(const Thumbnail *t, const Landscape *l, double x, double y, double *px, double *py);
+static double __height(const Landscape *l, double x, double y);
+static void __blend(Thumbnail *t, long x, long y, const uint8_t *color, double alpha);
+static void __fill_disc(Thumbnail *t, double cx, double cy, double radius, const uint8_t *color, double alpha);
+static void __draw_line(Thumbnail *t, double x0, double y0, double x1, double y1, const uint8_t *color);
+static uint32_t __crc32(uint32_t crc, const uint8_t *data, size_t size);
+static bool __write_be32(FILE *f, uint32_t v);
+static bool __write_chunk(FILE *f, const char *type, const uint8_t *data, size_t size);
+
+Thumbnail *thumbnail_create(size_t width, size_t height)
+{
+    assert(0 < width && THUMBNAIL_MAX_SIZE >= width && "Bad width.");
+    assert(0 < height && THUMBNAIL_MAX_SIZE >= height && "Bad height.");
+
+    Thumbnail *t = NULL;
+    check_mem(t = (Thumbnail *) calloc(1, sizeof(Thumbnail)));
+    check_mem(t->pixels = (uint8_t *) calloc(width * height, 3));
+    t->width = width;
+    t->height = height;
+    return t;
+
+    error:
+    if (t)
+    {
+        free(t);
+    }
+
+    return NULL;
+}
+
+void thumbnail_destroy(Thumbnail *t)
+{
+    assert(t && t->pixels && "Nothing to destroy.");
+    free(t->pixels);
+    free(t);
+}
+
+void thumbnail_copy(Thumbnail *dst, const Thumbnail *src)
+{
+    assert(dst && "Bad destination pointer.");
+    assert(src && "Bad source pointer.");
+    assert(dst->width == src->width && dst->height == src->height && "Sizes differ.");
+    memcpy(dst->pixels, src->pixels, src->width * src->height * 3);
+}
+
+void thumbnail_draw_landscape(Thumbnail *t, const Landscape *l)
+{
+    assert(t && "Bad thumbnail pointer.");
+    assert(l && "Bad landscape pointer.");
+
+    static const uint8_t grass[3] = { 0x22, 0x8b, 0x22 };
+
+    double min_height = l->height_map[0], max_height = l->height_map[0];
+    for (size_t i = 1; i < l->landscape_size * l->landscape_size; i++)
+    {
+        min_height = min(min_height, l->height_map[i]);
+        max_height = max(max_height, l->height_map[i]);
+    }
+
+    // Light comes from top left corner of image.
+    Vector light = { .x = -1.0, .y = 1.0, .z = 2.0 };
+    VECTOR_NORMALIZE(&light);
+
+    double world_size = __world_size(l),
+           step = max(world_size / t->width, (double) l->tile_size) / 2.0;
+
+    for (size_t py = 0; py < t->height; py++)
+    {
+        double y = world_size * (1.0 - (py + 0.5) / t->height);
+
+        for (size_t px = 0; px < t->width; px++)
+        {
+            double x = world_size * (px + 0.5) / t->width,
+                   h = __height(l, x, y);
+
+            Vector n = {
+                .x = (__height(l, x - step, y) - __height(l, x + step, y)) / (2.0 * step),
+                .y = (__height(l, x, y - step) - __height(l, x, y + step)) / (2.0 * step),
+                .z = 1.0
+            };
+            VECTOR_NORMALIZE(&n);
+
+            double shade = 0.35 + 0.65 * max(0.0, vector_mul(&n, &light)),
+                   tint = max_height > min_height ? 0.7 + 0.3 * (h - min_height) / (max_height - min_height) : 1.0;
+
+            uint8_t *p = &t->pixels[3 * (py * t->width + px)];
+            for (size_t c = 0; c < 3; c++)
+            {
+                p[c] = (uint8_t) min(255.0, grass[c] * shade * tint * 1.5);
+            }
+        }
+    }
+}
+
+void thumbnail_draw_tanks(Thumbnail *t, const Landscape *l, const ResGetTanksTankRecord *tanks, size_t tanks_count)
+{
+    assert(t && "Bad thumbnail pointer.");
+    assert(l && "Bad landscape pointer.");
+    assert(tanks && "Bad tanks pointer.");
+
+    static const uint8_t outline[3] = { 0x00, 0x00, 0x00 },
+                         gun[3]     = { 0xff, 0xff, 0xff };
+    static const Vector extent = TANK_BOUNDING_BOX_EXTENT;
+    double radius = max(THUMBNAIL_MIN_TANK_RADIUS, extent.x * __scale(t, l));
+
+    for (size_t i = 0; i < tanks_count; i++)
+    {
+        const ResGetTanksTankRecord *tank = &tanks[i];
+        const uint8_t *color = team_colors[tank->team % (sizeof(team_colors) / sizeof(team_colors[0]))];
+        double x, y;
+        __to_pixel(t, l, tank->x, tank->y, &x, &y);
+
+        // Dead tanks are left as dim spots.
+        double alpha = tank->hp ? 1.0 : 0.4;
+        __fill_disc(t, x, y, radius + 1.0, outline, alpha);
+        __fill_disc(t, x, y, radius, color, alpha);
+
+        if (!tank->hp)
+        {
+            continue;
+        }
+
+        // Image y goes down.
+        double turret_length = hypot(tank->turret_x, tank->turret_y);
+        if (0.0 < turret_length)
+        {
+            __draw_line(t,
+                        x,
+                        y,
+                        x + 2.0 * radius * tank->turret_x / turret_length,
+                        y - 2.0 * radius * tank->turret_y / turret_length,
+                        gun);
+        }
+    }
+}
+
+void thumbnail_draw_shoot(Thumbnail *t, const Landscape *l, const NotViewerShellEvent *e)
+{
+    assert(t && "Bad thumbnail pointer.");
+    assert(l && "Bad landscape pointer.");
+    assert(e && "Bad shoot pointer.");
+
+    static const uint8_t color[3] = { 0xff, 0xff, 0x00 };
+    double x, y;
+    __to_pixel(t, l, e->x, e->y, &x, &y);
+    __fill_disc(t, x, y, max(1.5, THUMBNAIL_SHOOT_RADIUS * __scale(t, l)), color, 0.8);
+}
+
+void thumbnail_draw_explosion(Thumbnail *t, const Landscape *l, const NotViewerShellEvent *e)
+{
+    assert(t && "Bad thumbnail pointer.");
+    assert(l && "Bad landscape pointer.");
+    assert(e && "Bad explosion pointer.");
+
+    static const uint8_t color[3] = { 0xcc, 0x00, 0x00 };
+    double x, y;
+    __to_pixel(t, l, e->x, e->y, &x, &y);
+    __fill_disc(t, x, y, max(2.5, THUMBNAIL_EXPLOSION_RADIUS * __scale(t, l)), color, 0.5);
+}
+
+// Truecolor 8 bit PNG. Image data isn't compressed: zlib stream consists of stored deflate blocks,
+// so no zlib is needed and thumbnails stay small enough at usual sizes.
+bool thumbnail_write_png(const Thumbnail *t, const char *filename)
+{
+    assert(t && "Bad thumbnail pointer.");
+    assert(filename && "Bad filename.");
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    FILE *f = NULL;
+    uint8_t *idat = NULL;
+
+    size_t row_size = 1 + 3 * t->width, // Filter type byte and pixels.
+           raw_size = row_size * t->height,
+           block_count = (raw_size + PNG_MAX_STORED_BLOCK - 1) / PNG_MAX_STORED_BLOCK,
+           idat_size = 2 + 5 * block_count + raw_size + 4;
+    check_mem(idat = (uint8_t *) malloc(idat_size));
+
+    uint8_t *p = idat;
+    *p++ = 0x78; // Deflate, 32K window.
+    *p++ = 0x01; // No preset dictionary, fastest compression, header checksum.
+
+    uint32_t adler_a = 1, adler_b = 0;
+    size_t block_left = 0, written = 0;
+    for (size_t row = 0; row < t->height; row++)
+    {
+        for (size_t i = 0; i < row_size; i++)
+        {
+            if (!block_left)
+            {
+                block_left = min(raw_size - written, (size_t) PNG_MAX_STORED_BLOCK);
+                *p++ = raw_size - written == block_left ? 1 : 0; // Final block flag, stored block type.
+                *p++ = (uint8_t) block_left;
+                *p++ = (uint8_t) (block_left >> 8);
+                *p++ = (uint8_t) ~block_left;
+                *p++ = (uint8_t) (~block_left >> 8);
+            }
+
+            uint8_t byte = i ? t->pixels[3 * row * t->width + i - 1] : 0;
+            *p++ = byte;
+            adler_a = (adler_a + byte) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+            block_left--;
+            written++;
+        }
+    }
+
+    uint32_t adler = (adler_b << 16) | adler_a;
+    *p++ = (uint8_t) (adler >> 24);
+    *p++ = (uint8_t) (adler >> 16);
+    *p++ = (uint8_t) (adler >> 8);
+    *p++ = (uint8_t) adler;
+    assert((size_t) (p - idat) == idat_size && "Bad IDAT size.");
+
+    uint8_t ihdr[13] = {
+        (uint8_t) (t->width >> 24), (uint8_t) (t->width >> 16), (uint8_t) (t->width >> 8), (uint8_t) t->width,
+        (uint8_t) (t->height >> 24), (uint8_t) (t->height >> 16), (uint8_t) (t->height >> 8), (uint8_t) t->height,
+        8, // Bit depth.
+        2, // Truecolor.
+        0, // Deflate.
+        0, // Adaptive filtering.
+        0  // No interlace.
+    };
+
+    check(f = fopen(filename, "wb"), "Failed to open %s.", filename);
+    check(sizeof(signature) == fwrite(signature, 1, sizeof(signature), f), "Failed to write PNG signature.", "");
+    check(__write_chunk(f, "IHDR", ihdr, sizeof(ihdr)), "Failed to write IHDR.", "");
+    check(__write_chunk(f, "IDAT", idat, idat_size), "Failed to write IDAT.", "");
+    check(__write_chunk(f, "IEND", NULL, 0), "Failed to write IEND.", "");
+    check(0 == fclose(f), "Failed to close %s.", filename);
+    f = NULL;
+
+    free(idat);
+    return true;
+
+    error:
+    if (f)
+    {
+        fclose(f);
+    }
+
+    free(idat);
+    return false;
+}
+
+static double __world_size(const Landscape *l)
+{
+    return (double) (l->landscape_size - 1) * l->tile_size;
+}
+
+// Pixels per world unit.
+static double __scale(const Thumbnail *t, const Landscape *l)
+{
+    return (double) min(t->width, t->height) / __world_size(l);
+}
+
+static void __to_pixel(const Thumbnail *t, const Landscape *l, double x, double y, double *px, double *py)
+{
+    double world_size = __world_size(l);
+    *px = x / world_size * t->width;
+    *py = (1.0 - y / world_size) * t->height;
+}
+
+static double __height(const Landscape *l, double x, double y)
+{
+    // Last row and column of nodes have no tiles after them.
+    double last = __world_size(l) * (1.0 - 1e-9);
+    return landscape_get_height_at(l, max(0.0, min(x, last)), max(0.0, min(y, last)));
+}
+
+static void __blend(Thumbnail *t, long x, long y, const uint8_t *color, double alpha)
+{
+    if (0 > x || 0 > y || (long) t->width <= x || (long) t->height <= y)
+    {
+        return;
+    }
+
+    uint8_t *p = &t->pixels[3 * ((size_t) y * t->width + (size_t) x)];
+    for (size_t c = 0; c < 3; c++)
+    {
+        p[c] = (uint8_t) (p[c] + (color[c] - p[c]) * alpha + 0.5);
+    }
+}
+
+static void __fill_disc(Thumbnail *t, double cx, double cy, double radius, const uint8_t *color, double alpha)
+{
+    for (long y = (long) floor(cy - radius); y <= (long) ceil(cy + radius); y++)
+    {
+        for (long x = (long) floor(cx - radius); x <= (long) ceil(cx + radius); x++)
+        {
+            double dx = x + 0.5 - cx,
+                   dy = y + 0.5 - cy;
+
+            if (dx * dx + dy * dy <= radius * radius)
+            {
+                __blend(t, x, y, color, alpha);
+            }
+        }
+    }
+}
+
+static void __draw_line(Thumbnail *t, double x0, double y0, double x1, double y1, const uint8_t *color)
+{
+    size_t steps = (size_t) ceil(max(fabs(x1 - x0), fabs(y1 - y0))) + 1;
+    for (size_t i = 0; i <= steps; i++)
+    {
+        double f = (double) i / steps;
+        __blend(t, (long) floor(x0 + (x1 - x0) * f), (long) floor(y0 + (y1 - y0) * f), color, 1.0);
+    }
+}
+
+static uint32_t __crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+
+    if (!table_ready)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (size_t k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+
+            table[n] = c;
+        }
+
+        table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static bool __write_be32(FILE *f, uint32_t v)
+{
+    uint8_t bytes[4] = { (uint8_t) (v >> 24), (uint8_t) (v >> 16), (uint8_t) (v >> 8), (uint8_t) v };
+    return sizeof(bytes) == fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+static bool __write_chunk(FILE *f, const char *type, const uint8_t *data, size_t size)
+{
+    uint32_t crc = __crc32(0, (const uint8_t *) type, 4);
+    if (size)
+    {
+        crc = __crc32(crc, data, size);
+    }
+
+    return __write_be32(f, (uint32_t) size) &&
+           4 == fwrite(type, 1, 4, f) &&
+           (!size || size == fwrite(data, 1, size, f)) &&
+           __write_be32(f, crc);
+}
+
+#if defined(THUMBNAIL_TESTS)
+#include "testhelp.h"
+
+#define TEST_PNG "thumbnail_test.png"
+
+int main(void)
+{
+    test_cond("CRC32.", 0xae426082u == __crc32(0, (const uint8_t *) "IEND", 4) &&
+                        0xcbf43926u == __crc32(__crc32(0, (const uint8_t *) "1234", 4), (const uint8_t *) "56789", 5));
+
+    Landscape *l = landscape_create(9, 16, 1.0);
+    for (size_t i = 0; i < 9; i++)
+    {
+        for (size_t j = 0; j < 9; j++)
+        {
+            landscape_set_height_at_node(l, i, j, (double) (i * j));
+        }
+    }
+
+    Thumbnail *t = thumbnail_create(64, 48), *background = thumbnail_create(64, 48);
+    test_cond("Create.", t && background);
+
+    thumbnail_draw_landscape(background, l);
+    bool shaded = true;
+    for (size_t i = 0; i < 64 * 48 * 3; i += 3)
+    {
+        shaded = shaded && background->pixels[i + 1] > background->pixels[i] && background->pixels[i + 1] > background->pixels[i + 2];
+    }
+    test_cond("Landscape is green.", shaded);
+
+    // Heights grow to top right corner, which is image's first row end.
+    const uint8_t *low = &background->pixels[3 * (47 * 64)], *high = &background->pixels[3 * 63];
+    test_cond("Higher is lighter.", high[1] > low[1]);
+
+    thumbnail_copy(t, background);
+    ResGetTanksTankRecord tank = { .x = 64.0, .y = 64.0, .turret_x = 1.0, .team = 12, .hp = 100 };
+    thumbnail_draw_tanks(t, l, &tank, 1);
+    const uint8_t *body = &t->pixels[3 * (25 * 64 + 31)];
+    test_cond("Tank is drawn in team's color.", 0xff == body[0] && 0x00 == body[1] && 0x00 == body[2]);
+    const uint8_t *turret = &t->pixels[3 * (24 * 64 + 34)];
+    test_cond("Turret is drawn.", 0xff == turret[0] && 0xff == turret[1] && 0xff == turret[2]);
+    test_cond("Background is kept.", 0 == memcmp(t->pixels, background->pixels, 3 * 64 * 18));
+
+    NotViewerShellEvent explosion = { .x = 100.0, .y = 100.0, .z = 0.0 };
+    thumbnail_draw_explosion(t, l, &explosion);
+    const uint8_t *e = &t->pixels[3 * (10 * 64 + 50)];
+    test_cond("Explosion is drawn.", e[0] > background->pixels[3 * (10 * 64 + 50)]);
+
+    test_cond("Write PNG.", thumbnail_write_png(t, TEST_PNG));
+
+    FILE *f = fopen(TEST_PNG, "rb");
+    uint8_t header[33];
+    bool read = f && sizeof(header) == fread(header, 1, sizeof(header), f);
+    long size = read && 0 == fseek(f, 0, SEEK_END) ? ftell(f) : 0;
+    if (f)
+    {
+        fclose(f);
+    }
+
+    test_cond("PNG header.",
+              read &&
+              0x89 == header[0] && 0 == memcmp(&header[1], "PNG", 3) &&
+              0 == memcmp(&header[12], "IHDR", 4) &&
+              64 == header[19] && 48 == header[23] && 2 == header[25]);
+    // Signature, IHDR, IDAT with zlib header, one stored block and Adler-32, IEND.
+    test_cond("PNG size.", 8 + 25 + (12 + 2 + 5 + (1 + 64 * 3) * 48 + 4) + 12 == size);
+
+    remove(TEST_PNG);
+    thumbnail_destroy(t);
+    thumbnail_destroy(background);
+    landscape_destroy(l);
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,42 @@
+// thumbnail.h - top-down match images rendered on CPU, PNG output.
+
+#pragma once
+#ifndef __THUMBNAIL_H__
+#define __THUMBNAIL_H__
+
+//#pragma message("__THUMBNAIL_H__")
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "morrigan.h"
+#include "landscape.h"
+#include "protocol.h"
+
+#define THUMBNAIL_MAX_SIZE 4096
+
+#pragma pack(push, 8)
+
+// RGB, 3 bytes per pixel, rows go from top (largest y) to bottom, so image looks like map from above.
+typedef struct Thumbnail
+{
+    size_t width, height;
+    uint8_t *pixels;
+} Thumbnail;
+
+#pragma pack(pop)
+
+Thumbnail *thumbnail_create(size_t width, size_t height);
+void thumbnail_destroy(Thumbnail *t);
+void thumbnail_copy(Thumbnail *dst, const Thumbnail *src);
+
+// Shaded relief of whole landscape. It doesn't change during match, so it's drawn once and copied.
+void thumbnail_draw_landscape(Thumbnail *t, const Landscape *l);
+void thumbnail_draw_tanks(Thumbnail *t, const Landscape *l, const ResGetTanksTankRecord *tanks, size_t tanks_count);
+void thumbnail_draw_shoot(Thumbnail *t, const Landscape *l, const NotViewerShellEvent *e);
+void thumbnail_draw_explosion(Thumbnail *t, const Landscape *l, const NotViewerShellEvent *e);
+
+bool thumbnail_write_png(const Thumbnail *t, const char *filename);
+
+#endif /* __THUMBNAIL_H__ */
@@ -0,0 +1,284 @@
+// thumbnail_main.c - main() for headless match thumbnails: connects as viewer, writes PNG snapshots.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+
+#include <winsock2.h>
+
+#include "debug.h"
+#include "net.h"
+#include "protocol.h"
+#include "client_protocol.h"
+#include "landscape.h"
+#include "scheduler.h"
+#include "thumbnail.h"
+#include "typed_array.h"
+
+#define THUMBNAIL_DEFAULT_INTERVAL 5 // In seconds.
+#define THUMBNAIL_DEFAULT_SIZE 512
+#define THUMBNAIL_DEFAULT_PREFIX "thumbnail"
+
+// Shell events since previous frame, type field holds notification id.
+TYPED_ARRAY_DEFINE(ThumbnailEventArray, thumbnail_event_array, NotViewerShellEvent)
+
+static bool __bye_executor(const void *packet);
+static bool __not_viewer_shell_event_validator(const void *packet, size_t packet_size);
+static bool __not_viewer_shell_event_executor(const void *packet);
+static void __stop(int unused);
+static bool __write_frame(Thumbnail *frame,
+                          const Thumbnail *background,
+                          const Landscape *l,
+                          const char *prefix,
+                          uint64_t *last_tick);
+
+#pragma warn(push)
+#pragma warn(disable: 2145)
+
+static PacketDefinition thumbnail_packets[] = {
+    { .id = req_viewer_hello                                                                                                  },
+    { .id = req_viewer_bye,                                                        .executor = __bye_executor                 },
+    { .id = req_viewer_get_map                                                                                                },
+    { .id = req_viewer_get_tanks                                                                                              },
+    { .id = not_viewer_shoot,     .validator = __not_viewer_shell_event_validator, .executor = __not_viewer_shell_event_executor },
+    { .id = not_viewer_explosion, .validator = __not_viewer_shell_event_validator, .executor = __not_viewer_shell_event_executor }
+};
+
+#pragma warn(pop)
+
+static ClientProtocol viewer = {
+    .packets      = thumbnail_packets,
+    .packet_count = sizeof(thumbnail_packets) / sizeof(thumbnail_packets[0]),
+    .s            = INVALID_SOCKET,
+    .connected    = false
+};
+
+static volatile bool working = true;
+static ThumbnailEventArray events = { 0 };
+
+// Usage: morrigan_thumbnail <server> [<port> [<arena> [<interval, s> [<size> [<output prefix> [<frames>]]]]]]
+// Writes <output prefix>_<tick>.png every interval until interrupted, server says bye or frames count is written.
+int main(int argc, char *argv[])
+{
+    if (2 > argc)
+    {
+        fprintf(stderr,
+                "Usage: %s <server> [<port> [<arena> [<interval, s> [<size> [<output prefix> [<frames>]]]]]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned short port = 2 < argc ? (unsigned short) atoi(argv[2]) : PORT;
+    uint8_t arena = 3 < argc ? (uint8_t) atoi(argv[3]) : 0;
+    unsigned interval = 4 < argc ? (unsigned) atoi(argv[4]) : THUMBNAIL_DEFAULT_INTERVAL;
+    int size = 5 < argc ? atoi(argv[5]) : THUMBNAIL_DEFAULT_SIZE;
+    const char *prefix = 6 < argc ? argv[6] : THUMBNAIL_DEFAULT_PREFIX;
+    unsigned frames = 7 < argc ? (unsigned) atoi(argv[7]) : 0; // 0 - no limit.
+
+    bool net_started = false;
+    Landscape *l = NULL;
+    Thumbnail *background = NULL, *frame = NULL;
+
+    check(0 < interval, "Bad interval.", "");
+    check(0 < size && THUMBNAIL_MAX_SIZE >= size, "Bad size.", "");
+    check(SIG_ERR != signal(SIGINT, __stop), "Failed to set signal handler.", "");
+    check(SIG_ERR != signal(SIGTERM, __stop), "Failed to set signal handler.", "");
+
+    check(net_started = client_net_start(), "Failed to initialize net.", "");
+    check(client_connect(&viewer, argv[1], port, false, arena), "Failed to connect to server.", "");
+    check(l = client_get_landscape(&viewer), "Failed to get map.", "");
+
+    check_mem(background = thumbnail_create((size_t) size, (size_t) size));
+    check_mem(frame = thumbnail_create((size_t) size, (size_t) size));
+    check(thumbnail_event_array_reserve(&events, 16), "Failed to reserve events.", "");
+    thumbnail_draw_landscape(background, l);
+
+    printf("Writing thumbnails of arena %u of %s:%u every %u s.\n", (unsigned) arena, argv[1], (unsigned) port, interval);
+
+    uint64_t period = (uint64_t) interval * SCHEDULER_NSEC_PER_SEC,
+             next_frame = scheduler_now(),
+             last_tick = UINT64_MAX;
+    unsigned written = 0;
+
+    while (working && viewer.connected && (!frames || written < frames))
+    {
+        uint64_t now = scheduler_now();
+
+        if (now >= next_frame)
+        {
+            if (__write_frame(frame, background, l, prefix, &last_tick))
+            {
+                written++;
+            }
+
+            next_frame += period;
+            if (next_frame < now)
+            {
+                next_frame = now + period;
+            }
+
+            continue;
+        }
+
+        // Shell events are collected between frames.
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(viewer.s, &set);
+
+        uint64_t wait = next_frame - now;
+        struct timeval tv = {
+            .tv_sec = (long) (wait / SCHEDULER_NSEC_PER_SEC),
+            .tv_usec = (long) (wait % SCHEDULER_NSEC_PER_SEC / 1000)
+        };
+
+        int ready = select(0, &set, NULL, NULL, &tv);
+        check(SOCKET_ERROR != ready, "select() failed. Error: %d.", WSAGetLastError());
+
+        if (FD_ISSET(viewer.s, &set))
+        {
+            client_protocol_process_event(&viewer);
+        }
+    }
+
+    printf("Written %u thumbnails.\n", written);
+
+    if (viewer.connected)
+    {
+        client_disconnect(&viewer, false);
+    }
+
+    thumbnail_event_array_destroy(&events);
+    thumbnail_destroy(frame);
+    thumbnail_destroy(background);
+    landscape_destroy(l);
+    client_net_stop();
+    return EXIT_SUCCESS;
+
+    error:
+    if (viewer.connected)
+    {
+        client_disconnect(&viewer, false);
+    }
+
+    thumbnail_event_array_destroy(&events);
+    if (frame)
+    {
+        thumbnail_destroy(frame);
+    }
+
+    if (background)
+    {
+        thumbnail_destroy(background);
+    }
+
+    if (l)
+    {
+        landscape_destroy(l);
+    }
+
+    if (net_started)
+    {
+        client_net_stop();
+    }
+
+    return EXIT_FAILURE;
+}
+
+static bool __bye_executor(const void *packet)
+{
+    #pragma ref packet
+    puts("Server has closed connection.");
+    working = false;
+    viewer.connected = false;
+    return true;
+}
+
+static bool __not_viewer_shell_event_validator(const void *packet, size_t packet_size)
+{
+    assert(packet && "Bad packet body pointer.");
+
+    if (sizeof(NotViewerShellEvent) != packet_size)
+    {
+        return false;
+    }
+
+    NotViewerShellEvent *p = (NotViewerShellEvent *) packet;
+
+    return isfinite(p->x) && isfinite(p->y) && isfinite(p->z);
+}
+
+static bool __not_viewer_shell_event_executor(const void *packet)
+{
+    assert(packet && "Bad packet body pointer.");
+
+    const NotViewerShellEvent *p = (const NotViewerShellEvent *) packet;
+    NotViewerShellEvent new_event = { .type = p->type, .x = p->x, .y = p->y, .z = p->z };
+    check(thumbnail_event_array_push(&events, new_event), "Failed to add event.", "");
+    return true;
+
+    error:
+    return false;
+}
+
+static void __stop(int unused)
+{
+    #pragma ref unused
+
+    working = false;
+}
+
+// Same tick isn't written twice, e.g. while arena waits for players.
+static bool __write_frame(Thumbnail *frame,
+                          const Thumbnail *background,
+                          const Landscape *l,
+                          const char *prefix,
+                          uint64_t *last_tick)
+{
+    assert(frame && "Bad frame pointer.");
+    assert(background && "Bad background pointer.");
+    assert(l && "Bad landscape pointer.");
+    assert(prefix && "Bad prefix pointer.");
+    assert(last_tick && "Bad last tick pointer.");
+
+    ResGetTanksTankRecord tanks[MAX_CLIENTS];
+    ResViewerGetTanks stamp = { 0 };
+    size_t tanks_count = client_get_tanks(&viewer, false, tanks, &stamp);
+
+    if (req_viewer_get_tanks != stamp.packet_id || stamp.tick == *last_tick)
+    {
+        return false;
+    }
+
+    thumbnail_copy(frame, background);
+    thumbnail_draw_tanks(frame, l, tanks, tanks_count);
+
+    TYPED_ARRAY_FOR_EACH(const NotViewerShellEvent *, e, &events)
+    {
+        if (not_viewer_shoot == e->type)
+        {
+            thumbnail_draw_shoot(frame, l, e);
+        }
+        else
+        {
+            thumbnail_draw_explosion(frame, l, e);
+        }
+    }
+
+    events.count = 0;
+
+    char filename[FILENAME_MAX];
+    snprintf(filename, sizeof(filename), "%s_%llu.png", prefix, (unsigned long long) stamp.tick);
+    check(thumbnail_write_png(frame, filename), "Failed to write %s.", filename);
+
+    *last_tick = stamp.tick;
+    printf("%s: %u tanks.\n", filename, (unsigned) tanks_count);
+    return true;
+
+    error:
+    return false;
+}
@@ -0,0 +1,288 @@
+// trace.c - tick and packet event tracing.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "minmax.h"
+#include "scheduler.h"
+#include "trace.h"
+
+static atomic_bool enabled = ATOMIC_VAR_INIT(false);
+static atomic_uint_fast64_t started_at = ATOMIC_VAR_INIT(0); // Older events belong to previous sessions.
+
+static TraceBuffer *buffers[TRACE_MAX_THREADS];
+static atomic_size_t buffer_count = ATOMIC_VAR_INIT(0);
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+
+static TraceEvent *__next_event(void);
+static TraceBuffer *__thread_buffer(void);
+static bool __write_event(FILE *f, size_t thread, const TraceEvent *e, bool *first);
+
+void trace_start(void)
+{
+    atomic_store(&started_at, scheduler_now());
+    atomic_store(&enabled, true);
+}
+
+void trace_stop(void)
+{
+    atomic_store(&enabled, false);
+}
+
+bool trace_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+void trace_span(const char *name, uint64_t start, uint64_t end, size_t arena)
+{
+    assert(name && "Bad name pointer.");
+
+    TraceEvent *e = __next_event();
+    if (NULL == e)
+    {
+        return;
+    }
+
+    *e = (TraceEvent) {
+        .name      = name,
+        .start     = start,
+        .duration  = end - start,
+        .arena     = arena,
+        .packet_id = TRACE_NO_PACKET
+    };
+    atomic_fetch_add_explicit(&thread_buffer->head, 1, memory_order_release);
+}
+
+void trace_packet(const char *name, uint64_t start, uint64_t end, uint8_t id, const SOCKADDR *peer)
+{
+    assert(name && "Bad name pointer.");
+    assert(peer && "Bad peer pointer.");
+
+    TraceEvent *e = __next_event();
+    if (NULL == e)
+    {
+        return;
+    }
+
+    *e = (TraceEvent) {
+        .name      = name,
+        .start     = start,
+        .duration  = end - start,
+        .arena     = TRACE_NO_ARENA,
+        .packet_id = id,
+        .peer      = *(const SOCKADDR_IN *) peer
+    };
+    atomic_fetch_add_explicit(&thread_buffer->head, 1, memory_order_release);
+}
+
+bool trace_write(const char *filename)
+{
+    assert(filename && "Bad filename pointer.");
+
+    FILE *f = fopen(filename, "w");
+    check(f, "Failed to open trace file %s.", filename);
+
+    uint64_t since = atomic_load(&started_at);
+    size_t threads = min(atomic_load(&buffer_count), TRACE_MAX_THREADS), written = 0;
+    bool first = true;
+
+    check(0 <= fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"), "Failed to write trace file.", "");
+
+    for (size_t t = 0; t < threads; t++)
+    {
+        TraceBuffer *b = buffers[t];
+        if (NULL == b)
+        {
+            continue;
+        }
+
+        check(0 <= fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"tid %lu\"}}",
+                           first ? "" : ",\n",
+                           (unsigned) t,
+                           b->thread_id),
+              "Failed to write trace file.", "");
+        first = false;
+
+        // Oldest events are overwritten by ring.
+        size_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+        for (size_t i = head - min(head, TRACE_RING_SIZE); i < head; i++)
+        {
+            const TraceEvent *e = &b->events[i & (TRACE_RING_SIZE - 1)];
+            if (e->start < since)
+            {
+                continue;
+            }
+
+            check(__write_event(f, t, e, &first), "Failed to write trace file.", "");
+            written++;
+        }
+    }
+
+    check(0 <= fprintf(f, "\n]}\n"), "Failed to write trace file.", "");
+    check(0 == fclose(f), "Failed to close trace file %s.", filename);
+
+    log_info("trace: %s, events: %u.", filename, (unsigned) written);
+    return true;
+    error:
+    if (f)
+    {
+        fclose(f);
+    }
+    return false;
+}
+
+void trace_clean(void)
+{
+    atomic_store(&enabled, false);
+
+    size_t threads = min(atomic_load(&buffer_count), TRACE_MAX_THREADS);
+    for (size_t t = 0; t < threads; t++)
+    {
+        free(buffers[t]);
+        buffers[t] = NULL;
+    }
+
+    atomic_store(&buffer_count, 0);
+    thread_buffer = NULL;
+}
+
+// Slot for next event of thread, NULL if tracing is off or thread has no buffer.
+// Caller fills it and publishes it by incrementing head.
+static TraceEvent *__next_event(void)
+{
+    if (!trace_enabled())
+    {
+        return NULL;
+    }
+
+    TraceBuffer *b = __thread_buffer();
+    if (NULL == b)
+    {
+        return NULL;
+    }
+
+    size_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+    return &b->events[head & (TRACE_RING_SIZE - 1)];
+}
+
+// Buffer is allocated on first traced event of thread.
+static TraceBuffer *__thread_buffer(void)
+{
+    if (thread_buffer)
+    {
+        return thread_buffer;
+    }
+
+    size_t index = atomic_fetch_add(&buffer_count, 1);
+    if (TRACE_MAX_THREADS <= index)
+    {
+        return NULL;
+    }
+
+    TraceBuffer *b = (TraceBuffer *) calloc(1, sizeof(TraceBuffer));
+    check_mem(b);
+
+    b->thread_id = GetCurrentThreadId();
+    buffers[index] = b;
+    thread_buffer = b;
+    return b;
+    error:
+    return NULL;
+}
+
+// Complete event: "ph" is "X", times are in microseconds.
+static bool __write_event(FILE *f, size_t thread, const TraceEvent *e, bool *first)
+{
+    assert(f && "Bad file pointer.");
+    assert(e && "Bad event pointer.");
+    assert(first && "Bad first pointer.");
+
+    int res = fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                      *first ? "" : ",\n",
+                      e->name,
+                      (unsigned) thread,
+                      e->start / 1000.0,
+                      e->duration / 1000.0);
+    check(0 <= res, "Failed to write event.", "");
+    *first = false;
+
+    bool has_args = false;
+    if (TRACE_NO_ARENA != e->arena)
+    {
+        check(0 <= fprintf(f, "\"arena\":%u", (unsigned) e->arena), "Failed to write event.", "");
+        has_args = true;
+    }
+
+    if (TRACE_NO_PACKET != e->packet_id)
+    {
+        check(0 <= fprintf(f, "%s\"id\":\"0x%02x\"", has_args ? "," : "", (unsigned) e->packet_id), "Failed to write event.", "");
+        has_args = true;
+    }
+
+    if (e->peer.sin_port)
+    {
+        check(0 <= fprintf(f, "%s\"peer\":\"%s:%u\"", has_args ? "," : "", inet_ntoa(e->peer.sin_addr), (unsigned) ntohs(e->peer.sin_port)),
+              "Failed to write event.", "");
+    }
+
+    check(0 <= fprintf(f, "}}"), "Failed to write event.", "");
+    return true;
+    error:
+    return false;
+}
+
+#if defined(TRACE_TESTS)
+#include <threads.h>
+
+#include "testhelp.h"
+
+#define TEST_TRACE_FILE "trace_test.json"
+
+static char *__read_trace(char *contents, size_t size)
+{
+    FILE *f = fopen(TEST_TRACE_FILE, "r");
+    size_t length = f ? fread(contents, 1, size - 1, f) : 0;
+    contents[length] = '\0';
+    if (f)
+    {
+        fclose(f);
+    }
+    remove(TEST_TRACE_FILE);
+    return contents;
+}
+
+int main(void)
+{
+    char contents[4096];
+
+    trace_span("ignored", 0, 10, 0);
+    test_cond("Nothing is traced by default.", NULL == thread_buffer);
+
+    trace_start();
+    uint64_t now = scheduler_now();
+    SOCKADDR_IN peer = { .sin_family = AF_INET, .sin_port = htons(8765), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    trace_span("tick", now, now + 1500, 2);
+    trace_packet("handle_packet", now + 2000, now + 2500, 0x10, (const SOCKADDR *) &peer);
+    trace_stop();
+    trace_span("ignored", now + 3000, now + 4000, 0);
+    test_cond("Events are written.", 2 == atomic_load(&thread_buffer->head));
+
+    test_cond("Write trace.", trace_write(TEST_TRACE_FILE));
+    __read_trace(contents, sizeof(contents));
+    test_cond("Trace is JSON object.", 0 == strncmp("{\"displayTimeUnit\"", contents, 18) && NULL != strstr(contents, "]}"));
+    test_cond("Span has duration.", NULL != strstr(contents, "\"name\":\"tick\",\"ph\":\"X\"") && NULL != strstr(contents, "\"dur\":1.500,\"args\":{\"arena\":2}"));
+    test_cond("Packet has id and peer.", NULL != strstr(contents, "\"args\":{\"id\":\"0x10\",\"peer\":\"127.0.0.1:8765\"}"));
+
+    thrd_sleep(&(struct timespec) { .tv_nsec = 1000000 }, NULL);
+    trace_start();
+    test_cond("Previous session is dropped.", trace_write(TEST_TRACE_FILE) && NULL == strstr(__read_trace(contents, sizeof(contents)), "tick"));
+
+    trace_clean();
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,62 @@
+// trace.h - tick and packet event tracing.
+
+#pragma once
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+//#pragma message("__TRACE_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include <winsock2.h>
+
+#include "morrigan.h"
+
+#define TRACE_MAX_THREADS 64
+#define TRACE_RING_SIZE 131072 // Power of two. Last events of each thread are kept.
+#define TRACE_NO_ARENA ((size_t) -1)
+#define TRACE_NO_PACKET (-1)
+#define TRACE_DEFAULT_FILE "morrigan_trace.json"
+
+#pragma pack(push, 8)
+
+// Span of work. Times are scheduler_now() nanoseconds.
+typedef struct TraceEvent
+{
+    const char *name; // Must have static storage.
+    uint64_t start;
+    uint64_t duration;
+    size_t arena;
+    int packet_id;
+    SOCKADDR_IN peer; // Zero port if there is no peer.
+} TraceEvent;
+
+// Written only by its thread.
+typedef struct TraceBuffer
+{
+    unsigned long thread_id;
+    atomic_size_t head; // Count of events ever written.
+    TraceEvent events[TRACE_RING_SIZE];
+} TraceBuffer;
+
+#pragma pack(pop)
+
+// Tracing is off by default. Starting it drops previous events.
+void trace_start(void);
+void trace_stop(void);
+bool trace_enabled(void);
+
+void trace_span(const char *name, uint64_t start, uint64_t end, size_t arena);
+void trace_packet(const char *name, uint64_t start, uint64_t end, uint8_t id, const SOCKADDR *peer);
+
+// Chrome trace event JSON, it's opened by chrome://tracing and Perfetto UI.
+// Tracing should be stopped: events which are written meanwhile may be torn.
+bool trace_write(const char *filename);
+
+// Frees thread buffers. No thread may trace after it.
+void trace_clean(void);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,115 @@
+// typed_array.h - type-safe dynamic arrays generated by macro.
+
+#pragma once
+#ifndef __TYPED_ARRAY_H__
+#define __TYPED_ARRAY_H__
+
+//#pragma message("__TYPED_ARRAY_H__")
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "morrigan.h"
+
+// TYPED_ARRAY_DEFINE(IntArray, int_array, int) defines struct IntArray and int_array_* functions.
+// Unlike DynamicArray, elements are stored by value without casts and array is embedded by value,
+// accessors are inline and bounds are only checked by assert(), so loops over data compile to plain indexing.
+// Empty array is all zeroes, nothing is allocated until first push or reserve.
+#define TYPED_ARRAY_DEFINE(array_type, prefix, element_type)                                           \
+    typedef struct array_type                                                                         \
+    {                                                                                                 \
+        size_t count;                                                                                 \
+        size_t capacity;                                                                              \
+        element_type *data;                                                                           \
+    } array_type;                                                                                     \
+                                                                                                      \
+    static inline void prefix##_destroy(array_type *a)                                                \
+    {                                                                                                 \
+        assert(a && "Bad array pointer.");                                                            \
+        free(a->data);                                                                                \
+        a->data = NULL;                                                                               \
+        a->count = a->capacity = 0;                                                                   \
+    }                                                                                                 \
+                                                                                                      \
+    static inline bool prefix##_reserve(array_type *a, size_t capacity)                               \
+    {                                                                                                 \
+        assert(a && "Bad array pointer.");                                                            \
+        if (capacity <= a->capacity)                                                                  \
+        {                                                                                             \
+            return true;                                                                              \
+        }                                                                                             \
+                                                                                                      \
+        element_type *data = (element_type *) realloc(a->data, capacity * sizeof(element_type));      \
+        if (!data)                                                                                    \
+        {                                                                                             \
+            return false;                                                                             \
+        }                                                                                             \
+                                                                                                      \
+        a->data = data;                                                                               \
+        a->capacity = capacity;                                                                       \
+        return true;                                                                                  \
+    }                                                                                                 \
+                                                                                                      \
+    static inline element_type *prefix##_at(const array_type *a, size_t i)                            \
+    {                                                                                                 \
+        assert(a && i < a->count && "Index out of range.");                                           \
+        return &a->data[i];                                                                           \
+    }                                                                                                 \
+                                                                                                      \
+    static inline bool prefix##_push(array_type *a, element_type e)                                   \
+    {                                                                                                 \
+        assert(a && "Bad array pointer.");                                                            \
+        if (a->count == a->capacity && !prefix##_reserve(a, a->capacity ? 2 * a->capacity : 4))       \
+        {                                                                                             \
+            return false;                                                                             \
+        }                                                                                             \
+                                                                                                      \
+        a->data[a->count++] = e;                                                                      \
+        return true;                                                                                  \
+    }                                                                                                 \
+                                                                                                      \
+    static inline element_type prefix##_pop(array_type *a)                                            \
+    {                                                                                                 \
+        assert(a && a->count && "Nothing to pop.");                                                   \
+        return a->data[--a->count];                                                                   \
+    }                                                                                                 \
+                                                                                                      \
+    /* Moves last element into removed one's place, O(1). */                                          \
+    static inline void prefix##_swap_remove(array_type *a, size_t i)                                  \
+    {                                                                                                 \
+        assert(a && i < a->count && "Index out of range.");                                           \
+        a->data[i] = a->data[--a->count];                                                             \
+    }                                                                                                 \
+                                                                                                      \
+    /* Keeps order of elements, O(n). */                                                              \
+    static inline void prefix##_delete_at(array_type *a, size_t i)                                    \
+    {                                                                                                 \
+        assert(a && i < a->count && "Index out of range.");                                           \
+        memmove(&a->data[i], &a->data[i + 1], (--a->count - i) * sizeof(element_type));               \
+    }                                                                                                 \
+                                                                                                      \
+    /* New elements are set to value. */                                                              \
+    static inline bool prefix##_resize(array_type *a, size_t count, element_type value)               \
+    {                                                                                                 \
+        assert(a && "Bad array pointer.");                                                            \
+        if (!prefix##_reserve(a, count))                                                              \
+        {                                                                                             \
+            return false;                                                                             \
+        }                                                                                             \
+                                                                                                      \
+        for (size_t i = a->count; i < count; i++)                                                     \
+        {                                                                                             \
+            a->data[i] = value;                                                                       \
+        }                                                                                             \
+                                                                                                      \
+        a->count = count;                                                                             \
+        return true;                                                                                  \
+    }
+
+// element is pointer of element_type to each element in order. Array mustn't be changed by loop body.
+#define TYPED_ARRAY_FOR_EACH(element_type, element, a) \
+    for (element_type element = (a)->data; element < (a)->data + (a)->count; element++)
+
+#endif /* __TYPED_ARRAY_H__ */
@@ -0,0 +1,37 @@
+// typed_ring.c - tests of typed ring buffers, ring itself lives in typed_ring.h.
+
+#if defined(TYPED_RING_TESTS)
+#include <stdio.h>
+
+#include "testhelp.h"
+#include "typed_ring.h"
+
+TYPED_RING_DEFINE(IntRing, int_ring, int, 4)
+
+int main(void)
+{
+    IntRing r = { 0 };
+    bool pushed = true;
+    for (int i = 0; i < 4; i++)
+    {
+        pushed = pushed && int_ring_push(&r, i);
+    }
+    test_cond("Ring push.", pushed && 4 == r.count && 0 == *int_ring_at(&r, 0) && 3 == *int_ring_at(&r, 3));
+
+    test_cond("Ring overwrites oldest.",
+              !int_ring_push(&r, 4) && !int_ring_push(&r, 5) && 4 == r.count && 2 == *int_ring_at(&r, 0) && 5 == *int_ring_at(&r, 3));
+
+    int_ring_drop_oldest(&r, 3);
+    test_cond("Ring drop oldest.", 1 == r.count && 5 == *int_ring_at(&r, 0));
+
+    pushed = int_ring_push(&r, 6) && int_ring_push(&r, 7);
+    test_cond("Ring wraps.", pushed && 3 == r.count && 5 == *int_ring_at(&r, 0) && 7 == *int_ring_at(&r, 2));
+
+    int_ring_clear(&r);
+    test_cond("Ring clear.", 0 == r.count && int_ring_push(&r, 8) && 8 == *int_ring_at(&r, 0));
+
+    test_report();
+    return EXIT_SUCCESS;
+}
+
+#endif
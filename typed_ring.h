@@ -0,0 +1,61 @@
+// typed_ring.h - fixed-capacity ring buffers generated by macro.
+
+#pragma once
+#ifndef __TYPED_RING_H__
+#define __TYPED_RING_H__
+
+//#pragma message("__TYPED_RING_H__")
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "morrigan.h"
+
+// TYPED_RING_DEFINE(IntRing, int_ring, int, 64) defines struct IntRing and int_ring_* functions.
+// Elements live in embedded array, so ring never allocates. Elements are kept in push order:
+// index 0 is the oldest one, push to full ring overwrites it. Empty ring is all zeroes.
+// Ring holds at most two contiguous runs of elements: from head to end of array and from its start.
+#define TYPED_RING_DEFINE(ring_type, prefix, element_type, ring_capacity)                              \
+    typedef struct ring_type                                                                          \
+    {                                                                                                 \
+        size_t head; /* Oldest element. */                                                            \
+        size_t count;                                                                                 \
+        element_type data[ring_capacity];                                                             \
+    } ring_type;                                                                                      \
+                                                                                                      \
+    static inline void prefix##_clear(ring_type *r)                                                   \
+    {                                                                                                 \
+        assert(r && "Bad ring pointer.");                                                             \
+        r->head = r->count = 0;                                                                       \
+    }                                                                                                 \
+                                                                                                      \
+    static inline element_type *prefix##_at(const ring_type *r, size_t i)                             \
+    {                                                                                                 \
+        assert(r && i < r->count && "Index out of range.");                                           \
+        return (element_type *) &r->data[(r->head + i) % (ring_capacity)];                            \
+    }                                                                                                 \
+                                                                                                      \
+    /* Returns false if oldest element was overwritten. */                                            \
+    static inline bool prefix##_push(ring_type *r, element_type e)                                    \
+    {                                                                                                 \
+        assert(r && "Bad ring pointer.");                                                             \
+        r->data[(r->head + r->count) % (ring_capacity)] = e;                                          \
+        if ((ring_capacity) == r->count)                                                              \
+        {                                                                                             \
+            r->head = (r->head + 1) % (ring_capacity);                                                \
+            return false;                                                                             \
+        }                                                                                             \
+                                                                                                      \
+        r->count++;                                                                                   \
+        return true;                                                                                  \
+    }                                                                                                 \
+                                                                                                      \
+    static inline void prefix##_drop_oldest(ring_type *r, size_t n)                                   \
+    {                                                                                                 \
+        assert(r && n <= r->count && "Nothing to drop.");                                             \
+        r->head = (r->head + n) % (ring_capacity);                                                    \
+        r->count -= n;                                                                                \
+    }
+
+#endif /* __TYPED_RING_H__ */
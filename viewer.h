@@ -8,10 +8,12 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 #pragma warn(push)
 #pragma warn(disable: 2185)
@@ -29,14 +31,32 @@
 #include <gl/glaux.h>
 
 #include "morrigan.h"
-#include "dynamic_array.h"
+#include "typed_ring.h"
 #include "landscape.h"
+#include "terrain_mesh.h"
+#include "mesh.h"
 #include "tank.h"
 #include "protocol.h"
 #include "protocol_utils.h"
 #include "client_protocol.h"
 #include "viewer_net.h"
 
+// Per kind of effect, oldest one is overwritten by new one when ring is full.
+#define SHELL_EFFECTS_CAPACITY 256
+
+// Buffer objects are GL 1.5, gl.h declares GL 1.1 only, so they are loaded at run time.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER         0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STREAM_DRAW          0x88E0
+#define GL_STATIC_DRAW          0x88E4
+#endif
+
+typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const GLvoid *data, GLenum usage);
+
 #pragma pack(push, 8)
 
 typedef struct Camera
@@ -49,38 +69,67 @@ typedef struct Camera
     double fov_y;
 } Camera;
 
+// Shoot or explosion being shown.
+typedef struct ShellEffect
+{
+    double x, y, z;
+    Uint32 time; // SDL_GetTicks() when received.
+} ShellEffect;
+
 #pragma pack(pop)
 
+// Effects are pushed in time order, so expired ones are always the oldest.
+TYPED_RING_DEFINE(ShellEffectRing, shell_effect_ring, ShellEffect, SHELL_EFFECTS_CAPACITY)
+
 extern bool working;
 
+// viewer_main.c, set once GL context is created.
+extern GenBuffersProc gl_gen_buffers;
+extern DeleteBuffersProc gl_delete_buffers;
+extern BindBufferProc gl_bind_buffer;
+extern BufferDataProc gl_buffer_data;
+
 // viewer_events.c
-bool process_events(bool *need_redraw, Camera *camera, ResGetTanksTankRecord *tanks, size_t *tanks_count, ClientProtocol *viewer_protocol);
+bool process_events(bool *need_redraw, Camera *camera, ClientProtocol *viewer_protocol);
+// Polls tanks into snapshot buffer.
+void receive_tanks(ClientProtocol *viewer_protocol);
+// Tanks as they were TANKS_INTERPOLATION_DELAY ms ago, interpolated between bracketing snapshots. Returns tanks count.
+size_t interpolate_tanks(Uint32 now, ResGetTanksTankRecord *tanks);
 //void move_tanks(const Landscape *l, ResGetTanksTankRecord *tanks, const size_t tanks_count);
-void process_shells(void);
+// Drops effects older than their lifetime.
+void process_shells(Uint32 now);
 
-DynamicArray *viewer_get_shoots(void);
-DynamicArray *viewer_get_explosions(void);
+ShellEffectRing *viewer_get_shoots(void);
+ShellEffectRing *viewer_get_explosions(void);
 
 // viewer_draw.c
-void draw_landscape(const Landscape *l);
-void draw_tank_body(void);
-void draw_tank_turret(void);
-void draw_tank_gun(void);
 void draw(const Landscape *l,
+          const TerrainMesh *terrain,
           const ResGetTanksTankRecord *tanks,
           size_t tanks_count,
           const Camera *camera,
-          const GLuint *display_lists,
-          const DynamicArray *shoots,
-          const DynamicArray *explosions);
+          Uint32 now,
+          const ShellEffectRing *shoots,
+          const ShellEffectRing *explosions);
+
+// viewer_terrain.c
+bool upload_terrain(const TerrainMesh *m);
+void draw_terrain(const TerrainMesh *m, const Camera *camera);
+void release_terrain(void);
+
+// viewer_meshes.c
+bool upload_meshes(void);
+// All tanks by single draw call.
+void draw_tanks(const ResGetTanksTankRecord *tanks, size_t tanks_count);
+void draw_sphere(double x, double y, double z, double radius);
+void release_meshes(void);
 
 #define TIMER_EVENT_ID 1
 #define TANKS_TIMER_EVENT_ID 2
 
-#define DISPLAY_LISTS_COUNT 4
-#define LANDSCAPE_DISPLAY_LIST   0
-#define TANK_BODY_DISPLAY_LIST   1
-#define TANK_TURRET_DISPLAY_LIST 2
-#define TANK_GUN_DISPLAY_LIST    3
+#define TANKS_POLL_INTERVAL 200
+#define TANKS_SNAPSHOTS 4
+// Newest snapshot may be up to poll interval old, rest is for net jitter.
+#define TANKS_INTERPOLATION_DELAY (TANKS_POLL_INTERVAL * 3 / 2)
 
 #endif /* __VIEWER_H__ */
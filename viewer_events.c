@@ -1,15 +1,33 @@
-// viewer_events.c - process_events() function.
+// viewer_events.c - process_events() function, tanks snapshots and their interpolation.
 
 #include "viewer.h"
 
+#pragma pack(push, 8)
+
+typedef struct TanksSnapshot
+{
+    uint64_t tick;
+    Uint32 received; // SDL_GetTicks() when response has arrived.
+    size_t tanks_count;
+    ResGetTanksTankRecord tanks[MAX_CLIENTS];
+} TanksSnapshot;
+
+#pragma pack(pop)
+
+// Ring of latest snapshots, oldest first.
+static TanksSnapshot snapshots[TANKS_SNAPSHOTS];
+static size_t snapshots_first = 0, snapshots_count = 0;
+static unsigned tick_rate = 0;
+
 static double __range_angle(double a);
+static const TanksSnapshot *__snapshot(size_t i);
+static Vector __interpolate_direction(const Vector *from, const Vector *to, double f);
+static void __interpolate_tank(ResGetTanksTankRecord *result, const ResGetTanksTankRecord *from, const ResGetTanksTankRecord *to, double f);
 
-bool process_events(bool *need_redraw, Camera *camera, ResGetTanksTankRecord *tanks, size_t *tanks_count, ClientProtocol *viewer_protocol)
+bool process_events(bool *need_redraw, Camera *camera, ClientProtocol *viewer_protocol)
 {
     assert(need_redraw && "Bad redraw flag pointer.");
     assert(camera && "Bad camera pointer.");
-    assert(tanks && "Bad tanks pointer.");
-    assert(tanks_count && "Bad tanks count pointer.");
     assert(viewer_protocol && "Bad viewer protocol pointer.");
 
     static bool w_pressed = false,
@@ -44,7 +62,7 @@ bool process_events(bool *need_redraw, Camera *camera, ResGetTanksTankRecord *ta
                 {
                     case TIMER_EVENT_ID:
                         //move_tanks(l, tanks, tanks_count);
-                        process_shells();
+                        process_shells(SDL_GetTicks());
 
                         while (client_protocol_process_event(viewer_protocol));
 
@@ -61,9 +79,7 @@ bool process_events(bool *need_redraw, Camera *camera, ResGetTanksTankRecord *ta
                        break;
 
                     case TANKS_TIMER_EVENT_ID:
-                        *tanks_count = client_get_tanks(viewer_protocol, false, tanks);
-                        //printf("Got %d tanks.\n", tanks_count);
-                        *need_redraw = true;
+                        receive_tanks(viewer_protocol);
                         break;
 
                     default:
@@ -189,6 +205,162 @@ bool process_events(bool *need_redraw, Camera *camera, ResGetTanksTankRecord *ta
     return true;
 }
 
+void receive_tanks(ClientProtocol *viewer_protocol)
+{
+    assert(viewer_protocol && "Bad viewer protocol pointer.");
+
+    ResViewerGetTanks stamp = { 0 };
+    ResGetTanksTankRecord tanks[MAX_CLIENTS];
+    size_t tanks_count = client_get_tanks(viewer_protocol, false, tanks, &stamp);
+    if (req_viewer_get_tanks != stamp.packet_id)
+    {
+        return;
+    }
+
+    if (snapshots_count)
+    {
+        uint64_t newest_tick = __snapshot(snapshots_count - 1)->tick;
+        if (stamp.tick == newest_tick)
+        {
+            return;
+        }
+
+        if (stamp.tick < newest_tick)
+        {
+            // Arena was restored from checkpoint or viewer was moved to another server.
+            snapshots_count = 0;
+        }
+    }
+
+    if (TANKS_SNAPSHOTS == snapshots_count)
+    {
+        snapshots_first = (snapshots_first + 1) % TANKS_SNAPSHOTS;
+        snapshots_count--;
+    }
+
+    TanksSnapshot *s = &snapshots[(snapshots_first + snapshots_count++) % TANKS_SNAPSHOTS];
+    s->tick = stamp.tick;
+    s->received = SDL_GetTicks();
+    s->tanks_count = tanks_count;
+    memcpy(s->tanks, tanks, tanks_count * sizeof(ResGetTanksTankRecord));
+    tick_rate = stamp.tick_rate;
+}
+
+size_t interpolate_tanks(Uint32 now, ResGetTanksTankRecord *tanks)
+{
+    assert(tanks && "Bad tanks pointer.");
+
+    if (!snapshots_count)
+    {
+        return 0;
+    }
+
+    const TanksSnapshot *newest = __snapshot(snapshots_count - 1);
+    if (1 == snapshots_count || !tick_rate)
+    {
+        memcpy(tanks, newest->tanks, newest->tanks_count * sizeof(ResGetTanksTankRecord));
+        return newest->tanks_count;
+    }
+
+    // Local time of tick 0 is estimated by the least delayed snapshot.
+    double tick_period = 1000.0 / tick_rate,
+           origin = (double) newest->received - newest->tick * tick_period;
+    for (size_t i = 0; i < snapshots_count - 1; i++)
+    {
+        const TanksSnapshot *s = __snapshot(i);
+        origin = fmin(origin, (double) s->received - s->tick * tick_period);
+    }
+
+    double render_tick = ((double) now - TANKS_INTERPOLATION_DELAY - origin) / tick_period;
+
+    // Snapshots aren't extrapolated: render tick out of buffer is clamped to oldest or newest one.
+    size_t i = 1;
+    while (i < snapshots_count - 1 && __snapshot(i)->tick < render_tick)
+    {
+        i++;
+    }
+
+    const TanksSnapshot *from = __snapshot(i - 1), *to = __snapshot(i);
+    double f = fmax(0.0, fmin(1.0, (render_tick - from->tick) / (to->tick - from->tick)));
+
+    // Records carry no tank ids, so tanks are matched by order while set of tanks is the same.
+    if (from->tanks_count != to->tanks_count)
+    {
+        const TanksSnapshot *nearest = 0.5 > f ? from : to;
+        memcpy(tanks, nearest->tanks, nearest->tanks_count * sizeof(ResGetTanksTankRecord));
+        return nearest->tanks_count;
+    }
+
+    for (size_t t = 0; t < to->tanks_count; t++)
+    {
+        __interpolate_tank(&tanks[t], &from->tanks[t], &to->tanks[t], f);
+    }
+
+    return to->tanks_count;
+}
+
+static const TanksSnapshot *__snapshot(size_t i)
+{
+    assert(i < snapshots_count && "Bad snapshot index.");
+    return &snapshots[(snapshots_first + i) % TANKS_SNAPSHOTS];
+}
+
+static Vector __interpolate_direction(const Vector *from, const Vector *to, double f)
+{
+    assert(from && "Bad from pointer.");
+    assert(to && "Bad to pointer.");
+
+    Vector v = { .x = from->x + (to->x - from->x) * f,
+                 .y = from->y + (to->y - from->y) * f,
+                 .z = from->z + (to->z - from->z) * f };
+
+    // Opposite directions lerp through zero, there's nothing to normalize then.
+    if (vector_tolerance_eq(0.0, vector_length(&v)))
+    {
+        return 0.5 > f ? *from : *to;
+    }
+
+    return *VECTOR_NORMALIZE(&v);
+}
+
+static void __interpolate_tank(ResGetTanksTankRecord *result, const ResGetTanksTankRecord *from, const ResGetTanksTankRecord *to, double f)
+{
+    assert(result && "Bad result pointer.");
+    assert(from && "Bad from pointer.");
+    assert(to && "Bad to pointer.");
+
+    *result = 0.5 > f ? *from : *to;
+    if (from->team != to->team)
+    {
+        return;
+    }
+
+    result->x = from->x + (to->x - from->x) * f;
+    result->y = from->y + (to->y - from->y) * f;
+    result->z = from->z + (to->z - from->z) * f;
+
+    Vector from_direction   = { .x = from->direction_x,   .y = from->direction_y,   .z = from->direction_z   },
+           to_direction     = { .x = to->direction_x,     .y = to->direction_y,     .z = to->direction_z     },
+           from_orientation = { .x = from->orientation_x, .y = from->orientation_y, .z = from->orientation_z },
+           to_orientation   = { .x = to->orientation_x,   .y = to->orientation_y,   .z = to->orientation_z   },
+           from_turret      = { .x = from->turret_x,      .y = from->turret_y,      .z = from->turret_z      },
+           to_turret        = { .x = to->turret_x,        .y = to->turret_y,        .z = to->turret_z        };
+
+    Vector direction   = __interpolate_direction(&from_direction, &to_direction, f),
+           orientation = __interpolate_direction(&from_orientation, &to_orientation, f),
+           turret      = __interpolate_direction(&from_turret, &to_turret, f);
+
+    result->direction_x   = direction.x;
+    result->direction_y   = direction.y;
+    result->direction_z   = direction.z;
+    result->orientation_x = orientation.x;
+    result->orientation_y = orientation.y;
+    result->orientation_z = orientation.z;
+    result->turret_x      = turret.x;
+    result->turret_y      = turret.y;
+    result->turret_z      = turret.z;
+}
+
 static double __range_angle(double a)
 {
     if (a < 0.0)
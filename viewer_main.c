@@ -7,21 +7,25 @@
 bool working = true;
 
 static Landscape *l = NULL;
+static TerrainMesh *terrain = NULL;
 static ResGetTanksTankRecord tanks[MAX_CLIENTS];
 static size_t tanks_count = 0;
 
-#define SHOOT_LIFETIME 100
-#define EXPLOSION_LIFETIME 250
-static DynamicArray *shoots = NULL, *explosions = NULL;
+#define SHOOT_LIFETIME 3000 // In milliseconds.
+#define EXPLOSION_LIFETIME 7500
+static ShellEffectRing shoots = { 0 }, explosions = { 0 };
 
-#define TANKS_POLL_INTERVAL 100
 static SDL_TimerID timer_id = NULL, tanks_timer_id = NULL;
 
 static Camera camera;
 
-static GLuint display_lists = 0;
+GenBuffersProc gl_gen_buffers = NULL;
+DeleteBuffersProc gl_delete_buffers = NULL;
+BindBufferProc gl_bind_buffer = NULL;
+BufferDataProc gl_buffer_data = NULL;
 
 static bool __init_video(Camera *camera);
+static bool __load_buffer_functions(void);
 static void __cleanup(void);
 
 static Uint32 __timer_handler(Uint32 interval, void *param);
@@ -30,7 +34,7 @@ int main(int argc, char *argv[])
 {
     if (2 > argc)
     {
-        fprintf(stderr, "Usage: %s <server-address> [<port>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <server-address> [<port> [<arena>]]\n", argv[0]);
         return -1;
     }
 
@@ -44,11 +48,14 @@ int main(int argc, char *argv[])
         }
     }
 
-    check_mem(shoots = DYNAMIC_ARRAY_CREATE(NotViewerShellEvent *, 16));
-    check_mem(explosions = DYNAMIC_ARRAY_CREATE(NotViewerShellEvent *, 16));
+    uint8_t arena = 0;
+    if (3 < argc)
+    {
+        arena = (uint8_t) atoi(argv[3]);
+    }
 
     check(client_net_start(), "Failed to initialize net.", "");
-    check(client_connect(&viewer_protocol, argv[1], port, false), "Failed to connect.", "");
+    check(client_connect(&viewer_protocol, argv[1], port, false, arena), "Failed to connect.", "");
 
     puts("Connected to server.");
 
@@ -58,41 +65,27 @@ int main(int argc, char *argv[])
 
     camera.x = camera.y = l->landscape_size / 2.0 * l->tile_size;
 
-    check(__init_video(&camera), "Failed to init video.", "");
-
-    check(0 != (display_lists = glGenLists(DISPLAY_LISTS_COUNT)), "Failed to create display list.", "");
-
-    glNewList(display_lists + LANDSCAPE_DISPLAY_LIST, GL_COMPILE);
-    check(GL_NO_ERROR == glGetError(), "Failed to create display list.", "");
-    draw_landscape(l);
-    glEndList();
-
-    glNewList(display_lists + TANK_BODY_DISPLAY_LIST, GL_COMPILE);
-    check(GL_NO_ERROR == glGetError(), "Failed to create display list.", "");
-    draw_tank_body();
-    glEndList();
+    check(terrain = terrain_mesh_create(l), "Failed to build terrain mesh.", "");
 
-    glNewList(display_lists + TANK_TURRET_DISPLAY_LIST, GL_COMPILE);
-    check(GL_NO_ERROR == glGetError(), "Failed to create display list.", "");
-    draw_tank_turret();
-    glEndList();
+    check(__init_video(&camera), "Failed to init video.", "");
 
-    glNewList(display_lists + TANK_GUN_DISPLAY_LIST, GL_COMPILE);
-    check(GL_NO_ERROR == glGetError(), "Failed to create display list.", "");
-    draw_tank_gun();
-    glEndList();
+    check(__load_buffer_functions(), "Vertex buffer objects aren't supported.", "");
+    check(upload_terrain(terrain), "Failed to upload terrain.", "");
+    check(upload_meshes(), "Failed to upload meshes.", "");
 
     while (working)
     {
         bool need_redraw = false;
-        if (!process_events(&need_redraw, &camera, tanks, &tanks_count, &viewer_protocol))
+        if (!process_events(&need_redraw, &camera, &viewer_protocol))
         {
             break;
         }
 
         if (need_redraw)
         {
-            draw(l, tanks, tanks_count, &camera, &display_lists, shoots, explosions);
+            Uint32 now = SDL_GetTicks();
+            tanks_count = interpolate_tanks(now, tanks);
+            draw(l, terrain, tanks, tanks_count, &camera, now, &shoots, &explosions);
         }
     }
 
@@ -174,8 +167,21 @@ static bool __init_video(Camera *camera)
     return false;
 }
 
+static bool __load_buffer_functions(void)
+{
+    gl_gen_buffers = (GenBuffersProc) SDL_GL_GetProcAddress("glGenBuffers");
+    gl_delete_buffers = (DeleteBuffersProc) SDL_GL_GetProcAddress("glDeleteBuffers");
+    gl_bind_buffer = (BindBufferProc) SDL_GL_GetProcAddress("glBindBuffer");
+    gl_buffer_data = (BufferDataProc) SDL_GL_GetProcAddress("glBufferData");
+    return gl_gen_buffers && gl_delete_buffers && gl_bind_buffer && gl_buffer_data;
+}
+
 static void __cleanup(void)
 {
+    // Need GL context.
+    release_terrain();
+    release_meshes();
+
     if (SDL_WasInit(SDL_INIT_VIDEO | SDL_INIT_TIMER))
     {
         SDL_Quit();
@@ -193,10 +199,10 @@ static void __cleanup(void)
         tanks_timer_id = NULL;
     }
 
-    if (0 != display_lists)
+    if (terrain)
     {
-        glDeleteLists(display_lists, DISPLAY_LISTS_COUNT);
-        display_lists = 0;
+        terrain_mesh_destroy(terrain);
+        terrain = NULL;
     }
 
     if (l)
@@ -210,18 +216,6 @@ static void __cleanup(void)
         check(client_disconnect(&viewer_protocol, false), "Failed to disconnect.", "");
     }
 
-    if (shoots)
-    {
-        dynamic_array_destroy(shoots);
-        shoots = NULL;
-    }
-
-    if (explosions)
-    {
-        dynamic_array_destroy(explosions);
-        explosions = NULL;
-    }
-
     static bool net_stopped = false;
     error:
     if (!net_stopped)
@@ -311,40 +305,31 @@ void move_tank(const Landscape *l, ResGetTanksTankRecord *tank)
     tank->turret_z = turret_direction.z;
 }*/
 
-void process_shell_collection(DynamicArray *c, const size_t lifetime)
+static void __expire_shell_effects(ShellEffectRing *r, Uint32 now, Uint32 lifetime)
 {
-    assert(c && "Bad shell event collection.");
+    assert(r && "Bad shell effects ring pointer.");
 
-    size_t count = dynamic_array_count(c);
-    for (size_t i = 0; i < count;)
+    size_t expired = 0;
+    while (expired < r->count && now - shell_effect_ring_at(r, expired)->time > lifetime)
     {
-        NotViewerShellEvent *e = *DYNAMIC_ARRAY_GET(NotViewerShellEvent **, c, i);
-
-        if (lifetime < e->type)
-        {
-            dynamic_array_delete_at(c, i);
-            count--;
-        }
-        else
-        {
-            e->type++;
-            i++;
-        }
+        expired++;
     }
+
+    shell_effect_ring_drop_oldest(r, expired);
 }
 
-void process_shells(void)
+void process_shells(Uint32 now)
 {
-    process_shell_collection(shoots, SHOOT_LIFETIME);
-    process_shell_collection(explosions, EXPLOSION_LIFETIME);
+    __expire_shell_effects(&shoots, now, SHOOT_LIFETIME);
+    __expire_shell_effects(&explosions, now, EXPLOSION_LIFETIME);
 }
 
-DynamicArray *viewer_get_shoots(void)
+ShellEffectRing *viewer_get_shoots(void)
 {
-    return shoots;
+    return &shoots;
 }
 
-DynamicArray *viewer_get_explosions(void)
+ShellEffectRing *viewer_get_explosions(void)
 {
-    return explosions;
+    return &explosions;
 }
@@ -0,0 +1,235 @@
+// viewer_meshes.c - tanks and shell events drawing from generated meshes.
+
+#include "debug.h"
+#include "viewer.h"
+
+// Turret colors, indexed by team.
+static const uint8_t team_colors[][3] = {
+    { 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x80 }, { 0x00, 0x80, 0x00 }, { 0x00, 0x80, 0x80 },
+    { 0x80, 0x00, 0x00 }, { 0x80, 0x00, 0x80 }, { 0x80, 0x80, 0x00 }, { 0xc0, 0xc0, 0xc0 },
+    { 0x80, 0x80, 0x80 }, { 0x00, 0x00, 0xff }, { 0x00, 0xff, 0x00 }, { 0x00, 0xff, 0xff },
+    { 0xff, 0x00, 0x00 }, { 0xff, 0x00, 0xff }, { 0xff, 0xff, 0x00 }, { 0xff, 0xff, 0xff }
+};
+static const uint8_t armor_color[3] = { 0x35, 0x5e, 0x3b };
+
+#define MESH_BUFFERS_COUNT 5
+#define TANKS_VERTICES_BUFFER 0 // Refilled every frame.
+#define TANKS_COLORS_BUFFER   1 // Refilled every frame.
+#define TANKS_INDICES_BUFFER  2 // Refilled when batch grows.
+#define SPHERE_VERTICES_BUFFER 3
+#define SPHERE_INDICES_BUFFER  4
+static GLuint buffers[MESH_BUFFERS_COUNT] = { 0 };
+
+static Mesh *tank_parts[TANK_MESH_PARTS] = { NULL };
+static Mesh *sphere = NULL; // Unit one, for shell events.
+
+// All parts of all tanks go into one batch, so tanks are drawn by single call.
+// Tank's vertices are its parts' ones in order, each tank's indices are shifted by its first vertex.
+static size_t tank_vertex_count = 0, tank_index_count = 0;
+static size_t batch_capacity = 0; // In tanks.
+static MeshVertex *batch_vertices = NULL;
+static uint8_t *batch_colors = NULL; // RGBA per vertex.
+
+static bool __reserve_batch(size_t tanks_count);
+
+bool upload_meshes(void)
+{
+    for (size_t part = 0; part < TANK_MESH_PARTS; part++)
+    {
+        check(tank_parts[part] = mesh_create_tank_part(part), "Failed to create tank mesh.", "");
+        tank_vertex_count += tank_parts[part]->vertex_count;
+        tank_index_count += tank_parts[part]->index_count;
+    }
+
+    Vector center = { .x = 0.0, .y = 0.0, .z = 0.0 };
+    check(sphere = mesh_create_sphere(&center, 1.0, MESH_SPHERE_SLICES, MESH_SPHERE_STACKS), "Failed to create sphere mesh.", "");
+
+    gl_gen_buffers(MESH_BUFFERS_COUNT, buffers);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[SPHERE_VERTICES_BUFFER]);
+    gl_buffer_data(GL_ARRAY_BUFFER, sphere->vertex_count * sizeof(MeshVertex), sphere->vertices, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[SPHERE_INDICES_BUFFER]);
+    gl_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sphere->index_count * sizeof(uint16_t), sphere->indices, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    check(__reserve_batch(MAX_CLIENTS), "Failed to allocate tanks batch.", "");
+    check(GL_NO_ERROR == glGetError(), "Failed to upload meshes.", "");
+    return true;
+
+    error:
+    return false;
+}
+
+void draw_tanks(const ResGetTanksTankRecord *tanks, size_t tanks_count)
+{
+    assert(tanks && "Bad tanks pointer.");
+
+    if (!tanks_count || !__reserve_batch(tanks_count))
+    {
+        return;
+    }
+
+    MeshVertex *v = batch_vertices;
+    uint8_t *c = batch_colors;
+
+    for (size_t i = 0; i < tanks_count; i++)
+    {
+        const ResGetTanksTankRecord *tank = &tanks[i];
+        MeshTransform transforms[2];
+        mesh_get_tank_transforms(tank, &transforms[0], &transforms[1]);
+
+        for (size_t part = 0; part < TANK_MESH_PARTS; part++)
+        {
+            const Mesh *m = tank_parts[part];
+            mesh_transform(m, &transforms[TANK_MESH_GUN == part ? 1 : 0], v);
+            v += m->vertex_count;
+
+            const uint8_t *color = TANK_MESH_TURRET == part ?
+                                   team_colors[tank->team % (sizeof(team_colors) / sizeof(team_colors[0]))] :
+                                   armor_color;
+            uint8_t alpha = tank->hp ? 0xff : 0x40;
+
+            for (size_t j = 0; j < m->vertex_count; j++, c += 4)
+            {
+                c[0] = color[0];
+                c[1] = color[1];
+                c[2] = color[2];
+                c[3] = alpha;
+            }
+        }
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TANKS_VERTICES_BUFFER]);
+    gl_buffer_data(GL_ARRAY_BUFFER, tanks_count * tank_vertex_count * sizeof(MeshVertex), batch_vertices, GL_STREAM_DRAW);
+    glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), (const GLvoid *) 0);
+    glNormalPointer(GL_FLOAT, sizeof(MeshVertex), (const GLvoid *) (3 * sizeof(float)));
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TANKS_COLORS_BUFFER]);
+    gl_buffer_data(GL_ARRAY_BUFFER, tanks_count * tank_vertex_count * 4, batch_colors, GL_STREAM_DRAW);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, (const GLvoid *) 0);
+
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TANKS_INDICES_BUFFER]);
+    glDrawElements(GL_TRIANGLES, (GLsizei) (tanks_count * tank_index_count), GL_UNSIGNED_INT, (const GLvoid *) 0);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void draw_sphere(double x, double y, double z, double radius)
+{
+    glPushMatrix();
+    glTranslated(x, y, z);
+    glScaled(radius, radius, radius);
+    glEnable(GL_NORMALIZE); // Scaling changes normals' length.
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[SPHERE_VERTICES_BUFFER]);
+    glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), (const GLvoid *) 0);
+    glNormalPointer(GL_FLOAT, sizeof(MeshVertex), (const GLvoid *) (3 * sizeof(float)));
+
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[SPHERE_INDICES_BUFFER]);
+    glDrawElements(GL_TRIANGLES, (GLsizei) sphere->index_count, GL_UNSIGNED_SHORT, (const GLvoid *) 0);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glDisable(GL_NORMALIZE);
+    glPopMatrix();
+}
+
+void release_meshes(void)
+{
+    if (gl_delete_buffers && 0 != buffers[TANKS_VERTICES_BUFFER])
+    {
+        gl_delete_buffers(MESH_BUFFERS_COUNT, buffers);
+        memset(buffers, 0, sizeof(buffers));
+    }
+
+    for (size_t part = 0; part < TANK_MESH_PARTS; part++)
+    {
+        if (tank_parts[part])
+        {
+            mesh_destroy(tank_parts[part]);
+            tank_parts[part] = NULL;
+        }
+    }
+
+    if (sphere)
+    {
+        mesh_destroy(sphere);
+        sphere = NULL;
+    }
+
+    free(batch_vertices);
+    free(batch_colors);
+    batch_vertices = NULL;
+    batch_colors = NULL;
+    batch_capacity = tank_vertex_count = tank_index_count = 0;
+}
+
+// Grows geometrically. Index buffer is rebuilt for new capacity, as it doesn't depend on tanks themselves.
+static bool __reserve_batch(size_t tanks_count)
+{
+    if (tanks_count <= batch_capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = batch_capacity ? batch_capacity : 1;
+    while (capacity < tanks_count)
+    {
+        capacity *= 2;
+    }
+
+    MeshVertex *vertices = NULL;
+    uint8_t *colors = NULL;
+    uint32_t *indices = NULL;
+
+    check_mem(vertices = (MeshVertex *) realloc(batch_vertices, capacity * tank_vertex_count * sizeof(MeshVertex)));
+    batch_vertices = vertices;
+    check_mem(colors = (uint8_t *) realloc(batch_colors, capacity * tank_vertex_count * 4));
+    batch_colors = colors;
+    check_mem(indices = (uint32_t *) malloc(capacity * tank_index_count * sizeof(uint32_t)));
+
+    uint32_t *index = indices;
+    for (size_t i = 0; i < capacity; i++)
+    {
+        size_t first_vertex = i * tank_vertex_count;
+
+        for (size_t part = 0; part < TANK_MESH_PARTS; part++)
+        {
+            const Mesh *m = tank_parts[part];
+
+            for (size_t j = 0; j < m->index_count; j++)
+            {
+                *index++ = (uint32_t) (first_vertex + m->indices[j]);
+            }
+
+            first_vertex += m->vertex_count;
+        }
+    }
+
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TANKS_INDICES_BUFFER]);
+    gl_buffer_data(GL_ELEMENT_ARRAY_BUFFER, capacity * tank_index_count * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    free(indices);
+    batch_capacity = capacity;
+    return true;
+
+    error:
+    return false;
+}
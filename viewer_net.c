@@ -5,7 +5,7 @@
 
 static bool __bye_executor(const void *packet);
 static bool __not_viewer_shell_event_validator(const void *packet, size_t packet_size);
-static void __shell_event_executor(const void *packet, DynamicArray *notification_collection);
+static void __shell_event_executor(const void *packet, ShellEffectRing *effects);
 static bool __not_viewer_shoot_executor(const void *packet);
 static bool __not_viewer_explosion_executor(const void *packet);
 
@@ -67,23 +67,15 @@ static bool __not_viewer_explosion_executor(const void *packet)
     return true;
 }
 
-static void __shell_event_executor(const void *packet, DynamicArray *notification_collection)
+static void __shell_event_executor(const void *packet, ShellEffectRing *effects)
 {
     assert(packet && "Bad packet body pointer.");
-    assert(notification_collection && "Bad notification collection pointer.");
+    assert(effects && "Bad shell effects ring pointer.");
 
-    NotViewerShellEvent *p = (NotViewerShellEvent *) packet,
-                        *new_event = NULL;
+    const NotViewerShellEvent *p = (const NotViewerShellEvent *) packet;
+    ShellEffect new_effect = { .x = p->x, .y = p->y, .z = p->z, .time = SDL_GetTicks() };
 
-    check_mem(new_event = calloc(1, sizeof(NotViewerShellEvent)));
-    new_event->x = p->x;
-    new_event->y = p->y;
-    new_event->z = p->z;
+    //printf("Shell event at: %lf; %lf; %lf\n", new_effect.x, new_effect.y, new_effect.z);
 
-    //printf("Shell event at: %lf; %lf; %lf\n", new_event->x, new_event->y, new_event->z);
-
-    dynamic_array_push(notification_collection, &new_event);
-
-    error:
-    return;
+    shell_effect_ring_push(effects, new_effect);
 }
@@ -0,0 +1,93 @@
+// viewer_terrain.c - terrain drawing through vertex buffer objects.
+
+#include "debug.h"
+#include "viewer.h"
+
+#define TERRAIN_BUFFERS_COUNT 3
+#define TERRAIN_VERTICES_BUFFER 0
+#define TERRAIN_INDICES_BUFFER  1
+#define TERRAIN_MORPHED_BUFFER  2 // Refilled for each chunk which is being morphed.
+static GLuint buffers[TERRAIN_BUFFERS_COUNT] = { 0 };
+
+static TerrainVertex morphed[(TERRAIN_CHUNK_TILES + 1) * (TERRAIN_CHUNK_TILES + 1)];
+
+bool upload_terrain(const TerrainMesh *m)
+{
+    assert(m && "Bad terrain mesh pointer.");
+
+    gl_gen_buffers(TERRAIN_BUFFERS_COUNT, buffers);
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TERRAIN_VERTICES_BUFFER]);
+    gl_buffer_data(GL_ARRAY_BUFFER, m->vertex_count * sizeof(TerrainVertex), m->vertices, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TERRAIN_MORPHED_BUFFER]);
+    gl_buffer_data(GL_ARRAY_BUFFER, sizeof(morphed), NULL, GL_STREAM_DRAW);
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TERRAIN_INDICES_BUFFER]);
+    gl_buffer_data(GL_ELEMENT_ARRAY_BUFFER, m->index_count * sizeof(uint16_t), m->indices, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    check(GL_NO_ERROR == glGetError(), "Failed to upload terrain.", "");
+    return true;
+
+    error:
+    return false;
+}
+
+void draw_terrain(const TerrainMesh *m, const Camera *camera)
+{
+    assert(m && "Bad terrain mesh pointer.");
+    assert(camera && "Bad camera pointer.");
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TERRAIN_INDICES_BUFFER]);
+
+    for (size_t chunk = 0; chunk < m->chunk_count; chunk++)
+    {
+        size_t level = terrain_mesh_select_level(m, chunk, camera->x, camera->y, camera->z),
+               first_vertex = 0;
+
+        if (terrain_mesh_is_morphed(m, chunk, level, camera->x, camera->y, camera->z))
+        {
+            terrain_mesh_morph(m, chunk, level, camera->x, camera->y, camera->z, morphed);
+            gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TERRAIN_MORPHED_BUFFER]);
+            gl_buffer_data(GL_ARRAY_BUFFER,
+                          terrain_mesh_get_level_vertex_count(m, level) * sizeof(TerrainVertex),
+                          morphed,
+                          GL_STREAM_DRAW);
+        }
+        else
+        {
+            gl_bind_buffer(GL_ARRAY_BUFFER, buffers[TERRAIN_VERTICES_BUFFER]);
+            first_vertex = chunk * m->chunk_vertex_count + m->level_vertex_offset[level];
+        }
+
+        // Pointers are offsets in bound buffers.
+        glVertexPointer(3, GL_FLOAT, sizeof(TerrainVertex), (const GLvoid *) (first_vertex * sizeof(TerrainVertex)));
+        glNormalPointer(GL_FLOAT, sizeof(TerrainVertex), (const GLvoid *) (first_vertex * sizeof(TerrainVertex) + 3 * sizeof(float)));
+        const GLvoid *indices = (const GLvoid *) (m->level_index_offset[level] * sizeof(uint16_t));
+
+        glColor3ub(0x22, 0x8b, 0x22);
+        glDrawElements(GL_TRIANGLES, (GLsizei) m->level_index_count[level], GL_UNSIGNED_SHORT, indices);
+
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glColor3ub(0x1e, 0x87, 0x1e);
+        glDrawElements(GL_TRIANGLES, (GLsizei) m->level_index_count[level], GL_UNSIGNED_SHORT, indices);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void release_terrain(void)
+{
+    if (gl_delete_buffers && 0 != buffers[TERRAIN_VERTICES_BUFFER])
+    {
+        gl_delete_buffers(TERRAIN_BUFFERS_COUNT, buffers);
+        memset(buffers, 0, sizeof(buffers));
+    }
+}
@@ -0,0 +1,225 @@
+// world.c - structure-of-arrays storage for game objects of an arena.
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "debug.h"
+#include "world.h"
+
+#define WORLD_INITIAL_SHELL_CAPACITY 16
+
+static bool __world_reserve_shells(World *w, size_t capacity);
+static bool __reallocate(void **array, size_t element_size, size_t capacity);
+
+World *world_create(void)
+{
+    World *w = (World *) calloc(1, sizeof(World));
+    check_mem(w);
+
+    check(__world_reserve_shells(w, WORLD_INITIAL_SHELL_CAPACITY), "Failed to reserve shells.", "");
+    return w;
+
+    error:
+    if (w)
+    {
+        world_destroy(w);
+    }
+    return NULL;
+}
+
+void world_destroy(World *w)
+{
+    assert(w && "Nothing to destroy.");
+
+    free(w->shell_position);
+    free(w->shell_previous_position);
+    free(w->shell_direction);
+    free(w->shell_speed);
+    free(w->shell_id);
+    free(w);
+}
+
+TankHandle world_tank_allocate(World *w, Client *c)
+{
+    assert(w && "Bad world pointer.");
+    assert(c && "Bad client pointer.");
+
+    for (TankHandle t = 0; t < WORLD_MAX_TANKS; t++)
+    {
+        if (!w->tank_used[t])
+        {
+            w->tank_used[t] = true;
+            w->tank_client[t] = c;
+            return t;
+        }
+    }
+
+    return TANK_NONE;
+}
+
+void world_tank_free(World *w, TankHandle t)
+{
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && w->tank_used[t] && "Bad tank handle.");
+
+    w->tank_used[t] = false;
+    w->tank_client[t] = NULL;
+}
+
+// Tank arrays and shell id counter precede shell arrays in World, so they are copied at once.
+bool world_copy(World *dst, const World *src)
+{
+    assert(dst && "Bad destination world pointer.");
+    assert(src && "Bad source world pointer.");
+
+    if (dst->shell_capacity < src->shell_count)
+    {
+        check(__world_reserve_shells(dst, src->shell_count), "Failed to reserve shells.", "");
+    }
+
+    memcpy(dst, src, offsetof(World, shell_count));
+
+    dst->shell_count = src->shell_count;
+    memcpy(dst->shell_position, src->shell_position, src->shell_count * sizeof(Vector));
+    memcpy(dst->shell_previous_position, src->shell_previous_position, src->shell_count * sizeof(Vector));
+    memcpy(dst->shell_direction, src->shell_direction, src->shell_count * sizeof(Vector));
+    memcpy(dst->shell_speed, src->shell_speed, src->shell_count * sizeof(double));
+    memcpy(dst->shell_id, src->shell_id, src->shell_count * sizeof(size_t));
+    return true;
+
+    error:
+    return false;
+}
+
+ShellHandle world_shell_add(World *w)
+{
+    assert(w && "Bad world pointer.");
+
+    if (w->shell_count == w->shell_capacity)
+    {
+        check(__world_reserve_shells(w, 2 * w->shell_capacity), "Failed to reserve shells.", "");
+    }
+
+    w->shell_id[w->shell_count] = w->next_shell_id++;
+    return w->shell_count++;
+
+    error:
+    return SHELL_NONE;
+}
+
+void world_shell_move(World *w, ShellHandle from, ShellHandle to)
+{
+    assert(w && "Bad world pointer.");
+    assert(from < w->shell_count && to <= from && "Bad shell handles.");
+
+    if (from == to)
+    {
+        return;
+    }
+
+    w->shell_position[to] = w->shell_position[from];
+    w->shell_previous_position[to] = w->shell_previous_position[from];
+    w->shell_direction[to] = w->shell_direction[from];
+    w->shell_speed[to] = w->shell_speed[from];
+    w->shell_id[to] = w->shell_id[from];
+}
+
+void world_shell_truncate(World *w, size_t count)
+{
+    assert(w && "Bad world pointer.");
+    assert(count <= w->shell_count && "Bad shell count.");
+
+    w->shell_count = count;
+}
+
+void world_tank_bounding(World *w, TankHandle t, Bounding *primitives, Bounding *bounding)
+{
+    assert(w && "Bad world pointer.");
+    assert(t < WORLD_MAX_TANKS && "Bad tank handle.");
+    assert(primitives && bounding && "Bad bounding pointers.");
+
+    primitives[0] = (Bounding) {
+        .origin          = &w->tank_position[t],
+        .previous_origin = &w->tank_previous_position[t],
+        .orientation     = &w->tank_orientation[t],
+        .direction       = &w->tank_direction[t],
+        .offset          = { .x = 0, .y = 0, .z = 0 },
+        .speed           = &w->tank_speed[t],
+        .bounding_type   = bounding_box,
+        .data            = { .extent = TANK_BOUNDING_BOX_EXTENT }
+    };
+
+    primitives[1] = (Bounding) {
+        .origin          = &w->tank_position[t],
+        .previous_origin = &w->tank_previous_position[t],
+        .orientation     = &w->tank_orientation[t],
+        .direction       = &w->tank_direction[t],
+        .offset          = { .x = 2, .y = 0, .z = TANK_BOUNDING_SPHERE_RADIUS },
+        .speed           = &w->tank_speed[t],
+        .bounding_type   = bounding_sphere,
+        .data            = { .radius = TANK_BOUNDING_SPHERE_RADIUS }
+    };
+
+    *bounding = (Bounding) {
+        .origin              = &w->tank_position[t],
+        .previous_origin     = &w->tank_previous_position[t],
+        .orientation         = &w->tank_orientation[t],
+        .direction           = &w->tank_direction[t],
+        .offset              = { .x = 0, .y = 0, .z = 0 },
+        .speed               = &w->tank_speed[t],
+        .bounding_type       = bounding_composite,
+        .data.composite_data = {
+            .children       = primitives,
+            .children_count = TANK_BOUNDING_PRIMITIVES
+        }
+    };
+}
+
+void world_shell_bounding(World *w, ShellHandle s, Bounding *bounding)
+{
+    assert(w && "Bad world pointer.");
+    assert(s < w->shell_count && "Bad shell handle.");
+    assert(bounding && "Bad bounding pointer.");
+
+    *bounding = (Bounding) {
+        .origin          = &w->shell_position[s],
+        .previous_origin = &w->shell_previous_position[s],
+        .direction       = &w->shell_direction[s],
+        .orientation     = &w->shell_direction[s],
+        .offset          = { .x = 0, .y = 0, .z = 0 },
+        .speed           = &w->shell_speed[s],
+        .bounding_type   = bounding_sphere,
+        .data            = { .radius = SHELL_RADIUS }
+    };
+}
+
+static bool __world_reserve_shells(World *w, size_t capacity)
+{
+    assert(w && "Bad world pointer.");
+
+    check_mem(__reallocate((void **) &w->shell_position, sizeof(Vector), capacity));
+    check_mem(__reallocate((void **) &w->shell_previous_position, sizeof(Vector), capacity));
+    check_mem(__reallocate((void **) &w->shell_direction, sizeof(Vector), capacity));
+    check_mem(__reallocate((void **) &w->shell_speed, sizeof(double), capacity));
+    check_mem(__reallocate((void **) &w->shell_id, sizeof(size_t), capacity));
+
+    w->shell_capacity = capacity;
+    return true;
+    error:
+    return false;
+}
+
+static bool __reallocate(void **array, size_t element_size, size_t capacity)
+{
+    assert(array && "Bad array pointer.");
+
+    void *new_array = realloc(*array, capacity * element_size);
+    if (NULL == new_array)
+    {
+        return false;
+    }
+
+    *array = new_array;
+    return true;
+}
@@ -0,0 +1,69 @@
+// world.h - structure-of-arrays storage for game objects of an arena.
+
+#pragma once
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+//#pragma message("__WORLD_H__")
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "morrigan.h"
+#include "vector.h"
+#include "bounding.h"
+#include "server.h"
+#include "tank.h"
+#include "shell.h"
+
+#define WORLD_MAX_TANKS MAX_CLIENTS
+
+#pragma pack(push, 8)
+
+typedef struct World
+{
+    // Tanks. Fixed slots, TankHandle is slot index.
+    bool tank_used[WORLD_MAX_TANKS];
+    Client *tank_client[WORLD_MAX_TANKS];
+    Vector tank_position[WORLD_MAX_TANKS];
+    Vector tank_previous_position[WORLD_MAX_TANKS];
+    Vector tank_direction[WORLD_MAX_TANKS]; // Look.
+    Vector tank_orientation[WORLD_MAX_TANKS]; // Top.
+    double tank_speed[WORLD_MAX_TANKS];
+    int tank_hp[WORLD_MAX_TANKS];
+    int tank_fire_delay[WORLD_MAX_TANKS]; // In ticks.
+    Tank tanks[WORLD_MAX_TANKS]; // Rarely used fields.
+
+    // Shells. Dense, ShellHandle is index, in order of firing. Removed shells are compacted away in place.
+    size_t next_shell_id; // Ids are per world, so they don't depend on other arenas.
+    size_t shell_count;
+    size_t shell_capacity;
+    Vector *shell_position;
+    Vector *shell_previous_position;
+    Vector *shell_direction;
+    double *shell_speed;
+    size_t *shell_id;
+} World;
+
+#pragma pack(pop)
+
+World *world_create(void);
+void world_destroy(World *w);
+
+// Client pointers are copied as is.
+bool world_copy(World *dst, const World *src);
+
+TankHandle world_tank_allocate(World *w, Client *c);
+void world_tank_free(World *w, TankHandle t);
+
+// New shell gets next id of world.
+ShellHandle world_shell_add(World *w);
+// Compaction: kept shells are moved down in order, then shells from count on are dropped.
+void world_shell_move(World *w, ShellHandle from, ShellHandle to);
+void world_shell_truncate(World *w, size_t count);
+
+// Boundings point into world arrays: valid until shells are added or removed.
+void world_tank_bounding(World *w, TankHandle t, Bounding *primitives, Bounding *bounding);
+void world_shell_bounding(World *w, ShellHandle s, Bounding *bounding);
+
+#endif /* __WORLD_H__ */